@@ -34,18 +34,6 @@ endif()
 add_compile_definitions(LF_DRKEY_FETCHER=${LF_DRKEY_FETCHER})
 add_compile_definitions(LF_DRKEY_FETCHER_${LF_DRKEY_FETCHER}=1)
 
-set(LF_CBCMAC "OPENSSL" CACHE STRING "CBC MAC implementation (OPENSSL, AESNI). AESNI requires hardware support.")
-if(LF_CBCMAC STREQUAL "AESNI")
-    add_subdirectory(lib/aesni/)
-    target_link_libraries(${EXEC}  PRIVATE aesni)
-elseif(LF_CBCMAC STREQUAL "OPENSSL")
-    target_link_libraries(${EXEC}  PRIVATE OpenSSL::SSL)
-else()
-    message( FATAL_ERROR "Unknown LF_CBCMAC parameter: ${LF_CBCMAC}" )
-endif()
-add_compile_definitions(LF_CBCMAC=${LF_CBCMAC})
-add_compile_definitions(LF_CBCMAC_${LF_CBCMAC}=1)
-
 # Add CMake option which is translated into a compiler flag (default: ON or OFF).
 function(option_compile_definition flag help default )
     option(${flag} ${help} ${default})
@@ -66,10 +54,14 @@ option_compile_definition(LF_IPV6 "Use IPv6 (ON, OFF)" OFF)
 option_compile_definition(LF_OFFLOAD_CKSUM "Offload checksum calculation to NIC (ON, OFF)" ON)
 option_compile_definition(LF_JUMBO_FRAME "Enable jumbo frame support (ON, OFF)" OFF)
 
+# Process packet bursts stage-wise instead of packet by packet
+option_compile_definition(LF_WORKER_BURST_PIPELINE "Perform the worker checks stage-wise over a whole packet burst (OFF, ON)" OFF)
+
 # Options to omit actions
 option_compile_definition(LF_WORKER_OMIT_TIME_UPDATE "Omit time update for workers (OFF, ON)" OFF)
 option_compile_definition(LF_WORKER_OMIT_KEY_GET "Omit key fetching for workers (OFF, ON)" OFF)
 option_compile_definition(LF_WORKER_OMIT_DECAPSULATION "Omit decapsulation (OFF, ON)" OFF)
+option_compile_definition(LF_WORKER_OMIT_HEAVY_HITTER "Omit heavy hitter detection (OFF, ON)" OFF)
 
 # Options to omit core checks
 option_compile_definition(LF_WORKER_OMIT_HASH_CHECK "Omit hash check (OFF, ON)" OFF)
@@ -78,6 +70,9 @@ option_compile_definition(LF_WORKER_OMIT_TIMESTAMP_CHECK "Omit timestamp check (
 option_compile_definition(LF_WORKER_OMIT_DUPLICATE_CHECK "Omit duplicate check (OFF, ON)" OFF)
 option_compile_definition(LF_WORKER_OMIT_RATELIMIT_CHECK "Omit ratelimiter check (OFF, ON)" OFF)
 
+# Rate limiter engine
+option_compile_definition(LF_RATELIMITER_TSB "Use timestamp buckets instead of token buckets for the rate limiter (OFF, ON)" OFF)
+
 # Option to ignore check results
 option(LF_WORKER_IGNORE_CHECKS "Ignore check results (but still perform all checks)" OFF)
 if(LF_WORKER_IGNORE_CHECKS)
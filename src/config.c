@@ -10,6 +10,10 @@
 #include <sys/stat.h>
 
 #include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_hash.h>
+#include <rte_jhash.h>
 
 #include "config.h"
 #include "lf.h"
@@ -23,11 +27,12 @@
 #define FIELD_ISD_AS "isd_as"
 #define FIELD_PEERS  "peers"
 
-#define FIELD_RATELIMIT    "ratelimit"
-#define FIELD_PACKET_RATE  "packet_rate"
-#define FIELD_PACKET_BURST "packet_burst"
-#define FIELD_BYTE_RATE    "byte_rate"
-#define FIELD_BYTE_BURST   "byte_burst"
+#define FIELD_RATELIMIT      "ratelimit"
+#define FIELD_HOST_RATELIMIT "host_ratelimit"
+#define FIELD_PACKET_RATE    "packet_rate"
+#define FIELD_PACKET_BURST   "packet_burst"
+#define FIELD_BYTE_RATE      "byte_rate"
+#define FIELD_BYTE_BURST     "byte_burst"
 
 #define FIELD_PORT       "port"
 #define FIELD_IP         "ip"
@@ -100,6 +105,10 @@ peer_init(struct lf_config_peer *config_peer)
 		/* per default no rate limit is defined for a peer */
 		.ratelimit_option = false,
 		.ratelimit = zero_ratelimit,
+
+		/* per default no host rate limit is defined for a peer */
+		.host_ratelimit_option = false,
+		.host_ratelimit = zero_ratelimit,
 	};
 }
 
@@ -355,6 +364,14 @@ parse_peer(json_value *json_val, struct lf_config_peer *peer)
 				error_count++;
 			}
 			peer->ratelimit_option = true;
+		} else if (strcmp(field_name, FIELD_HOST_RATELIMIT) == 0) {
+			res = parse_ratelimit(field_value, &peer->host_ratelimit);
+			if (res != 0) {
+				LF_LOG(ERR, "Invalid host ratelimit (%d:%d)\n",
+						field_value->line, field_value->col);
+				error_count++;
+			}
+			peer->host_ratelimit_option = true;
 		} else if (strcmp(field_name, FIELD_SHARED_SECRETS) == 0) {
 			res = parse_shared_secret_list(field_value, peer->shared_secrets);
 			if (res >= 0) {
@@ -1062,4 +1079,50 @@ lf_config_free(struct lf_config *config)
 	}
 
 	free(config);
-}
\ No newline at end of file
+}
+
+struct rte_hash *
+lf_config_peer_set_new(const struct lf_config *config)
+{
+	int res;
+	struct rte_hash *set;
+	struct rte_hash_parameters params = { 0 };
+	struct lf_config_peer *peer;
+	struct lf_config_peer_key key;
+	/* rte_hash table name */
+	char name[RTE_HASH_NAMESIZE];
+	/* counter to ensure unique rte_hash table name */
+	static int counter = 0;
+
+	(void)snprintf(name, sizeof(name), "lf_config_peers_%d", counter);
+	counter += 1;
+
+	params.name = name;
+	/* DPDK hash table entry must be at least 8 (undocumented) */
+	params.entries = RTE_MAX((uint32_t)config->nb_peers, 8U);
+	params.key_len = sizeof(struct lf_config_peer_key);
+	params.hash_func = rte_jhash;
+	params.hash_func_init_val = 0;
+	params.socket_id = SOCKET_ID_ANY;
+	/* ensure that insertion always succeeds */
+	params.extra_flag = RTE_HASH_EXTRA_FLAGS_EXT_TABLE;
+
+	set = rte_hash_create(&params);
+	if (set == NULL) {
+		LF_LOG(ERR, "Hash creation failed with: %d\n", rte_errno);
+		return NULL;
+	}
+
+	for (peer = config->peers; peer != NULL; peer = peer->next) {
+		key.as = peer->isd_as;
+		key.drkey_protocol = peer->drkey_protocol;
+		res = rte_hash_add_key(set, &key);
+		if (res < 0) {
+			LF_LOG(ERR, "Fail to add peer to set (err = %d)\n", res);
+			rte_hash_free(set);
+			return NULL;
+		}
+	}
+
+	return set;
+}
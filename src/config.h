@@ -49,6 +49,10 @@ struct lf_config_peer {
 	bool ratelimit_option; /* if a rate limit is defined */
 	struct lf_config_ratelimit ratelimit;
 
+	/* rate limit for each source host of the peer */
+	bool host_ratelimit_option; /* if a host rate limit is defined */
+	struct lf_config_ratelimit host_ratelimit;
+
 	/* preconfigured shared keys */
 	bool shared_secrets_configured_option; /* if shared secrets are defined*/
 	struct lf_config_shared_secret shared_secrets[LF_CONFIG_SV_MAX];
@@ -182,4 +186,25 @@ lf_config_new();
 void
 lf_config_free(struct lf_config *config);
 
+/*
+ * Key of the peer set. It has the same layout as the dictionary keys of the
+ * key manager, key fetcher, and rate limiter, such that their keys can be
+ * looked up in the set directly.
+ */
+struct lf_config_peer_key {
+	uint64_t as;             /* network byte order */
+	uint16_t drkey_protocol; /* network byte order */
+} __attribute__((__packed__));
+
+struct rte_hash;
+
+/**
+ * Create a hash set containing the keys of the config's peers, such that the
+ * entries to be removed when applying the config are determined in linear
+ * time. The set has to be freed with rte_hash_free().
+ * @return Returns new hash set if succeeds. Otherwise, NULL.
+ */
+struct rte_hash *
+lf_config_peer_set_new(const struct lf_config *config);
+
 #endif /* LF_CONFIG_H */
\ No newline at end of file
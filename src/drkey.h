@@ -59,19 +59,18 @@ struct lf_keymanager_key_container {
 };
 
 /**
- * Derive HOST-AS DRKey from AS-AS DRKey.
+ * Write the input of the derivation step from an AS-AS DRKey to a HOST-AS
+ * DRKey into the buffer.
  *
- * @param drkey_ctx DRKey cipher context.
- * @param drkey_as_as AS-AS DRKey.
  * @param fast_side_host Fast side host address.
  * @param drkey_protocol (network byte order).
- * @param drkey_ha Returning HOST-AS DRKey.
+ * @param buf Buffer to write the input to.
+ * @return Length of the input in bytes.
  */
-static inline void
-lf_drkey_derive_host_as_from_as_as(struct lf_crypto_drkey_ctx *drkey_ctx,
-		const struct lf_crypto_drkey *drkey_as_as,
-		const struct lf_host_addr *fast_side_host,
-		const uint16_t drkey_protocol, struct lf_crypto_drkey *drkey_ha)
+static inline int
+lf_drkey_host_as_input(const struct lf_host_addr *fast_side_host,
+		const uint16_t drkey_protocol,
+		uint8_t buf[2 * LF_CRYPTO_CBC_BLOCK_SIZE])
 {
 	assert(LF_HOST_ADDR_LENGTH(fast_side_host) <= LF_CRYPTO_CBC_BLOCK_SIZE);
 
@@ -89,29 +88,26 @@ lf_drkey_derive_host_as_from_as_as(struct lf_crypto_drkey_ctx *drkey_ctx,
 
 	int buf_len = (addr_len == 4) ? LF_CRYPTO_CBC_BLOCK_SIZE
 	                              : 2 * LF_CRYPTO_CBC_BLOCK_SIZE;
-	uint8_t buf[2 * LF_CRYPTO_CBC_BLOCK_SIZE] = { 0 };
+	memset(buf, 0, 2 * LF_CRYPTO_CBC_BLOCK_SIZE);
 	buf[0] = LF_DRKEY_DERIVATION_TYPE_HOST_AS;
 	memcpy(buf + 1, &drkey_protocol, 2);
 	buf[3] = addr_type_len;
 	memcpy(buf + 4, addr, addr_len);
 
-	lf_crypto_drkey_derivation_step(drkey_ctx, drkey_as_as, buf, buf_len,
-			drkey_ha);
+	return buf_len;
 }
 
 /**
- * Derive HOST-HOST DRKey from HOST-AS DRKey.
+ * Write the input of the derivation step from a HOST-AS DRKey to a HOST-HOST
+ * DRKey into the buffer.
  *
- * @param drkey_ctx DRKey cipher context.
- * @param drkey_host_as HOST-AS DRKey.
  * @param slow_side_host Slow side host address.
- * @param drkey_hh Returning HOST-HOST DRKey.
+ * @param buf Buffer to write the input to.
+ * @return Length of the input in bytes.
  */
-static inline void
-lf_drkey_derive_host_host_from_host_as(struct lf_crypto_drkey_ctx *drkey_ctx,
-		const struct lf_crypto_drkey *drkey_host_as,
-		const struct lf_host_addr *slow_side_host,
-		struct lf_crypto_drkey *drkey_hh)
+static inline int
+lf_drkey_host_host_input(const struct lf_host_addr *slow_side_host,
+		uint8_t buf[2 * LF_CRYPTO_CBC_BLOCK_SIZE])
 {
 	assert(LF_HOST_ADDR_LENGTH(slow_side_host) <= LF_CRYPTO_CBC_BLOCK_SIZE);
 
@@ -129,11 +125,53 @@ lf_drkey_derive_host_host_from_host_as(struct lf_crypto_drkey_ctx *drkey_ctx,
 
 	int buf_len = (addr_len == 4) ? LF_CRYPTO_CBC_BLOCK_SIZE
 	                              : 2 * LF_CRYPTO_CBC_BLOCK_SIZE;
-	uint8_t buf[2 * LF_CRYPTO_CBC_BLOCK_SIZE] = { 0 };
+	memset(buf, 0, 2 * LF_CRYPTO_CBC_BLOCK_SIZE);
 	buf[0] = LF_DRKEY_DERIVATION_TYPE_HOST_HOST;
 	buf[1] = addr_type_len;
 	memcpy(buf + 2, addr, addr_len);
 
+	return buf_len;
+}
+
+/**
+ * Derive HOST-AS DRKey from AS-AS DRKey.
+ *
+ * @param drkey_ctx DRKey cipher context.
+ * @param drkey_as_as AS-AS DRKey.
+ * @param fast_side_host Fast side host address.
+ * @param drkey_protocol (network byte order).
+ * @param drkey_ha Returning HOST-AS DRKey.
+ */
+static inline void
+lf_drkey_derive_host_as_from_as_as(struct lf_crypto_drkey_ctx *drkey_ctx,
+		const struct lf_crypto_drkey *drkey_as_as,
+		const struct lf_host_addr *fast_side_host,
+		const uint16_t drkey_protocol, struct lf_crypto_drkey *drkey_ha)
+{
+	uint8_t buf[2 * LF_CRYPTO_CBC_BLOCK_SIZE];
+	int buf_len = lf_drkey_host_as_input(fast_side_host, drkey_protocol, buf);
+
+	lf_crypto_drkey_derivation_step(drkey_ctx, drkey_as_as, buf, buf_len,
+			drkey_ha);
+}
+
+/**
+ * Derive HOST-HOST DRKey from HOST-AS DRKey.
+ *
+ * @param drkey_ctx DRKey cipher context.
+ * @param drkey_host_as HOST-AS DRKey.
+ * @param slow_side_host Slow side host address.
+ * @param drkey_hh Returning HOST-HOST DRKey.
+ */
+static inline void
+lf_drkey_derive_host_host_from_host_as(struct lf_crypto_drkey_ctx *drkey_ctx,
+		const struct lf_crypto_drkey *drkey_host_as,
+		const struct lf_host_addr *slow_side_host,
+		struct lf_crypto_drkey *drkey_hh)
+{
+	uint8_t buf[2 * LF_CRYPTO_CBC_BLOCK_SIZE];
+	int buf_len = lf_drkey_host_host_input(slow_side_host, buf);
+
 	lf_crypto_drkey_derivation_step(drkey_ctx, drkey_host_as, buf, buf_len,
 			drkey_hh);
 }
@@ -162,4 +200,102 @@ lf_drkey_derive_host_host_from_as_as(struct lf_crypto_drkey_ctx *drkey_ctx,
 			drkey_hh);
 }
 
+/**
+ * Perform up to LF_CRYPTO_CBCMAC_LANES derivation steps whose inputs are
+ * either one or two blocks long. The derivation steps are grouped by the input
+ * length, such that each group is processed by a single burst derivation.
+ *
+ * @param drkey_ctx DRKey cipher context.
+ * @param drkey DRKeys to derive from.
+ * @param buf Inputs of the derivation steps.
+ * @param buf_len Length of the inputs.
+ * @param drkey_out Returning derived DRKeys.
+ * @param nb_keys Number of keys to derive (at most LF_CRYPTO_CBCMAC_LANES).
+ */
+static inline void
+lf_drkey_derivation_step_burst(struct lf_crypto_drkey_ctx *drkey_ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		uint8_t buf[][2 * LF_CRYPTO_CBC_BLOCK_SIZE], const int buf_len[],
+		struct lf_crypto_drkey *const drkey_out[], unsigned int nb_keys)
+{
+	unsigned int i, n;
+	int len;
+	const struct lf_crypto_drkey *group_drkey[LF_CRYPTO_CBCMAC_LANES];
+	const uint8_t *group_buf[LF_CRYPTO_CBCMAC_LANES];
+	struct lf_crypto_drkey *group_drkey_out[LF_CRYPTO_CBCMAC_LANES];
+
+	assert(nb_keys <= LF_CRYPTO_CBCMAC_LANES);
+
+	for (len = LF_CRYPTO_CBC_BLOCK_SIZE; len <= 2 * LF_CRYPTO_CBC_BLOCK_SIZE;
+			len += LF_CRYPTO_CBC_BLOCK_SIZE) {
+		n = 0;
+		for (i = 0; i < nb_keys; i++) {
+			if (buf_len[i] != len) {
+				continue;
+			}
+			group_drkey[n] = drkey[i];
+			group_buf[n] = buf[i];
+			group_drkey_out[n] = drkey_out[i];
+			n++;
+		}
+		if (n > 0) {
+			lf_crypto_drkey_derivation_step_burst(drkey_ctx, group_drkey,
+					group_buf, len, group_drkey_out, n);
+		}
+	}
+}
+
+/**
+ * Derive a burst of HOST-HOST DRKeys from AS-AS DRKeys. The result is the same
+ * as calling lf_drkey_derive_host_host_from_as_as() for each key, but the
+ * CBC-MACs of the derivation steps are computed in parallel.
+ *
+ * @param drkey_ctx DRKey cipher context.
+ * @param drkey_as_as AS-AS DRKeys.
+ * @param fast_side_host Fast side host addresses.
+ * @param slow_side_host Slow side host addresses.
+ * @param drkey_protocol (network byte order).
+ * @param drkey_hh Returning HOST-HOST DRKeys.
+ * @param nb_keys Number of keys to derive.
+ */
+static inline void
+lf_drkey_derive_host_host_from_as_as_burst(
+		struct lf_crypto_drkey_ctx *drkey_ctx,
+		const struct lf_crypto_drkey *const drkey_as_as[],
+		const struct lf_host_addr *const fast_side_host[],
+		const struct lf_host_addr *const slow_side_host[],
+		const uint16_t drkey_protocol[],
+		struct lf_crypto_drkey *const drkey_hh[], unsigned int nb_keys)
+{
+	unsigned int i, j, n;
+	uint8_t buf[LF_CRYPTO_CBCMAC_LANES][2 * LF_CRYPTO_CBC_BLOCK_SIZE];
+	int buf_len[LF_CRYPTO_CBCMAC_LANES];
+	struct lf_crypto_drkey drkey_ha[LF_CRYPTO_CBCMAC_LANES];
+	struct lf_crypto_drkey *drkey_ha_out[LF_CRYPTO_CBCMAC_LANES];
+	const struct lf_crypto_drkey *drkey_ha_in[LF_CRYPTO_CBCMAC_LANES];
+
+	for (j = 0; j < LF_CRYPTO_CBCMAC_LANES; j++) {
+		drkey_ha_out[j] = &drkey_ha[j];
+		drkey_ha_in[j] = &drkey_ha[j];
+	}
+
+	for (i = 0; i < nb_keys; i += LF_CRYPTO_CBCMAC_LANES) {
+		n = nb_keys - i < LF_CRYPTO_CBCMAC_LANES ? nb_keys - i
+		                                         : LF_CRYPTO_CBCMAC_LANES;
+
+		for (j = 0; j < n; j++) {
+			buf_len[j] = lf_drkey_host_as_input(fast_side_host[i + j],
+					drkey_protocol[i + j], buf[j]);
+		}
+		lf_drkey_derivation_step_burst(drkey_ctx, &drkey_as_as[i], buf,
+				buf_len, drkey_ha_out, n);
+
+		for (j = 0; j < n; j++) {
+			buf_len[j] = lf_drkey_host_host_input(slow_side_host[i + j], buf[j]);
+		}
+		lf_drkey_derivation_step_burst(drkey_ctx, drkey_ha_in, buf, buf_len,
+				&drkey_hh[i], n);
+	}
+}
+
 #endif // LF_DRKEY_H
\ No newline at end of file
@@ -5,15 +5,19 @@
 #include <rte_branch_prediction.h>
 #include <rte_lcore.h>
 #include <rte_malloc.h>
+#include <rte_prefetch.h>
+#include <rte_telemetry.h>
 
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "duplicate_filter.h"
+#include "lib/hash/aeshash.h"
 #include "lib/hash/murmurhash.h"
 #include "lib/log/log.h"
 #include "lib/math/sat_op.h"
+#include "lib/telemetry/counters.h"
 
 /**
  * Log function for duplicate filter service (not on data path).
@@ -40,14 +44,42 @@ check_bit_set_bit(uint8_t *bf_array, unsigned int bit, int set_bit)
 	}
 }
 
+/**
+ * Variant of check_bit_set_bit for shared filters, which always sets the bit.
+ * The bit is set with a relaxed atomic OR, whose result tells if another worker
+ * has set the bit in the meantime.
+ */
+inline static int
+check_bit_set_bit_shared(uint8_t *bf_array, unsigned int bit,
+		struct lf_duplicate_filter_statistics *statistics)
+{
+	unsigned int byte = bit >> 3;
+	uint8_t mask = 1 << (bit & 0x7); /* 1 << (bit % 8) */
+
+	if (bf_array[byte] & mask) {
+		/* hit */
+		return 1;
+	}
+
+	statistics->shared_updates++;
+	if (__atomic_fetch_or(&bf_array[byte], mask, __ATOMIC_RELAXED) & mask) {
+		/* hit, since another worker has set the bit in the meantime */
+		statistics->shared_update_races++;
+		return 1;
+	}
+
+	/* no hit */
+	return 0;
+}
 
 inline static int
 check_key_add_key(uint8_t *bf_arrays[], unsigned int nb_bf,
 		unsigned int current_bf, uint32_t modulo_mask, unsigned int bf_hashes,
-		unsigned int secret, const uint8_t key[16])
+		uint32_t hash_1, uint32_t hash_2, bool shared,
+		struct lf_duplicate_filter_statistics *statistics)
 {
 	unsigned int i, j;
-	uint32_t hash_1, hash_2, a, b;
+	uint32_t a, b;
 	uint32_t bit;
 	unsigned int hit_counter;
 
@@ -57,9 +89,6 @@ check_key_add_key(uint8_t *bf_arrays[], unsigned int nb_bf,
 	 * hashes[i] = h1(x) + i*h2(x) + (i*i*i - i)/6
 	 */
 
-	hash_1 = lf_murmurhash(key, secret);
-	hash_2 = lf_murmurhash(key, hash_1);
-
 	hit_counter = 0;
 
 	a = hash_1;
@@ -70,7 +99,12 @@ check_key_add_key(uint8_t *bf_arrays[], unsigned int nb_bf,
 		a += b;
 		b += i;
 
-		if (check_bit_set_bit(bf_arrays[current_bf], bit, 1)) {
+		if (shared) {
+			if (check_bit_set_bit_shared(bf_arrays[current_bf], bit,
+						statistics)) {
+				hit_counter++;
+			}
+		} else if (check_bit_set_bit(bf_arrays[current_bf], bit, 1)) {
 			hit_counter++;
 		}
 	}
@@ -80,7 +114,7 @@ check_key_add_key(uint8_t *bf_arrays[], unsigned int nb_bf,
 		return 1;
 	}
 
-	for (j = 0; j < nb_bf - 1; ++j) {
+	for (j = 0; j < nb_bf; ++j) {
 		if (j == current_bf) {
 			continue;
 		}
@@ -111,30 +145,538 @@ check_key_add_key(uint8_t *bf_arrays[], unsigned int nb_bf,
 	return 0;
 }
 
+/*
+ * Number of 64 bit words in a block of the blocked Bloom filter and the mask to
+ * select a bit within a block.
+ */
+#define BLOCK_WORDS    (LF_DUPLICATE_FILTER_BLOCK_SIZE / sizeof(uint64_t))
+#define BLOCK_BIT_MASK (LF_DUPLICATE_FILTER_BLOCK_SIZE * 8 - 1)
+
+/**
+ * Blocked Bloom filter variant of check_key_add_key.
+ * The first hash selects the block, and the bits within the block are derived
+ * from the second hash. The bits are collected in a block sized mask, such that
+ * a filter is tested (and updated) with a few word-wise operations on a single
+ * cache line, which the compiler can vectorize.
+ * For shared filters, the missing bits are set word-wise with atomic OR
+ * operations.
+ */
+inline static int
+check_key_add_key_blocked(uint8_t *bf_arrays[], unsigned int nb_bf,
+		unsigned int current_bf, uint32_t block_mask, unsigned int bf_hashes,
+		uint32_t hash_1, uint32_t hash_2, bool shared,
+		struct lf_duplicate_filter_statistics *statistics)
+{
+	unsigned int i, j;
+	uint32_t a, b;
+	uint32_t bit;
+	size_t block_offset;
+	uint64_t mask[BLOCK_WORDS] = { 0 };
+	uint64_t *block;
+	uint64_t missing, word, old;
+
+	block_offset =
+			(size_t)(hash_1 & block_mask) * LF_DUPLICATE_FILTER_BLOCK_SIZE;
+
+	/* fetch the block of all filters while computing the mask */
+	for (j = 0; j < nb_bf; ++j) {
+		rte_prefetch0(bf_arrays[j] + block_offset);
+	}
+
+	/* enhanced double hashing within the block */
+	a = hash_2;
+	b = (hash_2 >> 16) | (hash_2 << 16);
+	for (i = 0; i < bf_hashes; ++i) {
+		bit = a & BLOCK_BIT_MASK;
+		a += b;
+		b += i;
+		mask[bit >> 6] |= (uint64_t)1 << (bit & 0x3F);
+	}
+
+	/* check and add key to the current bloom filter */
+	block = (uint64_t *)(bf_arrays[current_bf] + block_offset);
+	missing = 0;
+	for (i = 0; i < BLOCK_WORDS; ++i) {
+		missing |= mask[i] & ~block[i];
+	}
+	if (missing == 0) {
+		/* collision detected */
+		return 1;
+	}
+	/* only write if required, such that the cache line is not dirtied */
+	if (shared) {
+		missing = 0;
+		for (i = 0; i < BLOCK_WORDS; ++i) {
+			word = mask[i] & ~block[i];
+			if (word == 0) {
+				continue;
+			}
+			statistics->shared_updates++;
+			old = __atomic_fetch_or(&block[i], word, __ATOMIC_RELAXED);
+			if (old & word) {
+				statistics->shared_update_races++;
+			}
+			missing |= word & ~old;
+		}
+		if (missing == 0) {
+			/* another worker has added the key in the meantime */
+			return 1;
+		}
+	} else {
+		for (i = 0; i < BLOCK_WORDS; ++i) {
+			block[i] |= mask[i];
+		}
+	}
+
+	for (j = 0; j < nb_bf; ++j) {
+		if (j == current_bf) {
+			continue;
+		}
+
+		block = (uint64_t *)(bf_arrays[j] + block_offset);
+		missing = 0;
+		for (i = 0; i < BLOCK_WORDS; ++i) {
+			missing |= mask[i] & ~block[i];
+		}
+		if (missing == 0) {
+			/* collision detected */
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Cuckoo filter entries consist of a 24 bit fingerprint and the 8 bit time
+ * slice in which the entry has been inserted or last seen. Fingerprints are
+ * never 0, such that 0 marks an empty entry.
+ */
+#define CUCKOO_ENTRY(fp, slice) (((uint32_t)(fp) << 8) | (uint8_t)(slice))
+#define CUCKOO_ENTRY_FP(entry)  ((entry) >> 8)
+#define CUCKOO_ENTRY_SLICE(entry) ((uint8_t)(entry))
+
+/**
+ * An entry is valid if it is not empty and has not expired, i.e., it has been
+ * inserted less than nb_slices time slices ago.
+ */
+inline static int
+cuckoo_entry_valid(uint32_t entry, uint8_t slice, unsigned int nb_slices)
+{
+	return entry != 0 &&
+	       (uint8_t)(slice - CUCKOO_ENTRY_SLICE(entry)) < nb_slices;
+}
+
+/**
+ * Partial-key cuckoo hashing: the alternative bucket only depends on the
+ * current bucket and the fingerprint, such that entries can be relocated
+ * without knowing the key.
+ */
+inline static uint32_t
+cuckoo_alt_index(uint32_t index, uint32_t fp, uint32_t bucket_mask)
+{
+	return (index ^ (fp * 0x5bd1e995)) & bucket_mask;
+}
+
+/**
+ * Remove expired entries in the range [begin, end) (in bytes).
+ */
+static void
+cuckoo_scrub(struct lf_duplicate_filter_worker *df, unsigned int begin,
+		unsigned int end)
+{
+	unsigned int i;
+	uint32_t *table = df->cuckoo_table;
+
+	for (i = begin / sizeof(uint32_t); i < end / sizeof(uint32_t); ++i) {
+		if (table[i] != 0 &&
+				!cuckoo_entry_valid(table[i], df->slice, df->nb_bf)) {
+			table[i] = 0;
+		}
+	}
+}
+
+void
+lf_duplicate_filter_cuckoo_scrub_chunk(struct lf_duplicate_filter_worker *df)
+{
+	unsigned int end;
+
+	end = df->clear_offset + LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE;
+	if (end > df->bf_size) {
+		end = df->bf_size;
+	}
+	cuckoo_scrub(df, df->clear_offset, end);
+	df->clear_offset = end;
+}
+
+/**
+ * Insert the entry into the bucket at index, which has no free entry, by
+ * relocating entries to their alternative bucket. If no free entry is found
+ * within LF_DUPLICATE_FILTER_CUCKOO_MAX_KICKS relocations, the last relocated
+ * entry is dropped, i.e., a duplicate of its key might not be detected.
+ */
+static void
+cuckoo_relocate(struct lf_duplicate_filter_worker *df, uint32_t index,
+		uint32_t entry)
+{
+	unsigned int kick, i;
+	uint32_t *bucket;
+	uint32_t victim;
+
+	for (kick = 0; kick < LF_DUPLICATE_FILTER_CUCKOO_MAX_KICKS; ++kick) {
+		/* replace a pseudo-randomly selected entry */
+		bucket = &df->cuckoo_table[index *
+		                           LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES];
+		i = (CUCKOO_ENTRY_FP(entry) + kick) %
+		    LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES;
+		victim = bucket[i];
+		bucket[i] = entry;
+		entry = victim;
+
+		/* try to place the replaced entry in its alternative bucket */
+		index = cuckoo_alt_index(index, CUCKOO_ENTRY_FP(entry),
+				df->bucket_mask);
+		bucket = &df->cuckoo_table[index *
+		                           LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES];
+		for (i = 0; i < LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES; ++i) {
+			if (!cuckoo_entry_valid(bucket[i], df->slice, df->nb_bf)) {
+				bucket[i] = entry;
+				return;
+			}
+		}
+	}
+
+	df->statistics.cuckoo_insert_failures++;
+}
+
+/**
+ * Cuckoo filter variant of check_key_add_key.
+ * The key is looked up in its two candidate buckets. If it is found, the time
+ * slice of the entry is updated. Otherwise, the key is inserted.
+ */
+inline static void
+cuckoo_indices(struct lf_duplicate_filter_worker *df, uint32_t hash_1,
+		uint32_t hash_2, uint32_t *fp, uint32_t index[2])
+{
+	*fp = hash_2 >> 8;
+	if (*fp == 0) {
+		*fp = 1;
+	}
+	index[0] = hash_1 & df->bucket_mask;
+	index[1] = cuckoo_alt_index(index[0], *fp, df->bucket_mask);
+}
+
+inline static int
+check_key_add_key_cuckoo(struct lf_duplicate_filter_worker *df,
+		uint32_t hash_1, uint32_t hash_2)
+{
+	unsigned int b, i;
+	uint32_t fp;
+	uint32_t index[2];
+	uint32_t *bucket;
+	uint32_t *free_entry = NULL;
+
+	cuckoo_indices(df, hash_1, hash_2, &fp, index);
+	rte_prefetch0(&df->cuckoo_table[index[1] *
+	                                LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES]);
+
+	for (b = 0; b < 2; ++b) {
+		bucket = &df->cuckoo_table[index[b] *
+		                           LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES];
+		for (i = 0; i < LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES; ++i) {
+			if (!cuckoo_entry_valid(bucket[i], df->slice, df->nb_bf)) {
+				if (free_entry == NULL) {
+					free_entry = &bucket[i];
+				}
+			} else if (CUCKOO_ENTRY_FP(bucket[i]) == fp) {
+				/* collision detected */
+				bucket[i] = CUCKOO_ENTRY(fp, df->slice);
+				return 1;
+			}
+		}
+	}
+
+	if (likely(free_entry != NULL)) {
+		*free_entry = CUCKOO_ENTRY(fp, df->slice);
+	} else {
+		cuckoo_relocate(df, index[hash_2 & 1], CUCKOO_ENTRY(fp, df->slice));
+	}
+
+	return 0;
+}
+
+static void
+rotate_cuckoo(struct lf_duplicate_filter_worker *df, uint64_t ns_now)
+{
+	df->statistics.rotations++;
+
+	/*
+	 * Remove the expired entries that remain (if any), such that no entry is
+	 * older than nb_bf + 1 time slices and the time slices do not wrap around.
+	 */
+	if (unlikely(df->clear_offset < df->bf_size)) {
+		df->statistics.rotation_clears++;
+		cuckoo_scrub(df, df->clear_offset, df->bf_size);
+	}
+
+	df->slice++;
+	df->clear_offset = 0;
+
+	df->last_rotation = ns_now;
+}
+
+static void
+rotate(struct lf_duplicate_filter_worker *df, uint64_t ns_now)
+{
+	uint8_t *tmp;
+
+	df->statistics.rotations++;
+
+	/* clear the remaining part of the spare filter (if any) */
+	if (unlikely(df->clear_offset < df->bf_size)) {
+		df->statistics.rotation_clears++;
+		(void)memset(df->bf_arrays[df->nb_bf] + df->clear_offset, 0,
+				df->bf_size - df->clear_offset);
+	}
+
+	/* replace the oldest filter with the cleared spare filter */
+	df->current_bf = (df->current_bf + 1U) % df->nb_bf;
+	tmp = df->bf_arrays[df->current_bf];
+	df->bf_arrays[df->current_bf] = df->bf_arrays[df->nb_bf];
+	df->bf_arrays[df->nb_bf] = tmp;
+	df->clear_offset = 0;
+
+	df->last_rotation = ns_now;
+}
+
+/**
+ * Set the worker's filters to the shared filters of the worker's epoch.
+ * The filters are ordered as if the worker rotated its own filters, i.e., the
+ * filter of epoch e is at index e % nb_bf, and the spare filter, which is used
+ * in the next epoch, is at index nb_bf.
+ */
+static void
+set_shared_arrays(struct lf_duplicate_filter_worker *df)
+{
+	unsigned int i;
+	unsigned int nb_arrays = df->nb_bf + 1;
+	/* offset, which is a multiple of nb_bf and nb_arrays, to avoid underflow */
+	uint64_t epoch = df->epoch + (uint64_t)df->nb_bf * nb_arrays;
+
+	for (i = 0; i < df->nb_bf; ++i) {
+		df->bf_arrays[(epoch - i) % df->nb_bf] =
+				df->shared->bf_arrays[(epoch - i) % nb_arrays];
+	}
+	df->bf_arrays[df->nb_bf] = df->shared->bf_arrays[(epoch + 1) % nb_arrays];
+	df->current_bf = epoch % df->nb_bf;
+}
+
+/**
+ * Rotation for shared filters. The filters are selected according to the
+ * epoch, i.e., ns_now / bf_period, such that all workers agree on them.
+ * The worker that first observes a new epoch claims the rotation and is then
+ * responsible for clearing the spare filter.
+ *
+ * If the spare filter has not been cleared completely in time, the claiming
+ * worker clears it on rotation. Other workers might have inserted keys in the
+ * meantime, which are lost. This can only cause undetected duplicates but no
+ * false positives.
+ */
+static void
+rotate_shared(struct lf_duplicate_filter_worker *df, uint64_t ns_now)
+{
+	struct lf_duplicate_filter_shared *shared = df->shared;
+	uint64_t epoch = ns_now / df->bf_period;
+	uint64_t expected;
+	bool claimed = false;
+
+	df->statistics.rotations++;
+
+	expected = atomic_load_explicit(&shared->epoch, memory_order_relaxed);
+	while (expected < epoch) {
+		if (atomic_compare_exchange_weak_explicit(&shared->epoch, &expected,
+					epoch, memory_order_relaxed, memory_order_relaxed)) {
+			claimed = true;
+			break;
+		}
+	}
+
+	/* synchronizes with the worker that has cleared the filter */
+	if (atomic_load_explicit(&shared->cleared_epoch, memory_order_acquire) !=
+					epoch &&
+			claimed) {
+		df->statistics.rotation_clears++;
+		(void)memset(shared->bf_arrays[epoch % (df->nb_bf + 1)], 0,
+				df->bf_size);
+		atomic_store_explicit(&shared->cleared_epoch, epoch,
+				memory_order_release);
+	}
+
+	df->epoch = epoch;
+	set_shared_arrays(df);
+	/* only the claiming worker clears the spare filter */
+	df->clear_offset = claimed ? 0 : df->bf_size;
+
+	df->last_rotation = epoch * df->bf_period;
+}
+
+void
+lf_duplicate_filter_hash(struct lf_duplicate_filter_worker *df,
+		const uint8_t key[16], struct lf_duplicate_filter_hash *hash)
+{
+#if defined(__x86_64__)
+	uint64_t aeshash;
+
+	if (likely(df->hash_aesni)) {
+		aeshash = lf_aeshash(df->hash_secret, key);
+		hash->hash_1 = (uint32_t)aeshash;
+		hash->hash_2 = (uint32_t)(aeshash >> 32);
+		return;
+	}
+#endif /* __x86_64__ */
+
+	hash->hash_1 = lf_murmurhash(key, df->secret);
+	hash->hash_2 = lf_murmurhash(key, hash->hash_1);
+}
+
+/**
+ * Prefetch the cache lines of the current filter that are accessed for the
+ * hash. For the blocked mode, the block of all filters is prefetched.
+ */
+inline static void
+prefetch_hash(struct lf_duplicate_filter_worker *df,
+		const struct lf_duplicate_filter_hash *hash)
+{
+	unsigned int i;
+	uint32_t a, b, fp;
+	uint32_t index[2];
+	size_t block_offset;
+
+	if (df->backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+		cuckoo_indices(df, hash->hash_1, hash->hash_2, &fp, index);
+		rte_prefetch0(&df->cuckoo_table[index[0] *
+		                                LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES]);
+		rte_prefetch0(&df->cuckoo_table[index[1] *
+		                                LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES]);
+	} else if (df->mode == LF_DUPLICATE_FILTER_MODE_BLOCKED) {
+		block_offset = (size_t)(hash->hash_1 & df->block_mask) *
+		               LF_DUPLICATE_FILTER_BLOCK_SIZE;
+		for (i = 0; i < df->nb_bf; ++i) {
+			rte_prefetch0(df->bf_arrays[i] + block_offset);
+		}
+	} else {
+		/* same positions as in check_key_add_key */
+		a = hash->hash_1;
+		b = hash->hash_2;
+		for (i = 0; i < df->bf_hashes; ++i) {
+			rte_prefetch0(df->bf_arrays[df->current_bf] +
+					((a & df->modulo_mask) >> 3));
+			a += b;
+			b += i;
+		}
+	}
+}
+
+void
+lf_duplicate_filter_hash_burst(struct lf_duplicate_filter_worker *df,
+		const uint8_t *const keys[], uint16_t nb_keys,
+		struct lf_duplicate_filter_hash hashes[])
+{
+	uint16_t i;
+#if defined(__x86_64__)
+	uint64_t aeshash[LF_MAX_PKT_BURST];
+#endif /* __x86_64__ */
+
+#if defined(__x86_64__)
+	if (likely(df->hash_aesni)) {
+		/* hash all keys first, such that the AES rounds are pipelined */
+		lf_aeshash_burst(df->hash_secret, keys, nb_keys, aeshash);
+		for (i = 0; i < nb_keys; ++i) {
+			hashes[i].hash_1 = (uint32_t)aeshash[i];
+			hashes[i].hash_2 = (uint32_t)(aeshash[i] >> 32);
+		}
+	} else
+#endif /* __x86_64__ */
+	{
+		for (i = 0; i < nb_keys; ++i) {
+			lf_duplicate_filter_hash(df, keys[i], &hashes[i]);
+		}
+	}
+
+	for (i = 0; i < nb_keys; ++i) {
+		prefetch_hash(df, &hashes[i]);
+	}
+}
+
 int
-lf_duplicate_filter_apply(struct lf_duplicate_filter_worker *df,
-		const uint8_t key[16], uint64_t ns_now)
+lf_duplicate_filter_apply_hash(struct lf_duplicate_filter_worker *df,
+		const struct lf_duplicate_filter_hash *hash, uint64_t ns_now)
 {
+	bool shared = df->shared != NULL;
+
 	/* periodically rotate bloom filter */
 	if (unlikely(sat_sub_u64(ns_now, df->bf_period) > df->last_rotation)) {
-		df->current_bf = (df->current_bf + 1U) % df->nb_bf;
-		(void)memset(df->bf_arrays[df->current_bf], 0, df->bf_size);
+		if (df->backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+			rotate_cuckoo(df, ns_now);
+		} else if (shared) {
+			rotate_shared(df, ns_now);
+		} else {
+			rotate(df, ns_now);
+		}
+	}
+
+	if (df->backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+		return check_key_add_key_cuckoo(df, hash->hash_1, hash->hash_2);
+	}
 
-		df->last_rotation = ns_now;
+	if (df->mode == LF_DUPLICATE_FILTER_MODE_BLOCKED) {
+		return check_key_add_key_blocked(df->bf_arrays, df->nb_bf,
+				df->current_bf, df->block_mask, df->bf_hashes, hash->hash_1,
+				hash->hash_2, shared, &df->statistics);
 	}
 
 	return check_key_add_key(df->bf_arrays, df->nb_bf, df->current_bf,
-			df->modulo_mask, df->bf_hashes, df->secret, key);
+			df->modulo_mask, df->bf_hashes, hash->hash_1, hash->hash_2, shared,
+			&df->statistics);
 }
 
-struct lf_duplicate_filter_worker *
-lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
-		unsigned int bf_period, unsigned int bf_hashes, unsigned int bf_size,
-		unsigned int hash_secret)
+int
+lf_duplicate_filter_apply(struct lf_duplicate_filter_worker *df,
+		const uint8_t key[16], uint64_t ns_now)
+{
+	struct lf_duplicate_filter_hash hash;
+
+	lf_duplicate_filter_hash(df, key, &hash);
+	return lf_duplicate_filter_apply_hash(df, &hash, ns_now);
+}
+
+void
+lf_duplicate_filter_apply_burst(struct lf_duplicate_filter_worker *df,
+		const uint8_t *const keys[], uint16_t nb_keys, uint64_t ns_now,
+		int res[])
+{
+	uint16_t i;
+	struct lf_duplicate_filter_hash hashes[LF_MAX_PKT_BURST];
+
+	lf_duplicate_filter_hash_burst(df, keys, nb_keys, hashes);
+	for (i = 0; i < nb_keys; ++i) {
+		res[i] = lf_duplicate_filter_apply_hash(df, &hashes[i], ns_now);
+	}
+}
+
+/**
+ * Allocate the worker context and initialize it without assigning the bloom
+ * filters.
+ */
+static struct lf_duplicate_filter_worker *
+worker_alloc(uint16_t socket, enum lf_duplicate_filter_mode mode,
+		unsigned int nb_bf, unsigned int bf_period, unsigned int bf_hashes,
+		unsigned int bf_size, unsigned int hash_secret)
 {
-	int res;
 	unsigned int i;
 	unsigned int nb_bits;
+	uint32_t word;
+	uint8_t block[LF_MURMURHASH_KEY_SIZE];
 	size_t struct_size;
 	struct lf_duplicate_filter_worker *df_worker;
 
@@ -146,12 +688,21 @@ lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
 		return NULL;
 	}
 
+	if (mode == LF_DUPLICATE_FILTER_MODE_BLOCKED &&
+			bf_size < LF_DUPLICATE_FILTER_BLOCK_SIZE) {
+		LF_DUPLICATE_FILTER_LOG(ERR,
+				"bf_size must be at least %d in the blocked mode.\n",
+				LF_DUPLICATE_FILTER_BLOCK_SIZE);
+		return NULL;
+	}
+
 	/*
 	 * The struct size is dynamic and consists of the size of the struct without
-	 * the dynamically sized array plus a pointer for each bloom filter.
+	 * the dynamically sized array plus a pointer for each bloom filter,
+	 * including the spare filter.
 	 */
 	struct_size = sizeof(struct lf_duplicate_filter_worker) +
-	              nb_bf * sizeof(uint8_t *);
+	              (nb_bf + 1) * sizeof(uint8_t *);
 
 	df_worker =
 			rte_zmalloc_socket(NULL, struct_size, RTE_CACHE_LINE_SIZE, socket);
@@ -161,9 +712,116 @@ lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
 		return NULL;
 	}
 
-	/* assign all arrays */
+	/* x % (bf_size*8) == x & modulo_mask */
+	df_worker->modulo_mask = nb_bits - 1;
+	df_worker->block_mask = bf_size / LF_DUPLICATE_FILTER_BLOCK_SIZE - 1;
+	df_worker->mode = mode;
+	df_worker->last_rotation = 0;
+	df_worker->bf_period = bf_period;
+	df_worker->current_bf = 0;
+	df_worker->bf_size = bf_size;
+	df_worker->bf_hashes = bf_hashes;
+	df_worker->secret = hash_secret;
+	/* derive the secret of the AES hash from the hash secret */
+	df_worker->hash_aesni = lf_aeshash_supported();
+	for (i = 0; i < LF_AESHASH_SECRET_SIZE / sizeof(uint32_t); ++i) {
+		(void)memset(block, (int)i, sizeof(block));
+		word = lf_murmurhash(block, hash_secret);
+		(void)memcpy(df_worker->hash_secret + i * sizeof(uint32_t), &word,
+				sizeof(uint32_t));
+	}
+	df_worker->nb_bf = nb_bf;
+	/* the spare filter is already zeroed */
+	df_worker->clear_offset = bf_size;
+	df_worker->shared = NULL;
+	df_worker->epoch = 0;
+	df_worker->backend = LF_DUPLICATE_FILTER_BACKEND_BLOOM;
+	df_worker->cuckoo_table = NULL;
+
+	return df_worker;
+}
+
+/**
+ * Create a worker context with a single cuckoo filter, which uses the same
+ * amount of memory as the Bloom filters (rounded down to a power of 2).
+ */
+static struct lf_duplicate_filter_worker *
+worker_new_cuckoo(uint16_t socket, enum lf_duplicate_filter_mode mode,
+		unsigned int nb_bf, unsigned int bf_period, unsigned int bf_hashes,
+		unsigned int bf_size, unsigned int hash_secret)
+{
+	unsigned int table_size, nb_buckets;
+	struct lf_duplicate_filter_worker *df_worker;
+
+	if (nb_bf == 0 || nb_bf >= UINT8_MAX) {
+		LF_DUPLICATE_FILTER_LOG(ERR,
+				"nb_bf must be between 1 and %d for the cuckoo backend.\n",
+				UINT8_MAX - 1);
+		return NULL;
+	}
+
+	/* largest power of 2 not exceeding the memory of the Bloom filters */
+	table_size = 1;
+	while (table_size <= (nb_bf + 1) * bf_size / 2) {
+		table_size *= 2;
+	}
+	if (table_size < RTE_CACHE_LINE_SIZE) {
+		LF_DUPLICATE_FILTER_LOG(ERR,
+				"(nb_bf+1)*bf_size must be at least %d for the cuckoo "
+				"backend.\n",
+				RTE_CACHE_LINE_SIZE);
+		return NULL;
+	}
+
+	df_worker = worker_alloc(socket, mode, nb_bf, bf_period, bf_hashes,
+			table_size, hash_secret);
+	if (df_worker == NULL) {
+		return NULL;
+	}
+
+	df_worker->cuckoo_table = rte_zmalloc_socket(NULL, table_size,
+			RTE_CACHE_LINE_SIZE, socket);
+	if (df_worker->cuckoo_table == NULL) {
+		LF_DUPLICATE_FILTER_LOG(ERR,
+				"Unable to allocate %u bytes for cuckoo filter\n", table_size);
+		rte_free(df_worker);
+		return NULL;
+	}
+
+	df_worker->backend = LF_DUPLICATE_FILTER_BACKEND_CUCKOO;
+	nb_buckets = table_size /
+	             (LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES * sizeof(uint32_t));
+	df_worker->bucket_mask = nb_buckets - 1;
+	df_worker->slice = 0;
+
+	return df_worker;
+}
+
+struct lf_duplicate_filter_worker *
+lf_duplicate_filter_worker_new(uint16_t socket,
+		enum lf_duplicate_filter_backend backend,
+		enum lf_duplicate_filter_mode mode, unsigned int nb_bf,
+		unsigned int bf_period, unsigned int bf_hashes, unsigned int bf_size,
+		unsigned int hash_secret)
+{
+	int res;
+	unsigned int i;
+	struct lf_duplicate_filter_worker *df_worker;
+
+	if (backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+		return worker_new_cuckoo(socket, mode, nb_bf, bf_period, bf_hashes,
+				bf_size, hash_secret);
+	}
+
+	df_worker = worker_alloc(socket, mode, nb_bf, bf_period, bf_hashes,
+			bf_size, hash_secret);
+	if (df_worker == NULL) {
+		return NULL;
+	}
+
+	/* assign all arrays (including the spare filter) */
 	res = 0;
-	for (i = 0; i < nb_bf; ++i) {
+	for (i = 0; i < nb_bf + 1; ++i) {
 		df_worker->bf_arrays[i] =
 				rte_zmalloc_socket(NULL, bf_size, RTE_CACHE_LINE_SIZE, socket);
 
@@ -178,7 +836,7 @@ lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
 	/* check if an error occurred, i.e., it the loop was terminated early */
 	if (res != 0) {
 		/* free allocated memory */
-		for (i = 0; i < nb_bf; ++i) {
+		for (i = 0; i < nb_bf + 1; ++i) {
 			/* check if bloom filter has already been allocated */
 			if (df_worker->bf_arrays[i] == NULL) {
 				break;
@@ -189,15 +847,25 @@ lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
 		return NULL;
 	}
 
-	/* x % (bf_size*8) == x & modulo_mask */
-	df_worker->modulo_mask = nb_bits - 1;
-	df_worker->last_rotation = 0;
-	df_worker->bf_period = bf_period;
-	df_worker->current_bf = 0;
-	df_worker->bf_size = bf_size;
-	df_worker->bf_hashes = bf_hashes;
-	df_worker->secret = hash_secret;
-	df_worker->nb_bf = nb_bf;
+	return df_worker;
+}
+
+struct lf_duplicate_filter_worker *
+lf_duplicate_filter_worker_new_shared(uint16_t socket,
+		struct lf_duplicate_filter_shared *shared,
+		enum lf_duplicate_filter_mode mode, unsigned int bf_period,
+		unsigned int bf_hashes, unsigned int hash_secret)
+{
+	struct lf_duplicate_filter_worker *df_worker;
+
+	df_worker = worker_alloc(socket, mode, shared->nb_bf, bf_period, bf_hashes,
+			shared->bf_size, hash_secret);
+	if (df_worker == NULL) {
+		return NULL;
+	}
+
+	df_worker->shared = shared;
+	set_shared_arrays(df_worker);
 
 	return df_worker;
 }
@@ -205,17 +873,86 @@ lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
 void
 lf_duplicate_filter_worker_free(struct lf_duplicate_filter_worker *df)
 {
+	unsigned int i;
+
+	if (df == NULL) {
+		return;
+	}
+
+	/* shared filters are freed with lf_duplicate_filter_shared_free() */
+	if (df->backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+		rte_free(df->cuckoo_table);
+	} else if (df->shared == NULL) {
+		for (i = 0; i < df->nb_bf + 1; ++i) {
+			rte_free(df->bf_arrays[i]);
+		}
+	}
 	rte_free(df);
 }
 
+struct lf_duplicate_filter_shared *
+lf_duplicate_filter_shared_new(uint16_t socket, unsigned int nb_bf,
+		unsigned int bf_size)
+{
+	unsigned int i;
+	size_t struct_size;
+	struct lf_duplicate_filter_shared *shared;
+
+	struct_size = sizeof(struct lf_duplicate_filter_shared) +
+	              (nb_bf + 1) * sizeof(uint8_t *);
+
+	shared = rte_zmalloc_socket(NULL, struct_size, RTE_CACHE_LINE_SIZE, socket);
+	if (shared == NULL) {
+		LF_DUPLICATE_FILTER_LOG(ERR, "Unable to allocate %zu bytes\n",
+				struct_size);
+		return NULL;
+	}
+
+	shared->nb_bf = nb_bf;
+	shared->bf_size = bf_size;
+	atomic_init(&shared->epoch, 0);
+	atomic_init(&shared->cleared_epoch, 0);
+
+	for (i = 0; i < nb_bf + 1; ++i) {
+		shared->bf_arrays[i] =
+				rte_zmalloc_socket(NULL, bf_size, RTE_CACHE_LINE_SIZE, socket);
+		if (shared->bf_arrays[i] == NULL) {
+			LF_DUPLICATE_FILTER_LOG(ERR,
+					"Unable to allocate %d bytes for bloom filter\n", bf_size);
+			lf_duplicate_filter_shared_free(shared);
+			return NULL;
+		}
+	}
+
+	return shared;
+}
+
+void
+lf_duplicate_filter_shared_free(struct lf_duplicate_filter_shared *shared)
+{
+	unsigned int i;
+
+	if (shared == NULL) {
+		return;
+	}
+
+	for (i = 0; i < shared->nb_bf + 1; ++i) {
+		rte_free(shared->bf_arrays[i]);
+	}
+	rte_free(shared);
+}
+
 int
 lf_duplicate_filter_init(struct lf_duplicate_filter *df,
 		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
-		unsigned int nb_bf, unsigned int bf_period, unsigned int bf_hashes,
-		unsigned int bf_size, unsigned int hash_secret)
+		enum lf_duplicate_filter_backend backend,
+		enum lf_duplicate_filter_mode mode, bool shared, unsigned int nb_bf,
+		unsigned int bf_period, unsigned int bf_hashes, unsigned int bf_size,
+		unsigned int hash_secret)
 {
 	int res;
 	int worker_id;
+	unsigned int socket;
 	unsigned int nb_bits;
 
 	LF_DUPLICATE_FILTER_LOG(DEBUG, "Init\n");
@@ -228,11 +965,38 @@ lf_duplicate_filter_init(struct lf_duplicate_filter *df,
 		return -1;
 	}
 
+	if (shared && backend != LF_DUPLICATE_FILTER_BACKEND_BLOOM) {
+		LF_DUPLICATE_FILTER_LOG(ERR,
+				"Shared filters are only supported by the Bloom filter "
+				"backend.\n");
+		return -1;
+	}
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		df->shared[socket] = NULL;
+	}
+
 	res = 0;
 	for (worker_id = 0; worker_id < nb_workers; ++worker_id) {
-		df->workers[worker_id] = lf_duplicate_filter_worker_new(
-				rte_lcore_to_socket_id(worker_lcores[worker_id]), nb_bf,
-				bf_period, bf_hashes, bf_size, hash_secret);
+		socket = rte_lcore_to_socket_id(worker_lcores[worker_id]);
+		if (!shared) {
+			df->workers[worker_id] = lf_duplicate_filter_worker_new(socket,
+					backend, mode, nb_bf, bf_period, bf_hashes, bf_size,
+					hash_secret);
+		} else {
+			/* the first worker on the socket allocates the shared filters */
+			if (df->shared[socket] == NULL) {
+				df->shared[socket] =
+						lf_duplicate_filter_shared_new(socket, nb_bf, bf_size);
+				if (df->shared[socket] == NULL) {
+					res = -1;
+					break;
+				}
+			}
+			df->workers[worker_id] = lf_duplicate_filter_worker_new_shared(
+					socket, df->shared[socket], mode, bf_period, bf_hashes,
+					hash_secret);
+		}
 		if (df->workers[worker_id] == NULL) {
 			res = -1;
 			break;
@@ -245,6 +1009,10 @@ lf_duplicate_filter_init(struct lf_duplicate_filter *df,
 			lf_duplicate_filter_worker_free(df->workers[worker_id]);
 			df->workers[worker_id] = NULL;
 		}
+		for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+			lf_duplicate_filter_shared_free(df->shared[socket]);
+			df->shared[socket] = NULL;
+		}
 	}
 
 	df->nb_workers = nb_workers;
@@ -256,9 +1024,89 @@ void
 lf_duplicate_filter_close(struct lf_duplicate_filter *df)
 {
 	uint16_t worker_id;
+	unsigned int socket;
 
 	for (worker_id = 0; worker_id < df->nb_workers; ++worker_id) {
 		lf_duplicate_filter_worker_free(df->workers[worker_id]);
 		df->workers[worker_id] = NULL;
 	}
-}
\ No newline at end of file
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		lf_duplicate_filter_shared_free(df->shared[socket]);
+		df->shared[socket] = NULL;
+	}
+}
+
+/*
+ * Duplicate Filter Telemetry Functionalities
+ */
+
+/* Duplicate filter context used when telemetry commands are processed. */
+static struct lf_duplicate_filter *tel_ctx;
+
+static const struct lf_telemetry_field_name statistics_strings[] = {
+	LF_DUPLICATE_FILTER_STATISTICS(LF_TELEMETRY_FIELD_NAME)
+};
+
+#define STATISTICS_NUM \
+	(sizeof(statistics_strings) / sizeof(struct lf_telemetry_field_name))
+
+static int
+handle_stats(const char *cmd __rte_unused, const char *params __rte_unused,
+		struct rte_tel_data *d)
+{
+	size_t i;
+	uint16_t worker_id;
+	unsigned int socket;
+	uint64_t *values;
+	uint64_t sums[STATISTICS_NUM] = { 0 };
+	uint64_t memory = 0;
+	struct lf_duplicate_filter_worker *df_worker;
+
+	/*
+	 * The counters are read without synchronization, i.e., they might be
+	 * slightly outdated.
+	 */
+	for (worker_id = 0; worker_id < tel_ctx->nb_workers; ++worker_id) {
+		df_worker = tel_ctx->workers[worker_id];
+		values = (uint64_t *)&df_worker->statistics;
+		for (i = 0; i < STATISTICS_NUM; i++) {
+			sums[i] += values[i];
+		}
+		if (df_worker->backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+			memory += df_worker->bf_size;
+		} else if (df_worker->shared == NULL) {
+			memory += (uint64_t)(df_worker->nb_bf + 1) * df_worker->bf_size;
+		}
+	}
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (tel_ctx->shared[socket] != NULL) {
+			memory += (uint64_t)(tel_ctx->shared[socket]->nb_bf + 1) *
+			          tel_ctx->shared[socket]->bf_size;
+		}
+	}
+
+	rte_tel_data_start_dict(d);
+	for (i = 0; i < STATISTICS_NUM; i++) {
+		rte_tel_data_add_dict_uint(d, statistics_strings[i].name, sums[i]);
+	}
+	rte_tel_data_add_dict_uint(d, "memory_bytes", memory);
+
+	return 0;
+}
+
+int
+lf_duplicate_filter_register_telemetry(struct lf_duplicate_filter *df)
+{
+	int res;
+	tel_ctx = df;
+
+	res = rte_telemetry_register_cmd(
+			LF_TELEMETRY_PREFIX "/duplicate_filter/stats", handle_stats,
+			"Returns duplicate filter statistics aggregated over all workers.");
+	if (res != 0) {
+		return -1;
+	}
+
+	return 0;
+}
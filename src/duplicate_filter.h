@@ -6,22 +6,145 @@
 #define LF_DUPLICATE_FILTER_H
 
 #include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_config.h>
 
 #include "lf.h"
+#include "lib/hash/aeshash.h"
+#include "lib/telemetry/counters.h"
 
 /**
  * This module provides the (MAC) duplicate filtering functionalities.
  */
 
+/**
+ * Data structure used to detect duplicates.
+ */
+enum lf_duplicate_filter_backend {
+	/*
+	 * Rotating Bloom filters, one per period (see lf_duplicate_filter_mode).
+	 */
+	LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+	/*
+	 * Single cuckoo filter, whose entries contain a fingerprint of the key and
+	 * the time slice (period) in which the key has been inserted. Entries
+	 * expire after nb_bf time slices. Compared to the Bloom filters, the false
+	 * positive rate is lower for the same amount of memory.
+	 */
+	LF_DUPLICATE_FILTER_BACKEND_CUCKOO,
+};
+
+/**
+ * Number of entries per bucket of the cuckoo filter. Each entry consists of a
+ * 24 bit fingerprint and an 8 bit time slice.
+ */
+#define LF_DUPLICATE_FILTER_CUCKOO_BUCKET_ENTRIES 4
+
+/**
+ * Maximum number of relocations when inserting a key into a full bucket of the
+ * cuckoo filter.
+ */
+#define LF_DUPLICATE_FILTER_CUCKOO_MAX_KICKS 32
+
+/**
+ * Size of a Bloom filter block in the blocked mode (one cache line).
+ */
+#define LF_DUPLICATE_FILTER_BLOCK_SIZE 64
+
+/**
+ * Layout of the Bloom filters.
+ */
+enum lf_duplicate_filter_mode {
+	/*
+	 * Standard Bloom filter. The bits of a key are spread over the whole bit
+	 * array, i.e., a key accesses up to bf_hashes cache lines per filter.
+	 */
+	LF_DUPLICATE_FILTER_MODE_STANDARD,
+	/*
+	 * Blocked Bloom filter. All bits of a key are in the same block of
+	 * LF_DUPLICATE_FILTER_BLOCK_SIZE bytes, i.e., a key accesses a single
+	 * cache line per filter. This comes at the cost of a slightly higher false
+	 * positive rate.
+	 */
+	LF_DUPLICATE_FILTER_MODE_BLOCKED,
+};
+
+/**
+ * Number of bytes of the spare Bloom filter that are cleared per call of
+ * lf_duplicate_filter_clear_chunk().
+ */
+#define LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE 4096
+
+/**
+ * Bloom filters shared by all workers on the same socket (shared mode).
+ *
+ * The filters are selected by the rotation epoch, i.e., ns_now / bf_period.
+ * The filter of epoch e is bf_arrays[e % (nb_bf + 1)], such that the filter
+ * following the nb_bf filters in use is the spare filter, which is cleared
+ * incrementally during the epoch. The worker that first observes a new epoch
+ * claims the rotation and is responsible for clearing the next spare filter.
+ * Workers set bits with relaxed atomic OR operations.
+ */
+struct lf_duplicate_filter_shared {
+	/* latest epoch for which the rotation has been claimed */
+	_Atomic uint64_t epoch;
+	/* latest epoch whose filter has been cleared completely */
+	_Atomic uint64_t cleared_epoch;
+
+	unsigned int bf_size;
+	unsigned int nb_bf;
+
+	/* all nb_bf + 1 bloom filters */
+	uint8_t *bf_arrays[]; /* dynamically sized */
+};
+
+/**
+ * Duplicate filter statistics of a worker.
+ * rotation_clears: rotations for which the spare filter has not been cleared
+ * completely beforehand.
+ * shared_updates: atomic OR operations on the shared filters.
+ * shared_update_races: atomic OR operations for which another worker has set
+ * the bits in the meantime.
+ * cuckoo_insert_failures: insertions into the full cuckoo filter, for which an
+ * entry had to be dropped.
+ */
+#define LF_DUPLICATE_FILTER_STATISTICS(M) \
+	M(uint64_t, rotations)                \
+	M(uint64_t, rotation_clears)          \
+	M(uint64_t, shared_updates)           \
+	M(uint64_t, shared_update_races)      \
+	M(uint64_t, cuckoo_insert_failures)
+
+struct lf_duplicate_filter_statistics {
+	LF_DUPLICATE_FILTER_STATISTICS(LF_TELEMETRY_FIELD_DECL)
+};
+
 /**
  * The worker's duplicate filter struct, containing the worker's rotating bloom
  * filters.
+ *
+ * In addition to the nb_bf filters in use, a spare filter is kept, which is
+ * cleared incrementally (see lf_duplicate_filter_clear_chunk()). On rotation,
+ * the spare filter replaces the oldest filter, which then becomes the spare
+ * filter. Hence, the rotation itself does not need to clear a filter.
+ *
+ * With the cuckoo backend, the worker has a single cuckoo filter of bf_size
+ * bytes instead, and nb_bf is the number of time slices after which entries
+ * expire. Rather than clearing a spare filter, expired entries are removed
+ * incrementally, such that the time slices stored in the entries do not wrap
+ * around.
  */
 struct lf_duplicate_filter_worker {
 	uint64_t last_rotation; /* nanoseconds */
 	uint64_t bf_period;     /* nanoseconds */
 
 	/* Bloom Filter Variables */
+	enum lf_duplicate_filter_backend backend;
+	enum lf_duplicate_filter_mode mode;
 	unsigned int bf_hashes;
 	unsigned int bf_size;
 	unsigned int secret;
@@ -35,13 +158,61 @@ struct lf_duplicate_filter_worker {
 	 */
 	uint32_t modulo_mask;
 
-	/* all bloom filters. */
+	/*
+	 * Only for the blocked mode: the number of blocks (bf_size divided by the
+	 * block size) is a power of 2 as well.
+	 * x % nb_blocks == x & block_mask
+	 */
+	uint32_t block_mask;
+
+	/*
+	 * The keys are hashed with the AES hash if the CPU supports it, and with
+	 * murmurhash (seeded with secret) otherwise.
+	 */
+	bool hash_aesni;
+	uint8_t hash_secret[LF_AESHASH_SECRET_SIZE];
+
+	/* Number of bytes of the spare filter that are already cleared. */
+	unsigned int clear_offset;
+
+	/*
+	 * Only for the cuckoo backend: the cuckoo filter with a power of 2 number
+	 * of buckets, i.e., x % nb_buckets == x & bucket_mask, and the current time
+	 * slice.
+	 */
+	uint32_t *cuckoo_table;
+	uint32_t bucket_mask;
+	uint8_t slice;
+
+	/*
+	 * Only for the shared mode: the shared filters and the current epoch of
+	 * the worker. The worker's bf_arrays then point to the shared filters,
+	 * ordered as if the worker rotated its own filters. NULL if the worker
+	 * uses its own filters.
+	 */
+	struct lf_duplicate_filter_shared *shared;
+	uint64_t epoch;
+
+	struct lf_duplicate_filter_statistics statistics;
+
+	/* all bloom filters. The last one (index nb_bf) is the spare filter. */
 	uint8_t *bf_arrays[]; /* dynamically sized */
 };
 
 struct lf_duplicate_filter {
 	struct lf_duplicate_filter_worker *workers[LF_MAX_WORKER];
 	uint16_t nb_workers;
+
+	/* shared filters per socket (only for the shared mode) */
+	struct lf_duplicate_filter_shared *shared[RTE_MAX_NUMA_NODES];
+};
+
+/**
+ * Hash values of a key, from which the positions in the filters are derived.
+ */
+struct lf_duplicate_filter_hash {
+	uint32_t hash_1;
+	uint32_t hash_2;
 };
 
 /**
@@ -53,19 +224,137 @@ int
 lf_duplicate_filter_apply(struct lf_duplicate_filter_worker *df,
 		const uint8_t key[16], uint64_t ns_now);
 
+/**
+ * Hash a key for lf_duplicate_filter_apply_hash().
+ */
+void
+lf_duplicate_filter_hash(struct lf_duplicate_filter_worker *df,
+		const uint8_t key[16], struct lf_duplicate_filter_hash *hash);
+
+/**
+ * Hash the keys of a burst and prefetch the cache lines of the filters that are
+ * accessed when the hashes are applied with lf_duplicate_filter_apply_hash().
+ * @param nb_keys: Number of keys, at most LF_MAX_PKT_BURST.
+ */
+void
+lf_duplicate_filter_hash_burst(struct lf_duplicate_filter_worker *df,
+		const uint8_t *const keys[], uint16_t nb_keys,
+		struct lf_duplicate_filter_hash hashes[]);
+
+/**
+ * Applies duplicate detection to a key hashed with lf_duplicate_filter_hash()
+ * or lf_duplicate_filter_hash_burst().
+ * @return 0 if no duplication has been identified.
+ * Otherwise, a duplicate is suspected.
+ */
+int
+lf_duplicate_filter_apply_hash(struct lf_duplicate_filter_worker *df,
+		const struct lf_duplicate_filter_hash *hash, uint64_t ns_now);
+
+/**
+ * Applies duplicate detection to the keys of a burst, one after the other,
+ * i.e., duplicates within the burst are detected as well.
+ * @param nb_keys: Number of keys, at most LF_MAX_PKT_BURST.
+ * @param res: Result for each key (see lf_duplicate_filter_apply()).
+ */
+void
+lf_duplicate_filter_apply_burst(struct lf_duplicate_filter_worker *df,
+		const uint8_t *const keys[], uint16_t nb_keys, uint64_t ns_now,
+		int res[]);
+
+/**
+ * Remove the expired entries in the next chunk of the cuckoo filter.
+ * Use lf_duplicate_filter_clear_chunk() instead of calling this function
+ * directly.
+ */
+void
+lf_duplicate_filter_cuckoo_scrub_chunk(struct lf_duplicate_filter_worker *df);
+
+/**
+ * Clear the next chunk of the spare Bloom filter, if it is not yet cleared
+ * completely. This function should be called regularly by the worker, e.g.,
+ * once per received burst, such that the spare filter is cleared before the
+ * next rotation. Otherwise, the remaining part is cleared on rotation.
+ *
+ * In the shared mode, only the worker that claimed the current rotation clears
+ * the spare filter. With the cuckoo backend, the expired entries of the next
+ * chunk of the cuckoo filter are removed instead.
+ */
+static inline void
+lf_duplicate_filter_clear_chunk(struct lf_duplicate_filter_worker *df)
+{
+	unsigned int len;
+
+	if (likely(df->clear_offset >= df->bf_size)) {
+		return;
+	}
+
+	if (df->backend == LF_DUPLICATE_FILTER_BACKEND_CUCKOO) {
+		lf_duplicate_filter_cuckoo_scrub_chunk(df);
+		return;
+	}
+
+	if (df->shared != NULL &&
+			unlikely(atomic_load_explicit(&df->shared->epoch,
+							 memory_order_relaxed) != df->epoch)) {
+		/* another worker has rotated and is responsible for clearing now */
+		df->clear_offset = df->bf_size;
+		return;
+	}
+
+	len = df->bf_size - df->clear_offset;
+	if (len > LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE) {
+		len = LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE;
+	}
+	(void)memset(df->bf_arrays[df->nb_bf] + df->clear_offset, 0, len);
+	df->clear_offset += len;
+
+	if (df->shared != NULL && df->clear_offset >= df->bf_size) {
+		/* the spare filter is used in the next epoch */
+		atomic_store_explicit(&df->shared->cleared_epoch, df->epoch + 1,
+				memory_order_release);
+	}
+}
+
 /**
  * Create new duplicate filter worker context and initialize it.
  * See lf_duplicate_filter_init for the description of the parameters.
  * @return new duplicate filter worker context
  */
 struct lf_duplicate_filter_worker *
-lf_duplicate_filter_worker_new(uint16_t socket, unsigned int nb_bf,
+lf_duplicate_filter_worker_new(uint16_t socket,
+		enum lf_duplicate_filter_backend backend,
+		enum lf_duplicate_filter_mode mode, unsigned int nb_bf,
 		unsigned int bf_period, unsigned int bf_hashes, unsigned int bf_size,
 		unsigned int hash_secret);
 
+/**
+ * Create new duplicate filter worker context, which uses the provided shared
+ * filters instead of its own filters.
+ * See lf_duplicate_filter_init for the description of the parameters.
+ * @return new duplicate filter worker context
+ */
+struct lf_duplicate_filter_worker *
+lf_duplicate_filter_worker_new_shared(uint16_t socket,
+		struct lf_duplicate_filter_shared *shared,
+		enum lf_duplicate_filter_mode mode, unsigned int bf_period,
+		unsigned int bf_hashes, unsigned int hash_secret);
+
 void
 lf_duplicate_filter_worker_free(struct lf_duplicate_filter_worker *df);
 
+/**
+ * Create new shared filters, which can be used by multiple worker contexts.
+ * See lf_duplicate_filter_init for the description of the parameters.
+ * @return new shared filters
+ */
+struct lf_duplicate_filter_shared *
+lf_duplicate_filter_shared_new(uint16_t socket, unsigned int nb_bf,
+		unsigned int bf_size);
+
+void
+lf_duplicate_filter_shared_free(struct lf_duplicate_filter_shared *shared);
+
 /**
  * Initializes the duplicate filter struct. This also includes the allocation
  * and initialization of the worker contexts.
@@ -73,27 +362,45 @@ lf_duplicate_filter_worker_free(struct lf_duplicate_filter_worker *df);
  * @param worker_lcores: The lcore assignment for the workers, which determines
  * the socket for which memory is allocated.
  * @param nb_workers: Number of worker contexts to be created.
- * @param nb_bf: Number of Bloom filters to use.
+ * @param backend: Data structure used to detect duplicates.
+ * @param mode: Layout of the Bloom filters.
+ * @param shared: If true, all workers on the same socket share the Bloom
+ * filters. Otherwise, each worker has its own Bloom filters. Not supported by
+ * the cuckoo backend.
+ * @param nb_bf: Number of Bloom filters to use. For the cuckoo backend, the
+ * number of periods after which entries expire (less than 255).
  * @param bf_period: Period between Bloom filter rotation in nanoseconds.
  * @param bf_hashes: Number of hash values used for the Bloom filters.
  * @param bf_size: Size of each Bloom filter bit array in bytes.
  * The size in bits (8*bf_size) must be a power of 2, at least 8,
- * and fit into a 32 bit unsigned integer.
+ * and fit into a 32 bit unsigned integer. In the blocked mode, bf_size must be
+ * at least LF_DUPLICATE_FILTER_BLOCK_SIZE. The cuckoo backend uses a single
+ * cuckoo filter of (at most) the same total size as the Bloom filters, i.e.,
+ * (nb_bf + 1) * bf_size rounded down to a power of 2.
  * @param hash_secret: Random secret used to make the hash unpredictable.
  * @returns 0 if successful.
  */
 int
 lf_duplicate_filter_init(struct lf_duplicate_filter *df,
 		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
-		unsigned int nb_bf, unsigned int bf_period, unsigned int bf_hashes,
-		unsigned int bf_size, unsigned int hash_secret);
+		enum lf_duplicate_filter_backend backend,
+		enum lf_duplicate_filter_mode mode, bool shared, unsigned int nb_bf,
+		unsigned int bf_period, unsigned int bf_hashes, unsigned int bf_size,
+		unsigned int hash_secret);
 
 /**
  * De-initialize the duplicate filter struct and free all memory allocated for
- * it, i.e., the worker contexts.
+ * it, i.e., the worker contexts and shared filters.
  * @param df: Duplicate filter struct to be de-initialized.
  */
 void
 lf_duplicate_filter_close(struct lf_duplicate_filter *df);
 
+/**
+ * Register duplicate filter telemetry commands for the provided context.
+ * @return 0 on success.
+ */
+int
+lf_duplicate_filter_register_telemetry(struct lf_duplicate_filter *df);
+
 #endif /* LF_DUPLICATE_FILTER_H */
\ No newline at end of file
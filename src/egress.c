@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_telemetry.h>
+
+#include "egress.h"
+#include "lf.h"
+#include "lib/log/log.h"
+#include "lib/telemetry/counters.h"
+
+/**
+ * Log function for egress scheduler (not on data path).
+ * Format: "Egress: log message here"
+ */
+#define LF_EGRESS_LOG(level, ...) LF_LOG(level, "Egress: " __VA_ARGS__)
+
+int lf_egress_dynfield_offset = -1;
+
+int
+lf_egress_register_dynfield(void)
+{
+	static const struct rte_mbuf_dynfield egress_dynfield_desc = {
+		.name = LF_EGRESS_DYNFIELD_NAME,
+		.size = sizeof(struct lf_egress_dynfield),
+		.align = __alignof__(struct lf_egress_dynfield),
+	};
+	lf_egress_dynfield_offset =
+			rte_mbuf_dynfield_register(&egress_dynfield_desc);
+	if (lf_egress_dynfield_offset < 0) {
+		LF_EGRESS_LOG(ERR, "Failed to register mbuf dynfield field (%d)\n",
+				rte_errno);
+		return -1;
+	}
+	LF_EGRESS_LOG(DEBUG, "Registered mbuf dynfield field at offset %d\n",
+			lf_egress_dynfield_offset);
+	return 0;
+}
+
+int
+lf_egress_init(struct lf_egress *eg, uint16_t worker_lcores[LF_MAX_WORKER],
+		uint16_t nb_workers)
+{
+	uint16_t worker_id;
+	unsigned int socket;
+
+	LF_EGRESS_LOG(DEBUG, "Init\n");
+
+	eg->nb_workers = 0;
+	for (worker_id = 0; worker_id < nb_workers; ++worker_id) {
+		socket = rte_lcore_to_socket_id(worker_lcores[worker_id]);
+		eg->workers[worker_id] = rte_zmalloc_socket(NULL,
+				sizeof(struct lf_egress_worker), RTE_CACHE_LINE_SIZE,
+				(int)socket);
+		if (eg->workers[worker_id] == NULL) {
+			LF_EGRESS_LOG(ERR, "Fail to allocate memory for worker.\n");
+			lf_egress_close(eg);
+			return -1;
+		}
+		eg->nb_workers++;
+	}
+
+	LF_EGRESS_LOG(INFO,
+			"Best-effort DRR scheduling enabled (%d queues per worker)\n",
+			LF_EGRESS_QUEUES);
+
+	return 0;
+}
+
+void
+lf_egress_close(struct lf_egress *eg)
+{
+	uint16_t worker_id, i;
+	struct lf_egress_queue *queue;
+
+	for (worker_id = 0; worker_id < eg->nb_workers; ++worker_id) {
+		for (i = 0; i < LF_EGRESS_QUEUES; ++i) {
+			queue = &eg->workers[worker_id]->queues[i];
+			while (queue->count > 0) {
+				rte_pktmbuf_free(lf_egress_queue_pop(eg->workers[worker_id],
+						queue));
+			}
+		}
+		rte_free(eg->workers[worker_id]);
+		eg->workers[worker_id] = NULL;
+	}
+	eg->nb_workers = 0;
+}
+
+/*
+ * Egress Scheduler Telemetry Functionalities
+ */
+
+/* Egress scheduler context used when telemetry commands are processed. */
+static struct lf_egress *tel_ctx;
+
+static const struct lf_telemetry_field_name statistics_strings[] = {
+	LF_EGRESS_STATISTICS(LF_TELEMETRY_FIELD_NAME)
+};
+
+#define STATISTICS_NUM \
+	(sizeof(statistics_strings) / sizeof(struct lf_telemetry_field_name))
+
+static int
+handle_stats(const char *cmd __rte_unused, const char *params __rte_unused,
+		struct rte_tel_data *d)
+{
+	size_t i;
+	uint16_t worker_id;
+	uint64_t *values;
+	uint64_t sums[STATISTICS_NUM] = { 0 };
+	uint64_t backlog = 0, active = 0;
+
+	/*
+	 * The counters are read without synchronization, i.e., they might be
+	 * slightly outdated.
+	 */
+	for (worker_id = 0; worker_id < tel_ctx->nb_workers; ++worker_id) {
+		values = (uint64_t *)&tel_ctx->workers[worker_id]->statistics;
+		for (i = 0; i < STATISTICS_NUM; i++) {
+			sums[i] += values[i];
+		}
+		backlog += tel_ctx->workers[worker_id]->nb_pkts;
+		active += tel_ctx->workers[worker_id]->nb_active;
+	}
+
+	rte_tel_data_start_dict(d);
+	for (i = 0; i < STATISTICS_NUM; i++) {
+		rte_tel_data_add_dict_uint(d, statistics_strings[i].name, sums[i]);
+	}
+	rte_tel_data_add_dict_uint(d, "backlog_pkts", backlog);
+	rte_tel_data_add_dict_uint(d, "active_queues", active);
+
+	return 0;
+}
+
+int
+lf_egress_register_telemetry(struct lf_egress *eg)
+{
+	int res;
+	tel_ctx = eg;
+
+	res = rte_telemetry_register_cmd(LF_TELEMETRY_PREFIX "/egress/stats",
+			handle_stats,
+			"Returns the best-effort egress scheduler statistics aggregated "
+			"over all workers.");
+	if (res != 0) {
+		return -1;
+	}
+
+	return 0;
+}
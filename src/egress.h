@@ -0,0 +1,352 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_EGRESS_H
+#define LF_EGRESS_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_mbuf.h>
+
+#include "lf.h"
+#include "lib/telemetry/counters.h"
+#include "ratelimiter.h"
+
+/**
+ * The egress scheduler replaces the best-effort rate limit's forward-or-drop
+ * decision with deficit round robin (DRR) among the best-effort sources.
+ *
+ * Best-effort packets that pass all other checks are enqueued into one of
+ * LF_EGRESS_QUEUES queues, selected by the hash of the packet's source AS.
+ * After the other packets of a burst have been transmitted, the worker drains
+ * the active queues round-robin: each queue may send LF_EGRESS_QUANTUM bytes
+ * per round, and every dequeued packet consumes tokens of the best-effort
+ * (and overall) rate limit. If the rate limit is exhausted, draining stops
+ * and resumes at the same position in the next iteration.
+ *
+ * A queue holds at most LF_EGRESS_QUEUE_SIZE packets and all queues at most
+ * LF_EGRESS_MAX_PKTS packets. If all queues are full, the head of the longest
+ * queue is dropped, such that a few sources cannot crowd out the others.
+ *
+ * The scheduler is not thread-safe and is intended to be used per worker.
+ */
+
+/* Number of queues (must be a power of 2) */
+#define LF_EGRESS_QUEUES 64
+/* Maximum number of packets per queue (must be a power of 2) */
+#define LF_EGRESS_QUEUE_SIZE 32
+/* Maximum number of packets in all queues of a worker */
+#define LF_EGRESS_MAX_PKTS 512
+/* Bytes a queue may send per round */
+#define LF_EGRESS_QUANTUM 1500
+
+/*
+ * Best-effort packets are marked with their source AS in a mbuf dynfield.
+ * Any source AS, including 0, can be set by a packet. Hence, a separate flag
+ * indicates whether the packet is scheduled.
+ */
+#define LF_EGRESS_DYNFIELD_NAME "lf_egress_dynfield"
+struct lf_egress_dynfield {
+	uint64_t src_as;
+	bool scheduled;
+};
+extern int lf_egress_dynfield_offset;
+
+/**
+ * Helper function to obtain a pointer to the egress dynfield in the mbuf.
+ */
+static inline struct lf_egress_dynfield *
+lf_egress_dynfield(struct rte_mbuf *mbuf)
+{
+	// NOLINTNEXTLINE(performance-no-int-to-ptr)
+	return RTE_MBUF_DYNFIELD(mbuf, lf_egress_dynfield_offset,
+			struct lf_egress_dynfield *);
+}
+
+/**
+ * Mark the packet to be scheduled by its source AS.
+ */
+static inline void
+lf_egress_mark(struct rte_mbuf *mbuf, uint64_t src_as)
+{
+	struct lf_egress_dynfield *field = lf_egress_dynfield(mbuf);
+
+	field->src_as = src_as;
+	field->scheduled = true;
+}
+
+/**
+ * Clear the mark of a received packet, such that it is not scheduled.
+ */
+static inline void
+lf_egress_unmark(struct rte_mbuf *mbuf)
+{
+	lf_egress_dynfield(mbuf)->scheduled = false;
+}
+
+/**
+ * Egress scheduler statistics of a worker.
+ * enqueued_pkts: best-effort packets enqueued.
+ * dropped_pkts: best-effort packets dropped because the queues were full.
+ * sent_pkts: best-effort packets dequeued for transmission.
+ */
+#define LF_EGRESS_STATISTICS(M) \
+	M(uint64_t, enqueued_pkts)  \
+	M(uint64_t, dropped_pkts)   \
+	M(uint64_t, sent_pkts)
+
+struct lf_egress_statistics {
+	LF_EGRESS_STATISTICS(LF_TELEMETRY_FIELD_DECL)
+};
+
+struct lf_egress_queue {
+	struct rte_mbuf *pkts[LF_EGRESS_QUEUE_SIZE];
+	uint16_t head;
+	uint16_t count;
+	/* bytes the queue may still send in the current round */
+	uint32_t deficit;
+	bool active;
+};
+
+struct lf_egress_worker {
+	struct lf_egress_queue queues[LF_EGRESS_QUEUES];
+
+	/* round-robin list of the active queues (ring of queue indices) */
+	uint16_t active[LF_EGRESS_QUEUES];
+	uint16_t active_head;
+	uint16_t nb_active;
+	/* the queue at the head of the list has received its quantum */
+	bool quantum_granted;
+
+	/* packets in all queues */
+	uint16_t nb_pkts;
+
+	struct lf_egress_statistics statistics;
+} __rte_cache_aligned;
+
+struct lf_egress {
+	struct lf_egress_worker *workers[LF_MAX_WORKER];
+	uint16_t nb_workers;
+};
+
+static inline uint16_t
+lf_egress_queue_index(uint64_t src_as)
+{
+	/* multiplicative hashing (golden ratio) */
+	return (uint16_t)((src_as * UINT64_C(0x9e3779b97f4a7c15)) >>
+					  (64 - __builtin_ctz(LF_EGRESS_QUEUES)));
+}
+
+static inline struct rte_mbuf *
+lf_egress_queue_pop(struct lf_egress_worker *egress,
+		struct lf_egress_queue *queue)
+{
+	struct rte_mbuf *m = queue->pkts[queue->head];
+
+	queue->head = (queue->head + 1) & (LF_EGRESS_QUEUE_SIZE - 1);
+	queue->count--;
+	egress->nb_pkts--;
+	return m;
+}
+
+/**
+ * Move the head of the active list to its tail (or remove it if the queue
+ * became empty).
+ */
+static inline void
+lf_egress_next_queue(struct lf_egress_worker *egress, bool remove)
+{
+	uint16_t index = egress->active[egress->active_head];
+
+	egress->active_head = (egress->active_head + 1) & (LF_EGRESS_QUEUES - 1);
+	if (remove) {
+		egress->queues[index].active = false;
+		egress->queues[index].deficit = 0;
+		egress->nb_active--;
+	} else {
+		egress->active[(egress->active_head + egress->nb_active - 1) &
+					   (LF_EGRESS_QUEUES - 1)] = index;
+	}
+	egress->quantum_granted = false;
+}
+
+/**
+ * Find the queue with the most packets.
+ */
+static inline struct lf_egress_queue *
+lf_egress_longest_queue(struct lf_egress_worker *egress)
+{
+	uint16_t i;
+	struct lf_egress_queue *longest = &egress->queues[0];
+
+	for (i = 1; i < LF_EGRESS_QUEUES; ++i) {
+		if (egress->queues[i].count > longest->count) {
+			longest = &egress->queues[i];
+		}
+	}
+	return longest;
+}
+
+/**
+ * Enqueue a best-effort packet.
+ *
+ * @param src_as Source AS of the packet.
+ * @return The packet to be dropped, which is either the given packet or the
+ * head of the longest queue. NULL if no packet has to be dropped.
+ */
+static inline struct rte_mbuf *
+lf_egress_worker_enqueue(struct lf_egress_worker *egress, struct rte_mbuf *m,
+		uint64_t src_as)
+{
+	uint16_t index = lf_egress_queue_index(src_as);
+	struct lf_egress_queue *queue = &egress->queues[index];
+	struct lf_egress_queue *longest;
+	struct rte_mbuf *drop = NULL;
+
+	if (queue->count == LF_EGRESS_QUEUE_SIZE) {
+		egress->statistics.dropped_pkts++;
+		return m;
+	}
+
+	if (egress->nb_pkts == LF_EGRESS_MAX_PKTS) {
+		longest = lf_egress_longest_queue(egress);
+		if (longest->count <= queue->count) {
+			egress->statistics.dropped_pkts++;
+			return m;
+		}
+		/* the longest queue is active and not empty */
+		drop = lf_egress_queue_pop(egress, longest);
+		egress->statistics.dropped_pkts++;
+	}
+
+	queue->pkts[(queue->head + queue->count) & (LF_EGRESS_QUEUE_SIZE - 1)] = m;
+	queue->count++;
+	egress->nb_pkts++;
+	egress->statistics.enqueued_pkts++;
+
+	if (!queue->active) {
+		queue->active = true;
+		queue->deficit = 0;
+		egress->active[(egress->active_head + egress->nb_active) &
+					   (LF_EGRESS_QUEUES - 1)] = index;
+		egress->nb_active++;
+	}
+
+	return drop;
+}
+
+/**
+ * Dequeue best-effort packets according to deficit round robin, as long as
+ * the best-effort rate limit permits.
+ *
+ * @param pkts Returns the dequeued packets.
+ * @param max_pkts Maximum number of packets to be dequeued.
+ * @return Number of dequeued packets.
+ */
+static inline uint16_t
+lf_egress_worker_dequeue(struct lf_egress_worker *egress,
+		struct lf_ratelimiter_worker *rl, struct rte_mbuf **pkts,
+		uint16_t max_pkts, uint64_t ns_now)
+{
+	uint16_t nb_pkts = 0;
+	struct lf_egress_queue *queue;
+	struct rte_mbuf *m;
+
+	while (nb_pkts < max_pkts && egress->nb_active > 0) {
+		queue = &egress->queues[egress->active[egress->active_head]];
+
+		/* a queue whose head has been dropped might be empty */
+		if (queue->count == 0) {
+			lf_egress_next_queue(egress, true);
+			continue;
+		}
+
+		if (!egress->quantum_granted) {
+			queue->deficit += LF_EGRESS_QUANTUM;
+			egress->quantum_granted = true;
+		}
+
+		m = queue->pkts[queue->head];
+		if (m->pkt_len > queue->deficit) {
+			lf_egress_next_queue(egress, false);
+			continue;
+		}
+
+		if (lf_ratelimiter_worker_apply_best_effort(rl, m->pkt_len, ns_now) !=
+				0) {
+			/* resume at the same position once tokens are available */
+			break;
+		}
+
+		queue->deficit -= m->pkt_len;
+		pkts[nb_pkts++] = lf_egress_queue_pop(egress, queue);
+		egress->statistics.sent_pkts++;
+
+		if (queue->count == 0) {
+			lf_egress_next_queue(egress, true);
+		}
+	}
+
+	return nb_pkts;
+}
+
+/**
+ * Enqueue the marked packets of a burst, which are forwarded, and keep the
+ * other packets in the burst to be transmitted directly.
+ *
+ * @param pkts Packets of the burst. Returns the kept packets.
+ * @return Number of kept packets.
+ */
+static inline uint16_t
+lf_egress_worker_enqueue_burst(struct lf_egress_worker *egress,
+		struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+	uint16_t i, nb_kept = 0;
+	struct lf_egress_dynfield *field;
+	struct rte_mbuf *drop;
+
+	for (i = 0; i < nb_pkts; ++i) {
+		field = lf_egress_dynfield(pkts[i]);
+		if (*lf_pkt_action(pkts[i]) != LF_PKT_ACTION_FORWARD ||
+				!field->scheduled) {
+			pkts[nb_kept++] = pkts[i];
+			continue;
+		}
+		drop = lf_egress_worker_enqueue(egress, pkts[i], field->src_as);
+		if (drop != NULL) {
+			rte_pktmbuf_free(drop);
+		}
+	}
+
+	return nb_kept;
+}
+
+/**
+ * Initialize the egress schedulers of the workers.
+ */
+int
+lf_egress_init(struct lf_egress *eg, uint16_t worker_lcores[LF_MAX_WORKER],
+		uint16_t nb_workers);
+
+/**
+ * Free the workers' egress schedulers, including the queued packets.
+ */
+void
+lf_egress_close(struct lf_egress *eg);
+
+/**
+ * Register the mbuf dynfield, in which best-effort packets are marked.
+ */
+int
+lf_egress_register_dynfield(void);
+
+/**
+ * Register the egress scheduler's telemetry commands.
+ */
+int
+lf_egress_register_telemetry(struct lf_egress *eg);
+
+#endif /* LF_EGRESS_H */
@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <rte_common.h>
+
+#include "fetch_engine.h"
+#include "lib/log/log.h"
+
+/**
+ * Log function for the fetch engine (not on data path).
+ * Format: "Fetch Engine: log message here"
+ */
+#define LF_FETCH_ENGINE_LOG(level, ...) \
+	LF_LOG(level, "Fetch Engine: " __VA_ARGS__)
+
+/**
+ * Main loop of the fetch threads: take a queued request, fetch the key without
+ * holding the lock, and mark the request as done.
+ */
+static void *
+fetch_thread(void *arg)
+{
+	uint16_t i;
+	struct lf_fetch_engine *engine = arg;
+	struct lf_fetch_slot *slot = NULL;
+	struct lf_fetch_request request;
+
+	(void)pthread_mutex_lock(&engine->lock);
+	while (true) {
+		while (!engine->quit && engine->nb_queued == 0) {
+			(void)pthread_cond_wait(&engine->queued_cond, &engine->lock);
+		}
+		if (engine->quit) {
+			break;
+		}
+
+		for (i = 0; i < LF_FETCH_ENGINE_WINDOW; ++i) {
+			slot = &engine->slots[i];
+			if (slot->state == LF_FETCH_REQUEST_QUEUED) {
+				break;
+			}
+		}
+		slot->state = LF_FETCH_REQUEST_RUNNING;
+		engine->nb_queued--;
+		request = slot->request;
+		(void)pthread_mutex_unlock(&engine->lock);
+
+		request.res = engine->fetch(engine->fetch_ctx, &request);
+		request.attempts++;
+
+		(void)pthread_mutex_lock(&engine->lock);
+		slot->request = request;
+		slot->state = LF_FETCH_REQUEST_DONE;
+	}
+	(void)pthread_mutex_unlock(&engine->lock);
+
+	return NULL;
+}
+
+int
+lf_fetch_engine_init(struct lf_fetch_engine *engine, uint16_t nb_threads,
+		lf_fetch_engine_fetch_fn fetch, void *fetch_ctx)
+{
+	int res;
+	uint16_t i;
+
+	LF_FETCH_ENGINE_LOG(DEBUG, "Init\n");
+
+	if (nb_threads == 0 || nb_threads > LF_FETCH_ENGINE_MAX_THREADS) {
+		LF_FETCH_ENGINE_LOG(ERR, "Invalid number of fetch threads (%u)\n",
+				nb_threads);
+		return -1;
+	}
+
+	engine->fetch = fetch;
+	engine->fetch_ctx = fetch_ctx;
+	memset(engine->slots, 0, sizeof(engine->slots));
+	engine->nb_inflight = 0;
+	engine->nb_queued = 0;
+	engine->quit = false;
+	memset(&engine->statistics, 0, sizeof(engine->statistics));
+
+	if (pthread_mutex_init(&engine->lock, NULL) != 0) {
+		return -1;
+	}
+	if (pthread_cond_init(&engine->queued_cond, NULL) != 0) {
+		(void)pthread_mutex_destroy(&engine->lock);
+		return -1;
+	}
+
+	engine->nb_threads = 0;
+	for (i = 0; i < nb_threads; ++i) {
+		res = pthread_create(&engine->threads[i], NULL, fetch_thread, engine);
+		if (res != 0) {
+			LF_FETCH_ENGINE_LOG(ERR, "Fail to create fetch thread (err = %d)\n",
+					res);
+			lf_fetch_engine_close(engine);
+			return -1;
+		}
+		engine->nb_threads++;
+	}
+
+	LF_FETCH_ENGINE_LOG(INFO,
+			"Started %u fetch threads (window: %d requests)\n", nb_threads,
+			LF_FETCH_ENGINE_WINDOW);
+
+	return 0;
+}
+
+void
+lf_fetch_engine_close(struct lf_fetch_engine *engine)
+{
+	uint16_t i;
+
+	(void)pthread_mutex_lock(&engine->lock);
+	engine->quit = true;
+	(void)pthread_cond_broadcast(&engine->queued_cond);
+	(void)pthread_mutex_unlock(&engine->lock);
+
+	for (i = 0; i < engine->nb_threads; ++i) {
+		(void)pthread_join(engine->threads[i], NULL);
+	}
+	engine->nb_threads = 0;
+
+	(void)pthread_cond_destroy(&engine->queued_cond);
+	(void)pthread_mutex_destroy(&engine->lock);
+}
+
+int
+lf_fetch_engine_submit(struct lf_fetch_engine *engine,
+		const struct lf_fetch_request *request)
+{
+	uint16_t i;
+	struct lf_fetch_slot *slot;
+
+	if (!lf_fetch_engine_has_capacity(engine)) {
+		engine->statistics.requests_rejected++;
+		return -1;
+	}
+
+	(void)pthread_mutex_lock(&engine->lock);
+	for (i = 0; i < LF_FETCH_ENGINE_WINDOW; ++i) {
+		slot = &engine->slots[i];
+		if (slot->state == LF_FETCH_REQUEST_FREE) {
+			break;
+		}
+	}
+	slot->request = *request;
+	slot->request.res = -1;
+	slot->request.attempts = 0;
+	slot->state = LF_FETCH_REQUEST_QUEUED;
+	engine->nb_inflight++;
+	engine->nb_queued++;
+	(void)pthread_cond_signal(&engine->queued_cond);
+	(void)pthread_mutex_unlock(&engine->lock);
+
+	engine->statistics.requests_submitted++;
+
+	return 0;
+}
+
+/**
+ * Backoff before the next attempt after the given number of failed attempts.
+ */
+static uint64_t
+backoff_ns(uint32_t attempts)
+{
+	uint64_t backoff = LF_FETCH_ENGINE_BACKOFF_MIN;
+
+	while (attempts > 1 && backoff < LF_FETCH_ENGINE_BACKOFF_MAX) {
+		backoff *= 2;
+		attempts--;
+	}
+	return RTE_MIN(backoff, (uint64_t)LF_FETCH_ENGINE_BACKOFF_MAX);
+}
+
+uint16_t
+lf_fetch_engine_poll(struct lf_fetch_engine *engine, uint64_t ns_now,
+		struct lf_fetch_request *completed, uint16_t max)
+{
+	uint16_t i, nb_completed = 0, nb_requeued = 0;
+	struct lf_fetch_slot *slot;
+
+	(void)pthread_mutex_lock(&engine->lock);
+	for (i = 0; i < LF_FETCH_ENGINE_WINDOW; ++i) {
+		slot = &engine->slots[i];
+
+		if (slot->state == LF_FETCH_REQUEST_BACKOFF &&
+				ns_now >= slot->ns_retry) {
+			slot->state = LF_FETCH_REQUEST_QUEUED;
+			engine->nb_queued++;
+			nb_requeued++;
+			continue;
+		}
+
+		if (slot->state != LF_FETCH_REQUEST_DONE) {
+			continue;
+		}
+
+		if (slot->request.res != 0 &&
+				slot->request.attempts < LF_FETCH_ENGINE_MAX_ATTEMPTS) {
+			slot->state = LF_FETCH_REQUEST_BACKOFF;
+			slot->ns_retry = ns_now + backoff_ns(slot->request.attempts);
+			engine->statistics.requests_retried++;
+			continue;
+		}
+
+		if (nb_completed == max) {
+			/* returned with the next poll */
+			continue;
+		}
+		completed[nb_completed++] = slot->request;
+		slot->state = LF_FETCH_REQUEST_FREE;
+		engine->nb_inflight--;
+		if (slot->request.res == 0) {
+			engine->statistics.requests_completed++;
+		} else {
+			engine->statistics.requests_failed++;
+		}
+	}
+	if (nb_requeued > 0) {
+		(void)pthread_cond_broadcast(&engine->queued_cond);
+	}
+	(void)pthread_mutex_unlock(&engine->lock);
+
+	return nb_completed;
+}
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_FETCH_ENGINE_H
+#define LF_FETCH_ENGINE_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "drkey.h"
+#include "lib/telemetry/counters.h"
+#include "lib/time/time.h"
+
+/**
+ * The fetch engine performs DRKey fetches asynchronously, such that the key
+ * manager does not block on each fetch while holding its management lock.
+ *
+ * The key manager submits fetch requests, which are processed concurrently by
+ * a pool of fetch threads, and polls the completed requests to apply the
+ * fetched keys. At most LF_FETCH_ENGINE_WINDOW requests are in flight, i.e.,
+ * submitted and not yet polled. Failed fetches are retried with exponential
+ * backoff (starting at LF_FETCH_ENGINE_BACKOFF_MIN) until
+ * LF_FETCH_ENGINE_MAX_ATTEMPTS attempts failed.
+ *
+ * The engine is agnostic to how keys are fetched: the fetch function is
+ * provided when the engine is initialized and is called by the fetch threads
+ * concurrently. The submit and poll functions must only be called by a single
+ * thread.
+ */
+
+/* Maximum number of requests in flight */
+#define LF_FETCH_ENGINE_WINDOW 256
+/* Maximum number of fetch threads */
+#define LF_FETCH_ENGINE_MAX_THREADS 16
+/* Maximum number of attempts per request */
+#define LF_FETCH_ENGINE_MAX_ATTEMPTS 5
+/* Backoff after the first failed attempt (nanoseconds) */
+#define LF_FETCH_ENGINE_BACKOFF_MIN (100 * LF_TIME_NS_IN_MS)
+/* Maximum backoff (nanoseconds) */
+#define LF_FETCH_ENGINE_BACKOFF_MAX (5 * LF_TIME_NS_IN_S)
+
+struct lf_fetch_request {
+	/* DRKey to be fetched (network byte order) */
+	uint64_t src_ia;
+	uint64_t dst_ia;
+	uint16_t drkey_protocol;
+	/* time at which the key must be valid (Unix timestamp in nanoseconds) */
+	uint64_t ns_valid;
+	/* opaque value identifying the request for the submitter */
+	uint64_t tag;
+
+	/* result of the last attempt (0 on success) and the fetched key */
+	int res;
+	struct lf_keymanager_key_container key;
+	uint32_t attempts;
+};
+
+/**
+ * Function fetching the requested key, which is called by the fetch threads.
+ * It sets the request's key and returns 0 on success.
+ */
+typedef int (*lf_fetch_engine_fetch_fn)(void *ctx,
+		struct lf_fetch_request *request);
+
+enum lf_fetch_request_state {
+	/* slot is unused */
+	LF_FETCH_REQUEST_FREE = 0,
+	/* request waits for a fetch thread */
+	LF_FETCH_REQUEST_QUEUED,
+	/* request is processed by a fetch thread */
+	LF_FETCH_REQUEST_RUNNING,
+	/* attempt has completed and waits to be polled */
+	LF_FETCH_REQUEST_DONE,
+	/* attempt has failed and waits to be retried */
+	LF_FETCH_REQUEST_BACKOFF,
+};
+
+struct lf_fetch_slot {
+	struct lf_fetch_request request;
+	enum lf_fetch_request_state state;
+	/* time after which a failed request is retried (nanoseconds) */
+	uint64_t ns_retry;
+};
+
+#define LF_FETCH_ENGINE_STATISTICS(M) \
+	M(uint64_t, requests_submitted)   \
+	M(uint64_t, requests_completed)   \
+	M(uint64_t, requests_failed)      \
+	M(uint64_t, requests_retried)     \
+	M(uint64_t, requests_rejected)
+
+struct lf_fetch_engine_statistics {
+	LF_FETCH_ENGINE_STATISTICS(LF_TELEMETRY_FIELD_DECL)
+};
+
+struct lf_fetch_engine {
+	lf_fetch_engine_fetch_fn fetch;
+	void *fetch_ctx;
+
+	pthread_t threads[LF_FETCH_ENGINE_MAX_THREADS];
+	uint16_t nb_threads;
+
+	/* protects the slots and the counters below */
+	pthread_mutex_t lock;
+	/* signaled when requests are queued or the engine is closed */
+	pthread_cond_t queued_cond;
+	struct lf_fetch_slot slots[LF_FETCH_ENGINE_WINDOW];
+	/* number of used slots and of slots in state QUEUED */
+	uint16_t nb_inflight;
+	uint16_t nb_queued;
+	bool quit;
+
+	/* only written by the submitting thread */
+	struct lf_fetch_engine_statistics statistics;
+};
+
+/**
+ * Initialize the fetch engine and start the fetch threads.
+ *
+ * @param nb_threads Number of fetch threads (at most
+ * LF_FETCH_ENGINE_MAX_THREADS).
+ * @param fetch Function called by the fetch threads to fetch a key.
+ * @param fetch_ctx Context passed to the fetch function.
+ * @return 0 on success.
+ */
+int
+lf_fetch_engine_init(struct lf_fetch_engine *engine, uint16_t nb_threads,
+		lf_fetch_engine_fetch_fn fetch, void *fetch_ctx);
+
+/**
+ * Stop the fetch threads. Requests in flight are discarded.
+ */
+void
+lf_fetch_engine_close(struct lf_fetch_engine *engine);
+
+/**
+ * Submit a fetch request.
+ *
+ * @return 0 on success, and -1 if the window is full.
+ */
+int
+lf_fetch_engine_submit(struct lf_fetch_engine *engine,
+		const struct lf_fetch_request *request);
+
+/**
+ * Collect completed requests and requeue failed requests whose backoff has
+ * passed. Requests that succeeded or failed LF_FETCH_ENGINE_MAX_ATTEMPTS
+ * times are returned and leave the window.
+ *
+ * @param ns_now Current Unix timestamp in nanoseconds.
+ * @param completed Returns the completed requests (res indicates success).
+ * @param max Maximum number of returned requests.
+ * @return Number of returned requests.
+ */
+uint16_t
+lf_fetch_engine_poll(struct lf_fetch_engine *engine, uint64_t ns_now,
+		struct lf_fetch_request *completed, uint16_t max);
+
+/**
+ * @return Returns true if another request can be submitted.
+ */
+static inline bool
+lf_fetch_engine_has_capacity(const struct lf_fetch_engine *engine)
+{
+	/* only the submitting thread changes the number of requests in flight */
+	return engine->nb_inflight < LF_FETCH_ENGINE_WINDOW;
+}
+
+#endif /* LF_FETCH_ENGINE_H */
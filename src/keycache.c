@@ -0,0 +1,372 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_hash_crc.h>
+#include <rte_jhash.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+
+#include "keycache.h"
+#include "lib/log/log.h"
+
+/**
+ * Log function for key cache (not on data path).
+ * Format: "Keycache: log message here"
+ */
+#define LF_KEYCACHE_LOG(level, ...) LF_LOG(level, "Keycache: " __VA_ARGS__)
+
+int
+lf_keycache_init(struct lf_keycache *cache, const char *path)
+{
+	int res;
+
+	memset(cache->path, 0, sizeof(cache->path));
+	memset(cache->tmp_path, 0, sizeof(cache->tmp_path));
+	cache->restored = NULL;
+	cache->restored_entries = NULL;
+	cache->restored_src_as = 0;
+	cache->fd = -1;
+	cache->map = NULL;
+	cache->map_size = 0;
+	cache->max_entries = 0;
+
+	if (path == NULL) {
+		return 0;
+	}
+
+	res = snprintf(cache->tmp_path, sizeof(cache->tmp_path), "%s.tmp", path);
+	if (strlen(path) == 0 || res < 0 ||
+			(size_t)res >= sizeof(cache->tmp_path)) {
+		LF_KEYCACHE_LOG(ERR, "Invalid cache file name\n");
+		cache->tmp_path[0] = '\0';
+		return -1;
+	}
+	(void)strcpy(cache->path, path);
+
+	return 0;
+}
+
+/**
+ * Remove the checkpoint in progress.
+ */
+static void
+checkpoint_abort(struct lf_keycache *cache)
+{
+	if (cache->map != NULL) {
+		(void)munmap(cache->map, cache->map_size);
+		cache->map = NULL;
+	}
+	if (cache->fd >= 0) {
+		(void)close(cache->fd);
+		cache->fd = -1;
+		(void)unlink(cache->tmp_path);
+	}
+}
+
+void
+lf_keycache_close(struct lf_keycache *cache)
+{
+	lf_keycache_release(cache);
+	checkpoint_abort(cache);
+}
+
+/**
+ * Create the hash table, which maps the restored entries' keys to the entries.
+ */
+static struct rte_hash *
+restored_dictionary_init(uint32_t size)
+{
+	struct rte_hash_parameters params = { 0 };
+	/* rte_hash table name */
+	char name[RTE_HASH_NAMESIZE];
+	/* counter to ensure unique rte_hash table name */
+	static int counter = 0;
+
+	(void)snprintf(name, sizeof(name), "lf_keycache_%d", counter);
+	counter += 1;
+
+	params.name = name;
+	/* DPDK hash table entry must be at least 8 (undocumented) */
+	params.entries = RTE_MAX(size, 8U);
+	params.key_len = sizeof(struct lf_keycache_key);
+	params.hash_func = rte_jhash;
+	params.hash_func_init_val = 0;
+	params.socket_id = SOCKET_ID_ANY;
+
+	return rte_hash_create(&params);
+}
+
+/**
+ * CRC of the header, with the crc field set to 0, and the entries.
+ */
+static uint32_t
+checksum(const struct lf_keycache_header *header,
+		const struct lf_keycache_entry *entries)
+{
+	struct lf_keycache_header tmp = *header;
+
+	tmp.crc = 0;
+	return rte_hash_crc(entries,
+			header->nb_entries * sizeof(struct lf_keycache_entry),
+			rte_hash_crc(&tmp, sizeof(tmp), 0));
+}
+
+/**
+ * Check the header of the cache file with the given size.
+ */
+static int
+check_header(const struct lf_keycache_header *header, size_t size,
+		uint32_t max_entries)
+{
+	if (header->magic != LF_KEYCACHE_MAGIC ||
+			header->version != LF_KEYCACHE_VERSION ||
+			header->entry_size != sizeof(struct lf_keycache_entry)) {
+		LF_KEYCACHE_LOG(ERR, "Incompatible cache file\n");
+		return -1;
+	}
+	if (size != sizeof(struct lf_keycache_header) +
+						(size_t)header->nb_entries *
+								sizeof(struct lf_keycache_entry)) {
+		LF_KEYCACHE_LOG(ERR, "Truncated cache file\n");
+		return -1;
+	}
+	if (header->nb_entries > max_entries) {
+		LF_KEYCACHE_LOG(ERR, "Cache file has too many entries (%u > %u)\n",
+				header->nb_entries, max_entries);
+		return -1;
+	}
+	return 0;
+}
+
+int
+lf_keycache_restore(struct lf_keycache *cache, uint32_t max_entries)
+{
+	int fd, res = -1;
+	uint32_t i;
+	struct stat st;
+	void *map;
+	const struct lf_keycache_header *header;
+	const struct lf_keycache_entry *entries;
+
+	lf_keycache_release(cache);
+
+	fd = open(cache->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			LF_KEYCACHE_LOG(INFO, "No cache file to restore\n");
+			return 0;
+		}
+		LF_KEYCACHE_LOG(ERR, "Fail to open cache file (errno = %d)\n",
+				errno);
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		LF_KEYCACHE_LOG(ERR, "Fail to stat cache file (errno = %d)\n", errno);
+		(void)close(fd);
+		return -1;
+	}
+	/* the file contains secret keys */
+	if (!S_ISREG(st.st_mode) || st.st_uid != geteuid() ||
+			(st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+		LF_KEYCACHE_LOG(ERR,
+				"Cache file must be a regular file only accessible by its "
+				"owner\n");
+		(void)close(fd);
+		return -1;
+	}
+	if ((size_t)st.st_size < sizeof(struct lf_keycache_header)) {
+		LF_KEYCACHE_LOG(ERR, "Truncated cache file\n");
+		(void)close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (map == MAP_FAILED) {
+		LF_KEYCACHE_LOG(ERR, "Fail to map cache file (errno = %d)\n", errno);
+		return -1;
+	}
+	header = map;
+	entries = (const struct lf_keycache_entry *)(header + 1);
+
+	if (check_header(header, (size_t)st.st_size, max_entries) != 0) {
+		goto exit_unmap;
+	}
+	if (checksum(header, entries) != header->crc) {
+		LF_KEYCACHE_LOG(ERR, "Corrupted cache file\n");
+		goto exit_unmap;
+	}
+
+	cache->restored_entries = rte_malloc(NULL,
+			RTE_MAX(header->nb_entries, 1U) * sizeof(struct lf_keycache_entry),
+			0);
+	cache->restored = restored_dictionary_init(header->nb_entries);
+	if (cache->restored_entries == NULL || cache->restored == NULL) {
+		LF_KEYCACHE_LOG(ERR, "Fail to allocate memory for restored keys\n");
+		lf_keycache_release(cache);
+		goto exit_unmap;
+	}
+	(void)rte_memcpy(cache->restored_entries, entries,
+			header->nb_entries * sizeof(struct lf_keycache_entry));
+
+	for (i = 0; i < header->nb_entries; ++i) {
+		res = rte_hash_add_key_data(cache->restored,
+				&cache->restored_entries[i].key,
+				&cache->restored_entries[i]);
+		if (res != 0) {
+			LF_KEYCACHE_LOG(ERR, "Fail to add restored entry (err = %d)\n",
+					res);
+			lf_keycache_release(cache);
+			goto exit_unmap;
+		}
+	}
+	cache->restored_src_as = header->src_as;
+
+	LF_KEYCACHE_LOG(NOTICE, "Restored %u entries\n", header->nb_entries);
+	res = 0;
+
+exit_unmap:
+	(void)munmap(map, (size_t)st.st_size);
+	return res;
+}
+
+const struct lf_keycache_entry *
+lf_keycache_lookup(const struct lf_keycache *cache, uint64_t src_as,
+		const struct lf_keycache_key *key)
+{
+	struct lf_keycache_entry *entry;
+
+	if (cache->restored == NULL || cache->restored_src_as != src_as) {
+		return NULL;
+	}
+	if (rte_hash_lookup_data(cache->restored, key, (void **)&entry) < 0) {
+		return NULL;
+	}
+	return entry;
+}
+
+void
+lf_keycache_release(struct lf_keycache *cache)
+{
+	rte_hash_free(cache->restored);
+	cache->restored = NULL;
+	rte_free(cache->restored_entries);
+	cache->restored_entries = NULL;
+	cache->restored_src_as = 0;
+}
+
+int
+lf_keycache_checkpoint_begin(struct lf_keycache *cache, uint64_t src_as,
+		uint32_t max_entries)
+{
+	void *map;
+
+	checkpoint_abort(cache);
+
+	cache->fd = open(cache->tmp_path,
+			O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+			S_IRUSR | S_IWUSR);
+	if (cache->fd < 0) {
+		LF_KEYCACHE_LOG(ERR, "Fail to create checkpoint file (errno = %d)\n",
+				errno);
+		return -1;
+	}
+	/* an existing file keeps its mode */
+	if (fchmod(cache->fd, S_IRUSR | S_IWUSR) != 0) {
+		LF_KEYCACHE_LOG(ERR, "Fail to restrict checkpoint file (errno = %d)\n",
+				errno);
+		checkpoint_abort(cache);
+		return -1;
+	}
+
+	cache->map_size = sizeof(struct lf_keycache_header) +
+	                  (size_t)max_entries * sizeof(struct lf_keycache_entry);
+	if (ftruncate(cache->fd, (off_t)cache->map_size) != 0) {
+		LF_KEYCACHE_LOG(ERR, "Fail to resize checkpoint file (errno = %d)\n",
+				errno);
+		checkpoint_abort(cache);
+		return -1;
+	}
+	map = mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			cache->fd, 0);
+	if (map == MAP_FAILED) {
+		LF_KEYCACHE_LOG(ERR, "Fail to map checkpoint file (errno = %d)\n",
+				errno);
+		checkpoint_abort(cache);
+		return -1;
+	}
+
+	cache->map = map;
+	cache->max_entries = max_entries;
+	/* the header is completed when the checkpoint is committed */
+	memset(cache->map, 0, sizeof(struct lf_keycache_header));
+	cache->map->src_as = src_as;
+
+	return 0;
+}
+
+struct lf_keycache_entry *
+lf_keycache_checkpoint_next(struct lf_keycache *cache)
+{
+	struct lf_keycache_entry *entries;
+
+	if (cache->map == NULL || cache->map->nb_entries == cache->max_entries) {
+		return NULL;
+	}
+	entries = (struct lf_keycache_entry *)(cache->map + 1);
+	return &entries[cache->map->nb_entries++];
+}
+
+int
+lf_keycache_checkpoint_commit(struct lf_keycache *cache)
+{
+	size_t size;
+	uint32_t nb_entries;
+
+	if (cache->map == NULL) {
+		return -1;
+	}
+
+	nb_entries = cache->map->nb_entries;
+	cache->map->magic = LF_KEYCACHE_MAGIC;
+	cache->map->version = LF_KEYCACHE_VERSION;
+	cache->map->entry_size = sizeof(struct lf_keycache_entry);
+	cache->map->crc = checksum(cache->map,
+			(const struct lf_keycache_entry *)(cache->map + 1));
+
+	size = sizeof(struct lf_keycache_header) +
+	       (size_t)nb_entries * sizeof(struct lf_keycache_entry);
+	if (msync(cache->map, cache->map_size, MS_SYNC) != 0 ||
+			munmap(cache->map, cache->map_size) != 0) {
+		LF_KEYCACHE_LOG(ERR, "Fail to write checkpoint (errno = %d)\n", errno);
+		checkpoint_abort(cache);
+		return -1;
+	}
+	cache->map = NULL;
+
+	/* drop the unused entries and replace the cache file */
+	if (ftruncate(cache->fd, (off_t)size) != 0 || fsync(cache->fd) != 0 ||
+			rename(cache->tmp_path, cache->path) != 0) {
+		LF_KEYCACHE_LOG(ERR, "Fail to store checkpoint (errno = %d)\n", errno);
+		checkpoint_abort(cache);
+		return -1;
+	}
+	(void)close(cache->fd);
+	cache->fd = -1;
+
+	LF_KEYCACHE_LOG(DEBUG, "Checkpointed %u entries\n", nb_entries);
+	return 0;
+}
@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_KEYCACHE_H
+#define LF_KEYCACHE_H
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include <rte_hash.h>
+
+#include "lib/crypto/crypto.h"
+
+/**
+ * The key cache persists the key manager's AS-AS DRKeys in a file, such that
+ * they can be restored after a restart instead of being fetched again.
+ *
+ * A checkpoint is written into a memory-mapped temporary file, which then
+ * atomically replaces the cache file. Hence, the cache file always contains a
+ * complete checkpoint.
+ *
+ * Since the file contains secret keys, it is created such that only its owner
+ * can access it, and a file that is accessible by other users is not restored.
+ * Only the raw key bytes are stored. The derived state of a key, e.g., the AES
+ * round keys, is rebuilt when the key is restored. A file whose version or
+ * checksum does not match is not restored.
+ */
+
+#define LF_KEYCACHE_MAGIC   0x4c464b43 /* "LFKC" */
+#define LF_KEYCACHE_VERSION 2
+
+struct lf_keycache_header {
+	uint32_t magic;
+	uint32_t version;
+	/* size of an entry, which detects files written by incompatible builds */
+	uint32_t entry_size;
+	uint32_t nb_entries;
+	/* AS for which the keys have been fetched (network byte order) */
+	uint64_t src_as;
+	/* CRC of the header (with crc set to 0) and the entries */
+	uint32_t crc;
+	uint32_t reserved;
+};
+
+struct lf_keycache_key {
+	uint64_t as;             /* network byte order */
+	uint16_t drkey_protocol; /* network byte order */
+} __attribute__((__packed__));
+
+/*
+ * Raw DRKey with its validity period.
+ */
+struct lf_keycache_drkey {
+	uint64_t validity_not_before; /* Unix timestamp (nanoseconds) */
+	uint64_t validity_not_after;  /* Unix timestamp (nanoseconds) */
+	uint8_t key[LF_CRYPTO_DRKEY_SIZE];
+};
+
+struct lf_keycache_entry {
+	struct lf_keycache_key key;
+	struct lf_keycache_drkey inbound_key;
+	struct lf_keycache_drkey old_inbound_key;
+	struct lf_keycache_drkey outbound_key;
+	struct lf_keycache_drkey old_outbound_key;
+};
+
+struct lf_keycache {
+	/* cache file and the temporary file for checkpoints (empty if disabled) */
+	char path[PATH_MAX];
+	char tmp_path[PATH_MAX];
+
+	/* restored entries, looked up by AS and DRKey protocol (NULL if none) */
+	struct rte_hash *restored;
+	struct lf_keycache_entry *restored_entries;
+	uint64_t restored_src_as;
+
+	/* checkpoint in progress */
+	int fd;
+	struct lf_keycache_header *map;
+	size_t map_size;
+	uint32_t max_entries;
+};
+
+/**
+ * Initialize the key cache.
+ *
+ * @param path Cache file. If NULL, the key cache is disabled.
+ * @return 0 on success.
+ */
+int
+lf_keycache_init(struct lf_keycache *cache, const char *path);
+
+/**
+ * Release the restored entries and discard a checkpoint in progress.
+ */
+void
+lf_keycache_close(struct lf_keycache *cache);
+
+static inline bool
+lf_keycache_enabled(const struct lf_keycache *cache)
+{
+	return cache->path[0] != '\0';
+}
+
+/**
+ * Load the entries of the cache file. A missing cache file is not an error.
+ *
+ * @param max_entries Maximum number of entries to be restored.
+ * @return 0 on success, and -1 if the cache file is invalid or accessible by
+ * other users.
+ */
+int
+lf_keycache_restore(struct lf_keycache *cache, uint32_t max_entries);
+
+/**
+ * Look up a restored entry.
+ *
+ * @param src_as AS for which the keys must have been fetched (network byte
+ * order).
+ * @return The restored entry, or NULL if there is none.
+ */
+const struct lf_keycache_entry *
+lf_keycache_lookup(const struct lf_keycache *cache, uint64_t src_as,
+		const struct lf_keycache_key *key);
+
+/**
+ * Release the restored entries.
+ */
+void
+lf_keycache_release(struct lf_keycache *cache);
+
+/**
+ * Start a checkpoint, which can hold up to max_entries entries.
+ *
+ * @param src_as AS for which the keys have been fetched (network byte order).
+ * @return 0 on success.
+ */
+int
+lf_keycache_checkpoint_begin(struct lf_keycache *cache, uint64_t src_as,
+		uint32_t max_entries);
+
+/**
+ * @return The next entry of the checkpoint in progress to be filled in, or
+ * NULL if the checkpoint is full.
+ */
+struct lf_keycache_entry *
+lf_keycache_checkpoint_next(struct lf_keycache *cache);
+
+/**
+ * Complete the checkpoint in progress and replace the cache file with it.
+ *
+ * @return 0 on success. On failure, the previous cache file is kept.
+ */
+int
+lf_keycache_checkpoint_commit(struct lf_keycache *cache);
+
+#endif /* LF_KEYCACHE_H */
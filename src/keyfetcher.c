@@ -2,6 +2,7 @@
  * Copyright (c) 2021 ETH Zurich
  */
 
+#include <assert.h>
 #include <inttypes.h>
 
 #include <rte_byteorder.h>
@@ -125,7 +126,6 @@ lf_keyfetcher_derive_shared_key(struct lf_crypto_drkey_ctx *drkey_ctx,
 	return 0;
 }
 
-// should only be called when keymanager management lock is hold
 int
 lf_keyfetcher_fetch_as_as_key(struct lf_keyfetcher *kf, uint64_t src_ia,
 		uint64_t dst_ia, uint16_t drkey_protocol, uint64_t ns_valid,
@@ -135,6 +135,8 @@ lf_keyfetcher_fetch_as_as_key(struct lf_keyfetcher *kf, uint64_t src_ia,
 	struct lf_keyfetcher_dictionary_key dict_key;
 	struct lf_keyfetcher_sv_dictionary_data *shared_secret_node;
 
+	rte_spinlock_lock(&kf->lock);
+
 	// check if there is entry in cache
 	dict_key.as = src_ia == kf->src_ia ? dst_ia : src_ia;
 	dict_key.drkey_protocol = drkey_protocol;
@@ -153,6 +155,8 @@ lf_keyfetcher_fetch_as_as_key(struct lf_keyfetcher *kf, uint64_t src_ia,
 				rte_be_to_cpu_16(drkey_protocol));
 		res = -1;
 	}
+
+	rte_spinlock_unlock(&kf->lock);
 	return res;
 }
 
@@ -267,6 +271,11 @@ lf_keyfetcher_fetch_host_host_key(struct lf_keyfetcher *kf, uint64_t src_ia,
 	return res;
 }
 
+/* the dictionary keys are looked up in the config's peer set */
+static_assert(sizeof(struct lf_keyfetcher_dictionary_key) ==
+					  sizeof(struct lf_config_peer_key),
+		"unexpected dictionary key size");
+
 // should only be called when keymanager management lock is hold
 int
 lf_keyfetcher_apply_config(struct lf_keyfetcher *kf,
@@ -274,29 +283,24 @@ lf_keyfetcher_apply_config(struct lf_keyfetcher *kf,
 {
 	int res, err = 0, key_id;
 	uint32_t iterator;
-	bool is_in_list;
 	struct lf_keyfetcher_dictionary_key key, *key_ptr;
 	struct lf_keyfetcher_sv_dictionary_data *shared_secret_data;
 	struct lf_config_peer *peer;
+	struct rte_hash *peer_set;
 
 	LF_KEYFETCHER_LOG(NOTICE, "Apply config!\n");
 
-	memcpy(kf->drkey_service_addr, config->drkey_service_addr,
-			sizeof kf->drkey_service_addr);
+	peer_set = lf_config_peer_set_new(config);
+	if (peer_set == NULL) {
+		LF_KEYFETCHER_LOG(ERR, "Failed to set config");
+		return -1;
+	}
 
-	kf->src_ia = config->isd_as;
+	rte_spinlock_lock(&kf->lock);
 
 	for (iterator = 0; rte_hash_iterate(kf->dict, (void *)&key_ptr,
 							   (void **)&shared_secret_data, &iterator) >= 0;) {
-		is_in_list = false;
-		for (peer = config->peers; peer != NULL; peer = peer->next) {
-			if (peer->isd_as == key_ptr->as &&
-					peer->drkey_protocol == key_ptr->drkey_protocol) {
-				is_in_list = true;
-				break;
-			}
-		}
-		if (!is_in_list) {
+		if (rte_hash_lookup(peer_set, key_ptr) < 0) {
 			// Remove SV since peer is no longer configured.
 			LF_KEYFETCHER_LOG(DEBUG,
 					"Remove SV entry for AS " PRIISDAS " DRKey protocol %u\n",
@@ -307,6 +311,7 @@ lf_keyfetcher_apply_config(struct lf_keyfetcher *kf,
 			rte_free(shared_secret_data);
 		}
 	}
+	rte_hash_free(peer_set);
 
 	for (peer = config->peers; peer != NULL; peer = peer->next) {
 		key.as = peer->isd_as;
@@ -368,6 +373,15 @@ lf_keyfetcher_apply_config(struct lf_keyfetcher *kf,
 			}
 		}
 	}
+
+	/* the source AS and service address only change with the whole config */
+	if (err == 0) {
+		memcpy(kf->drkey_service_addr, config->drkey_service_addr,
+				sizeof kf->drkey_service_addr);
+		kf->src_ia = config->isd_as;
+	}
+	rte_spinlock_unlock(&kf->lock);
+
 	if (err == 0) {
 		return 0;
 	} else {
@@ -470,6 +484,7 @@ lf_keyfetcher_init(struct lf_keyfetcher *kf, uint32_t initial_size)
 	}
 	// NOLINTEND(readability-magic-numbers)
 	kf->size = initial_size;
+	rte_spinlock_init(&kf->lock);
 	kf->dict = key_dictionary_init(initial_size);
 	if (kf->dict == NULL) {
 		return -1;
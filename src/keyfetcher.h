@@ -8,6 +8,7 @@
 #include <inttypes.h>
 
 #include <rte_jhash.h>
+#include <rte_spinlock.h>
 
 #include "config.h"
 #include "drkey.h"
@@ -23,6 +24,10 @@
  *
  * The keyfetcher does not implement additional caching.
  *
+ * AS-AS keys can be fetched concurrently, e.g., by the key manager's fetch
+ * engine. The keyfetcher's lock protects the SV dictionary and the crypto
+ * context against concurrent fetches and configuration changes.
+ *
  * The CS fetching depends on a DRKey fetcher module, which depends on the
  * deployment setup.
  */
@@ -54,8 +59,14 @@ struct lf_keyfetcher {
 
 	/* crypto DRKey context */
 	struct lf_crypto_drkey_ctx drkey_ctx;
+
+	/* protects the SV dictionary and the crypto context */
+	rte_spinlock_t lock;
 };
 
+/**
+ * Fetch an AS-AS key. This function is thread-safe.
+ */
 int
 lf_keyfetcher_fetch_as_as_key(struct lf_keyfetcher *kf, uint64_t src_ia,
 		uint64_t dst_ia, uint16_t drkey_protocol, uint64_t ns_valid,
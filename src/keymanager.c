@@ -2,14 +2,22 @@
  * Copyright (c) 2021 ETH Zurich
  */
 
+#include <assert.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 
 #include <rte_branch_prediction.h>
 #include <rte_byteorder.h>
 #include <rte_cycles.h>
+#include <rte_errno.h>
 #include <rte_jhash.h>
+#include <rte_lcore.h>
 #include <rte_malloc.h>
 #include <rte_memcpy.h>
+#include <rte_mempool.h>
+#include <rte_random.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_ring.h>
 #include <rte_spinlock.h>
 #include <rte_telemetry.h>
 
@@ -27,10 +35,27 @@
  * Synchronization and Atomic Operations:
  * For the key dictionary, the rte_hash is used, which provides a lock-free RW
  * implementation. This is sufficient, since key updates only happen rarely.
- * After updating (or removing) a key, the old memory is freed after all workers
- * pass through the quiescent state. This ensures, that no worker still accesses
- * the memory.
+ * After updating (or removing) a key, the old memory is enqueued in the RCU
+ * defer queue and only returned to its mempool after all workers passed through
+ * the quiescent state. This ensures, that no worker still accesses the memory,
+ * without the manager waiting for the workers.
  * The manager lock ensures that updates to the dictionary cannot interleave.
+ *
+ * The workers do not access the dictionary but a replica on their socket, which
+ * holds socket-local copies of the dictionary data. Whenever the manager
+ * adds, replaces, or removes an entry, it does the same in all replicas, i.e.,
+ * the replicas' old data are also reclaimed after the workers passed through the
+ * quiescent state. The dictionary's own data are not accessed by the workers
+ * and are returned to the mempool immediately.
+ * Since the hash tables are lock-free, the key positions of removed entries are
+ * not freed on deletion. The replicas free them through their RCU defer queue,
+ * the dictionary immediately.
+ *
+ * Each worker caches the host-to-host DRKeys it derived. The cache entries are
+ * tagged with the key manager's generation, which is increased whenever AS-AS
+ * DRKeys are replaced or removed. Workers load the generation before looking up
+ * the AS-AS DRKey, such that a derived key is never cached with a generation
+ * newer than the AS-AS DRKey it has been derived from.
  */
 
 /**
@@ -39,165 +64,1100 @@
  */
 #define LF_KEYMANAGER_LOG(level, ...) LF_LOG(level, "Keymanager: " __VA_ARGS__)
 
-struct linked_list {
+/**
+ * Wait for all workers to be in the quiescent state.
+ */
+inline static void
+synchronize_worker(struct lf_keymanager *km)
+{
+	(void)rte_rcu_qsbr_synchronize(km->qsv, RTE_QSBR_THRID_INVALID);
+}
+
+/*
+ * Dictionary Data Allocation:
+ * The dictionary data are allocated from fixed-size mempools, one for the
+ * dictionary and one for each socket replica, such that key updates do not
+ * fragment the heap.
+ */
+
+/**
+ * Create the mempool for the data of a dictionary with the given size. It holds
+ * each entry and a replaced copy awaiting reclamation.
+ */
+static struct rte_mempool *
+data_pool_new(uint32_t size, int socket)
+{
+	struct rte_mempool *pool;
+	/* mempool name */
+	char name[RTE_MEMPOOL_NAMESIZE];
+	/* counter to ensure unique mempool name */
+	static int counter = 0;
+
+	(void)snprintf(name, sizeof(name), "lf_km_data_%d", counter);
+	counter += 1;
+
+	/* only the manager gets and puts data */
+	pool = rte_mempool_create(name, 2 * size,
+			sizeof(struct lf_keymanager_dictionary_data), 0, 0, NULL, NULL,
+			NULL, NULL, socket, RTE_MEMPOOL_F_SP_PUT | RTE_MEMPOOL_F_SC_GET);
+	if (pool == NULL) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to create data pool (err = %d)\n",
+				rte_errno);
+	}
+	return pool;
+}
+
+/**
+ * Free function of the RCU defer queue, returning the data to their mempool.
+ */
+static void
+data_reclaim(void *p, void *e, unsigned int n)
+{
+	unsigned int i;
+	void **data = e;
+	(void)p;
+
+	for (i = 0; i < n; ++i) {
+		rte_mempool_put(rte_mempool_from_obj(data[i]), data[i]);
+	}
+}
+
+/**
+ * Get dictionary data from the mempool. If the mempool is exhausted, the data
+ * no worker accesses anymore are reclaimed first, and only if this does not
+ * suffice, the manager waits for the workers. Requires the management lock!
+ */
+static struct lf_keymanager_dictionary_data *
+data_alloc(struct lf_keymanager *km, struct rte_mempool *pool)
+{
 	void *data;
-	void *next;
-};
 
+	if (likely(rte_mempool_get(pool, &data) == 0)) {
+		return data;
+	}
+
+	(void)rte_rcu_qsbr_dq_reclaim(km->dq, UINT32_MAX, NULL, NULL, NULL);
+	if (rte_mempool_get(pool, &data) == 0) {
+		return data;
+	}
+
+	synchronize_worker(km);
+	(void)rte_rcu_qsbr_dq_reclaim(km->dq, UINT32_MAX, NULL, NULL, NULL);
+	if (rte_mempool_get(pool, &data) == 0) {
+		return data;
+	}
+
+	LF_KEYMANAGER_LOG(ERR, "Fail to allocate memory for key\n");
+	return NULL;
+}
+
+/**
+ * Return the data of a socket replica to its mempool after all workers passed
+ * through the quiescent state. Requires the management lock!
+ */
+static void
+data_free_deferred(struct lf_keymanager *km,
+		struct lf_keymanager_dictionary_data *data)
+{
+	if (unlikely(rte_rcu_qsbr_dq_enqueue(km->dq, &data) != 0)) {
+		/* defer queue is full, i.e., wait for the workers */
+		synchronize_worker(km);
+		rte_mempool_put(rte_mempool_from_obj(data), data);
+	}
+}
+
+/**
+ * Create the RCU defer queue for the replicas' data, which reclaims the data no
+ * worker accesses anymore whenever new data is enqueued.
+ */
+static struct rte_rcu_qsbr_dq *
+replicas_dq_new(struct lf_keymanager *km, uint32_t size)
+{
+	struct rte_rcu_qsbr_dq *dq;
+	struct rte_rcu_qsbr_dq_parameters params = { 0 };
+	/* defer queue name */
+	char name[RTE_RCU_QSBR_DQ_NAMESIZE];
+	/* counter to ensure unique defer queue name */
+	static int counter = 0;
+
+	(void)snprintf(name, sizeof(name), "lf_km_dq_%d", counter);
+	counter += 1;
+
+	params.name = name;
+	/* only accessed with the management lock */
+	params.flags = RTE_RCU_QSBR_DQ_MT_UNSAFE;
+	params.size = size;
+	params.esize = sizeof(struct lf_keymanager_dictionary_data *);
+	params.trigger_reclaim_limit = 0;
+	params.max_reclaim_size = size;
+	params.free_fn = data_reclaim;
+	params.p = NULL;
+	params.v = km->qsv;
+
+	dq = rte_rcu_qsbr_dq_create(&params);
+	if (dq == NULL) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to create defer queue (err = %d)\n",
+				rte_errno);
+	}
+	return dq;
+}
+
+/**
+ * Set the dictionary data of the key in all socket replicas to a copy of data.
+ * The replaced data are reclaimed deferred. Requires the management lock!
+ */
+static int
+replicas_set(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key,
+		const struct lf_keymanager_dictionary_data *data)
+{
+	int res;
+	unsigned int socket;
+	struct lf_keymanager_dictionary_data *old_data, *new_data;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (km->socket_dict[socket] == NULL) {
+			continue;
+		}
+		new_data = data_alloc(km, km->socket_pool[socket]);
+		if (new_data == NULL) {
+			return -1;
+		}
+		(void)rte_memcpy(new_data, data,
+				sizeof(struct lf_keymanager_dictionary_data));
+
+		res = rte_hash_lookup_data(km->socket_dict[socket], key,
+				(void **)&old_data);
+		if (res < 0) {
+			old_data = NULL;
+		}
+		res = rte_hash_add_key_data(km->socket_dict[socket], key,
+				(void *)new_data);
+		if (res != 0) {
+			LF_KEYMANAGER_LOG(ERR,
+					"Fail to add key to dictionary on socket %u (err = %d)\n",
+					socket, res);
+			rte_mempool_put(km->socket_pool[socket], new_data);
+			return -1;
+		}
+		if (old_data != NULL) {
+			data_free_deferred(km, old_data);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Remove the key from all socket replicas. The data are reclaimed deferred.
+ * Requires the management lock!
+ */
+static void
+replicas_del(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key)
+{
+	int res;
+	unsigned int socket;
+	struct lf_keymanager_dictionary_data *data;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (km->socket_dict[socket] == NULL) {
+			continue;
+		}
+		res = rte_hash_lookup_data(km->socket_dict[socket], key,
+				(void **)&data);
+		if (res < 0) {
+			continue;
+		}
+		(void)rte_hash_del_key(km->socket_dict[socket], key);
+		data_free_deferred(km, data);
+	}
+}
+
+/*
+ * LRU List:
+ * With on-demand fetching, the dictionary entries are kept in a doubly linked
+ * list ordered by the time they have last been reported by the workers. The
+ * list is indexed by the entries' key positions in the dictionary, which do not
+ * change while the entry exists.
+ */
+
+/**
+ * Remove the entry at the key position from the LRU list. Requires the
+ * management lock!
+ */
+static void
+lru_unlink(struct lf_keymanager *km, uint32_t pos)
+{
+	struct lf_keymanager_lru_node *node = &km->lru[pos];
+
+	if (node->prev != LF_KEYMANAGER_LRU_NONE) {
+		km->lru[node->prev].next = node->next;
+	} else {
+		km->lru_head = node->next;
+	}
+	if (node->next != LF_KEYMANAGER_LRU_NONE) {
+		km->lru[node->next].prev = node->prev;
+	} else {
+		km->lru_tail = node->prev;
+	}
+}
+
+/**
+ * Insert the entry at the key position as most recently used entry. Requires
+ * the management lock!
+ */
+static void
+lru_push_front(struct lf_keymanager *km, uint32_t pos,
+		const struct lf_keymanager_dictionary_key *key, uint64_t ns_now)
+{
+	struct lf_keymanager_lru_node *node = &km->lru[pos];
+
+	node->key = *key;
+	node->ns_last_used = ns_now;
+	node->prev = LF_KEYMANAGER_LRU_NONE;
+	node->next = km->lru_head;
+	if (km->lru_head != LF_KEYMANAGER_LRU_NONE) {
+		km->lru[km->lru_head].prev = pos;
+	} else {
+		km->lru_tail = pos;
+	}
+	km->lru_head = pos;
+}
+
+/**
+ * Remove the entry from the dictionary and all socket replicas. Requires the
+ * management lock!
+ */
+static void
+entry_remove(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key,
+		struct lf_keymanager_dictionary_data *data)
+{
+	int32_t pos;
+
+	replicas_del(km, key);
+	pos = rte_hash_del_key(km->dict, key);
+	if (pos >= 0) {
+		if (km->report_ring != NULL) {
+			lru_unlink(km, (uint32_t)pos);
+		}
+		/* the dictionary is not accessed by the workers */
+		(void)rte_hash_free_key_with_position(km->dict, pos);
+	}
+	/* the dictionary data is not accessed by the workers */
+	rte_mempool_put(km->dict_pool, data);
+}
+
+/**
+ * Invalidate the workers' host-to-host DRKey caches.
+ * This has to be called after AS-AS DRKeys have been replaced or removed from
+ * the dictionary.
+ */
+static void
+invalidate_worker_caches(struct lf_keymanager *km)
+{
+	(void)atomic_fetch_add_explicit(&km->generation, 1, memory_order_release);
+}
+
+/*
+ * Refresh Scheduler:
+ * The refreshes of the inbound and outbound keys are kept in a min-heap ordered
+ * by their due time, such that each update only touches the keys which are due.
+ * Refreshes are not removed from the heap when the key is replaced or the entry
+ * is removed. Instead, a refresh is discarded when it is due and the expiry of
+ * the current key does not match anymore.
+ */
+
+/**
+ * Add the refresh to the heap. Requires the management lock!
+ */
+static int
+refresh_push(struct lf_keymanager *km,
+		const struct lf_keymanager_refresh *refresh)
+{
+	uint32_t i, parent;
+	struct lf_keymanager_refresh *heap;
+
+	if (km->refresh_nb == km->refresh_capacity) {
+		heap = rte_realloc(km->refresh_heap,
+				2 * km->refresh_capacity * sizeof(struct lf_keymanager_refresh),
+				0);
+		if (heap == NULL) {
+			return -1;
+		}
+		km->refresh_heap = heap;
+		km->refresh_capacity *= 2;
+	}
+
+	heap = km->refresh_heap;
+	for (i = km->refresh_nb; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (heap[parent].ns_due <= refresh->ns_due) {
+			break;
+		}
+		heap[i] = heap[parent];
+	}
+	heap[i] = *refresh;
+	km->refresh_nb++;
+	return 0;
+}
+
+/**
+ * Remove the refresh with the earliest due time from the heap. Requires the
+ * management lock!
+ */
+static void
+refresh_pop(struct lf_keymanager *km)
+{
+	uint32_t i, child;
+	struct lf_keymanager_refresh *heap = km->refresh_heap;
+	struct lf_keymanager_refresh last;
+
+	last = heap[--km->refresh_nb];
+	for (i = 0; (child = 2 * i + 1) < km->refresh_nb; i = child) {
+		if (child + 1 < km->refresh_nb &&
+				heap[child + 1].ns_due < heap[child].ns_due) {
+			child++;
+		}
+		if (last.ns_due <= heap[child].ns_due) {
+			break;
+		}
+		heap[i] = heap[child];
+	}
+	heap[i] = last;
+}
+
+/**
+ * Time at which a key expiring at validity_not_after is refreshed, i.e.,
+ * LF_DRKEY_PREFETCHING_PERIOD plus a random jitter before it expires.
+ */
+static uint64_t
+refresh_due(uint64_t validity_not_after)
+{
+	uint64_t lead = LF_DRKEY_PREFETCHING_PERIOD +
+			rte_rand_max(LF_KEYMANAGER_REFRESH_JITTER);
+
+	return validity_not_after > lead ? validity_not_after - lead : 0;
+}
+
+/**
+ * Schedule the refresh of the inbound or outbound key of the dictionary entry.
+ * Requires the management lock!
+ */
+static void
+refresh_schedule(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key, uint8_t direction,
+		uint64_t validity_not_after, uint64_t ns_due)
+{
+	struct lf_keymanager_refresh refresh = {
+		.ns_due = ns_due,
+		.validity_not_after = validity_not_after,
+		.key = *key,
+		.direction = direction,
+	};
+
+	if (refresh_push(km, &refresh) != 0) {
+		LF_KEYMANAGER_LOG(ERR,
+				"Fail to schedule refresh for AS " PRIISDAS
+				" DRKey protocol %u\n",
+				PRIISDAS_VAL(rte_be_to_cpu_64(key->as)),
+				rte_be_to_cpu_16(key->drkey_protocol));
+	}
+}
+
+/**
+ * @return The current inbound or outbound key of the dictionary entry.
+ */
+static inline struct lf_keymanager_key_container *
+current_key(struct lf_keymanager_dictionary_data *data, uint8_t direction)
+{
+	if (direction == LF_KEYMANAGER_DIRECTION_INBOUND) {
+		return &data->inbound_key;
+	}
+	return &data->outbound_key;
+}
+
+/**
+ * Fetch function of the fetch engine, which is called by the fetch threads.
+ */
+static int
+fetch_as_as_key(void *ctx, struct lf_fetch_request *request)
+{
+	struct lf_keymanager *km = ctx;
+
+	return lf_keyfetcher_fetch_as_as_key(km->fetcher, request->src_ia,
+			request->dst_ia, request->drkey_protocol, request->ns_valid,
+			&request->key);
+}
+
+/**
+ * Replace the inbound or outbound key of the dictionary entry with the fetched
+ * key. The previous key is kept as old key and the refresh of the new key is
+ * scheduled. If the key cannot be replaced, the refresh of the current key is
+ * rescheduled. Requires the management lock!
+ *
+ * @return Returns true if the key has been replaced.
+ */
+static bool
+apply_fetched_key(struct lf_keymanager *km,
+		const struct lf_fetch_request *request, uint64_t ns_now)
+{
+	int res;
+	uint8_t direction = (uint8_t)request->tag;
+	struct lf_keymanager_dictionary_key key;
+	struct lf_keymanager_dictionary_data *data, *new_data;
+	uint64_t validity_not_after;
+
+	if (direction == LF_KEYMANAGER_DIRECTION_INBOUND) {
+		key.as = request->src_ia;
+	} else {
+		key.as = request->dst_ia;
+	}
+	key.drkey_protocol = request->drkey_protocol;
+
+	res = rte_hash_lookup_data(km->dict, &key, (void **)&data);
+	if (res < 0) {
+		/* peer has been removed in the meantime */
+		return false;
+	}
+	/* the dictionary data is only accessed by the manager */
+	data->fetch_pending &= ~(1 << direction);
+	validity_not_after = current_key(data, direction)->validity_not_after;
+
+	if (request->res != 0) {
+		km->statistics.fetch_fail++;
+		LF_KEYMANAGER_LOG(ERR,
+				"Fail to fetch %s key for AS " PRIISDAS
+				" DRKey protocol %u (attempts: %u)\n",
+				direction == LF_KEYMANAGER_DIRECTION_INBOUND ? "inbound"
+															 : "outbound",
+				PRIISDAS_VAL(rte_be_to_cpu_64(key.as)),
+				rte_be_to_cpu_16(key.drkey_protocol), request->attempts);
+		goto retry;
+	}
+	if ((direction == LF_KEYMANAGER_DIRECTION_INBOUND ? request->dst_ia
+													  : request->src_ia) !=
+			km->src_as) {
+		/* key has been fetched for a previously configured AS */
+		refresh_schedule(km, &key, direction, validity_not_after, ns_now);
+		return false;
+	}
+	km->statistics.fetch_successful++;
+
+	/*
+	 * create new node and copy everything from old node
+	 */
+	new_data = data_alloc(km, km->dict_pool);
+	if (new_data == NULL) {
+		goto retry;
+	}
+	(void)rte_memcpy(new_data, data,
+			sizeof(struct lf_keymanager_dictionary_data));
+
+	/* keep key as old key */
+	if (direction == LF_KEYMANAGER_DIRECTION_INBOUND) {
+		new_data->old_inbound_key = data->inbound_key;
+		new_data->inbound_key = request->key;
+	} else {
+		new_data->old_outbound_key = data->outbound_key;
+		new_data->outbound_key = request->key;
+	}
+
+	/* add new node to dictionary */
+	res = rte_hash_add_key_data(km->dict, &key, (void *)new_data);
+	if (res != 0) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to add key to dictionary (err = %d)\n",
+				res);
+		rte_mempool_put(km->dict_pool, new_data);
+		goto retry;
+	}
+	/* the old dictionary data is not accessed by the workers */
+	rte_mempool_put(km->dict_pool, data);
+	if (replicas_set(km, &key, new_data) != 0) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to update dictionary replicas\n");
+	}
+
+	refresh_schedule(km, &key, direction, request->key.validity_not_after,
+			refresh_due(request->key.validity_not_after));
+	km->keycache_dirty = true;
+	return true;
+
+retry:
+	if (km->report_ring != NULL && validity_not_after < ns_now) {
+		/* the reported peer has no valid key, i.e., it might be unknown to
+		 * the key fetcher */
+		refresh_schedule(km, &key, direction, validity_not_after,
+				ns_now + LF_KEYMANAGER_ON_DEMAND_RETRY);
+		return false;
+	}
+	/* the fetch engine already backed off, retry with the next update */
+	refresh_schedule(km, &key, direction, validity_not_after,
+			ns_now + (uint64_t)(LF_KEYMANAGER_INTERVAL * LF_TIME_NS_IN_S));
+	return false;
+}
+
+/* tag of the fetch requests for pending peers (see on-demand key fetching) */
+#define ON_DEMAND_TAG (UINT64_C(1) << 8)
+
+static void
+on_demand_apply(struct lf_keymanager *km,
+		const struct lf_fetch_request *request, uint64_t ns_now);
+
+/**
+ * Apply the keys fetched since the last call. Requires the management lock!
+ */
+static void
+apply_fetched_keys(struct lf_keymanager *km, uint64_t ns_now)
+{
+	uint16_t i, nb_completed;
+	bool replaced = false;
+	struct lf_fetch_request completed[LF_FETCH_ENGINE_WINDOW];
+
+	nb_completed = lf_fetch_engine_poll(&km->fetch_engine, ns_now, completed,
+			LF_FETCH_ENGINE_WINDOW);
+	for (i = 0; i < nb_completed; ++i) {
+		if (completed[i].tag == ON_DEMAND_TAG) {
+			on_demand_apply(km, &completed[i], ns_now);
+			continue;
+		}
+		if (apply_fetched_key(km, &completed[i], ns_now)) {
+			replaced = true;
+		}
+	}
+
+	if (replaced) {
+		invalidate_worker_caches(km);
+	}
+}
+
+/**
+ * Submit a fetch request for the inbound or outbound key of the dictionary
+ * entry. Requires the management lock!
+ *
+ * @return 0 on success, and -1 if the fetch engine's window is full.
+ */
+static int
+submit_fetch(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key,
+		struct lf_keymanager_dictionary_data *data, uint8_t direction,
+		uint64_t ns_valid)
+{
+	struct lf_fetch_request request = {
+		.drkey_protocol = key->drkey_protocol,
+		.ns_valid = ns_valid,
+		.tag = direction,
+	};
+
+	if (direction == LF_KEYMANAGER_DIRECTION_INBOUND) {
+		request.src_ia = key->as;
+		request.dst_ia = km->src_as;
+	} else {
+		request.src_ia = km->src_as;
+		request.dst_ia = key->as;
+	}
+
+	if (lf_fetch_engine_submit(&km->fetch_engine, &request) != 0) {
+		return -1;
+	}
+	data->fetch_pending |= 1 << direction;
+	return 0;
+}
+
+/**
+ * Schedule the refresh of the inbound or outbound key of a new dictionary
+ * entry. A key that is not valid is requested right away, or with the next
+ * update if the fetch engine's window is full. Requires the management lock!
+ */
+static void
+request_new_key(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key,
+		struct lf_keymanager_dictionary_data *data, uint8_t direction,
+		uint64_t ns_now)
+{
+	uint64_t validity_not_after =
+			current_key(data, direction)->validity_not_after;
+
+	if (validity_not_after != 0) {
+		refresh_schedule(km, key, direction, validity_not_after,
+				refresh_due(validity_not_after));
+		return;
+	}
+	if (submit_fetch(km, key, data, direction, ns_now) != 0) {
+		refresh_schedule(km, key, direction, 0, ns_now);
+	}
+}
+
+/*
+ * On-Demand Key Fetching:
+ * For each peer reported by the workers that is not in the dictionary, the
+ * manager requests the inbound key and keeps the peer in the pending table.
+ * Only once the key has been fetched, an entry is added to the dictionary and
+ * the replicas, evicting the least recently used entry if the dictionary is
+ * full, and the outbound key is requested. Hence, reports of peers whose keys
+ * cannot be fetched do not evict entries. Such peers stay in the pending table
+ * until LF_KEYMANAGER_ON_DEMAND_RETRY has passed, unless the slot is needed for
+ * another peer. Removing an entry does not invalidate the workers' caches,
+ * since the workers look up the AS-AS key before the cache.
+ */
+
+/**
+ * Remove the least recently used entry. Requires the management lock!
+ */
+static void
+on_demand_remove_lru(struct lf_keymanager *km)
+{
+	uint32_t pos = km->lru_tail;
+	struct lf_keymanager_dictionary_data *data;
+
+	if (rte_hash_lookup_data(km->dict, &km->lru[pos].key, (void **)&data) <
+			0) {
+		lru_unlink(km, pos);
+		return;
+	}
+	entry_remove(km, &km->lru[pos].key, data);
+}
+
+/**
+ * Add an entry with the fetched inbound key for the reported peer and request
+ * its outbound key. Requires the management lock!
+ */
+static int
+on_demand_add(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key,
+		const struct lf_keymanager_key_container *inbound_key, uint64_t ns_now)
+{
+	int res;
+	int32_t pos;
+	struct lf_keymanager_dictionary_data *data;
+
+	if ((uint32_t)rte_hash_count(km->dict) >= km->size &&
+			km->lru_tail != LF_KEYMANAGER_LRU_NONE) {
+		on_demand_remove_lru(km);
+		km->statistics.on_demand_evicted++;
+	}
+
+	data = data_alloc(km, km->dict_pool);
+	if (data == NULL) {
+		return -1;
+	}
+	memset(data, 0, sizeof(struct lf_keymanager_dictionary_data));
+	data->inbound_key = *inbound_key;
+
+	res = rte_hash_add_key_data(km->dict, key, (void *)data);
+	if (res != 0) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to add key to dictionary (err = %d)\n",
+				res);
+		rte_mempool_put(km->dict_pool, data);
+		return -1;
+	}
+	pos = rte_hash_lookup(km->dict, key);
+	lru_push_front(km, (uint32_t)pos, key, ns_now);
+	km->statistics.on_demand_added++;
+	if (replicas_set(km, key, data) != 0) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to update dictionary replicas\n");
+	}
+
+	LF_KEYMANAGER_LOG(DEBUG,
+			"Add on-demand entry for AS " PRIISDAS " DRKey protocol %u\n",
+			PRIISDAS_VAL(rte_be_to_cpu_64(key->as)),
+			rte_be_to_cpu_16(key->drkey_protocol));
+
+	request_new_key(km, key, data, LF_KEYMANAGER_DIRECTION_INBOUND, ns_now);
+	request_new_key(km, key, data, LF_KEYMANAGER_DIRECTION_OUTBOUND, ns_now);
+	km->keycache_dirty = true;
+	return 0;
+}
+
+/**
+ * @return The pending table's slot of the peer, or NULL if there is none.
+ */
+static struct lf_keymanager_pending *
+pending_lookup(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key)
+{
+	uint32_t i;
+
+	for (i = 0; i < LF_KEYMANAGER_ON_DEMAND_PENDING; ++i) {
+		if (km->pending[i].state != LF_KEYMANAGER_PENDING_FREE &&
+				km->pending[i].key.as == key->as &&
+				km->pending[i].key.drkey_protocol == key->drkey_protocol) {
+			return &km->pending[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Get a slot of the pending table for a new peer, which is either a free slot
+ * or the slot of the failed peer that is retried first.
+ *
+ * @return The slot, or NULL if the keys of all pending peers are being fetched.
+ */
+static struct lf_keymanager_pending *
+pending_alloc(struct lf_keymanager *km)
+{
+	uint32_t i;
+	struct lf_keymanager_pending *slot = NULL;
+
+	for (i = 0; i < LF_KEYMANAGER_ON_DEMAND_PENDING; ++i) {
+		if (km->pending[i].state == LF_KEYMANAGER_PENDING_FREE) {
+			return &km->pending[i];
+		}
+		if (km->pending[i].state == LF_KEYMANAGER_PENDING_FAILED &&
+				(slot == NULL || km->pending[i].ns_retry < slot->ns_retry)) {
+			slot = &km->pending[i];
+		}
+	}
+	return slot;
+}
+
+/**
+ * Request the inbound key of a reported peer that is not in the dictionary,
+ * unless it is already being fetched or has failed recently. Requires the
+ * management lock!
+ */
 static void
-linked_list_push(struct linked_list **head_ref, void *data)
+on_demand_request(struct lf_keymanager *km,
+		const struct lf_keymanager_dictionary_key *key, uint64_t ns_now)
 {
-	struct linked_list *new = rte_malloc(NULL, sizeof(struct linked_list), 0);
-	new->data = data;
-	new->next = *head_ref;
-	*head_ref = new;
+	struct lf_keymanager_pending *pending;
+	struct lf_fetch_request request = {
+		.src_ia = key->as,
+		.dst_ia = km->src_as,
+		.drkey_protocol = key->drkey_protocol,
+		.ns_valid = ns_now,
+		.tag = ON_DEMAND_TAG,
+	};
+
+	pending = pending_lookup(km, key);
+	if (pending != NULL) {
+		if (pending->state == LF_KEYMANAGER_PENDING_FETCHING ||
+				ns_now < pending->ns_retry) {
+			return;
+		}
+	} else {
+		pending = pending_alloc(km);
+		if (pending == NULL) {
+			km->statistics.on_demand_dropped++;
+			return;
+		}
+		pending->key = *key;
+		pending->state = LF_KEYMANAGER_PENDING_FREE;
+	}
+
+	/* if the fetch engine's window is full, the peer is reported again */
+	if (lf_fetch_engine_submit(&km->fetch_engine, &request) == 0) {
+		pending->state = LF_KEYMANAGER_PENDING_FETCHING;
+	}
 }
 
+/**
+ * Add the pending peer to the dictionary if its inbound key has been fetched.
+ * Otherwise, the peer is remembered as failed. Requires the management lock!
+ */
 static void
-linked_list_free(struct linked_list *ll)
+on_demand_apply(struct lf_keymanager *km,
+		const struct lf_fetch_request *request, uint64_t ns_now)
 {
-	struct linked_list *next;
-	while (ll != NULL) {
-		rte_free(ll->data);
-		next = ll->next;
-		rte_free(ll);
-		ll = next;
+	struct lf_keymanager_pending *pending;
+	struct lf_keymanager_dictionary_key key = {
+		.as = request->src_ia,
+		.drkey_protocol = request->drkey_protocol,
+	};
+
+	pending = pending_lookup(km, &key);
+	if (pending == NULL || pending->state != LF_KEYMANAGER_PENDING_FETCHING) {
+		return;
+	}
+
+	if (request->dst_ia != km->src_as) {
+		/* key has been fetched for a previously configured AS */
+		pending->state = LF_KEYMANAGER_PENDING_FREE;
+		return;
+	}
+	if (request->res != 0) {
+		km->statistics.fetch_fail++;
+		km->statistics.on_demand_failed++;
+		LF_KEYMANAGER_LOG(DEBUG,
+				"Fail to fetch key for reported AS " PRIISDAS
+				" DRKey protocol %u\n",
+				PRIISDAS_VAL(rte_be_to_cpu_64(key.as)),
+				rte_be_to_cpu_16(key.drkey_protocol));
+		pending->state = LF_KEYMANAGER_PENDING_FAILED;
+		pending->ns_retry = ns_now + LF_KEYMANAGER_ON_DEMAND_RETRY;
+		return;
 	}
+	km->statistics.fetch_successful++;
+	pending->state = LF_KEYMANAGER_PENDING_FREE;
+
+	(void)on_demand_add(km, &key, &request->key, ns_now);
 }
 
 /**
- * Wait for all workers to be in the quiescent state.
+ * Process the peers reported by the workers. Reported entries are marked as
+ * most recently used and the keys of unknown peers are requested. Requires the
+ * management lock!
  */
-inline static void
-synchronize_worker(struct lf_keymanager *km)
+static void
+handle_reports(struct lf_keymanager *km, uint64_t ns_now)
 {
-	(void)rte_rcu_qsbr_synchronize(km->qsv, RTE_QSBR_THRID_INVALID);
+	unsigned int i, nb_reports, nb_handled = 0;
+	int32_t pos;
+	struct lf_keymanager_report reports[LF_KEYMANAGER_REPORT_BURST];
+
+	/* the reports enqueued in the meantime are processed with the next call */
+	do {
+		nb_reports = rte_ring_sc_dequeue_burst_elem(km->report_ring, reports,
+				sizeof(struct lf_keymanager_report),
+				LF_KEYMANAGER_REPORT_BURST, NULL);
+		for (i = 0; i < nb_reports; ++i) {
+			pos = rte_hash_lookup(km->dict, &reports[i].key);
+			if (pos >= 0) {
+				lru_unlink(km, (uint32_t)pos);
+				lru_push_front(km, (uint32_t)pos, &reports[i].key, ns_now);
+				continue;
+			}
+			on_demand_request(km, &reports[i].key, ns_now);
+		}
+		nb_handled += nb_reports;
+	} while (nb_reports == LF_KEYMANAGER_REPORT_BURST &&
+			 nb_handled < LF_KEYMANAGER_REPORT_RING_SIZE);
+}
+
+/**
+ * Remove the entries that have not been reported for
+ * LF_KEYMANAGER_ON_DEMAND_IDLE. Requires the management lock!
+ */
+static void
+expire_idle(struct lf_keymanager *km, uint64_t ns_now)
+{
+	while (km->lru_tail != LF_KEYMANAGER_LRU_NONE &&
+			km->lru[km->lru_tail].ns_last_used + LF_KEYMANAGER_ON_DEMAND_IDLE <=
+					ns_now) {
+		on_demand_remove_lru(km);
+		km->statistics.on_demand_expired++;
+	}
 }
 
+/*
+ * Key Cache:
+ * The keys are checkpointed into the key cache file, such that they can be
+ * restored after a restart instead of fetching all keys again. Only the
+ * manager accesses the key cache.
+ */
 
-void
-lf_keymanager_service_update(struct lf_keymanager *km)
+/**
+ * Store the raw key of the container in the key cache entry.
+ */
+static void
+checkpoint_key(const struct lf_keymanager_key_container *key,
+		struct lf_keycache_drkey *cached_key)
+{
+	cached_key->validity_not_before = key->validity_not_before;
+	cached_key->validity_not_after = key->validity_not_after;
+	memcpy(cached_key->key, key->key.key, sizeof cached_key->key);
+}
+
+/**
+ * Rebuild the key container, including the derived round keys, from the raw
+ * key of the key cache entry.
+ */
+static void
+rebuild_key(struct lf_keymanager *km,
+		const struct lf_keycache_drkey *cached_key,
+		struct lf_keymanager_key_container *key)
+{
+	key->validity_not_before = cached_key->validity_not_before;
+	key->validity_not_after = cached_key->validity_not_after;
+	lf_crypto_drkey_from_buf(&km->drkey_ctx, cached_key->key, &key->key);
+}
+
+/**
+ * Write the dictionary's keys that have not yet expired into the key cache.
+ * Requires the management lock!
+ */
+static int
+checkpoint(struct lf_keymanager *km, uint64_t ns_now)
 {
-	int res;
-	int err = 0;
-	struct lf_keymanager_dictionary_key *key_ptr;
 	uint32_t iterator;
-	struct lf_keymanager_dictionary_data *data, *new_data;
+	struct lf_keymanager_dictionary_key *key_ptr;
+	struct lf_keymanager_dictionary_data *data;
+	struct lf_keycache_entry *entry;
+
+	km->ns_last_checkpoint = ns_now;
+
+	if (lf_keycache_checkpoint_begin(&km->keycache, km->src_as, km->size) !=
+			0) {
+		return -1;
+	}
+
+	for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
+							   (void **)&data, &iterator) >= 0;) {
+		if (data->inbound_key.validity_not_after <= ns_now &&
+				data->outbound_key.validity_not_after <= ns_now) {
+			continue;
+		}
+		entry = lf_keycache_checkpoint_next(&km->keycache);
+		if (entry == NULL) {
+			/* the dictionary holds at most km->size entries */
+			break;
+		}
+		entry->key.as = key_ptr->as;
+		entry->key.drkey_protocol = key_ptr->drkey_protocol;
+		checkpoint_key(&data->inbound_key, &entry->inbound_key);
+		checkpoint_key(&data->old_inbound_key, &entry->old_inbound_key);
+		checkpoint_key(&data->outbound_key, &entry->outbound_key);
+		checkpoint_key(&data->old_outbound_key, &entry->old_outbound_key);
+	}
+
+	if (lf_keycache_checkpoint_commit(&km->keycache) != 0) {
+		return -1;
+	}
+	km->keycache_dirty = false;
+	km->statistics.checkpoints++;
+	return 0;
+}
+
+/**
+ * Set the key and the old key to the restored keys if the restored key is
+ * valid at ns_now. Requires the management lock!
+ *
+ * @return Returns true if the keys have been restored.
+ */
+static bool
+restore_key(struct lf_keymanager *km,
+		const struct lf_keycache_drkey *restored_key,
+		const struct lf_keycache_drkey *restored_old_key, uint64_t ns_now,
+		struct lf_keymanager_key_container *key,
+		struct lf_keymanager_key_container *old_key)
+{
+	rebuild_key(km, restored_key, key);
+	if (lf_keymanager_check_drkey_validity(key, ns_now) != 0) {
+		return false;
+	}
+	rebuild_key(km, restored_old_key, old_key);
+	km->statistics.keys_restored++;
+	return true;
+}
+
+int
+lf_keymanager_cache_init(struct lf_keymanager *km, const char *path)
+{
+	int res;
+
+	(void)rte_spinlock_lock(&km->management_lock);
+	res = lf_keycache_init(&km->keycache, path);
+	if (res == 0) {
+		res = lf_keycache_restore(&km->keycache, km->size);
+	}
+	(void)rte_spinlock_unlock(&km->management_lock);
+
+	return res;
+}
+
+int
+lf_keymanager_checkpoint(struct lf_keymanager *km)
+{
+	int res;
 	uint64_t ns_now;
 
-	/* memory to be freed later */
-	struct linked_list *free_list = NULL;
+	if (!lf_keycache_enabled(&km->keycache)) {
+		LF_KEYMANAGER_LOG(ERR, "Key cache is disabled\n");
+		return -1;
+	}
+	if (lf_time_get(&ns_now) != 0) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to get current time\n");
+		return -1;
+	}
+
+	(void)rte_spinlock_lock(&km->management_lock);
+	res = checkpoint(km, ns_now);
+	(void)rte_spinlock_unlock(&km->management_lock);
+
+	return res;
+}
+
+void
+lf_keymanager_service_update(struct lf_keymanager *km)
+{
+	struct lf_keymanager_refresh refresh;
+	struct lf_keymanager_dictionary_data *data;
+	uint64_t ns_now, ns_valid;
 
 	if (lf_time_get(&ns_now) != 0) {
 		LF_KEYMANAGER_LOG(ERR, "Fail to get current time\n");
 		return;
 	}
 
-	/* Check if inbound keys are required to be updated */
 	(void)rte_spinlock_lock(&km->management_lock);
-	for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
-							   (void **)&data, &iterator) >= 0;) {
-		if (ns_now + LF_DRKEY_PREFETCHING_PERIOD >=
-				data->inbound_key.validity_not_after) {
-			/*
-			 * create new node and copy everything from old node
-			 */
-			new_data = rte_malloc(NULL,
-					sizeof(struct lf_keymanager_dictionary_data), 0);
-			if (new_data == NULL) {
-				LF_KEYMANAGER_LOG(ERR,
-						"Fail to allocate memory for key update\n");
-				err = -1;
-				goto exit;
-			}
-			(void)rte_memcpy(new_data, data,
-					sizeof(struct lf_keymanager_dictionary_data));
-
-			res = lf_keyfetcher_fetch_as_as_key(km->fetcher, key_ptr->as,
-					km->src_as, key_ptr->drkey_protocol,
-					ns_now + LF_DRKEY_PREFETCHING_PERIOD,
-					&new_data->inbound_key);
-			if (res < 0) {
-				rte_free(new_data);
-				err = -1;
-				goto exit;
-			}
 
-			/* keep key as old key */
-			(void)rte_memcpy(&new_data->old_inbound_key, &data->inbound_key,
-					sizeof(struct lf_keymanager_key_container));
-
-			/* add new node to dictionary */
-			res = rte_hash_add_key_data(km->dict, key_ptr, (void *)new_data);
-			if (res != 0) {
-				LF_KEYMANAGER_LOG(ERR,
-						"Fail to add inbound key to dictionary (err = %d)\n",
-						res);
-				rte_free(new_data);
-				err = -1;
-				goto exit;
-			}
-			/* free old dictionary data later */
-			(void)linked_list_push(&free_list, data);
-		}
+	apply_fetched_keys(km, ns_now);
+	if (km->report_ring != NULL) {
+		handle_reports(km, ns_now);
+		expire_idle(km, ns_now);
 	}
 
-	/* Check if outbound keys are required to be updated */
-	for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
-							   (void **)&data, &iterator) >= 0;) {
-		if (ns_now + LF_DRKEY_PREFETCHING_PERIOD >=
-				data->outbound_key.validity_not_after) {
-			/*
-			 * create new node and copy everything from old node
-			 */
-			new_data = rte_malloc(NULL,
-					sizeof(struct lf_keymanager_dictionary_data), 0);
-			if (new_data == NULL) {
-				LF_KEYMANAGER_LOG(ERR,
-						"Fail to allocate memory for key update\n");
-				err = -1;
-				goto exit;
-			}
-			(void)rte_memcpy(new_data, data,
-					sizeof(struct lf_keymanager_dictionary_data));
-
-			res = lf_keyfetcher_fetch_as_as_key(km->fetcher, km->src_as,
-					key_ptr->as, key_ptr->drkey_protocol,
-					ns_now + LF_DRKEY_PREFETCHING_PERIOD,
-					&new_data->outbound_key);
-			if (res < 0) {
-				rte_free(new_data);
-				err = -1;
-				goto exit;
-			}
+	/*
+	 * Request the keys whose refresh is due. The keys are fetched
+	 * asynchronously and applied when polling the fetch engine. If the fetch
+	 * engine's window is full, the remaining refreshes stay in the heap until
+	 * the next update.
+	 */
+	while (km->refresh_nb > 0 && km->refresh_heap[0].ns_due <= ns_now &&
+			lf_fetch_engine_has_capacity(&km->fetch_engine)) {
+		refresh = km->refresh_heap[0];
+		refresh_pop(km);
 
-			/* keep key as old key */
-			(void)rte_memcpy(&new_data->old_outbound_key, &data->outbound_key,
-					sizeof(struct lf_keymanager_key_container));
+		if (rte_hash_lookup_data(km->dict, &refresh.key, (void **)&data) < 0) {
+			/* peer has been removed */
+			continue;
+		}
+		if (data->fetch_pending & (1 << refresh.direction) ||
+				current_key(data, refresh.direction)->validity_not_after !=
+						refresh.validity_not_after) {
+			/* the refresh is outdated */
+			continue;
+		}
 
-			/* add new node to dictionary */
-			res = rte_hash_add_key_data(km->dict, key_ptr, (void *)new_data);
-			if (res != 0) {
-				LF_KEYMANAGER_LOG(ERR,
-						"Fail to add outbound key to dictionary (err = %d)\n",
-						res);
-				rte_free(new_data);
-				err = -1;
-				goto exit;
-			}
-			/* free old dictionary data later */
-			(void)linked_list_push(&free_list, data);
+		/* request the key succeeding the current one, or a key valid now if
+		 * the current one has expired */
+		if (refresh.validity_not_after < ns_now) {
+			ns_valid = ns_now;
+		} else {
+			ns_valid = RTE_MAX(ns_now + LF_DRKEY_PREFETCHING_PERIOD,
+					refresh.validity_not_after + 1);
 		}
+		(void)submit_fetch(km, &refresh.key, data, refresh.direction,
+				ns_valid);
 	}
-exit:
-	if (free_list != NULL) {
-		/* free old data after no worker accesses it anymore */
-		synchronize_worker(km);
-		linked_list_free(free_list);
+
+	if (km->keycache_dirty && lf_keycache_enabled(&km->keycache) &&
+			ns_now - km->ns_last_checkpoint >=
+					LF_KEYMANAGER_CHECKPOINT_INTERVAL) {
+		(void)checkpoint(km, ns_now);
 	}
-	if (err != 0) {
-		LF_KEYMANAGER_LOG(ERR, "Error occurred during update (err = %d)\n",
-				err);
+
+	(void)rte_spinlock_unlock(&km->management_lock);
+}
+
+/**
+ * Apply the fetched keys and process the workers' reports without scanning the
+ * dictionary.
+ */
+static void
+service_poll(struct lf_keymanager *km)
+{
+	uint64_t ns_now;
+
+	if (lf_time_get(&ns_now) != 0) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to get current time\n");
+		return;
+	}
+
+	(void)rte_spinlock_lock(&km->management_lock);
+	apply_fetched_keys(km, ns_now);
+	if (km->report_ring != NULL) {
+		handle_reports(km, ns_now);
 	}
 	(void)rte_spinlock_unlock(&km->management_lock);
 }
@@ -205,22 +1165,32 @@ exit:
 int
 lf_keymanager_service_launch(struct lf_keymanager *km)
 {
-	uint64_t current_tsc, last_rotation_tsc, period_tsc;
+	uint64_t current_tsc, last_rotation_tsc, last_poll_tsc, period_tsc,
+			poll_period_tsc;
 
 	/* measure time using the time stamp counter */
 	last_rotation_tsc = rte_rdtsc();
+	last_poll_tsc = last_rotation_tsc;
 	period_tsc =
 			(uint64_t)((double)rte_get_timer_hz() * LF_KEYMANAGER_INTERVAL);
+	poll_period_tsc = (uint64_t)((double)rte_get_timer_hz() *
+								 LF_KEYMANAGER_FETCH_POLL_INTERVAL);
 
 	while (!lf_force_quit) {
 		current_tsc = rte_rdtsc();
 		if (current_tsc - last_rotation_tsc >= period_tsc) {
 			(void)lf_keymanager_service_update(km);
 			last_rotation_tsc = current_tsc;
+			last_poll_tsc = current_tsc;
 
 			/* potentially the clock speed has changed */
 			period_tsc = (uint64_t)((double)rte_get_timer_hz() *
 									LF_KEYMANAGER_INTERVAL);
+			poll_period_tsc = (uint64_t)((double)rte_get_timer_hz() *
+										 LF_KEYMANAGER_FETCH_POLL_INTERVAL);
+		} else if (current_tsc - last_poll_tsc >= poll_period_tsc) {
+			service_poll(km);
+			last_poll_tsc = current_tsc;
 		}
 	}
 
@@ -229,10 +1199,11 @@ lf_keymanager_service_launch(struct lf_keymanager *km)
 
 /**
  * @param size of table. Must be at least 8.
+ * @param socket NUMA socket on which the table is allocated.
  * @return struct rte_hash*
  */
 static struct rte_hash *
-key_dictionary_init(uint32_t size)
+key_dictionary_init(uint32_t size, int socket)
 {
 	struct rte_hash *dic;
 	struct rte_hash_parameters params = { 0 };
@@ -261,9 +1232,7 @@ key_dictionary_init(uint32_t size)
 	/* hash function */
 	params.hash_func = rte_jhash;
 	params.hash_func_init_val = 0;
-	/* TODO: (fstreun) potentially use multiple hash tables for different
-	 * sockets */
-	params.socket_id = (int)rte_socket_id();
+	params.socket_id = socket;
 	/* ensure that insertion always succeeds */
 	params.extra_flag = RTE_HASH_EXTRA_FLAGS_EXT_TABLE;
 	/* Lock Free Read Write */
@@ -282,22 +1251,10 @@ key_dictionary_init(uint32_t size)
 	return dic;
 }
 
-/**
- * Free all keys stored in the dictionary and the dictionary itself.
- */
-static void
-key_dictionary_free(struct rte_hash *dict)
-{
-	uint32_t iterator;
-	struct lf_keymanager_dictionary_key *key_ptr;
-	struct lf_keymanager_dictionary_data *data;
-
-	for (iterator = 0; rte_hash_iterate(dict, (void *)&key_ptr, (void **)&data,
-							   &iterator) >= 0;) {
-		rte_free(data);
-	}
-	rte_hash_free(dict);
-}
+/* the dictionary keys are looked up in the config's peer set */
+static_assert(sizeof(struct lf_keymanager_dictionary_key) ==
+					  sizeof(struct lf_config_peer_key),
+		"unexpected dictionary key size");
 
 int
 lf_keymanager_apply_config(struct lf_keymanager *km,
@@ -305,14 +1262,14 @@ lf_keymanager_apply_config(struct lf_keymanager *km,
 {
 	int res, err = 0, key_id;
 	uint32_t iterator;
-	bool is_in_list;
 	struct lf_keymanager_dictionary_key key, *key_ptr;
 	struct lf_keymanager_dictionary_data *dictionary_data;
 	struct lf_config_peer *peer;
+	struct rte_hash *peer_set;
+	struct lf_keycache_key cache_key;
+	const struct lf_keycache_entry *restored;
 	uint64_t ns_now;
-
-	/* memory to be freed later */
-	struct linked_list *free_list = NULL;
+	bool src_as_changed;
 
 	rte_spinlock_lock(&km->management_lock);
 	LF_KEYMANAGER_LOG(NOTICE, "Apply config...\n");
@@ -322,6 +1279,7 @@ lf_keymanager_apply_config(struct lf_keymanager *km,
 	/*
 	 * Update general keymanager configurations
 	 */
+	src_as_changed = km->src_as != config->isd_as;
 	km->src_as = config->isd_as;
 	memcpy(km->drkey_service_addr, config->drkey_service_addr,
 			sizeof km->drkey_service_addr);
@@ -345,29 +1303,43 @@ lf_keymanager_apply_config(struct lf_keymanager *km,
 		goto exit_unlock;
 	}
 
-	/* remove dictionary entries which are not anymore in config */
-	for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
-							   (void **)&dictionary_data, &iterator) >= 0;) {
-		is_in_list = false;
-		for (peer = config->peers; peer != NULL; peer = peer->next) {
-			if (peer->isd_as == key_ptr->as &&
-					peer->drkey_protocol == key_ptr->drkey_protocol) {
-				is_in_list = true;
-				break;
+	/*
+	 * Remove the dictionary entries which are not anymore in the config. With
+	 * on-demand fetching, the entries belong to the reported peers, which are
+	 * only removed if the local AS has changed, since their keys have been
+	 * derived for the previous AS. Otherwise, they are removed once they are
+	 * idle or least recently used.
+	 */
+	if (km->report_ring == NULL) {
+		peer_set = lf_config_peer_set_new(config);
+		if (peer_set == NULL) {
+			err = -1;
+			goto exit_unlock;
+		}
+		for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
+								   (void **)&dictionary_data, &iterator) >= 0;) {
+			if (rte_hash_lookup(peer_set, key_ptr) < 0) {
+				LF_KEYMANAGER_LOG(DEBUG,
+						"Remove entry for AS " PRIISDAS
+						" DRKey protocol %u\n",
+						PRIISDAS_VAL(rte_be_to_cpu_64(key_ptr->as)),
+						rte_be_to_cpu_16(key_ptr->drkey_protocol));
+				entry_remove(km, key_ptr, dictionary_data);
 			}
 		}
-		if (!is_in_list) {
-			LF_KEYMANAGER_LOG(DEBUG,
-					"Remove entry for AS " PRIISDAS " DRKey protocol %u\n",
-					PRIISDAS_VAL(rte_be_to_cpu_64(key_ptr->as)),
-					rte_be_to_cpu_16(key_ptr->drkey_protocol));
-			(void)rte_hash_del_key(km->dict, key_ptr);
-			/* free data later */
-			(void)linked_list_push(&free_list, dictionary_data);
+		rte_hash_free(peer_set);
+	} else if (src_as_changed) {
+		LF_KEYMANAGER_LOG(DEBUG, "Remove all on-demand entries\n");
+		for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
+								   (void **)&dictionary_data, &iterator) >= 0;) {
+			entry_remove(km, key_ptr, dictionary_data);
 		}
+		memset(km->pending, 0, sizeof(km->pending));
 	}
 
-	for (peer = config->peers; peer != NULL; peer = peer->next) {
+	/* with on-demand fetching, the peers' keys are fetched once reported */
+	for (peer = config->peers; peer != NULL && km->report_ring == NULL;
+			peer = peer->next) {
 		key.as = peer->isd_as;
 		key.drkey_protocol = peer->drkey_protocol;
 
@@ -378,47 +1350,65 @@ lf_keymanager_apply_config(struct lf_keymanager *km,
 		}
 
 		/* create new dictionary entry for key */
-		dictionary_data = rte_malloc(NULL,
-				sizeof(struct lf_keymanager_dictionary_data), 0);
+		dictionary_data = data_alloc(km, km->dict_pool);
 		if (dictionary_data == NULL) {
-			LF_KEYMANAGER_LOG(ERR, "Fail to allocate memory for key\n");
 			err = 1;
 			break;
 		}
 
-		res = lf_keyfetcher_fetch_as_as_key(km->fetcher, key.as, config->isd_as,
-				key.drkey_protocol, ns_now, &dictionary_data->inbound_key);
-		if (res < 0) {
+		/* use the keys restored from the key cache if they are still valid,
+		 * and fetch the others asynchronously */
+		cache_key.as = key.as;
+		cache_key.drkey_protocol = key.drkey_protocol;
+		restored = lf_keycache_lookup(&km->keycache, config->isd_as,
+				&cache_key);
+
+		if (restored == NULL ||
+				!restore_key(km, &restored->inbound_key,
+						&restored->old_inbound_key, ns_now,
+						&dictionary_data->inbound_key,
+						&dictionary_data->old_inbound_key)) {
 			dictionary_data->inbound_key.validity_not_after = 0;
+			dictionary_data->old_inbound_key.validity_not_after = 0;
 		}
-		dictionary_data->old_inbound_key.validity_not_after = 0;
 
-		res = lf_keyfetcher_fetch_as_as_key(km->fetcher, config->isd_as, key.as,
-				key.drkey_protocol, ns_now, &dictionary_data->outbound_key);
-		if (res < 0) {
+		if (restored == NULL ||
+				!restore_key(km, &restored->outbound_key,
+						&restored->old_outbound_key, ns_now,
+						&dictionary_data->outbound_key,
+						&dictionary_data->old_outbound_key)) {
 			dictionary_data->outbound_key.validity_not_after = 0;
+			dictionary_data->old_outbound_key.validity_not_after = 0;
 		}
-		dictionary_data->old_outbound_key.validity_not_after = 0;
+		dictionary_data->fetch_pending = 0;
 
 		res = rte_hash_add_key_data(km->dict, &key, (void *)dictionary_data);
 		if (res != 0) {
 			LF_KEYMANAGER_LOG(ERR, "Add key failed with %d!\n", key_id);
-			rte_free(dictionary_data);
+			rte_mempool_put(km->dict_pool, dictionary_data);
+			err = 1;
+			break;
+		}
+		if (replicas_set(km, &key, dictionary_data) != 0) {
 			err = 1;
 			break;
 		}
+
+		request_new_key(km, &key, dictionary_data,
+				LF_KEYMANAGER_DIRECTION_INBOUND, ns_now);
+		request_new_key(km, &key, dictionary_data,
+				LF_KEYMANAGER_DIRECTION_OUTBOUND, ns_now);
 	}
+	km->keycache_dirty = true;
 
 	if (err != 0) {
 		goto exit_unlock;
 	}
 
 exit_unlock:
-	if (free_list != NULL) {
-		/* free old data after no worker accesses it anymore */
-		synchronize_worker(km);
-		linked_list_free(free_list);
-	}
+	/* the restored keys are only used for the first config */
+	lf_keycache_release(&km->keycache);
+	invalidate_worker_caches(km);
 
 	(void)rte_spinlock_unlock(&km->management_lock);
 
@@ -441,12 +1431,54 @@ int
 lf_keymanager_close(struct lf_keymanager *km)
 {
 	uint16_t worker_id;
+	unsigned int socket;
+	uint64_t ns_now;
+
+	/* stop the fetch threads before the key fetcher is freed */
+	lf_fetch_engine_close(&km->fetch_engine);
+
+	/* persist the keys fetched since the last checkpoint */
+	if (km->keycache_dirty && lf_keycache_enabled(&km->keycache) &&
+			lf_time_get(&ns_now) == 0) {
+		(void)checkpoint(km, ns_now);
+	}
+	lf_keycache_close(&km->keycache);
+
+	rte_ring_free(km->report_ring);
+	km->report_ring = NULL;
+	rte_free(km->lru);
+	km->lru = NULL;
 
-	key_dictionary_free(km->dict);
+	rte_hash_free(km->dict);
 	km->dict = NULL;
+	rte_free(km->refresh_heap);
+	km->refresh_heap = NULL;
+	km->refresh_nb = 0;
+	km->refresh_capacity = 0;
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		rte_hash_free(km->socket_dict[socket]);
+		km->socket_dict[socket] = NULL;
+	}
+
+	/* reclaim the deferred data before their mempools are freed */
+	synchronize_worker(km);
+	(void)rte_rcu_qsbr_dq_delete(km->dq);
+	km->dq = NULL;
+	rte_mempool_free(km->dict_pool);
+	km->dict_pool = NULL;
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		rte_mempool_free(km->socket_pool[socket]);
+		km->socket_pool[socket] = NULL;
+	}
+
 	lf_crypto_drkey_ctx_close(&km->drkey_ctx);
 	for (worker_id = 0; worker_id < km->nb_workers; worker_id++) {
 		km->workers[worker_id].dict = NULL;
+		rte_free(km->workers[worker_id].cache);
+		km->workers[worker_id].cache = NULL;
+		km->workers[worker_id].report_ring = NULL;
+		rte_free(km->workers[worker_id].reported);
+		km->workers[worker_id].reported = NULL;
 		lf_crypto_drkey_ctx_close(&km->workers[worker_id].drkey_ctx);
 	}
 	lf_keyfetcher_close(km->fetcher);
@@ -456,11 +1488,14 @@ lf_keymanager_close(struct lf_keymanager *km)
 }
 
 int
-lf_keymanager_init(struct lf_keymanager *km, uint16_t nb_workers,
+lf_keymanager_init(struct lf_keymanager *km,
+		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
 		uint32_t initial_size, struct rte_rcu_qsbr *qsv)
 {
 	int res;
 	size_t i;
+	unsigned int socket, nb_replicas;
+	struct rte_hash_rcu_config rcu_config = { 0 };
 
 	km->qsv = qsv;
 	km->nb_workers = nb_workers;
@@ -475,21 +1510,100 @@ lf_keymanager_init(struct lf_keymanager *km, uint16_t nb_workers,
 	// NOLINTEND(readability-magic-numbers)
 	km->size = initial_size;
 
-	km->dict = key_dictionary_init(initial_size);
+	km->dict = key_dictionary_init(initial_size, (int)rte_socket_id());
 	if (km->dict == NULL) {
 		return -1;
 	}
+	km->dict_pool = data_pool_new(initial_size, (int)rte_socket_id());
+	if (km->dict_pool == NULL) {
+		return -1;
+	}
 	km->src_as = 0;
 	memset(km->drkey_service_addr, 0, sizeof km->drkey_service_addr);
 
+	/* on-demand fetching is disabled until lf_keymanager_on_demand_init() */
+	km->report_ring = NULL;
+	km->lru = NULL;
+	km->lru_head = LF_KEYMANAGER_LRU_NONE;
+	km->lru_tail = LF_KEYMANAGER_LRU_NONE;
+
+	/* the key cache is disabled until lf_keymanager_cache_init() is called */
+	(void)lf_keycache_init(&km->keycache, NULL);
+	km->keycache_dirty = false;
+	km->ns_last_checkpoint = 0;
+
+	/* an inbound and an outbound refresh per entry (grows if required) */
+	km->refresh_nb = 0;
+	km->refresh_capacity = 2 * initial_size;
+	km->refresh_heap = rte_malloc(NULL,
+			km->refresh_capacity * sizeof(struct lf_keymanager_refresh), 0);
+	if (km->refresh_heap == NULL) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to allocate refresh heap\n");
+		return -1;
+	}
+
 	res = lf_crypto_drkey_ctx_init(&km->drkey_ctx);
 	if (res != 0) {
 		/* TODO: (fstreun) error handling*/
 		return -1;
 	}
 
+	/* Zeroed cache entries are invalid since the generation starts at 1. */
+	km->generation = 1;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		km->socket_dict[socket] = NULL;
+		km->socket_pool[socket] = NULL;
+	}
+	nb_replicas = 0;
+
 	for (i = 0; i < nb_workers; ++i) {
-		km->workers[i].dict = km->dict;
+		socket = rte_lcore_to_socket_id(worker_lcores[i]);
+		/* the first worker on the socket creates the dictionary replica */
+		if (km->socket_dict[socket] == NULL) {
+			km->socket_dict[socket] =
+					key_dictionary_init(initial_size, (int)socket);
+			if (km->socket_dict[socket] == NULL) {
+				return -1;
+			}
+			/* free the key positions of removed entries once no worker
+			 * accesses them anymore */
+			rcu_config.v = qsv;
+			rcu_config.mode = RTE_HASH_QSBR_MODE_DQ;
+			res = rte_hash_rcu_qsbr_add(km->socket_dict[socket], &rcu_config);
+			if (res != 0) {
+				LF_KEYMANAGER_LOG(ERR,
+						"Fail to add RCU to dictionary on socket %u\n",
+						socket);
+				return -1;
+			}
+			km->socket_pool[socket] = data_pool_new(initial_size, (int)socket);
+			if (km->socket_pool[socket] == NULL) {
+				return -1;
+			}
+			nb_replicas++;
+		}
+		km->workers[i].dict = km->socket_dict[socket];
+		km->workers[i].generation = &km->generation;
+		km->workers[i].cache = rte_zmalloc_socket(NULL,
+				LF_KEYMANAGER_WORKER_CACHE_SIZE *
+						sizeof(struct lf_keymanager_worker_cache_entry),
+				RTE_CACHE_LINE_SIZE, (int)socket);
+		if (km->workers[i].cache == NULL) {
+			LF_KEYMANAGER_LOG(ERR, "Fail to allocate worker DRKey cache\n");
+			return -1;
+		}
+		km->workers[i].report_ring = NULL;
+		km->workers[i].reported = rte_zmalloc_socket(NULL,
+				LF_KEYMANAGER_WORKER_REPORT_CACHE_SIZE *
+						sizeof(struct lf_keymanager_worker_report_entry),
+				RTE_CACHE_LINE_SIZE, (int)socket);
+		if (km->workers[i].reported == NULL) {
+			LF_KEYMANAGER_LOG(ERR, "Fail to allocate worker report cache\n");
+			return -1;
+		}
+		km->workers[i].ns_report_interval = 0;
+		km->workers[i].nb_reports = 0;
 		res = lf_crypto_drkey_ctx_init(&km->workers[i].drkey_ctx);
 		if (res != 0) {
 			/* TODO: (fstreun) error handling*/
@@ -497,6 +1611,12 @@ lf_keymanager_init(struct lf_keymanager *km, uint16_t nb_workers,
 		}
 	}
 
+	/* the defer queue can hold all data of the replicas' mempools */
+	km->dq = replicas_dq_new(km, 2 * initial_size * RTE_MAX(nb_replicas, 1U));
+	if (km->dq == NULL) {
+		return -1;
+	}
+
 	reset_statistics(&km->statistics);
 
 	km->fetcher = malloc(sizeof(struct lf_keyfetcher));
@@ -508,6 +1628,63 @@ lf_keymanager_init(struct lf_keymanager *km, uint16_t nb_workers,
 		return -1;
 	}
 
+	res = lf_fetch_engine_init(&km->fetch_engine, LF_KEYMANAGER_FETCH_THREADS,
+			fetch_as_as_key, km);
+	if (res != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+lf_keymanager_on_demand_init(struct lf_keymanager *km)
+{
+	uint16_t worker_id;
+	uint32_t nb_positions;
+	/* ring name */
+	char name[RTE_RING_NAMESIZE];
+	/* counter to ensure unique ring name */
+	static int counter = 0;
+
+	if (rte_hash_count(km->dict) != 0) {
+		LF_KEYMANAGER_LOG(ERR, "On-demand fetching must be enabled before a "
+							   "config is applied\n");
+		return -1;
+	}
+
+	(void)snprintf(name, sizeof(name), "lf_km_report_%d", counter);
+	counter += 1;
+
+	/* the workers enqueue reports and only the manager dequeues them */
+	km->report_ring = rte_ring_create_elem(name,
+			sizeof(struct lf_keymanager_report), LF_KEYMANAGER_REPORT_RING_SIZE,
+			(int)rte_socket_id(), RING_F_SC_DEQ);
+	if (km->report_ring == NULL) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to create report ring (err = %d)\n",
+				rte_errno);
+		return -1;
+	}
+
+	/* key positions are at most the dictionary's max key id */
+	nb_positions = (uint32_t)rte_hash_max_key_id(km->dict) + 1;
+	km->lru = rte_malloc(NULL,
+			nb_positions * sizeof(struct lf_keymanager_lru_node), 0);
+	if (km->lru == NULL) {
+		LF_KEYMANAGER_LOG(ERR, "Fail to allocate LRU list\n");
+		rte_ring_free(km->report_ring);
+		km->report_ring = NULL;
+		return -1;
+	}
+	km->lru_head = LF_KEYMANAGER_LRU_NONE;
+	km->lru_tail = LF_KEYMANAGER_LRU_NONE;
+	memset(km->pending, 0, sizeof(km->pending));
+
+	for (worker_id = 0; worker_id < km->nb_workers; ++worker_id) {
+		km->workers[worker_id].report_ring = km->report_ring;
+	}
+
+	LF_KEYMANAGER_LOG(NOTICE, "On-demand key fetching enabled\n");
 	return 0;
 }
 
@@ -543,6 +1720,14 @@ const struct lf_telemetry_field_name lf_keymanager_statistics_strings[] = {
 	(sizeof(lf_keymanager_statistics_strings) / \
 			sizeof(struct lf_telemetry_field_name))
 
+static const struct lf_telemetry_field_name fetch_engine_statistics_strings[] = {
+	LF_FETCH_ENGINE_STATISTICS(LF_TELEMETRY_FIELD_NAME)
+};
+
+#define FETCH_ENGINE_STATISTICS_NUM            \
+	(sizeof(fetch_engine_statistics_strings) / \
+			sizeof(struct lf_telemetry_field_name))
+
 static int
 handle_dict_stats(const char *cmd __rte_unused, const char *params __rte_unused,
 		struct rte_tel_data *d)
@@ -553,8 +1738,9 @@ handle_dict_stats(const char *cmd __rte_unused, const char *params __rte_unused,
 	rte_tel_data_add_dict_uint(d, "entries", rte_hash_count(tel_ctx->dict));
 	rte_tel_data_add_dict_uint(d, "entries_max",
 			rte_hash_max_key_id(tel_ctx->dict));
+	rte_tel_data_add_dict_uint(d, "refresh_scheduled", tel_ctx->refresh_nb);
 
-	rte_spinlock_lock(&tel_ctx->management_lock);
+	rte_spinlock_unlock(&tel_ctx->management_lock);
 
 	return 0;
 }
@@ -573,6 +1759,15 @@ handle_stats(const char *cmd __rte_unused, const char *params __rte_unused,
 				values[i]);
 	}
 
+	/* fetch engine statistics */
+	values = (uint64_t *)&tel_ctx->fetch_engine.statistics;
+	for (i = 0; i < FETCH_ENGINE_STATISTICS_NUM; i++) {
+		rte_tel_data_add_dict_uint(d, fetch_engine_statistics_strings[i].name,
+				values[i]);
+	}
+	rte_tel_data_add_dict_uint(d, "fetch_inflight",
+			tel_ctx->fetch_engine.nb_inflight);
+
 	return 0;
 }
 
@@ -8,14 +8,19 @@
 #include <inttypes.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <rte_byteorder.h>
 #include <rte_hash.h>
+#include <rte_hash_crc.h>
 #include <rte_memcpy.h>
+#include <rte_ring.h>
 #include <rte_spinlock.h>
 
 #include "config.h"
 #include "drkey.h"
+#include "fetch_engine.h"
+#include "keycache.h"
 #include "keyfetcher.h"
 #include "lf.h"
 #include "lib/crypto/crypto.h"
@@ -34,9 +39,108 @@
 
 #define LF_KEYMANAGER_INTERVAL 0.5 /* seconds */
 
+/*
+ * The AS-AS DRKeys are fetched asynchronously by the fetch engine's threads.
+ * The fetched keys are applied every LF_KEYMANAGER_FETCH_POLL_INTERVAL.
+ */
+#define LF_KEYMANAGER_FETCH_THREADS       4
+#define LF_KEYMANAGER_FETCH_POLL_INTERVAL 0.01 /* seconds */
+
+/*
+ * Keys are refreshed LF_DRKEY_PREFETCHING_PERIOD plus a random jitter of up to
+ * LF_KEYMANAGER_REFRESH_JITTER before they expire, such that the refreshes of
+ * keys expiring at the same time are spread out.
+ */
+#define LF_KEYMANAGER_REFRESH_JITTER (1 * LF_TIME_NS_IN_S) /* in nanoseconds */
+
+/*
+ * If the key cache is enabled, the fetched keys are checkpointed at most every
+ * LF_KEYMANAGER_CHECKPOINT_INTERVAL.
+ */
+#define LF_KEYMANAGER_CHECKPOINT_INTERVAL \
+	(10 * LF_TIME_NS_IN_S) /* in nanoseconds */
+
+/*
+ * On-demand key fetching: Instead of fetching the keys of all configured peers,
+ * the workers report the peers they encounter to the manager, which fetches
+ * their keys and evicts the least recently used entries. Each worker reports a
+ * peer at most once per LF_KEYMANAGER_REPORT_INTERVAL and at most
+ * LF_KEYMANAGER_REPORT_BURST peers per interval. Entries that have not been
+ * reported for LF_KEYMANAGER_ON_DEMAND_IDLE are removed, and keys that cannot
+ * be fetched are requested again after LF_KEYMANAGER_ON_DEMAND_RETRY.
+ * A reported peer is only added to the dictionary once its inbound key has been
+ * fetched. Until then, it is kept in a separate table of
+ * LF_KEYMANAGER_ON_DEMAND_PENDING peers, which also remembers the peers whose
+ * key could not be fetched.
+ */
+#define LF_KEYMANAGER_REPORT_INTERVAL (1 * LF_TIME_NS_IN_S)  /* in nanoseconds */
+#define LF_KEYMANAGER_REPORT_BURST    64
+#define LF_KEYMANAGER_REPORT_RING_SIZE 4096
+#define LF_KEYMANAGER_ON_DEMAND_IDLE  (60 * LF_TIME_NS_IN_S) /* in nanoseconds */
+#define LF_KEYMANAGER_ON_DEMAND_RETRY (10 * LF_TIME_NS_IN_S) /* in nanoseconds */
+#define LF_KEYMANAGER_ON_DEMAND_PENDING 64
+
+/*
+ * Number of reported peers remembered by each worker to deduplicate reports.
+ * Must be a power of 2.
+ */
+#define LF_KEYMANAGER_WORKER_REPORT_CACHE_SIZE 256
+
+/*
+ * Number of derived host-to-host DRKeys cached by each worker.
+ * Must be a power of 2.
+ */
+#define LF_KEYMANAGER_WORKER_CACHE_SIZE 1024
+
+/*
+ * Direction of a cached host-to-host DRKey.
+ */
+#define LF_KEYMANAGER_DIRECTION_INBOUND  0
+#define LF_KEYMANAGER_DIRECTION_OUTBOUND 1
+
+/**
+ * Identifies a derived host-to-host DRKey in the worker's cache.
+ * Unused address bytes are set to zero.
+ */
+struct lf_keymanager_worker_cache_key {
+	uint64_t as; /* network byte order */
+	/* start of the AS-AS DRKey's epoch (Unix timestamp in nanoseconds) */
+	uint64_t validity_not_before;
+	uint16_t drkey_protocol; /* network byte order */
+	uint8_t direction;
+	uint8_t fast_side_type_length;
+	uint8_t slow_side_type_length;
+	uint8_t fast_side_addr[LF_CRYPTO_CBC_BLOCK_SIZE];
+	uint8_t slow_side_addr[LF_CRYPTO_CBC_BLOCK_SIZE];
+} __attribute__((__packed__));
+
+struct lf_keymanager_worker_cache_entry {
+	struct lf_keymanager_worker_cache_key key;
+	/* Key manager generation at the time the entry has been added. The entry
+	 * is only valid if it corresponds to the current generation. */
+	uint32_t generation;
+	struct lf_crypto_drkey drkey;
+};
+
 struct lf_keymanager_worker {
+	/* replica of the AS-AS DRKey dictionary on the worker's socket */
 	struct rte_hash *dict;
 	struct lf_crypto_drkey_ctx drkey_ctx;
+
+	/* Direct-mapped cache of derived host-to-host DRKeys */
+	struct lf_keymanager_worker_cache_entry *cache;
+	/* Key manager generation, which is increased whenever AS-AS DRKeys are
+	 * replaced or removed. */
+	const _Atomic(uint32_t) *generation;
+
+	/* ring to report peers to the manager (NULL if on-demand fetching is
+	 * disabled) */
+	struct rte_ring *report_ring;
+	/* direct-mapped cache of recently reported peers */
+	struct lf_keymanager_worker_report_entry *reported;
+	/* start of the current report interval and reports within it */
+	uint64_t ns_report_interval;
+	uint32_t nb_reports;
 };
 
 struct lf_keymanager_dictionary_data {
@@ -46,6 +150,8 @@ struct lf_keymanager_dictionary_data {
 	/* previous keys */
 	struct lf_keymanager_key_container old_inbound_key;
 	struct lf_keymanager_key_container old_outbound_key;
+	/* directions with a fetch in flight (bit set with 1 << direction) */
+	uint8_t fetch_pending;
 };
 
 struct lf_keymanager_dictionary_key {
@@ -53,10 +159,76 @@ struct lf_keymanager_dictionary_key {
 	uint16_t drkey_protocol; /* network byte order */
 } __attribute__((__packed__));
 
+/**
+ * Peer reported by a worker. Ring elements must be a multiple of 4 bytes.
+ */
+struct lf_keymanager_report {
+	struct lf_keymanager_dictionary_key key;
+	uint8_t padding[6];
+};
+
+struct lf_keymanager_worker_report_entry {
+	struct lf_keymanager_dictionary_key key;
+	/* time of the last report (Unix timestamp in nanoseconds) */
+	uint64_t ns_reported;
+};
+
+/**
+ * Node of the on-demand entries' LRU list, which is indexed by the entries'
+ * key positions in the dictionary.
+ */
+struct lf_keymanager_lru_node {
+	struct lf_keymanager_dictionary_key key;
+	/* time the entry has last been reported (Unix timestamp in nanoseconds) */
+	uint64_t ns_last_used;
+	uint32_t prev;
+	uint32_t next;
+};
+
+#define LF_KEYMANAGER_LRU_NONE UINT32_MAX
+
+enum lf_keymanager_pending_state {
+	LF_KEYMANAGER_PENDING_FREE = 0,
+	/* the peer's inbound key is being fetched */
+	LF_KEYMANAGER_PENDING_FETCHING,
+	/* the peer's inbound key could not be fetched */
+	LF_KEYMANAGER_PENDING_FAILED,
+};
+
+/**
+ * Reported peer that is not in the dictionary yet.
+ */
+struct lf_keymanager_pending {
+	struct lf_keymanager_dictionary_key key;
+	enum lf_keymanager_pending_state state;
+	/* time from which on a failed fetch is retried (Unix timestamp in
+	 * nanoseconds) */
+	uint64_t ns_retry;
+};
+
+/**
+ * Scheduled refresh of a dictionary entry's inbound or outbound key.
+ */
+struct lf_keymanager_refresh {
+	/* time at which the key is refreshed (Unix timestamp in nanoseconds) */
+	uint64_t ns_due;
+	/* expiry of the key to be refreshed, which identifies outdated refreshes */
+	uint64_t validity_not_after;
+	struct lf_keymanager_dictionary_key key;
+	uint8_t direction;
+};
+
 
 #define LF_KEYMANAGER_STATISTICS(M) \
 	M(uint64_t, fetch_successful)   \
-	M(uint64_t, fetch_fail)
+	M(uint64_t, fetch_fail)         \
+	M(uint64_t, keys_restored)      \
+	M(uint64_t, checkpoints)        \
+	M(uint64_t, on_demand_added)    \
+	M(uint64_t, on_demand_evicted)  \
+	M(uint64_t, on_demand_expired)  \
+	M(uint64_t, on_demand_failed)   \
+	M(uint64_t, on_demand_dropped)
 
 struct lf_keymanager_statistics {
 	LF_KEYMANAGER_STATISTICS(LF_TELEMETRY_FIELD_DECL)
@@ -66,20 +238,52 @@ struct lf_keymanager {
 	struct lf_keymanager_worker workers[LF_MAX_WORKER];
 	uint16_t nb_workers;
 
-	/* AS-AS DRKey dictionary */
+	/* AS-AS DRKey dictionary (only accessed by the manager) and its replicas
+	 * for each socket with workers, holding socket-local copies of the data */
 	struct rte_hash *dict;
+	struct rte_hash *socket_dict[RTE_MAX_NUMA_NODES];
 	/* max number of entries */
 	uint32_t size;
+	/* mempools of the dictionary's and the replicas' data, and the defer queue
+	 * of the replicas' replaced data */
+	struct rte_mempool *dict_pool;
+	struct rte_mempool *socket_pool[RTE_MAX_NUMA_NODES];
+	struct rte_rcu_qsbr_dq *dq;
 
 	uint64_t src_as;
 
 	struct lf_keyfetcher *fetcher;
+	struct lf_fetch_engine fetch_engine;
+
+	/* on-demand key fetching (report_ring is NULL if disabled): ring of the
+	 * workers' reports, LRU list of the dictionary entries, and reported peers
+	 * that are not in the dictionary yet */
+	struct rte_ring *report_ring;
+	struct lf_keymanager_lru_node *lru;
+	uint32_t lru_head;
+	uint32_t lru_tail;
+	struct lf_keymanager_pending pending[LF_KEYMANAGER_ON_DEMAND_PENDING];
+
+	/* scheduled key refreshes (min-heap ordered by the due time) */
+	struct lf_keymanager_refresh *refresh_heap;
+	uint32_t refresh_nb;
+	uint32_t refresh_capacity;
 
 	char drkey_service_addr[48];
 
+	/* persistent key cache, which is checkpointed if keys have been replaced
+	 * since the last checkpoint (dirty) */
+	struct lf_keycache keycache;
+	bool keycache_dirty;
+	uint64_t ns_last_checkpoint;
+
 	/* crypto DRKey context */
 	struct lf_crypto_drkey_ctx drkey_ctx;
 
+	/* Generation of the AS-AS DRKeys. Increasing it invalidates the workers'
+	 * host-to-host DRKey caches. */
+	_Atomic(uint32_t) generation;
+
 	/* synchronize management */
 	rte_spinlock_t management_lock;
 	/* Workers' Quiescent State Variable */
@@ -116,26 +320,161 @@ lf_keymanager_check_drkey_validity(struct lf_keymanager_key_container *drkey,
 }
 
 /**
- * Obtain inbound DRKey.
+ * Initialize the worker's cache key for a host-to-host DRKey.
+ *
+ * @param peer_as: Peer AS (network byte order).
+ * @param direction: LF_KEYMANAGER_DIRECTION_INBOUND or
+ * LF_KEYMANAGER_DIRECTION_OUTBOUND.
+ * @param as_as_key: AS-AS DRKey container.
+ * @param drkey_protocol: (network byte order).
+ * @param key: Returns the cache key.
+ */
+static inline void
+lf_keymanager_worker_cache_key_init(uint64_t peer_as, uint8_t direction,
+		const struct lf_keymanager_key_container *as_as_key,
+		const struct lf_host_addr *fast_side_host,
+		const struct lf_host_addr *slow_side_host, uint16_t drkey_protocol,
+		struct lf_keymanager_worker_cache_key *key)
+{
+	memset(key, 0, sizeof *key);
+	key->as = peer_as;
+	key->validity_not_before = as_as_key->validity_not_before;
+	key->drkey_protocol = drkey_protocol;
+	key->direction = direction;
+	key->fast_side_type_length = fast_side_host->type_length;
+	key->slow_side_type_length = slow_side_host->type_length;
+	(void)rte_memcpy(key->fast_side_addr, fast_side_host->addr,
+			LF_HOST_ADDR_LENGTH(fast_side_host));
+	(void)rte_memcpy(key->slow_side_addr, slow_side_host->addr,
+			LF_HOST_ADDR_LENGTH(slow_side_host));
+}
+
+/**
+ * Get the worker's cache entry slot for the cache key.
+ */
+static inline struct lf_keymanager_worker_cache_entry *
+lf_keymanager_worker_cache_entry(struct lf_keymanager_worker *kmw,
+		const struct lf_keymanager_worker_cache_key *key)
+{
+	uint32_t index = rte_hash_crc(key, sizeof *key, 0) &
+			(LF_KEYMANAGER_WORKER_CACHE_SIZE - 1);
+	return &kmw->cache[index];
+}
+
+/**
+ * Check if the cache entry holds the DRKey for the cache key and has been
+ * derived in the current generation.
+ */
+static inline bool
+lf_keymanager_worker_cache_entry_hit(
+		const struct lf_keymanager_worker_cache_entry *entry,
+		uint32_t generation, const struct lf_keymanager_worker_cache_key *key)
+{
+	return entry->generation == generation &&
+	       memcmp(&entry->key, key, sizeof *key) == 0;
+}
+
+/**
+ * Derive the host-to-host DRKey from the AS-AS DRKey, or get it from the
+ * worker's cache if it has already been derived in the current generation.
+ *
+ * @param generation: Key manager generation loaded before the AS-AS DRKey has
+ * been looked up.
+ * @param peer_as: Peer AS (network byte order).
+ * @param direction: LF_KEYMANAGER_DIRECTION_INBOUND or
+ * LF_KEYMANAGER_DIRECTION_OUTBOUND.
+ * @param as_as_key: AS-AS DRKey container.
+ * @param drkey_protocol: (network byte order).
+ * @param drkey: Memory to write DRKey to.
+ */
+static inline void
+lf_keymanager_worker_derive_drkey(struct lf_keymanager_worker *kmw,
+		uint32_t generation, uint64_t peer_as, uint8_t direction,
+		const struct lf_keymanager_key_container *as_as_key,
+		const struct lf_host_addr *fast_side_host,
+		const struct lf_host_addr *slow_side_host, uint16_t drkey_protocol,
+		struct lf_crypto_drkey *drkey)
+{
+	struct lf_keymanager_worker_cache_key key;
+	struct lf_keymanager_worker_cache_entry *entry;
+
+	lf_keymanager_worker_cache_key_init(peer_as, direction, as_as_key,
+			fast_side_host, slow_side_host, drkey_protocol, &key);
+	entry = lf_keymanager_worker_cache_entry(kmw, &key);
+
+	if (likely(lf_keymanager_worker_cache_entry_hit(entry, generation, &key))) {
+		*drkey = entry->drkey;
+		return;
+	}
+
+	lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx, &as_as_key->key,
+			fast_side_host, slow_side_host, drkey_protocol, drkey);
+
+	entry->key = key;
+	entry->generation = generation;
+	entry->drkey = *drkey;
+}
+
+/**
+ * Report the peer to the manager if on-demand fetching is enabled, such that
+ * the manager fetches the peer's keys or marks its entry as recently used. The
+ * reports are deduplicated and rate limited; reports exceeding the limit or not
+ * fitting into the ring are dropped.
+ *
+ * @param ns_now: Current Unix timestamp in nanoseconds.
+ */
+static inline void
+lf_keymanager_worker_report(struct lf_keymanager_worker *kmw,
+		const struct lf_keymanager_dictionary_key *key, uint64_t ns_now)
+{
+	struct lf_keymanager_worker_report_entry *entry;
+	struct lf_keymanager_report report = { .key = *key };
+
+	if (likely(kmw->report_ring == NULL)) {
+		return;
+	}
+
+	entry = &kmw->reported[rte_hash_crc(key, sizeof *key, 0) &
+						   (LF_KEYMANAGER_WORKER_REPORT_CACHE_SIZE - 1)];
+	if (likely(ns_now - entry->ns_reported < LF_KEYMANAGER_REPORT_INTERVAL &&
+				memcmp(&entry->key, key, sizeof *key) == 0)) {
+		return;
+	}
+
+	if (ns_now - kmw->ns_report_interval >= LF_KEYMANAGER_REPORT_INTERVAL) {
+		kmw->ns_report_interval = ns_now;
+		kmw->nb_reports = 0;
+	}
+	if (kmw->nb_reports >= LF_KEYMANAGER_REPORT_BURST) {
+		return;
+	}
+	if (rte_ring_mp_enqueue_elem(kmw->report_ring, &report, sizeof report) !=
+			0) {
+		return;
+	}
+	kmw->nb_reports++;
+	entry->key = *key;
+	entry->ns_reported = ns_now;
+}
+
+/**
+ * Obtain the inbound AS-AS DRKey container for the epoch identified by
+ * ns_rel_time.
  *
  * @param peer_as: Packet's source AS (network byte order).
- * @param peer_addr: Packet's source address (network byte order).
- * @param backend_addr: Packet's destination address (network byte
- * order).
  * @param drkey_protocol: (network byte order).
  * @param ns_now: Unix timestamp in nanoseconds, at which the requested key
  * must be valid.
  * @param ns_rel_time: Relative timestamp in nanoseconds to uniquely identify
  * the epoch for the key that should be used.
- * @param drkey: Memory to write DRKey to.
+ * @param as_as_key: Returns the AS-AS DRKey container.
  * @return 0 if success. Otherwise, < 0.
  */
 static inline int
-lf_keymanager_worker_inbound_get_drkey(struct lf_keymanager_worker *kmw,
-		uint64_t peer_as, const struct lf_host_addr *peer_addr,
-		const struct lf_host_addr *backend_addr, uint16_t drkey_protocol,
-		uint64_t ns_now, uint64_t ns_rel_time, uint64_t *ns_drkey_epoch_start,
-		struct lf_crypto_drkey *drkey)
+lf_keymanager_worker_inbound_get_as_as_key(struct lf_keymanager_worker *kmw,
+		uint64_t peer_as, uint16_t drkey_protocol, uint64_t ns_now,
+		uint64_t ns_rel_time,
+		const struct lf_keymanager_key_container **as_as_key)
 {
 	int res;
 	int key_id;
@@ -147,6 +486,7 @@ lf_keymanager_worker_inbound_get_drkey(struct lf_keymanager_worker *kmw,
 
 	/* find AS-AS key */
 	key_id = rte_hash_lookup_data(kmw->dict, &key, (void **)&dict_node);
+	lf_keymanager_worker_report(kmw, &key, ns_now);
 	if (unlikely(key_id < 0)) {
 		return -1;
 	}
@@ -173,10 +513,7 @@ lf_keymanager_worker_inbound_get_drkey(struct lf_keymanager_worker *kmw,
 		if (res < 0) {
 			return -3;
 		}
-		lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
-				&dict_node->inbound_key.key, backend_addr, peer_addr,
-				drkey_protocol, drkey);
-		*ns_drkey_epoch_start = dict_node->inbound_key.validity_not_before;
+		*as_as_key = &dict_node->inbound_key;
 		return 0;
 	}
 
@@ -194,16 +531,139 @@ lf_keymanager_worker_inbound_get_drkey(struct lf_keymanager_worker *kmw,
 		if (res < 0) {
 			return -4;
 		}
-		lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
-				&dict_node->old_inbound_key.key, backend_addr, peer_addr,
-				drkey_protocol, drkey);
-		*ns_drkey_epoch_start = dict_node->old_inbound_key.validity_not_before;
+		*as_as_key = &dict_node->old_inbound_key;
 		return 0;
 	}
 
 	return -2;
 }
 
+/**
+ * Obtain inbound DRKey.
+ *
+ * @param peer_as: Packet's source AS (network byte order).
+ * @param peer_addr: Packet's source address (network byte order).
+ * @param backend_addr: Packet's destination address (network byte
+ * order).
+ * @param drkey_protocol: (network byte order).
+ * @param ns_now: Unix timestamp in nanoseconds, at which the requested key
+ * must be valid.
+ * @param ns_rel_time: Relative timestamp in nanoseconds to uniquely identify
+ * the epoch for the key that should be used.
+ * @param drkey: Memory to write DRKey to.
+ * @return 0 if success. Otherwise, < 0.
+ */
+static inline int
+lf_keymanager_worker_inbound_get_drkey(struct lf_keymanager_worker *kmw,
+		uint64_t peer_as, const struct lf_host_addr *peer_addr,
+		const struct lf_host_addr *backend_addr, uint16_t drkey_protocol,
+		uint64_t ns_now, uint64_t ns_rel_time, uint64_t *ns_drkey_epoch_start,
+		struct lf_crypto_drkey *drkey)
+{
+	int res;
+	uint32_t generation;
+	const struct lf_keymanager_key_container *as_as_key;
+
+	/* The generation must be loaded before the AS-AS key is looked up. */
+	generation = atomic_load_explicit(kmw->generation, memory_order_acquire);
+
+	res = lf_keymanager_worker_inbound_get_as_as_key(kmw, peer_as,
+			drkey_protocol, ns_now, ns_rel_time, &as_as_key);
+	if (unlikely(res < 0)) {
+		return res;
+	}
+
+	lf_keymanager_worker_derive_drkey(kmw, generation, peer_as,
+			LF_KEYMANAGER_DIRECTION_INBOUND, as_as_key, backend_addr, peer_addr,
+			drkey_protocol, drkey);
+	*ns_drkey_epoch_start = as_as_key->validity_not_before;
+	return 0;
+}
+
+/**
+ * Obtain a burst of inbound DRKeys. The result is the same as calling
+ * lf_keymanager_worker_inbound_get_drkey() for each key. However, the DRKeys
+ * that are not in the worker's cache are derived together, such that the
+ * CBC-MACs of the derivation steps are computed in parallel.
+ *
+ * @param peer_as: Packets' source AS (network byte order).
+ * @param peer_addr: Packets' source address (network byte order).
+ * @param backend_addr: Packets' destination address (network byte order).
+ * @param drkey_protocol: (network byte order).
+ * @param ns_now: Unix timestamp in nanoseconds, at which the requested keys
+ * must be valid.
+ * @param ns_rel_time: Relative timestamps in nanoseconds to uniquely identify
+ * the epochs for the keys that should be used.
+ * @param drkey: Memory to write DRKeys to.
+ * @param res: Returns 0 for each key that has been obtained. Otherwise, < 0.
+ * @param nb_keys: Number of keys (at most LF_MAX_PKT_BURST).
+ */
+static inline void
+lf_keymanager_worker_inbound_get_drkey_burst(struct lf_keymanager_worker *kmw,
+		const uint64_t peer_as[], const struct lf_host_addr *const peer_addr[],
+		const struct lf_host_addr *const backend_addr[],
+		const uint16_t drkey_protocol[], uint64_t ns_now,
+		const uint64_t ns_rel_time[], uint64_t ns_drkey_epoch_start[],
+		struct lf_crypto_drkey *const drkey[], int res[], unsigned int nb_keys)
+{
+	unsigned int i, nb_miss = 0;
+	uint32_t generation;
+	const struct lf_keymanager_key_container *as_as_key;
+	struct lf_keymanager_worker_cache_key key[LF_MAX_PKT_BURST];
+	struct lf_keymanager_worker_cache_entry *entry[LF_MAX_PKT_BURST];
+	const struct lf_crypto_drkey *miss_as_as_key[LF_MAX_PKT_BURST];
+	const struct lf_host_addr *miss_backend_addr[LF_MAX_PKT_BURST];
+	const struct lf_host_addr *miss_peer_addr[LF_MAX_PKT_BURST];
+	uint16_t miss_drkey_protocol[LF_MAX_PKT_BURST];
+	struct lf_crypto_drkey *miss_drkey[LF_MAX_PKT_BURST];
+
+	assert(nb_keys <= LF_MAX_PKT_BURST);
+
+	/* The generation must be loaded before the AS-AS keys are looked up. */
+	generation = atomic_load_explicit(kmw->generation, memory_order_acquire);
+
+	for (i = 0; i < nb_keys; i++) {
+		res[i] = lf_keymanager_worker_inbound_get_as_as_key(kmw, peer_as[i],
+				drkey_protocol[i], ns_now, ns_rel_time[i], &as_as_key);
+		if (unlikely(res[i] < 0)) {
+			continue;
+		}
+		ns_drkey_epoch_start[i] = as_as_key->validity_not_before;
+
+		lf_keymanager_worker_cache_key_init(peer_as[i],
+				LF_KEYMANAGER_DIRECTION_INBOUND, as_as_key, backend_addr[i],
+				peer_addr[i], drkey_protocol[i], &key[nb_miss]);
+		entry[nb_miss] = lf_keymanager_worker_cache_entry(kmw, &key[nb_miss]);
+		if (likely(lf_keymanager_worker_cache_entry_hit(entry[nb_miss],
+					generation, &key[nb_miss]))) {
+			*drkey[i] = entry[nb_miss]->drkey;
+			continue;
+		}
+
+		miss_as_as_key[nb_miss] = &as_as_key->key;
+		miss_backend_addr[nb_miss] = backend_addr[i];
+		miss_peer_addr[nb_miss] = peer_addr[i];
+		miss_drkey_protocol[nb_miss] = drkey_protocol[i];
+		miss_drkey[nb_miss] = drkey[i];
+		nb_miss++;
+	}
+
+	if (nb_miss == 0) {
+		return;
+	}
+
+	lf_drkey_derive_host_host_from_as_as_burst(&kmw->drkey_ctx, miss_as_as_key,
+			miss_backend_addr, miss_peer_addr, miss_drkey_protocol, miss_drkey,
+			nb_miss);
+
+	/* Multiple misses can map to the same cache entry. The last one wins. */
+	for (i = 0; i < nb_miss; i++) {
+		entry[i]->key = key[i];
+		entry[i]->generation = generation;
+		entry[i]->drkey = *miss_drkey[i];
+	}
+}
+
 /**
  * Obtain an outbound DRKey that is valid (including grace period) at the
  * requested time. If two valid DRKeys are available, which is possible due to
@@ -229,14 +689,19 @@ lf_keymanager_worker_outbound_get_drkey(struct lf_keymanager_worker *kmw,
 {
 	int res;
 	int key_id;
+	uint32_t generation;
 	struct lf_keymanager_dictionary_data *dict_node;
 	struct lf_keymanager_dictionary_key key = {
 		.as = peer_as,
 		.drkey_protocol = drkey_protocol,
 	};
 
+	/* The generation must be loaded before the AS-AS key is looked up. */
+	generation = atomic_load_explicit(kmw->generation, memory_order_acquire);
+
 	/* find AS-AS key */
 	key_id = rte_hash_lookup_data(kmw->dict, &key, (void **)&dict_node);
+	lf_keymanager_worker_report(kmw, &key, ns_now);
 	if (unlikely(key_id < 0)) {
 		return -1;
 	}
@@ -244,9 +709,9 @@ lf_keymanager_worker_outbound_get_drkey(struct lf_keymanager_worker *kmw,
 	/* Check if the new key is valid. */
 	res = lf_keymanager_check_drkey_validity(&dict_node->outbound_key, ns_now);
 	if (likely(res == 0 || res == 1)) {
-		lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
-				&dict_node->outbound_key.key, peer_addr, backend_addr,
-				drkey_protocol, drkey);
+		lf_keymanager_worker_derive_drkey(kmw, generation, peer_as,
+				LF_KEYMANAGER_DIRECTION_OUTBOUND, &dict_node->outbound_key,
+				peer_addr, backend_addr, drkey_protocol, drkey);
 		*ns_drkey_epoch_start = dict_node->outbound_key.validity_not_before;
 		return res;
 	}
@@ -255,9 +720,9 @@ lf_keymanager_worker_outbound_get_drkey(struct lf_keymanager_worker *kmw,
 	res = lf_keymanager_check_drkey_validity(&dict_node->old_outbound_key,
 			ns_now);
 	if (likely(res == 0 || res == 1)) {
-		lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
-				&dict_node->old_outbound_key.key, peer_addr, backend_addr,
-				drkey_protocol, drkey);
+		lf_keymanager_worker_derive_drkey(kmw, generation, peer_as,
+				LF_KEYMANAGER_DIRECTION_OUTBOUND, &dict_node->old_outbound_key,
+				peer_addr, backend_addr, drkey_protocol, drkey);
 		*ns_drkey_epoch_start = dict_node->old_outbound_key.validity_not_before;
 		return res;
 	}
@@ -272,7 +737,15 @@ int
 lf_keymanager_service_launch(struct lf_keymanager *km);
 
 /**
- * Replaces current config with new config.
+ * Apply the fetched keys and request the keys whose refresh is due. This is
+ * called periodically by the keymanager service.
+ */
+void
+lf_keymanager_service_update(struct lf_keymanager *km);
+
+/**
+ * Replaces current config with new config. The keys of new peers are fetched
+ * asynchronously and applied by the keymanager service.
  * @param config: new config
  * @return 0 on success, otherwise, -1.
  */
@@ -280,6 +753,36 @@ int
 lf_keymanager_apply_config(struct lf_keymanager *km,
 		const struct lf_config *config);
 
+/**
+ * Enable the persistent key cache and restore the keys of the cache file. The
+ * restored keys are used instead of fetching them when the next config is
+ * applied, if they are still valid and have been fetched for the config's AS.
+ * Must be called before the config is applied.
+ *
+ * @param path: Cache file.
+ * @return 0 on success, otherwise, -1. On failure, the keys are fetched.
+ */
+int
+lf_keymanager_cache_init(struct lf_keymanager *km, const char *path);
+
+/**
+ * Write the keys that have not yet expired into the key cache file.
+ * @return 0 on success, otherwise, -1.
+ */
+int
+lf_keymanager_checkpoint(struct lf_keymanager *km);
+
+/**
+ * Enable on-demand key fetching: The keys of the configured peers are no longer
+ * fetched when a config is applied. Instead, the keys of the peers reported by
+ * the workers are fetched, and the least recently used entries are evicted
+ * if the dictionary is full. Must be called before the workers are launched.
+ *
+ * @return 0 on success, otherwise, -1.
+ */
+int
+lf_keymanager_on_demand_init(struct lf_keymanager *km);
+
 /**
  * Frees the content of the keymanager struct (not itself).
  * This includes also the workers' structs. Hence, all the workers have to
@@ -289,12 +792,15 @@ int
 lf_keymanager_close(struct lf_keymanager *km);
 
 /**
+ * @param worker_lcores Lcores of the workers. The workers access the
+ * dictionary replica and the cache on their lcore's socket.
  * @param qsv workers' QS variable for the RCU synchronization. The QS variable
  * can be shared with other services, i.e., other processes call check on it,
  * because the keymanager service calls it rarely and can also wait.
  */
 int
-lf_keymanager_init(struct lf_keymanager *km, uint16_t nb_workers,
+lf_keymanager_init(struct lf_keymanager *km,
+		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
 		uint32_t initial_size, struct rte_rcu_qsbr *qsv);
 
 
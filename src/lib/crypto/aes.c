@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "aes.h"
+
+#if defined(__x86_64__)
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+__attribute__((target("aes"))) static inline __m128i
+expand_key128_step(__m128i key, __m128i keygened)
+{
+	keygened = _mm_shuffle_epi32(keygened, 0xff);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, keygened);
+}
+
+/* The round constant must be an immediate, hence, the macro. */
+#define EXPAND_KEY128_STEP(rk, i, rcon) \
+	rk[i] = expand_key128_step(rk[i - 1], \
+			_mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+__attribute__((target("aes"))) void
+lf_aes_expand_key128_aesni(const uint8_t key[LF_AES_KEY_SIZE],
+		uint8_t roundkey[LF_AES_ROUNDKEY_SIZE])
+{
+	int i;
+	__m128i rk[11];
+
+	rk[0] = _mm_loadu_si128((const __m128i *)key);
+	EXPAND_KEY128_STEP(rk, 1, 0x01);
+	EXPAND_KEY128_STEP(rk, 2, 0x02);
+	EXPAND_KEY128_STEP(rk, 3, 0x04);
+	EXPAND_KEY128_STEP(rk, 4, 0x08);
+	EXPAND_KEY128_STEP(rk, 5, 0x10);
+	EXPAND_KEY128_STEP(rk, 6, 0x20);
+	EXPAND_KEY128_STEP(rk, 7, 0x40);
+	EXPAND_KEY128_STEP(rk, 8, 0x80);
+	EXPAND_KEY128_STEP(rk, 9, 0x1b);
+	EXPAND_KEY128_STEP(rk, 10, 0x36);
+
+	for (i = 0; i < 11; i++) {
+		_mm_storeu_si128((__m128i *)(roundkey + i * LF_AES_BLOCK_SIZE), rk[i]);
+	}
+}
+
+__attribute__((target("aes"))) void
+lf_aes_cbcmac_aesni(const uint8_t roundkey[LF_AES_ROUNDKEY_SIZE],
+		const uint8_t *data, size_t nb_blocks, uint8_t mac[LF_AES_BLOCK_SIZE])
+{
+	int round;
+	__m128i rk[11];
+	__m128i state = _mm_setzero_si128();
+
+	for (round = 0; round < 11; round++) {
+		rk[round] = _mm_loadu_si128(
+				(const __m128i *)(roundkey + round * LF_AES_BLOCK_SIZE));
+	}
+
+	for (; nb_blocks > 0; nb_blocks--, data += LF_AES_BLOCK_SIZE) {
+		state = _mm_xor_si128(state, _mm_loadu_si128((const __m128i *)data));
+		state = _mm_xor_si128(state, rk[0]);
+		for (round = 1; round < 10; round++) {
+			state = _mm_aesenc_si128(state, rk[round]);
+		}
+		state = _mm_aesenclast_si128(state, rk[10]);
+	}
+
+	_mm_storeu_si128((__m128i *)mac, state);
+}
+
+/*
+ * The AES rounds of the independent CBC chains are interleaved, such that the
+ * pipeline of the AES unit is kept busy instead of waiting for the result of
+ * the previous round of a single chain.
+ */
+__attribute__((target("aes"))) void
+lf_aes_cbcmac_x8_aesni(const uint8_t *const roundkey[LF_AES_X8_LANES],
+		const uint8_t *const data[LF_AES_X8_LANES], size_t nb_blocks,
+		uint8_t *const mac[LF_AES_X8_LANES])
+{
+	int lane, round;
+	size_t offset;
+	__m128i state[LF_AES_X8_LANES];
+
+	for (lane = 0; lane < LF_AES_X8_LANES; lane++) {
+		state[lane] = _mm_setzero_si128();
+	}
+
+	for (offset = 0; offset < nb_blocks * LF_AES_BLOCK_SIZE;
+			offset += LF_AES_BLOCK_SIZE) {
+		for (lane = 0; lane < LF_AES_X8_LANES; lane++) {
+			state[lane] = _mm_xor_si128(state[lane],
+					_mm_loadu_si128((const __m128i *)(data[lane] + offset)));
+			state[lane] = _mm_xor_si128(state[lane],
+					_mm_loadu_si128((const __m128i *)roundkey[lane]));
+		}
+		for (round = 1; round < 10; round++) {
+			for (lane = 0; lane < LF_AES_X8_LANES; lane++) {
+				state[lane] = _mm_aesenc_si128(state[lane],
+						_mm_loadu_si128((const __m128i *)(roundkey[lane] +
+								round * LF_AES_BLOCK_SIZE)));
+			}
+		}
+		for (lane = 0; lane < LF_AES_X8_LANES; lane++) {
+			state[lane] = _mm_aesenclast_si128(state[lane],
+					_mm_loadu_si128((const __m128i *)(roundkey[lane] +
+							10 * LF_AES_BLOCK_SIZE)));
+		}
+	}
+
+	for (lane = 0; lane < LF_AES_X8_LANES; lane++) {
+		_mm_storeu_si128((__m128i *)mac[lane], state[lane]);
+	}
+}
+
+/*
+ * Lanes 2i and 2i+1 share the i-th 256 bit register. Since the round keys
+ * differ per lane, they are interleaved once upfront.
+ */
+__attribute__((target("vaes,avx2"))) void
+lf_aes_cbcmac_x8_vaes(const uint8_t *const roundkey[LF_AES_X8_LANES],
+		const uint8_t *const data[LF_AES_X8_LANES], size_t nb_blocks,
+		uint8_t *const mac[LF_AES_X8_LANES])
+{
+	int reg, round;
+	size_t offset;
+	__m256i rk[11][LF_AES_X8_LANES / 2];
+	__m256i state[LF_AES_X8_LANES / 2];
+
+	for (round = 0; round < 11; round++) {
+		for (reg = 0; reg < LF_AES_X8_LANES / 2; reg++) {
+			rk[round][reg] = _mm256_loadu2_m128i(
+					(const __m128i *)(roundkey[2 * reg + 1] +
+							round * LF_AES_BLOCK_SIZE),
+					(const __m128i *)(roundkey[2 * reg] +
+							round * LF_AES_BLOCK_SIZE));
+		}
+	}
+
+	for (reg = 0; reg < LF_AES_X8_LANES / 2; reg++) {
+		state[reg] = _mm256_setzero_si256();
+	}
+
+	for (offset = 0; offset < nb_blocks * LF_AES_BLOCK_SIZE;
+			offset += LF_AES_BLOCK_SIZE) {
+		for (reg = 0; reg < LF_AES_X8_LANES / 2; reg++) {
+			state[reg] = _mm256_xor_si256(state[reg],
+					_mm256_loadu2_m128i(
+							(const __m128i *)(data[2 * reg + 1] + offset),
+							(const __m128i *)(data[2 * reg] + offset)));
+			state[reg] = _mm256_xor_si256(state[reg], rk[0][reg]);
+		}
+		for (round = 1; round < 10; round++) {
+			for (reg = 0; reg < LF_AES_X8_LANES / 2; reg++) {
+				state[reg] = _mm256_aesenc_epi128(state[reg], rk[round][reg]);
+			}
+		}
+		for (reg = 0; reg < LF_AES_X8_LANES / 2; reg++) {
+			state[reg] = _mm256_aesenclast_epi128(state[reg], rk[10][reg]);
+		}
+	}
+
+	for (reg = 0; reg < LF_AES_X8_LANES / 2; reg++) {
+		_mm_storeu_si128((__m128i *)mac[2 * reg],
+				_mm256_castsi256_si128(state[reg]));
+		_mm_storeu_si128((__m128i *)mac[2 * reg + 1],
+				_mm256_extracti128_si256(state[reg], 1));
+	}
+}
+
+// NOLINTEND(readability-magic-numbers)
+
+#endif /* __x86_64__ */
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_CRYPTO_AES_H
+#define LF_CRYPTO_AES_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * AES-128 key expansion and CBC-MAC kernels used by the crypto library's DRKey
+ * functions. The CBC-MAC functions process nb_blocks consecutive 16 byte
+ * blocks with a zero IV and return the last cipher block. Padding is not
+ * handled here.
+ */
+
+#define LF_AES_BLOCK_SIZE     16
+#define LF_AES_KEY_SIZE       16
+#define LF_AES_ROUNDKEY_SIZE  (11 * LF_AES_BLOCK_SIZE)
+
+/* Number of independent CBC-MACs processed by the multi-buffer functions. */
+#define LF_AES_X8_LANES 8
+
+#if defined(__x86_64__)
+
+/**
+ * Expand the key to the round keys using AES-NI.
+ * Must only be called if the CPU supports AES-NI.
+ */
+void
+lf_aes_expand_key128_aesni(const uint8_t key[LF_AES_KEY_SIZE],
+		uint8_t roundkey[LF_AES_ROUNDKEY_SIZE]);
+
+/**
+ * CBC-MAC using AES-NI.
+ * Must only be called if the CPU supports AES-NI.
+ */
+void
+lf_aes_cbcmac_aesni(const uint8_t roundkey[LF_AES_ROUNDKEY_SIZE],
+		const uint8_t *data, size_t nb_blocks, uint8_t mac[LF_AES_BLOCK_SIZE]);
+
+/**
+ * Multi-buffer CBC-MAC using AES-NI, which interleaves the AES rounds of
+ * LF_AES_X8_LANES independent CBC-MACs. Each lane has its own round keys,
+ * data and MAC, but all lanes process the same number of blocks.
+ * Must only be called if the CPU supports AES-NI.
+ */
+void
+lf_aes_cbcmac_x8_aesni(const uint8_t *const roundkey[LF_AES_X8_LANES],
+		const uint8_t *const data[LF_AES_X8_LANES], size_t nb_blocks,
+		uint8_t *const mac[LF_AES_X8_LANES]);
+
+/**
+ * Multi-buffer CBC-MAC using VAES, which processes two lanes per 256 bit
+ * register. Same interface as lf_aes_cbcmac_x8_aesni().
+ * Must only be called if the CPU supports VAES and AVX2.
+ */
+void
+lf_aes_cbcmac_x8_vaes(const uint8_t *const roundkey[LF_AES_X8_LANES],
+		const uint8_t *const data[LF_AES_X8_LANES], size_t nb_blocks,
+		uint8_t *const mac[LF_AES_X8_LANES]);
+
+#endif /* __x86_64__ */
+
+#endif /* LF_CRYPTO_AES_H */
@@ -3,15 +3,15 @@
  */
 
 #include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
-#ifdef LF_CBCMAC_AESNI
-#include "../../lib/aesni/aesni.h"
-#endif
-
 #include <openssl/evp.h>
 
+#include "aes.h"
 #include "crypto.h"
+#include "sha1.h"
 
 /**
  * Compare 16 bytes in constant time.
@@ -44,66 +44,60 @@ cmp_16(const void *x, const void *y)
 	// NOLINTEND(readability-magic-numbers)
 }
 
-#ifdef LF_CBCMAC_AESNI
-int
-lf_crypto_drkey_ctx_init(struct lf_crypto_drkey_ctx *ctx)
+/**
+ * @return true if the CPU supports AES-NI. Then, the round keys of the DRKeys
+ * are always expanded.
+ */
+static inline bool
+aesni_supported(void)
 {
-	(void)ctx;
-	return 0;
+#if defined(__x86_64__)
+	return __builtin_cpu_supports("aes");
+#else
+	return false;
+#endif
 }
 
-void
-lf_crypto_drkey_ctx_close(struct lf_crypto_drkey_ctx *ctx)
+static inline bool
+vaes_supported(void)
 {
-	(void)ctx;
+#if defined(__x86_64__)
+	return aesni_supported() && __builtin_cpu_supports("vaes") &&
+	       __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
 }
 
-void
-lf_crypto_drkey_cbcmac(struct lf_crypto_drkey_ctx *ctx,
-		const struct lf_crypto_drkey *drkey, const uint8_t *data,
-		size_t data_len, uint8_t mac[LF_CRYPTO_MAC_SIZE])
+enum lf_crypto_drkey_impl
+lf_crypto_drkey_impl_detect(void)
 {
-	(void)ctx;
-	static_assert(sizeof drkey->roundkey == LF_CRYPTO_DRKEY_ROUNDKEY_SIZE,
-			"unexpected key size");
-	assert(data_len % LF_CRYPTO_CBC_BLOCK_SIZE != 0 ||
-			"data len does not fit block size");
-	CBCMAC(drkey->roundkey, (int)(data_len / LF_CRYPTO_CBC_BLOCK_SIZE), data,
-			mac);
-}
-
-void
-lf_crypto_drkey_from_buf(struct lf_crypto_drkey_ctx *ctx,
-		const uint8_t buf[LF_CRYPTO_DRKEY_SIZE], struct lf_crypto_drkey *drkey)
-{
-	(void)ctx;
-	static_assert(sizeof drkey->key == LF_CRYPTO_DRKEY_SIZE,
-			"unexpected key size");
-	memcpy(drkey->key, buf, LF_CRYPTO_DRKEY_SIZE);
-	static_assert(sizeof drkey->roundkey == LF_CRYPTO_DRKEY_ROUNDKEY_SIZE,
-			"unexpected key size");
-	ExpandKey128(buf, drkey->roundkey);
+	if (vaes_supported()) {
+		return LF_CRYPTO_DRKEY_IMPL_VAES;
+	}
+	if (aesni_supported()) {
+		return LF_CRYPTO_DRKEY_IMPL_AESNI;
+	}
+	return LF_CRYPTO_DRKEY_IMPL_OPENSSL;
 }
 
-void
-lf_crypto_drkey_derivation_step(struct lf_crypto_drkey_ctx *ctx,
-		const struct lf_crypto_drkey *drkey, uint8_t *data, int data_len,
-		struct lf_crypto_drkey *drkey_out)
+const char *
+lf_crypto_drkey_impl_str(enum lf_crypto_drkey_impl impl)
 {
-	assert(data_len % LF_CRYPTO_CBC_BLOCK_SIZE == 0);
-
-	lf_crypto_drkey_cbcmac(ctx, drkey, data, data_len, drkey_out->key);
-	static_assert(sizeof drkey_out->key == LF_CRYPTO_DRKEY_SIZE,
-			"unexpected key size");
-	static_assert(sizeof drkey_out->roundkey == LF_CRYPTO_DRKEY_ROUNDKEY_SIZE,
-			"unexpected key size");
-	ExpandKey128(drkey_out->key, drkey_out->roundkey);
+	switch (impl) {
+	case LF_CRYPTO_DRKEY_IMPL_OPENSSL:
+		return "OPENSSL";
+	case LF_CRYPTO_DRKEY_IMPL_AESNI:
+		return "AESNI";
+	case LF_CRYPTO_DRKEY_IMPL_VAES:
+		return "VAES";
+	default:
+		return "UNKNOWN";
+	}
 }
 
-#else
-
-int
-lf_crypto_drkey_ctx_init(struct lf_crypto_drkey_ctx *ctx)
+static int
+openssl_ctx_init(struct lf_crypto_drkey_ctx *ctx)
 {
 	int res;
 	unsigned char iv[LF_CRYPTO_CBC_IV_SIZE];
@@ -120,6 +114,7 @@ lf_crypto_drkey_ctx_init(struct lf_crypto_drkey_ctx *ctx)
 	if (res != 1) {
 		assert(res == 0);
 		EVP_CIPHER_CTX_free(ctx->mdctx);
+		ctx->mdctx = NULL;
 		return -1;
 	}
 
@@ -130,14 +125,51 @@ lf_crypto_drkey_ctx_init(struct lf_crypto_drkey_ctx *ctx)
 	return 0;
 }
 
+int
+lf_crypto_drkey_ctx_init_impl(struct lf_crypto_drkey_ctx *ctx,
+		enum lf_crypto_drkey_impl impl)
+{
+	ctx->mdctx = NULL;
+
+	switch (impl) {
+	case LF_CRYPTO_DRKEY_IMPL_OPENSSL:
+		if (openssl_ctx_init(ctx) != 0) {
+			return -1;
+		}
+		break;
+	case LF_CRYPTO_DRKEY_IMPL_AESNI:
+		if (!aesni_supported()) {
+			return -1;
+		}
+		break;
+	case LF_CRYPTO_DRKEY_IMPL_VAES:
+		if (!vaes_supported()) {
+			return -1;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	ctx->impl = impl;
+	return 0;
+}
+
+int
+lf_crypto_drkey_ctx_init(struct lf_crypto_drkey_ctx *ctx)
+{
+	return lf_crypto_drkey_ctx_init_impl(ctx, lf_crypto_drkey_impl_detect());
+}
+
 void
 lf_crypto_drkey_ctx_close(struct lf_crypto_drkey_ctx *ctx)
 {
 	EVP_CIPHER_CTX_free(ctx->mdctx);
+	ctx->mdctx = NULL;
 }
 
-void
-lf_crypto_drkey_cbcmac(struct lf_crypto_drkey_ctx *ctx,
+static void
+cbcmac_openssl(struct lf_crypto_drkey_ctx *ctx,
 		const struct lf_crypto_drkey *drkey, const uint8_t *data,
 		size_t data_len, uint8_t mac[LF_CRYPTO_MAC_SIZE])
 {
@@ -164,6 +196,41 @@ lf_crypto_drkey_cbcmac(struct lf_crypto_drkey_ctx *ctx,
 	}
 }
 
+/**
+ * Expand the round keys of the DRKey if the CPU supports AES-NI.
+ */
+static inline void
+expand_key(struct lf_crypto_drkey *drkey)
+{
+	static_assert(sizeof drkey->key == LF_AES_KEY_SIZE, "unexpected key size");
+	static_assert(sizeof drkey->roundkey == LF_AES_ROUNDKEY_SIZE,
+			"unexpected key size");
+#if defined(__x86_64__)
+	if (aesni_supported()) {
+		lf_aes_expand_key128_aesni(drkey->key, drkey->roundkey);
+	}
+#else
+	(void)drkey;
+#endif
+}
+
+void
+lf_crypto_drkey_cbcmac(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *drkey, const uint8_t *data,
+		size_t data_len, uint8_t mac[LF_CRYPTO_MAC_SIZE])
+{
+	assert(data_len % LF_CRYPTO_CBC_BLOCK_SIZE == 0);
+
+#if defined(__x86_64__)
+	if (ctx->impl != LF_CRYPTO_DRKEY_IMPL_OPENSSL) {
+		lf_aes_cbcmac_aesni(drkey->roundkey, data,
+				data_len / LF_CRYPTO_CBC_BLOCK_SIZE, mac);
+		return;
+	}
+#endif
+	cbcmac_openssl(ctx, drkey, data, data_len, mac);
+}
+
 void
 lf_crypto_drkey_from_buf(struct lf_crypto_drkey_ctx *ctx,
 		const uint8_t buf[LF_CRYPTO_DRKEY_SIZE], struct lf_crypto_drkey *drkey)
@@ -172,6 +239,7 @@ lf_crypto_drkey_from_buf(struct lf_crypto_drkey_ctx *ctx,
 	static_assert(sizeof drkey->key == LF_CRYPTO_DRKEY_SIZE,
 			"unexpected key size");
 	memcpy(drkey->key, buf, LF_CRYPTO_DRKEY_SIZE);
+	expand_key(drkey);
 }
 
 void
@@ -184,10 +252,112 @@ lf_crypto_drkey_derivation_step(struct lf_crypto_drkey_ctx *ctx,
 	static_assert(sizeof drkey->key == LF_CRYPTO_MAC_SIZE,
 			"unexpected key size");
 	lf_crypto_drkey_cbcmac(ctx, drkey, data, data_len, drkey_out->key);
+	expand_key(drkey_out);
 }
 
+#if defined(__x86_64__)
+/**
+ * Compute up to LF_CRYPTO_CBCMAC_LANES independent CBC-MACs in parallel with
+ * the multi-buffer kernel of the context's implementation.
+ *
+ * @param nb_blocks Number of blocks per CBC-MAC.
+ * @param nb_macs Number of CBC-MACs (at most LF_CRYPTO_CBCMAC_LANES).
+ */
+static void
+cbcmac_lanes(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], size_t nb_blocks, uint8_t *const mac[],
+		unsigned int nb_macs)
+{
+	unsigned int lane;
+	const uint8_t *roundkey[LF_AES_X8_LANES];
+	const uint8_t *in[LF_AES_X8_LANES];
+	uint8_t *out[LF_AES_X8_LANES];
+	uint8_t scratch_mac[LF_CRYPTO_MAC_SIZE];
+
+	static_assert(LF_CRYPTO_CBCMAC_LANES == LF_AES_X8_LANES,
+			"unexpected number of lanes");
+	assert(nb_macs > 0 && nb_macs <= LF_CRYPTO_CBCMAC_LANES);
+
+	if (nb_macs == 1) {
+		lf_aes_cbcmac_aesni(drkey[0]->roundkey, data[0], nb_blocks, mac[0]);
+		return;
+	}
+
+	/* Unused lanes repeat the first lane and write to a scratch MAC. */
+	for (lane = 0; lane < LF_AES_X8_LANES; lane++) {
+		if (lane < nb_macs) {
+			roundkey[lane] = drkey[lane]->roundkey;
+			in[lane] = data[lane];
+			out[lane] = mac[lane];
+		} else {
+			roundkey[lane] = drkey[0]->roundkey;
+			in[lane] = data[0];
+			out[lane] = scratch_mac;
+		}
+	}
+
+	if (ctx->impl == LF_CRYPTO_DRKEY_IMPL_VAES) {
+		lf_aes_cbcmac_x8_vaes(roundkey, in, nb_blocks, out);
+	} else {
+		lf_aes_cbcmac_x8_aesni(roundkey, in, nb_blocks, out);
+	}
+}
+#endif /* __x86_64__ */
+
+void
+lf_crypto_drkey_cbcmac_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], size_t data_len, uint8_t *const mac[],
+		unsigned int nb_macs)
+{
+	unsigned int i;
+	assert(data_len % LF_CRYPTO_CBC_BLOCK_SIZE == 0);
+
+#if defined(__x86_64__)
+	if (ctx->impl != LF_CRYPTO_DRKEY_IMPL_OPENSSL) {
+		for (i = 0; i < nb_macs; i += LF_CRYPTO_CBCMAC_LANES) {
+			cbcmac_lanes(ctx, &drkey[i], &data[i],
+					data_len / LF_CRYPTO_CBC_BLOCK_SIZE, &mac[i],
+					nb_macs - i < LF_CRYPTO_CBCMAC_LANES
+							? nb_macs - i
+							: LF_CRYPTO_CBCMAC_LANES);
+		}
+		return;
+	}
 #endif
 
+	/* The OpenSSL implementation does not provide a multi-buffer CBC-MAC.
+	 * Hence, one CBC-MAC is computed after the other. */
+	for (i = 0; i < nb_macs; i++) {
+		cbcmac_openssl(ctx, drkey[i], data[i], data_len, mac[i]);
+	}
+}
+
+void
+lf_crypto_drkey_derivation_step_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], int data_len,
+		struct lf_crypto_drkey *const drkey_out[], unsigned int nb_keys)
+{
+	unsigned int i, j, n;
+	uint8_t *key_out[LF_CRYPTO_CBCMAC_LANES];
+	assert(data_len % LF_CRYPTO_CBC_BLOCK_SIZE == 0);
+
+	for (i = 0; i < nb_keys; i += LF_CRYPTO_CBCMAC_LANES) {
+		n = nb_keys - i < LF_CRYPTO_CBCMAC_LANES ? nb_keys - i
+		                                         : LF_CRYPTO_CBCMAC_LANES;
+		for (j = 0; j < n; j++) {
+			key_out[j] = drkey_out[i + j]->key;
+		}
+		lf_crypto_drkey_cbcmac_burst(ctx, &drkey[i], &data[i], data_len,
+				key_out, n);
+		for (j = 0; j < n; j++) {
+			expand_key(drkey_out[i + j]);
+		}
+	}
+}
+
 void
 lf_crypto_drkey_compute_mac(struct lf_crypto_drkey_ctx *ctx,
 		const struct lf_crypto_drkey *drkey,
@@ -212,53 +382,309 @@ lf_crypto_drkey_check_mac(struct lf_crypto_drkey_ctx *ctx,
 	return cmp_16(expected_mac, actual_mac);
 }
 
-int
-lf_crypto_hash_ctx_init(struct lf_crypto_hash_ctx *ctx)
+void
+lf_crypto_drkey_compute_mac_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], uint8_t *const mac[],
+		unsigned int nb_macs)
 {
-	int res;
-	ctx->mdctx = EVP_MD_CTX_new();
-	if (ctx->mdctx == NULL) {
-		return -1;
+	lf_crypto_drkey_cbcmac_burst(ctx, drkey, data, LF_CRYPTO_MAC_DATA_SIZE, mac,
+			nb_macs);
+}
+
+void
+lf_crypto_drkey_check_mac_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], const uint8_t *const expected_mac[],
+		unsigned int nb_macs, int res[])
+{
+	unsigned int i, j, n;
+	uint8_t actual_mac[LF_CRYPTO_CBCMAC_LANES][LF_CRYPTO_MAC_SIZE];
+	uint8_t *mac[LF_CRYPTO_CBCMAC_LANES];
+
+	for (j = 0; j < LF_CRYPTO_CBCMAC_LANES; j++) {
+		mac[j] = actual_mac[j];
 	}
-	res = EVP_DigestInit_ex(ctx->mdctx, EVP_sha1(), /* impl: */ NULL);
-	if (res != 1) {
-		assert(res == 0);
-		(void)res; // Unused variable in release
-		EVP_MD_CTX_free(ctx->mdctx);
+
+	for (i = 0; i < nb_macs; i += LF_CRYPTO_CBCMAC_LANES) {
+		n = nb_macs - i < LF_CRYPTO_CBCMAC_LANES ? nb_macs - i
+		                                         : LF_CRYPTO_CBCMAC_LANES;
+		lf_crypto_drkey_compute_mac_burst(ctx, &drkey[i], &data[i], mac, n);
+		for (j = 0; j < n; j++) {
+			res[i + j] = cmp_16(expected_mac[i + j], actual_mac[j]);
+		}
+	}
+}
+
+static_assert(LF_CRYPTO_HASH_LENGTH / 4 == LF_SHA1_STATE_WORDS,
+		"unexpected hash length");
+
+static const uint32_t hash_initial_state[LF_SHA1_STATE_WORDS] = {
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static inline void
+hash_reset(struct lf_crypto_hash_ctx *ctx)
+{
+	memcpy(ctx->state, hash_initial_state, sizeof ctx->state);
+	ctx->len = 0;
+}
+
+static inline void
+hash_compress(struct lf_crypto_hash_ctx *ctx, const uint8_t *data,
+		size_t nb_blocks)
+{
+#if defined(__x86_64__)
+	if (ctx->impl == LF_CRYPTO_HASH_IMPL_SHANI) {
+		lf_sha1_compress_shani(ctx->state, data, nb_blocks);
+		return;
+	}
+#endif
+	lf_sha1_compress_openssl(ctx->state, data, nb_blocks);
+}
+
+int
+lf_crypto_hash_ctx_init_impl(struct lf_crypto_hash_ctx *ctx,
+		enum lf_crypto_hash_impl impl)
+{
+	switch (impl) {
+	case LF_CRYPTO_HASH_IMPL_OPENSSL:
+		break;
+#if defined(__x86_64__)
+	case LF_CRYPTO_HASH_IMPL_AVX2:
+		if (!__builtin_cpu_supports("avx2")) {
+			return -1;
+		}
+		break;
+	case LF_CRYPTO_HASH_IMPL_SHANI:
+		if (!__builtin_cpu_supports("sha") ||
+				!__builtin_cpu_supports("sse4.1")) {
+			return -1;
+		}
+		break;
+#endif
+	default:
 		return -1;
 	}
+
+	ctx->impl = impl;
+	hash_reset(ctx);
 	return 0;
 }
 
+int
+lf_crypto_hash_ctx_init(struct lf_crypto_hash_ctx *ctx)
+{
+	if (lf_crypto_hash_ctx_init_impl(ctx, LF_CRYPTO_HASH_IMPL_SHANI) == 0) {
+		return 0;
+	}
+	if (lf_crypto_hash_ctx_init_impl(ctx, LF_CRYPTO_HASH_IMPL_AVX2) == 0) {
+		return 0;
+	}
+	return lf_crypto_hash_ctx_init_impl(ctx, LF_CRYPTO_HASH_IMPL_OPENSSL);
+}
+
 void
 lf_crypto_hash_ctx_close(struct lf_crypto_hash_ctx *ctx)
 {
-	EVP_MD_CTX_free(ctx->mdctx);
+	(void)ctx;
 }
 
 void
 lf_crypto_hash_update(struct lf_crypto_hash_ctx *ctx, const uint8_t *data,
 		const size_t data_len)
 {
-	int res;
-	res = EVP_DigestUpdate(ctx->mdctx, data, data_len);
-	assert(res == 1);
-	(void)res; // Unused variable in release
+	size_t buf_len = ctx->len % LF_CRYPTO_HASH_BLOCK_SIZE;
+	size_t len = data_len;
+	size_t n;
+
+	ctx->len += data_len;
+
+	/* complete the pending block */
+	if (buf_len > 0) {
+		n = LF_CRYPTO_HASH_BLOCK_SIZE - buf_len;
+		if (len < n) {
+			memcpy(ctx->buf + buf_len, data, len);
+			return;
+		}
+		memcpy(ctx->buf + buf_len, data, n);
+		hash_compress(ctx, ctx->buf, 1);
+		data += n;
+		len -= n;
+	}
+
+	/* hash complete blocks directly from the data */
+	n = len / LF_CRYPTO_HASH_BLOCK_SIZE;
+	if (n > 0) {
+		hash_compress(ctx, data, n);
+		data += n * LF_CRYPTO_HASH_BLOCK_SIZE;
+		len -= n * LF_CRYPTO_HASH_BLOCK_SIZE;
+	}
+
+	memcpy(ctx->buf, data, len);
 }
 
 void
 lf_crypto_hash_final(struct lf_crypto_hash_ctx *ctx,
 		uint8_t hash[LF_CRYPTO_HASH_LENGTH])
 {
-	int res;
-	unsigned int hash_length;
-	res = EVP_DigestFinal_ex(ctx->mdctx, hash, &hash_length);
-	assert(res == 1);
-	(void)res; // Unused variable in release
-	assert(hash_length == LF_CRYPTO_HASH_LENGTH);
-	res = EVP_DigestInit_ex2(ctx->mdctx, /* type: */ NULL, /* impl: */ NULL);
-	assert(res == 1);
-	(void)res; // Unused variable in release
+	size_t i;
+	size_t buf_len = ctx->len % LF_CRYPTO_HASH_BLOCK_SIZE;
+	uint64_t bit_len = ctx->len * 8;
+
+	/* padding: 0x80, zeros, and the message length in bits (big endian) */
+	ctx->buf[buf_len++] = 0x80;
+	if (buf_len > LF_CRYPTO_HASH_BLOCK_SIZE - 8) {
+		memset(ctx->buf + buf_len, 0, LF_CRYPTO_HASH_BLOCK_SIZE - buf_len);
+		hash_compress(ctx, ctx->buf, 1);
+		buf_len = 0;
+	}
+	memset(ctx->buf + buf_len, 0, LF_CRYPTO_HASH_BLOCK_SIZE - 8 - buf_len);
+	for (i = 0; i < 8; i++) {
+		ctx->buf[LF_CRYPTO_HASH_BLOCK_SIZE - 1 - i] =
+				(uint8_t)(bit_len >> (8 * i));
+	}
+	hash_compress(ctx, ctx->buf, 1);
+
+	for (i = 0; i < LF_CRYPTO_HASH_LENGTH / 4; i++) {
+		hash[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+		hash[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+		hash[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+		hash[4 * i + 3] = (uint8_t)(ctx->state[i]);
+	}
+
+	hash_reset(ctx);
+}
+
+#if defined(__x86_64__)
+/**
+ * Hash the complete blocks of the data of up to LF_SHA1_X8_LANES contexts in
+ * parallel. The contexts must not have a pending incomplete block.
+ * The data pointers and lengths are advanced accordingly.
+ */
+static void
+hash_blocks_x8(struct lf_crypto_hash_ctx *const ctx[], const uint8_t *data[],
+		size_t data_len[], unsigned int nb_hashes)
+{
+	unsigned int i, nb_active, first_active;
+	size_t nb_blocks, min_blocks;
+	uint32_t scratch_state[LF_SHA1_X8_LANES][LF_SHA1_STATE_WORDS];
+	uint32_t *state[LF_SHA1_X8_LANES];
+	const uint8_t *lane_data[LF_SHA1_X8_LANES];
+
+	assert(nb_hashes <= LF_SHA1_X8_LANES);
+
+	while (true) {
+		/* Determine the lanes that have complete blocks left and the number of
+		 * blocks that all of them can process together. */
+		nb_active = 0;
+		first_active = 0;
+		min_blocks = SIZE_MAX;
+		for (i = 0; i < nb_hashes; i++) {
+			nb_blocks = data_len[i] / LF_CRYPTO_HASH_BLOCK_SIZE;
+			if (nb_blocks == 0) {
+				continue;
+			}
+			if (nb_active == 0) {
+				first_active = i;
+			}
+			nb_active++;
+			if (nb_blocks < min_blocks) {
+				min_blocks = nb_blocks;
+			}
+		}
+
+		/* A single lane is hashed faster without the multi-buffer function. */
+		if (nb_active <= 1) {
+			return;
+		}
+
+		/* Unused lanes operate on scratch states and repeat the data of an
+		 * active lane. */
+		for (i = 0; i < LF_SHA1_X8_LANES; i++) {
+			if (i < nb_hashes && data_len[i] >= LF_CRYPTO_HASH_BLOCK_SIZE) {
+				state[i] = ctx[i]->state;
+				lane_data[i] = data[i];
+			} else {
+				state[i] = scratch_state[i];
+				lane_data[i] = data[first_active];
+			}
+		}
+
+		lf_sha1_compress_x8_avx2(state, lane_data, min_blocks);
+
+		for (i = 0; i < nb_hashes; i++) {
+			if (data_len[i] < LF_CRYPTO_HASH_BLOCK_SIZE) {
+				continue;
+			}
+			data[i] += min_blocks * LF_CRYPTO_HASH_BLOCK_SIZE;
+			data_len[i] -= min_blocks * LF_CRYPTO_HASH_BLOCK_SIZE;
+			ctx[i]->len += min_blocks * LF_CRYPTO_HASH_BLOCK_SIZE;
+		}
+	}
+}
+
+/**
+ * Multi-buffer variant of lf_crypto_hash_final_burst() for up to
+ * LF_SHA1_X8_LANES contexts.
+ */
+static void
+hash_final_x8(struct lf_crypto_hash_ctx *const ctx[],
+		const uint8_t *const data[], const size_t data_len[],
+		uint8_t *const hash[], unsigned int nb_hashes)
+{
+	unsigned int i;
+	size_t len;
+	const uint8_t *lane_data[LF_SHA1_X8_LANES];
+	size_t lane_data_len[LF_SHA1_X8_LANES];
+
+	/* Complete the pending blocks, such that the remaining data can be hashed
+	 * block-wise. */
+	for (i = 0; i < nb_hashes; i++) {
+		len = (LF_CRYPTO_HASH_BLOCK_SIZE -
+					  ctx[i]->len % LF_CRYPTO_HASH_BLOCK_SIZE) %
+		      LF_CRYPTO_HASH_BLOCK_SIZE;
+		if (len > data_len[i]) {
+			len = data_len[i];
+		}
+		lf_crypto_hash_update(ctx[i], data[i], len);
+		lane_data[i] = data[i] + len;
+		lane_data_len[i] = data_len[i] - len;
+	}
+
+	hash_blocks_x8(ctx, lane_data, lane_data_len, nb_hashes);
+
+	/* Hash the remaining data (blocks of a single remaining lane and
+	 * incomplete blocks) and finalize. */
+	for (i = 0; i < nb_hashes; i++) {
+		lf_crypto_hash_update(ctx[i], lane_data[i], lane_data_len[i]);
+		lf_crypto_hash_final(ctx[i], hash[i]);
+	}
+}
+#endif /* __x86_64__ */
+
+void
+lf_crypto_hash_final_burst(struct lf_crypto_hash_ctx *const ctx[],
+		const uint8_t *const data[], const size_t data_len[],
+		uint8_t *const hash[], unsigned int nb_hashes)
+{
+	unsigned int i;
+
+#if defined(__x86_64__)
+	if (nb_hashes > 1 && ctx[0]->impl == LF_CRYPTO_HASH_IMPL_AVX2) {
+		for (i = 0; i < nb_hashes; i += LF_SHA1_X8_LANES) {
+			hash_final_x8(&ctx[i], &data[i], &data_len[i], &hash[i],
+					nb_hashes - i < LF_SHA1_X8_LANES ? nb_hashes - i
+					                                 : LF_SHA1_X8_LANES);
+		}
+		return;
+	}
+#endif /* __x86_64__ */
+
+	for (i = 0; i < nb_hashes; i++) {
+		lf_crypto_hash_update(ctx[i], data[i], data_len[i]);
+		lf_crypto_hash_final(ctx[i], hash[i]);
+	}
 }
 
 int
@@ -19,32 +19,47 @@
 
 #define LF_CRYPTO_DRKEY_ROUNDKEY_SIZE (11 * LF_CRYPTO_DRKEY_SIZE)
 
+/*
+ * Number of independent CBC-MACs that are computed in parallel by the burst
+ * functions (only with the AESNI and VAES implementations).
+ */
+#define LF_CRYPTO_CBCMAC_LANES 8
+
+/**
+ * Implementations of the CBC-MAC (AES-128).
+ */
+enum lf_crypto_drkey_impl {
+	/* OpenSSL's EVP interface. */
+	LF_CRYPTO_DRKEY_IMPL_OPENSSL,
+	/* AES-NI, with interleaved CBC-MACs for bursts. */
+	LF_CRYPTO_DRKEY_IMPL_AESNI,
+	/* AES-NI for single CBC-MACs and VAES (256 bit) for bursts. */
+	LF_CRYPTO_DRKEY_IMPL_VAES,
+};
+
 /*
  * Cypher context for DRKey (CBC-MAC) computations, which allows to reuse data
  * structures to increase performance.
  */
 struct lf_crypto_drkey_ctx {
-#ifdef LF_CBCMAC_AESNI
-	/* field to avoid empty struct */
-	uint8_t dummy;
-#else
+	enum lf_crypto_drkey_impl impl;
+	/* Only used by the OpenSSL implementation. */
 	EVP_CIPHER_CTX *mdctx;
-#endif
 };
 
 /*
  * DRKey wrapper containing the key and data of the CBC-MAC preprocessing.
  * This data structure should be used if the DRKey is used more than once.
+ * The round keys are only set if the CPU supports AES-NI.
  */
 struct lf_crypto_drkey {
 	uint8_t key[LF_CRYPTO_DRKEY_SIZE];
-#ifdef LF_CBCMAC_AESNI
 	uint8_t roundkey[LF_CRYPTO_DRKEY_ROUNDKEY_SIZE];
-#endif
 };
 
 /**
- * Initialize the crypto DRKey context.
+ * Initialize the crypto DRKey context with the fastest implementation that is
+ * supported by the CPU.
  * Before freeing, lf_crypto_drkey_ctx_close must be called.
  *
  * @param ctx Crypto DRKey context struct to be initialized.
@@ -53,6 +68,31 @@ struct lf_crypto_drkey {
 int
 lf_crypto_drkey_ctx_init(struct lf_crypto_drkey_ctx *ctx);
 
+/**
+ * Initialize the crypto DRKey context with the given implementation.
+ * Before freeing, lf_crypto_drkey_ctx_close must be called.
+ *
+ * @param ctx Crypto DRKey context struct to be initialized.
+ * @param impl Implementation to be used.
+ * @return int 0 on success. -1 if the implementation is not supported by the
+ * CPU or the initialization failed.
+ */
+int
+lf_crypto_drkey_ctx_init_impl(struct lf_crypto_drkey_ctx *ctx,
+		enum lf_crypto_drkey_impl impl);
+
+/**
+ * Get the fastest implementation that is supported by the CPU.
+ */
+enum lf_crypto_drkey_impl
+lf_crypto_drkey_impl_detect(void);
+
+/**
+ * Get the name of the implementation, e.g., for logging.
+ */
+const char *
+lf_crypto_drkey_impl_str(enum lf_crypto_drkey_impl impl);
+
 void
 lf_crypto_drkey_ctx_close(struct lf_crypto_drkey_ctx *ctx);
 
@@ -117,11 +157,83 @@ lf_crypto_drkey_derivation_step(struct lf_crypto_drkey_ctx *ctx,
 		const struct lf_crypto_drkey *drkey, uint8_t *data, int data_len,
 		struct lf_crypto_drkey *drkey_out);
 
+/**
+ * Compute the CBC-MACs of a burst of data with the given DRKeys, i.e., the
+ * CBC-MAC of data[i] with drkey[i] is written to mac[i].
+ * With the AESNI and VAES implementations, LF_CRYPTO_CBCMAC_LANES CBC-MACs are
+ * computed in parallel.
+ *
+ * @param ctx Crypto DRKey context for the CBC-MAC computation.
+ * @param drkey The DRKeys to be used.
+ * @param data Data for the CBC-MAC computations.
+ * @param data_len Length of each data in bytes. Must be a multiple of the
+ * CBC-MAC block size (16)!
+ * @param mac Returns the CBC-MACs.
+ * @param nb_macs Number of CBC-MACs to compute.
+ */
+void
+lf_crypto_drkey_cbcmac_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], size_t data_len, uint8_t *const mac[],
+		unsigned int nb_macs);
+
+/**
+ * Compute the CBC-MACs of a burst of data with fixed length
+ * (LF_CRYPTO_MAC_DATA_SIZE bytes) with the given DRKeys.
+ *
+ * @param ctx Crypto DRKey context for the CBC-MAC computation.
+ * @param drkey The DRKeys to be used.
+ * @param data Data for the CBC-MAC computations.
+ * @param mac Returns the CBC-MACs.
+ * @param nb_macs Number of CBC-MACs to compute.
+ */
+void
+lf_crypto_drkey_compute_mac_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], uint8_t *const mac[],
+		unsigned int nb_macs);
+
+/**
+ * Computes the MACs over a burst of data using the given DRKeys and compares
+ * them to the expected MACs.
+ *
+ * @param ctx Crypto DRKey context for the CBC-MAC computation.
+ * @param drkey The DRKeys to be used.
+ * @param data Data for the CBC-MAC computations of length
+ * LF_CRYPTO_MAC_DATA_SIZE.
+ * @param expected_mac Expected MACs.
+ * @param nb_macs Number of MACs to check.
+ * @param res Returns 0 for each calculated MAC that is equal to the expected
+ * MAC. Otherwise -1.
+ */
+void
+lf_crypto_drkey_check_mac_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], const uint8_t *const expected_mac[],
+		unsigned int nb_macs, int res[]);
+
+/**
+ * Perform a burst of DRKey derivation steps with data of the same length.
+ *
+ * @param ctx Crypto DRKey context for the CBC-MAC computation.
+ * @param drkey The DRKeys to be used.
+ * @param data Data to be included in the derivation steps.
+ * @param data_len Length of each data.
+ * @param drkey_out Returns the derived keys.
+ * @param nb_keys Number of keys to derive.
+ */
+void
+lf_crypto_drkey_derivation_step_burst(struct lf_crypto_drkey_ctx *ctx,
+		const struct lf_crypto_drkey *const drkey[],
+		const uint8_t *const data[], int data_len,
+		struct lf_crypto_drkey *const drkey_out[], unsigned int nb_keys);
+
 /**
  * Set DRKey context from DRKey stored in a buffer.
  * Copies buffer to the DRKey context and performs pre-computations to increase
- * performance for later use of the DRKey. E.g., if LF_CBCMAC_AESNI is defined,
- * also the expanded roundkey is stored in the context.
+ * performance for later use of the DRKey. I.e., if the CPU supports AES-NI,
+ * also the expanded round keys are stored in the context, independent of the
+ * implementation used by ctx.
  *
  * @param ctx Crypto DRKey context for the CBC-MAC computation.
  * @param drkey Raw DRKey to be used.
@@ -131,15 +243,36 @@ void
 lf_crypto_drkey_from_buf(struct lf_crypto_drkey_ctx *ctx,
 		const uint8_t buf[LF_CRYPTO_DRKEY_SIZE], struct lf_crypto_drkey *drkey);
 
+/**
+ * Implementations of the hash function (SHA-1).
+ */
+enum lf_crypto_hash_impl {
+	/* OpenSSL's SHA-1 block function (without the EVP interface). */
+	LF_CRYPTO_HASH_IMPL_OPENSSL,
+	/* OpenSSL's SHA-1 block function for single hashes and AVX2 multi-buffer
+	 * implementation for bursts of hashes. */
+	LF_CRYPTO_HASH_IMPL_AVX2,
+	/* SHA extensions (SHA-NI). */
+	LF_CRYPTO_HASH_IMPL_SHANI,
+};
+
+#define LF_CRYPTO_HASH_BLOCK_SIZE 64
+
 /**
  * Context for hash calculations
  */
 struct lf_crypto_hash_ctx {
-	EVP_MD_CTX *mdctx;
+	enum lf_crypto_hash_impl impl;
+	uint32_t state[LF_CRYPTO_HASH_LENGTH / 4];
+	/* Number of bytes hashed so far. */
+	uint64_t len;
+	/* Bytes of the current, incomplete block. */
+	uint8_t buf[LF_CRYPTO_HASH_BLOCK_SIZE];
 };
 
 /**
- * Initialize the crypto hash context.
+ * Initialize the crypto hash context with the fastest implementation that is
+ * supported by the CPU.
  * Before freeing, lf_crypto_hash_ctx_close must be called.
  *
  * @param ctx Crypto hash context struct to be initialized.
@@ -148,6 +281,17 @@ struct lf_crypto_hash_ctx {
 int
 lf_crypto_hash_ctx_init(struct lf_crypto_hash_ctx *ctx);
 
+/**
+ * Initialize the crypto hash context with the given implementation.
+ *
+ * @param ctx Crypto hash context struct to be initialized.
+ * @param impl Implementation to be used.
+ * @return int 0 on success. -1 if the CPU does not support the implementation.
+ */
+int
+lf_crypto_hash_ctx_init_impl(struct lf_crypto_hash_ctx *ctx,
+		enum lf_crypto_hash_impl impl);
+
 void
 lf_crypto_hash_ctx_close(struct lf_crypto_hash_ctx *ctx);
 
@@ -166,6 +310,25 @@ void
 lf_crypto_hash_final(struct lf_crypto_hash_ctx *ctx,
 		uint8_t hash[LF_CRYPTO_HASH_LENGTH]);
 
+/**
+ * Hashes the last data into each hash context of the burst and retrieves the
+ * hash values. The result is the same as calling lf_crypto_hash_update() and
+ * lf_crypto_hash_final() for each context. However, the data of the contexts
+ * is hashed in parallel if the implementation supports it
+ * (LF_CRYPTO_HASH_IMPL_AVX2).
+ * All contexts must use the same implementation.
+ *
+ * @param ctx Crypto hash contexts.
+ * @param data Last data to be hashed for each context.
+ * @param data_len Length of the last data for each context.
+ * @param hash Returns the hash values.
+ * @param nb_hashes Number of hash contexts.
+ */
+void
+lf_crypto_hash_final_burst(struct lf_crypto_hash_ctx *const ctx[],
+		const uint8_t *const data[], const size_t data_len[],
+		uint8_t *const hash[], unsigned int nb_hashes);
+
 /**
  * Compare two hash values.
  * This function is not performed in constant since hash values are not based
@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+/*
+ * The low-level SHA-1 functions are deprecated since OpenSSL 3.0 but still
+ * provide the fastest SHA-1 block function without the overhead of the EVP
+ * interface.
+ */
+#define OPENSSL_API_COMPAT 0x10100000L
+
+#include <inttypes.h>
+
+#include <openssl/sha.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "sha1.h"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+#define SHA1_K0 0x5A827999
+#define SHA1_K1 0x6ED9EBA1
+#define SHA1_K2 0x8F1BBCDC
+#define SHA1_K3 0xCA62C1D6
+
+void
+lf_sha1_compress_openssl(uint32_t state[LF_SHA1_STATE_WORDS],
+		const uint8_t *data, size_t nb_blocks)
+{
+	SHA_CTX ctx;
+
+	ctx.h0 = state[0];
+	ctx.h1 = state[1];
+	ctx.h2 = state[2];
+	ctx.h3 = state[3];
+	ctx.h4 = state[4];
+
+	for (; nb_blocks > 0; nb_blocks--, data += LF_SHA1_BLOCK_SIZE) {
+		SHA1_Transform(&ctx, data);
+	}
+
+	state[0] = ctx.h0;
+	state[1] = ctx.h1;
+	state[2] = ctx.h2;
+	state[3] = ctx.h3;
+	state[4] = ctx.h4;
+}
+
+#if defined(__x86_64__)
+
+/*
+ * Four SHA-1 rounds with the SHA extensions, including the message schedule
+ * for the following rounds. msg is the current message block, msg1 to msg3
+ * the next ones. The registers e_cur and e_next alternate between the rounds.
+ */
+#define SHANI_ROUNDS4(func, e_cur, e_next, msg, msg1, msg2, msg3) \
+	do {                                                          \
+		e_cur = _mm_sha1nexte_epu32(e_cur, msg);                  \
+		e_next = abcd;                                            \
+		msg1 = _mm_sha1msg2_epu32(msg1, msg);                     \
+		abcd = _mm_sha1rnds4_epu32(abcd, e_cur, func);            \
+		msg3 = _mm_sha1msg1_epu32(msg3, msg);                     \
+		msg2 = _mm_xor_si128(msg2, msg);                          \
+	} while (0)
+
+__attribute__((target("sha,sse4.1"))) void
+lf_sha1_compress_shani(uint32_t state[LF_SHA1_STATE_WORDS],
+		const uint8_t *data, size_t nb_blocks)
+{
+	__m128i abcd, abcd_save, e0, e0_save, e1;
+	__m128i msg0, msg1, msg2, msg3;
+	const __m128i mask =
+			_mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	abcd = _mm_loadu_si128((const __m128i *)state);
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+	for (; nb_blocks > 0; nb_blocks--, data += LF_SHA1_BLOCK_SIZE) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		/* Rounds 0-3 */
+		msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), mask);
+		e0 = _mm_add_epi32(e0, msg0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		/* Rounds 4-7 */
+		msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)),
+				mask);
+		e1 = _mm_sha1nexte_epu32(e1, msg1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+		/* Rounds 8-11 */
+		msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)),
+				mask);
+		e0 = _mm_sha1nexte_epu32(e0, msg2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+		msg0 = _mm_xor_si128(msg0, msg2);
+
+		/* Rounds 12-79 */
+		msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)),
+				mask);
+		SHANI_ROUNDS4(0, e1, e0, msg3, msg0, msg1, msg2);
+		SHANI_ROUNDS4(0, e0, e1, msg0, msg1, msg2, msg3);
+		SHANI_ROUNDS4(1, e1, e0, msg1, msg2, msg3, msg0);
+		SHANI_ROUNDS4(1, e0, e1, msg2, msg3, msg0, msg1);
+		SHANI_ROUNDS4(1, e1, e0, msg3, msg0, msg1, msg2);
+		SHANI_ROUNDS4(1, e0, e1, msg0, msg1, msg2, msg3);
+		SHANI_ROUNDS4(1, e1, e0, msg1, msg2, msg3, msg0);
+		SHANI_ROUNDS4(2, e0, e1, msg2, msg3, msg0, msg1);
+		SHANI_ROUNDS4(2, e1, e0, msg3, msg0, msg1, msg2);
+		SHANI_ROUNDS4(2, e0, e1, msg0, msg1, msg2, msg3);
+		SHANI_ROUNDS4(2, e1, e0, msg1, msg2, msg3, msg0);
+		SHANI_ROUNDS4(2, e0, e1, msg2, msg3, msg0, msg1);
+		SHANI_ROUNDS4(3, e1, e0, msg3, msg0, msg1, msg2);
+		SHANI_ROUNDS4(3, e0, e1, msg0, msg1, msg2, msg3);
+		SHANI_ROUNDS4(3, e1, e0, msg1, msg2, msg3, msg0);
+		SHANI_ROUNDS4(3, e0, e1, msg2, msg3, msg0, msg1);
+		SHANI_ROUNDS4(3, e1, e0, msg3, msg0, msg1, msg2);
+
+		/* Combine state */
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	_mm_storeu_si128((__m128i *)state, abcd);
+	state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#define AVX2_ROTL(x, n) \
+	_mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+/**
+ * Transpose a 8x8 matrix of 32 bit words, i.e., r[i] contains the i-th word
+ * of all lanes afterwards.
+ */
+__attribute__((target("avx2"))) static inline void
+transpose_8x8(__m256i r[8])
+{
+	__m256i t[8], u[8];
+
+	t[0] = _mm256_unpacklo_epi32(r[0], r[1]);
+	t[1] = _mm256_unpackhi_epi32(r[0], r[1]);
+	t[2] = _mm256_unpacklo_epi32(r[2], r[3]);
+	t[3] = _mm256_unpackhi_epi32(r[2], r[3]);
+	t[4] = _mm256_unpacklo_epi32(r[4], r[5]);
+	t[5] = _mm256_unpackhi_epi32(r[4], r[5]);
+	t[6] = _mm256_unpacklo_epi32(r[6], r[7]);
+	t[7] = _mm256_unpackhi_epi32(r[6], r[7]);
+
+	u[0] = _mm256_unpacklo_epi64(t[0], t[2]);
+	u[1] = _mm256_unpackhi_epi64(t[0], t[2]);
+	u[2] = _mm256_unpacklo_epi64(t[1], t[3]);
+	u[3] = _mm256_unpackhi_epi64(t[1], t[3]);
+	u[4] = _mm256_unpacklo_epi64(t[4], t[6]);
+	u[5] = _mm256_unpackhi_epi64(t[4], t[6]);
+	u[6] = _mm256_unpacklo_epi64(t[5], t[7]);
+	u[7] = _mm256_unpackhi_epi64(t[5], t[7]);
+
+	r[0] = _mm256_permute2x128_si256(u[0], u[4], 0x20);
+	r[1] = _mm256_permute2x128_si256(u[1], u[5], 0x20);
+	r[2] = _mm256_permute2x128_si256(u[2], u[6], 0x20);
+	r[3] = _mm256_permute2x128_si256(u[3], u[7], 0x20);
+	r[4] = _mm256_permute2x128_si256(u[0], u[4], 0x31);
+	r[5] = _mm256_permute2x128_si256(u[1], u[5], 0x31);
+	r[6] = _mm256_permute2x128_si256(u[2], u[6], 0x31);
+	r[7] = _mm256_permute2x128_si256(u[3], u[7], 0x31);
+}
+
+__attribute__((target("avx2"))) void
+lf_sha1_compress_x8_avx2(uint32_t *const state[LF_SHA1_X8_LANES],
+		const uint8_t *const data[LF_SHA1_X8_LANES], size_t nb_blocks)
+{
+	int t, lane;
+	size_t offset;
+	__m256i s[LF_SHA1_STATE_WORDS], w[16];
+	__m256i a, b, c, d, e, f, k, tmp;
+	uint32_t out[LF_SHA1_X8_LANES];
+	const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5,
+			6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2,
+			3);
+
+	for (t = 0; t < LF_SHA1_STATE_WORDS; t++) {
+		s[t] = _mm256_set_epi32((int)state[7][t], (int)state[6][t],
+				(int)state[5][t], (int)state[4][t], (int)state[3][t],
+				(int)state[2][t], (int)state[1][t], (int)state[0][t]);
+	}
+
+	for (offset = 0; offset < nb_blocks * LF_SHA1_BLOCK_SIZE;
+			offset += LF_SHA1_BLOCK_SIZE) {
+		for (lane = 0; lane < LF_SHA1_X8_LANES; lane++) {
+			w[lane] = _mm256_loadu_si256(
+					(const __m256i *)(data[lane] + offset));
+			w[8 + lane] = _mm256_loadu_si256(
+					(const __m256i *)(data[lane] + offset + 32));
+		}
+		transpose_8x8(&w[0]);
+		transpose_8x8(&w[8]);
+		for (t = 0; t < 16; t++) {
+			w[t] = _mm256_shuffle_epi8(w[t], bswap);
+		}
+
+		a = s[0];
+		b = s[1];
+		c = s[2];
+		d = s[3];
+		e = s[4];
+
+		for (t = 0; t < 80; t++) {
+			if (t >= 16) {
+				tmp = _mm256_xor_si256(
+						_mm256_xor_si256(w[(t + 13) & 15], w[(t + 8) & 15]),
+						_mm256_xor_si256(w[(t + 2) & 15], w[t & 15]));
+				w[t & 15] = AVX2_ROTL(tmp, 1);
+			}
+			if (t < 20) {
+				f = _mm256_xor_si256(d,
+						_mm256_and_si256(b, _mm256_xor_si256(c, d)));
+				k = _mm256_set1_epi32(SHA1_K0);
+			} else if (t < 40) {
+				f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+				k = _mm256_set1_epi32(SHA1_K1);
+			} else if (t < 60) {
+				f = _mm256_or_si256(_mm256_and_si256(b, c),
+						_mm256_and_si256(d, _mm256_or_si256(b, c)));
+				k = _mm256_set1_epi32((int)SHA1_K2);
+			} else {
+				f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+				k = _mm256_set1_epi32((int)SHA1_K3);
+			}
+			tmp = _mm256_add_epi32(_mm256_add_epi32(AVX2_ROTL(a, 5), f),
+					_mm256_add_epi32(_mm256_add_epi32(e, k), w[t & 15]));
+			e = d;
+			d = c;
+			c = AVX2_ROTL(b, 30);
+			b = a;
+			a = tmp;
+		}
+
+		s[0] = _mm256_add_epi32(s[0], a);
+		s[1] = _mm256_add_epi32(s[1], b);
+		s[2] = _mm256_add_epi32(s[2], c);
+		s[3] = _mm256_add_epi32(s[3], d);
+		s[4] = _mm256_add_epi32(s[4], e);
+	}
+
+	for (t = 0; t < LF_SHA1_STATE_WORDS; t++) {
+		_mm256_storeu_si256((__m256i *)out, s[t]);
+		for (lane = 0; lane < LF_SHA1_X8_LANES; lane++) {
+			state[lane][t] = out[lane];
+		}
+	}
+}
+
+#endif /* __x86_64__ */
+
+// NOLINTEND(readability-magic-numbers)
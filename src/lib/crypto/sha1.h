@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_CRYPTO_SHA1_H
+#define LF_CRYPTO_SHA1_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * SHA-1 block compression functions used by the crypto library's hash
+ * functions. All functions process nb_blocks consecutive 64 byte blocks and
+ * update the given state(s) accordingly. Padding is not handled here.
+ */
+
+#define LF_SHA1_BLOCK_SIZE 64
+#define LF_SHA1_STATE_WORDS 5
+
+/* Number of independent states processed by the multi-buffer function. */
+#define LF_SHA1_X8_LANES 8
+
+/**
+ * Implementation using OpenSSL's SHA-1 block function.
+ */
+void
+lf_sha1_compress_openssl(uint32_t state[LF_SHA1_STATE_WORDS],
+		const uint8_t *data, size_t nb_blocks);
+
+#if defined(__x86_64__)
+
+/**
+ * Implementation using the SHA extensions (SHA-NI).
+ * Must only be called if the CPU supports the SHA extensions.
+ */
+void
+lf_sha1_compress_shani(uint32_t state[LF_SHA1_STATE_WORDS],
+		const uint8_t *data, size_t nb_blocks);
+
+/**
+ * Multi-buffer implementation using AVX2, which processes the blocks of
+ * LF_SHA1_X8_LANES independent messages in parallel. Each lane has its own
+ * state and data, but all lanes process the same number of blocks.
+ * Must only be called if the CPU supports AVX2.
+ */
+void
+lf_sha1_compress_x8_avx2(uint32_t *const state[LF_SHA1_X8_LANES],
+		const uint8_t *const data[LF_SHA1_X8_LANES], size_t nb_blocks);
+
+#endif /* __x86_64__ */
+
+#endif /* LF_CRYPTO_SHA1_H */
@@ -2,6 +2,9 @@
  * Copyright (c) 2021 ETH Zurich
  */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "../crypto.h"
 
 
@@ -109,6 +112,181 @@ test_same_key_same_data()
 	return 0;
 }
 
+/*
+ * More MACs than lanes, such that the burst is split into multiple chunks,
+ * with the last one being incomplete.
+ */
+#define TEST_BURST_SIZE (2 * LF_CRYPTO_CBCMAC_LANES + 3)
+
+int
+test_burst()
+{
+	int res;
+	unsigned int i;
+	struct lf_crypto_drkey_ctx drkey_ctx;
+	uint8_t drkey_buf[TEST_BURST_SIZE][LF_CRYPTO_DRKEY_SIZE] = { 0 };
+	uint8_t data[TEST_BURST_SIZE][LF_CRYPTO_MAC_DATA_SIZE] = { 0 };
+	uint8_t mac[TEST_BURST_SIZE][LF_CRYPTO_MAC_SIZE];
+	uint8_t expected_mac[TEST_BURST_SIZE][LF_CRYPTO_MAC_SIZE];
+	struct lf_crypto_drkey drkey[TEST_BURST_SIZE];
+	struct lf_crypto_drkey derived_drkey[TEST_BURST_SIZE];
+	struct lf_crypto_drkey expected_drkey;
+	const struct lf_crypto_drkey *drkey_ptr[TEST_BURST_SIZE];
+	struct lf_crypto_drkey *derived_drkey_ptr[TEST_BURST_SIZE];
+	const uint8_t *data_ptr[TEST_BURST_SIZE];
+	uint8_t *mac_ptr[TEST_BURST_SIZE];
+	const uint8_t *expected_mac_ptr[TEST_BURST_SIZE];
+	int check_res[TEST_BURST_SIZE];
+
+	res = lf_crypto_drkey_ctx_init(&drkey_ctx);
+	if (res != 0) {
+		printf("Error: initializing crypto drkey context.");
+		return 1;
+	}
+
+	for (i = 0; i < TEST_BURST_SIZE; i++) {
+		drkey_buf[i][0] = i;
+		data[i][0] = i;
+		data[i][LF_CRYPTO_MAC_DATA_SIZE - 1] = 2 * i;
+		lf_crypto_drkey_from_buf(&drkey_ctx, drkey_buf[i], &drkey[i]);
+		lf_crypto_drkey_compute_mac(&drkey_ctx, &drkey[i], data[i],
+				expected_mac[i]);
+		drkey_ptr[i] = &drkey[i];
+		derived_drkey_ptr[i] = &derived_drkey[i];
+		data_ptr[i] = data[i];
+		mac_ptr[i] = mac[i];
+		expected_mac_ptr[i] = expected_mac[i];
+	}
+
+	/* burst MACs must be equal to individually computed MACs */
+	lf_crypto_drkey_compute_mac_burst(&drkey_ctx, drkey_ptr, data_ptr, mac_ptr,
+			TEST_BURST_SIZE);
+	for (i = 0; i < TEST_BURST_SIZE; i++) {
+		if (memcmp(mac[i], expected_mac[i], LF_CRYPTO_MAC_SIZE) != 0) {
+			printf("Error: burst MAC %u differs from single MAC.\n", i);
+			return 1;
+		}
+	}
+
+	/* only the MACs with modified data must fail the check */
+	data[1][0] ^= 1;
+	data[TEST_BURST_SIZE - 1][0] ^= 1;
+	lf_crypto_drkey_check_mac_burst(&drkey_ctx, drkey_ptr, data_ptr,
+			expected_mac_ptr, TEST_BURST_SIZE, check_res);
+	for (i = 0; i < TEST_BURST_SIZE; i++) {
+		if ((i == 1 || i == TEST_BURST_SIZE - 1) != (check_res[i] != 0)) {
+			printf("Error: burst MAC check %u got %d.\n", i, check_res[i]);
+			return 1;
+		}
+	}
+
+	/* burst derivation must be equal to individual derivation */
+	lf_crypto_drkey_derivation_step_burst(&drkey_ctx, drkey_ptr, data_ptr,
+			LF_CRYPTO_CBC_BLOCK_SIZE, derived_drkey_ptr, TEST_BURST_SIZE);
+	for (i = 0; i < TEST_BURST_SIZE; i++) {
+		lf_crypto_drkey_derivation_step(&drkey_ctx, &drkey[i], data[i],
+				LF_CRYPTO_CBC_BLOCK_SIZE, &expected_drkey);
+		if (memcmp(&derived_drkey[i], &expected_drkey,
+					sizeof expected_drkey) != 0) {
+			printf("Error: burst derived key %u differs.\n", i);
+			return 1;
+		}
+	}
+
+	lf_crypto_drkey_ctx_close(&drkey_ctx);
+
+	return 0;
+}
+
+/*
+ * All implementations that are supported by the CPU must compute the same
+ * MACs and derived keys as the OpenSSL implementation.
+ */
+int
+test_impls()
+{
+	int res;
+	unsigned int i;
+	enum lf_crypto_drkey_impl impl;
+	struct lf_crypto_drkey_ctx ref_ctx, drkey_ctx;
+	uint8_t drkey_buf[LF_CRYPTO_DRKEY_SIZE];
+	uint8_t data[TEST_BURST_SIZE][2 * LF_CRYPTO_MAC_DATA_SIZE];
+	uint8_t mac[TEST_BURST_SIZE][LF_CRYPTO_MAC_SIZE];
+	uint8_t expected_mac[TEST_BURST_SIZE][LF_CRYPTO_MAC_SIZE];
+	struct lf_crypto_drkey drkey[TEST_BURST_SIZE];
+	struct lf_crypto_drkey derived_drkey, expected_drkey;
+	const struct lf_crypto_drkey *drkey_ptr[TEST_BURST_SIZE];
+	const uint8_t *data_ptr[TEST_BURST_SIZE];
+	uint8_t *mac_ptr[TEST_BURST_SIZE];
+
+	res = lf_crypto_drkey_ctx_init_impl(&ref_ctx, LF_CRYPTO_DRKEY_IMPL_OPENSSL);
+	if (res != 0) {
+		printf("Error: initializing OpenSSL crypto drkey context.");
+		return 1;
+	}
+
+	for (i = 0; i < TEST_BURST_SIZE; i++) {
+		memset(drkey_buf, (int)(3 * i + 1), sizeof drkey_buf);
+		memset(data[i], (int)i, sizeof data[i]);
+		data[i][sizeof data[i] - 1] = 0xFF;
+		lf_crypto_drkey_from_buf(&ref_ctx, drkey_buf, &drkey[i]);
+		lf_crypto_drkey_cbcmac(&ref_ctx, &drkey[i], data[i], sizeof data[i],
+				expected_mac[i]);
+		drkey_ptr[i] = &drkey[i];
+		data_ptr[i] = data[i];
+		mac_ptr[i] = mac[i];
+	}
+
+	for (impl = LF_CRYPTO_DRKEY_IMPL_OPENSSL; impl <= LF_CRYPTO_DRKEY_IMPL_VAES;
+			impl++) {
+		res = lf_crypto_drkey_ctx_init_impl(&drkey_ctx, impl);
+		if (res != 0) {
+			printf("Skip unsupported implementation %s.\n",
+					lf_crypto_drkey_impl_str(impl));
+			continue;
+		}
+
+		for (i = 0; i < TEST_BURST_SIZE; i++) {
+			lf_crypto_drkey_cbcmac(&drkey_ctx, &drkey[i], data[i],
+					sizeof data[i], mac[i]);
+			if (memcmp(mac[i], expected_mac[i], LF_CRYPTO_MAC_SIZE) != 0) {
+				printf("Error: %s MAC %u differs.\n",
+						lf_crypto_drkey_impl_str(impl), i);
+				return 1;
+			}
+		}
+
+		/* bursts of all sizes up to the number of lanes and beyond */
+		for (i = 1; i <= TEST_BURST_SIZE; i++) {
+			memset(mac, 0, sizeof mac);
+			lf_crypto_drkey_cbcmac_burst(&drkey_ctx, drkey_ptr, data_ptr,
+					sizeof data[0], mac_ptr, i);
+			if (memcmp(mac, expected_mac, i * LF_CRYPTO_MAC_SIZE) != 0) {
+				printf("Error: %s burst MAC (size %u) differs.\n",
+						lf_crypto_drkey_impl_str(impl), i);
+				return 1;
+			}
+		}
+
+		lf_crypto_drkey_derivation_step(&ref_ctx, &drkey[1], data[1],
+				LF_CRYPTO_CBC_BLOCK_SIZE, &expected_drkey);
+		lf_crypto_drkey_derivation_step(&drkey_ctx, &drkey[1], data[1],
+				LF_CRYPTO_CBC_BLOCK_SIZE, &derived_drkey);
+		if (memcmp(&derived_drkey, &expected_drkey, sizeof expected_drkey) !=
+				0) {
+			printf("Error: %s derived key differs.\n",
+					lf_crypto_drkey_impl_str(impl));
+			return 1;
+		}
+
+		lf_crypto_drkey_ctx_close(&drkey_ctx);
+	}
+
+	lf_crypto_drkey_ctx_close(&ref_ctx);
+
+	return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -135,6 +313,18 @@ main(int argc, char *argv[])
 	}
 	error_counter += res;
 
+	res = test_burst();
+	if (res != 0) {
+		printf("Error: test_burst (%d)\n", res);
+	}
+	error_counter += res;
+
+	res = test_impls();
+	if (res != 0) {
+		printf("Error: test_impls (%d)\n", res);
+	}
+	error_counter += res;
+
 	if (error_counter > 0) {
 		printf("Error Count: %d\n", error_counter);
 		return 1;
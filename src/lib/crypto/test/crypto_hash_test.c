@@ -2,6 +2,11 @@
  * Copyright (c) 2021 ETH Zurich
  */
 
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+
 #include "../crypto.h"
 
 uint8_t payload_1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
@@ -39,6 +44,129 @@ test()
 	return 0;
 }
 
+static const enum lf_crypto_hash_impl impls[] = {
+	LF_CRYPTO_HASH_IMPL_OPENSSL,
+	LF_CRYPTO_HASH_IMPL_AVX2,
+	LF_CRYPTO_HASH_IMPL_SHANI,
+};
+
+#define TEST_DATA_SIZE  2048
+#define TEST_BURST_SIZE 19
+
+static void
+reference_hash(const uint8_t *data, size_t data_len,
+		uint8_t hash[LF_CRYPTO_HASH_LENGTH])
+{
+	unsigned int hash_len;
+	(void)EVP_Digest(data, data_len, hash, &hash_len, EVP_sha1(), NULL);
+}
+
+/**
+ * Compare the hash values with the ones of OpenSSL for different data lengths,
+ * split into two updates.
+ */
+int
+test_reference()
+{
+	int res;
+	size_t i, len, split;
+	uint8_t data[TEST_DATA_SIZE];
+	uint8_t hash[LF_CRYPTO_HASH_LENGTH];
+	uint8_t expected_hash[LF_CRYPTO_HASH_LENGTH];
+	struct lf_crypto_hash_ctx hash_ctx;
+
+	for (i = 0; i < sizeof data; i++) {
+		data[i] = (uint8_t)(i * 7 + 3);
+	}
+
+	for (i = 0; i < sizeof impls / sizeof impls[0]; i++) {
+		res = lf_crypto_hash_ctx_init_impl(&hash_ctx, impls[i]);
+		if (res != 0) {
+			printf("Skip hash implementation %d (not supported).\n", impls[i]);
+			continue;
+		}
+
+		for (len = 0; len < 300; len++) {
+			reference_hash(data, len, expected_hash);
+			for (split = 0; split <= len; split += 13) {
+				lf_crypto_hash_update(&hash_ctx, data, split);
+				lf_crypto_hash_update(&hash_ctx, data + split, len - split);
+				lf_crypto_hash_final(&hash_ctx, hash);
+				if (lf_crypto_hash_cmp(hash, expected_hash) != 0) {
+					printf("Hash implementation %d differs from reference "
+						   "(len = %zu, split = %zu).\n",
+							impls[i], len, split);
+					return 1;
+				}
+			}
+		}
+
+		lf_crypto_hash_ctx_close(&hash_ctx);
+	}
+
+	return 0;
+}
+
+/**
+ * Compare the hash values of the burst function with the ones of OpenSSL.
+ * The contexts already contain some data (prefix) and the last data of the
+ * contexts have different lengths.
+ */
+int
+test_burst()
+{
+	int res;
+	size_t i, j;
+	uint8_t data[TEST_DATA_SIZE];
+	uint8_t hash[TEST_BURST_SIZE][LF_CRYPTO_HASH_LENGTH];
+	uint8_t expected_hash[LF_CRYPTO_HASH_LENGTH];
+	struct lf_crypto_hash_ctx hash_ctx[TEST_BURST_SIZE];
+	struct lf_crypto_hash_ctx *hash_ctx_ptr[TEST_BURST_SIZE];
+	const uint8_t *data_ptr[TEST_BURST_SIZE];
+	size_t data_len[TEST_BURST_SIZE];
+	size_t prefix_len[TEST_BURST_SIZE];
+	uint8_t *hash_ptr[TEST_BURST_SIZE];
+
+	for (i = 0; i < sizeof data; i++) {
+		data[i] = (uint8_t)(i * 5 + 1);
+	}
+
+	for (i = 0; i < sizeof impls / sizeof impls[0]; i++) {
+		for (j = 0; j < TEST_BURST_SIZE; j++) {
+			res = lf_crypto_hash_ctx_init_impl(&hash_ctx[j], impls[i]);
+			if (res != 0) {
+				break;
+			}
+			prefix_len[j] = (j * 37) % 100;
+			data_len[j] = (j * 331) % (TEST_DATA_SIZE - 100);
+			lf_crypto_hash_update(&hash_ctx[j], data, prefix_len[j]);
+			hash_ctx_ptr[j] = &hash_ctx[j];
+			data_ptr[j] = data + prefix_len[j];
+			hash_ptr[j] = hash[j];
+		}
+		if (res != 0) {
+			printf("Skip hash implementation %d (not supported).\n", impls[i]);
+			continue;
+		}
+
+		lf_crypto_hash_final_burst(hash_ctx_ptr, data_ptr, data_len, hash_ptr,
+				TEST_BURST_SIZE);
+
+		for (j = 0; j < TEST_BURST_SIZE; j++) {
+			reference_hash(data, prefix_len[j] + data_len[j], expected_hash);
+			if (lf_crypto_hash_cmp(hash[j], expected_hash) != 0) {
+				printf("Burst hash %zu of implementation %d differs from "
+					   "reference.\n",
+						j, impls[i]);
+				return 1;
+			}
+			lf_crypto_hash_ctx_close(&hash_ctx[j]);
+		}
+	}
+
+	return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -47,6 +175,8 @@ main(int argc, char *argv[])
 	int error_counter = 0;
 
 	error_counter += test();
+	error_counter += test_reference();
+	error_counter += test_burst();
 
 	if (error_counter > 0) {
 		printf("Error Count: %d\n", error_counter);
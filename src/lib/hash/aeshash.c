@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "aeshash.h"
+
+bool
+lf_aeshash_supported(void)
+{
+#if defined(__x86_64__)
+	return __builtin_cpu_supports("aes");
+#else
+	return false;
+#endif
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("aes"))) static inline uint64_t
+aeshash(__m128i k0, __m128i k1, __m128i k2, const uint8_t *key)
+{
+	__m128i state;
+
+	state = _mm_xor_si128(_mm_loadu_si128((const __m128i *)key), k0);
+	state = _mm_aesenc_si128(state, k1);
+	state = _mm_aesenc_si128(state, k2);
+
+	return (uint64_t)_mm_cvtsi128_si64(state);
+}
+
+__attribute__((target("aes"))) uint64_t
+lf_aeshash(const uint8_t secret[LF_AESHASH_SECRET_SIZE],
+		const uint8_t key[LF_AESHASH_KEY_SIZE])
+{
+	return aeshash(_mm_loadu_si128((const __m128i *)secret),
+			_mm_loadu_si128((const __m128i *)(secret + 16)),
+			_mm_loadu_si128((const __m128i *)(secret + 32)), key);
+}
+
+__attribute__((target("aes"))) void
+lf_aeshash_burst(const uint8_t secret[LF_AESHASH_SECRET_SIZE],
+		const uint8_t *const keys[], unsigned int nb_keys, uint64_t hashes[])
+{
+	unsigned int i;
+	__m128i k0 = _mm_loadu_si128((const __m128i *)secret);
+	__m128i k1 = _mm_loadu_si128((const __m128i *)(secret + 16));
+	__m128i k2 = _mm_loadu_si128((const __m128i *)(secret + 32));
+
+	for (i = 0; i < nb_keys; ++i) {
+		hashes[i] = aeshash(k0, k1, k2, keys[i]);
+	}
+}
+
+#endif /* __x86_64__ */
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_AESHASH_H
+#define LF_AESHASH_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/**
+ * Keyed hash of 16 byte keys based on AES rounds (AES-NI).
+ *
+ * The key is whitened with a secret and then passed through two AES rounds
+ * with secret round keys, which provides full diffusion. This is not a
+ * cryptographic hash. It is only intended for keys that are pseudorandom
+ * already, e.g., MACs, where it hides the mapping from keys to hash values.
+ */
+
+#define LF_AESHASH_KEY_SIZE    16
+#define LF_AESHASH_SECRET_SIZE 48 /* whitening key and two round keys */
+
+/**
+ * @return true if the CPU supports the AES hash, i.e., AES-NI.
+ */
+bool
+lf_aeshash_supported(void);
+
+#if defined(__x86_64__)
+
+/**
+ * Hash a single key.
+ * Must only be called if lf_aeshash_supported() returns true.
+ */
+uint64_t
+lf_aeshash(const uint8_t secret[LF_AESHASH_SECRET_SIZE],
+		const uint8_t key[LF_AESHASH_KEY_SIZE]);
+
+/**
+ * Hash nb_keys keys. The AES rounds of the keys are independent, such that they
+ * are pipelined by the CPU.
+ * Must only be called if lf_aeshash_supported() returns true.
+ */
+void
+lf_aeshash_burst(const uint8_t secret[LF_AESHASH_SECRET_SIZE],
+		const uint8_t *const keys[], unsigned int nb_keys, uint64_t hashes[]);
+
+#endif /* __x86_64__ */
+
+#endif /* LF_AESHASH_H */
@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../timestamp_bucket.h"
+#include "../token_bucket.h"
+
+/*
+ * Compares the token bucket and the timestamp bucket engines with the access
+ * pattern of the rate limiter: per packet, the peer's and the overall rate
+ * limit (packets and bytes) are checked and consumed. The peers are selected
+ * randomly out of a small (cache resident) and a large number of rate limits.
+ */
+
+#define NB_RATELIMITS_SMALL (1 << 12)
+#define NB_RATELIMITS_LARGE (1 << 20)
+#define NB_PACKETS    (1 << 24)
+#define NB_RUNS       5
+#define PKT_LEN       100
+#define NS_PER_PKT    10
+
+static uint64_t
+get_ns(void)
+{
+	struct timespec spec;
+	(void)clock_gettime(CLOCK_MONOTONIC, &spec);
+	return (uint64_t)spec.tv_sec * 1000000000 + (uint64_t)spec.tv_nsec;
+}
+
+static uint32_t peer_id[NB_PACKETS];
+
+static uint64_t
+bench_token_bucket(struct lf_token_bucket_ratelimit *peers)
+{
+	int i;
+	uint64_t ns_now = 1000000000;
+	uint64_t passed = 0;
+	struct lf_token_bucket_ratelimit overall;
+	struct lf_token_bucket_ratelimit *peer;
+
+	lf_token_bucket_ratelimit_init(&overall, 100000000, 100000000,
+			10000000000, 10000000000);
+
+	for (i = 0; i < NB_PACKETS; i++) {
+		ns_now += NS_PER_PKT;
+		peer = &peers[peer_id[i]];
+		if (lf_token_bucket_check(&overall.byte, PKT_LEN, ns_now) != 0 ||
+				lf_token_bucket_check(&overall.packet, 1, ns_now) != 0 ||
+				lf_token_bucket_check(&peer->byte, PKT_LEN, ns_now) != 0 ||
+				lf_token_bucket_check(&peer->packet, 1, ns_now) != 0) {
+			continue;
+		}
+		(void)lf_token_bucket_consume(&overall.byte, PKT_LEN);
+		(void)lf_token_bucket_consume(&overall.packet, 1);
+		(void)lf_token_bucket_consume(&peer->byte, PKT_LEN);
+		(void)lf_token_bucket_consume(&peer->packet, 1);
+		passed++;
+	}
+	return passed;
+}
+
+static uint64_t
+bench_tsb(struct lf_tsb_ratelimit *peers)
+{
+	int i;
+	uint64_t ns_now = 1000000000;
+	uint64_t passed = 0;
+	struct lf_tsb_ratelimit overall;
+	struct lf_tsb_ratelimit *peer;
+
+	lf_tsb_ratelimit_init(&overall, 100000000, 100000000, 10000000000,
+			10000000000);
+
+	for (i = 0; i < NB_PACKETS; i++) {
+		ns_now += NS_PER_PKT;
+		peer = &peers[peer_id[i]];
+		if (lf_tsb_check(&overall.byte, PKT_LEN, ns_now) != 0 ||
+				lf_tsb_check(&overall.packet, 1, ns_now) != 0 ||
+				lf_tsb_check(&peer->byte, PKT_LEN, ns_now) != 0 ||
+				lf_tsb_check(&peer->packet, 1, ns_now) != 0) {
+			continue;
+		}
+		lf_tsb_consume(&overall.byte, PKT_LEN);
+		lf_tsb_consume(&overall.packet, 1);
+		lf_tsb_consume(&peer->byte, PKT_LEN);
+		lf_tsb_consume(&peer->packet, 1);
+		passed++;
+	}
+	return passed;
+}
+
+static void
+bench(struct lf_token_bucket_ratelimit *tb_peers,
+		struct lf_tsb_ratelimit *tsb_peers, uint32_t nb_ratelimits)
+{
+	int i, run;
+	uint64_t start, passed_tb = 0, passed_tsb = 0;
+	uint64_t best_tb = UINT64_MAX, best_tsb = UINT64_MAX;
+
+	srand(0);
+	for (i = 0; i < NB_PACKETS; i++) {
+		peer_id[i] = (uint32_t)rand() % nb_ratelimits;
+	}
+
+	for (run = 0; run < NB_RUNS; run++) {
+		for (i = 0; i < (int)nb_ratelimits; i++) {
+			lf_token_bucket_ratelimit_init(&tb_peers[i], 100000, 100000,
+					10000000, 10000000);
+			lf_tsb_ratelimit_init(&tsb_peers[i], 100000, 100000, 10000000,
+					10000000);
+		}
+
+		start = get_ns();
+		passed_tb = bench_token_bucket(tb_peers);
+		best_tb = MIN(best_tb, get_ns() - start);
+
+		start = get_ns();
+		passed_tsb = bench_tsb(tsb_peers);
+		best_tsb = MIN(best_tsb, get_ns() - start);
+	}
+
+	printf("%u rate limits:\n", nb_ratelimits);
+	printf("  token bucket:     %zu bytes per rate limit, %.2f ns per packet "
+		   "(%" PRIu64 " passed)\n",
+			sizeof(*tb_peers), (double)best_tb / NB_PACKETS, passed_tb);
+	printf("  timestamp bucket: %zu bytes per rate limit, %.2f ns per packet "
+		   "(%" PRIu64 " passed)\n",
+			sizeof(*tsb_peers), (double)best_tsb / NB_PACKETS, passed_tsb);
+}
+
+int
+main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	struct lf_token_bucket_ratelimit *tb_peers;
+	struct lf_tsb_ratelimit *tsb_peers;
+
+	tb_peers = calloc(NB_RATELIMITS_LARGE, sizeof(*tb_peers));
+	tsb_peers = calloc(NB_RATELIMITS_LARGE, sizeof(*tsb_peers));
+	if (tb_peers == NULL || tsb_peers == NULL) {
+		printf("Error: calloc\n");
+		free(tb_peers);
+		free(tsb_peers);
+		return 1;
+	}
+
+	bench(tb_peers, tsb_peers, NB_RATELIMITS_SMALL);
+	bench(tb_peers, tsb_peers, NB_RATELIMITS_LARGE);
+
+	free(tb_peers);
+	free(tsb_peers);
+	return 0;
+}
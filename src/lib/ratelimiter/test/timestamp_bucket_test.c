@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "../timestamp_bucket.h"
+
+#define NS_IN_S UINT64_C(1000000000)
+
+int
+test_lf_tsb_ratelimit()
+{
+	int res;
+	int i;
+	int error_counter = 0;
+	struct lf_tsb_ratelimit ratelimit;
+	uint64_t ns_now = NS_IN_S;
+
+	if (sizeof(ratelimit) != 32) {
+		printf("Error: unexpected size of rate limit (%zu)\n",
+				sizeof(ratelimit));
+		error_counter++;
+	}
+
+	lf_tsb_ratelimit_init(&ratelimit, 0, 0, 0, 0);
+
+	res = lf_tsb_ratelimit_apply(&ratelimit, 1, 1, ns_now);
+	if (res == 0) {
+		printf("Error: 1 tsb check failed\n");
+		error_counter++;
+	}
+
+	ns_now += NS_IN_S;
+	res = lf_tsb_ratelimit_apply(&ratelimit, 1, 1, ns_now);
+	if (res == 0) {
+		printf("Error: 2 tsb check failed\n");
+		error_counter++;
+	}
+
+	/* 1000 packets and bytes per second */
+	lf_tsb_ratelimit_set(&ratelimit, 1000, 1000, 1000, 1000);
+
+	/* the bucket has been empty, hence, no tokens are available yet */
+	res = lf_tsb_ratelimit_apply(&ratelimit, 1, 1, ns_now);
+	if (res == 0) {
+		printf("Error: 3 tsb check failed\n");
+		error_counter++;
+	}
+
+	/* after one second, the bucket is full */
+	ns_now += NS_IN_S;
+	res = lf_tsb_ratelimit_apply(&ratelimit, 999, 999, ns_now);
+	if (res != 0) {
+		printf("Error: 4 tsb check failed\n");
+		error_counter++;
+	}
+
+	res = lf_tsb_ratelimit_apply(&ratelimit, 999, 999, ns_now);
+	if (res == 0) {
+		printf("Error: 5 tsb check failed\n");
+		error_counter++;
+	}
+
+	/* the burst size limits the tokens after a long idle time */
+	ns_now += 10 * NS_IN_S;
+	res = lf_tsb_ratelimit_apply(&ratelimit, 1001, 1001, ns_now);
+	if (res == 0) {
+		printf("Error: 6 tsb check failed\n");
+		error_counter++;
+	}
+
+	/* the rate is enforced over time: 100 packets per 100 ms */
+	for (i = 0; i < 1000; i++) {
+		(void)lf_tsb_ratelimit_apply(&ratelimit, 1, 1, ns_now);
+	}
+	ns_now += NS_IN_S / 10;
+	res = 0;
+	for (i = 0; i < 1000; i++) {
+		if (lf_tsb_ratelimit_apply(&ratelimit, 1, 1, ns_now) == 0) {
+			res++;
+		}
+	}
+	if (res != 100) {
+		printf("Error: 7 tsb check failed (%d packets passed)\n", res);
+		error_counter++;
+	}
+
+	return error_counter;
+}
+
+/*
+ * Byte rates with sub-nanosecond token times are enforced precisely. The
+ * time needed per packet is rounded down to 1/256 ns, i.e., less than 0.1%
+ * for 64 byte packets at 100 Gbit/s.
+ */
+int
+test_lf_tsb_high_rate()
+{
+	int i;
+	int error_counter = 0;
+	uint64_t passed = 0;
+	struct lf_tsb bucket;
+	uint64_t ns_now = NS_IN_S;
+
+	/* 100 Gbit/s */
+	lf_tsb_init(&bucket, 12500000000, 12500000);
+
+	/* first check fills the bucket */
+	(void)lf_tsb_check(&bucket, 0, ns_now);
+	lf_tsb_consume(&bucket, 12500000);
+
+	/* 64 byte packets for 1 ms (one packet every 4 ns) */
+	for (i = 0; i < 250000; i++) {
+		ns_now += 4;
+		if (lf_tsb_check(&bucket, 64, ns_now) == 0) {
+			lf_tsb_consume(&bucket, 64);
+			passed += 64;
+		}
+	}
+
+	if (passed < 12500000 - 64 || passed > 12500000 + 12500) {
+		printf("Error: 1 tsb high rate check failed (%" PRIu64
+			   " bytes passed)\n",
+				passed);
+		error_counter++;
+	}
+
+	return error_counter;
+}
+
+/*
+ * The time needed for a large number of tokens, e.g., the bytes of a whole
+ * burst, saturates instead of overflowing.
+ */
+int
+test_lf_tsb_large_tokens()
+{
+	int error_counter = 0;
+	struct lf_tsb bucket;
+	struct lf_tsb_shared shared;
+	uint64_t ns_now = NS_IN_S;
+
+	/* 1 token per second, burst of 1000 tokens */
+	lf_tsb_init(&bucket, 1, 1000);
+	lf_tsb_shared_init(&shared, 1, 1000);
+
+	if (lf_tsb_check(&bucket, 1000, ns_now) != 0) {
+		printf("Error: 1 tsb large tokens check failed\n");
+		error_counter++;
+	}
+	if (lf_tsb_check(&bucket, UINT64_C(1) << 40, ns_now) == 0) {
+		printf("Error: 2 tsb large tokens check failed\n");
+		error_counter++;
+	}
+	if (lf_tsb_shared_check(&shared, UINT64_C(1) << 40, ns_now) == 0) {
+		printf("Error: 3 tsb large tokens check failed\n");
+		error_counter++;
+	}
+
+	return error_counter;
+}
+
+int
+test_lf_tsb_shared()
+{
+	int error_counter = 0;
+	uint64_t tokens;
+	struct lf_tsb_shared bucket;
+	uint64_t ns_now = NS_IN_S;
+
+	/* 1000 tokens per second, burst of 100 tokens */
+	lf_tsb_shared_init(&bucket, 1000, 100);
+
+	/* a new bucket is full */
+	if (lf_tsb_shared_check(&bucket, 100, ns_now) != 0) {
+		printf("Error: 1 tsb shared check failed\n");
+		error_counter++;
+	}
+	if (lf_tsb_shared_check(&bucket, 101, ns_now) == 0) {
+		printf("Error: 2 tsb shared check failed\n");
+		error_counter++;
+	}
+
+	/* the check does not consume tokens */
+	if (lf_tsb_shared_check(&bucket, 100, ns_now) != 0) {
+		printf("Error: 3 tsb shared check failed\n");
+		error_counter++;
+	}
+
+	lf_tsb_shared_consume(&bucket, 60, ns_now);
+	if (lf_tsb_shared_check(&bucket, 41, ns_now) == 0) {
+		printf("Error: 4 tsb shared check failed\n");
+		error_counter++;
+	}
+
+	/* take at most 30 of the remaining 40 tokens */
+	tokens = lf_tsb_shared_take(&bucket, 1, 30, ns_now);
+	if (tokens != 30) {
+		printf("Error: 5 tsb shared take failed (%" PRIu64 " tokens)\n",
+				tokens);
+		error_counter++;
+	}
+
+	/* take the remaining tokens (up to rounding) */
+	tokens = lf_tsb_shared_take(&bucket, 1, 1000, ns_now);
+	if (tokens < 9 || tokens > 10) {
+		printf("Error: 6 tsb shared take failed (%" PRIu64 " tokens)\n",
+				tokens);
+		error_counter++;
+	}
+	if (lf_tsb_shared_take(&bucket, 2, 1000, ns_now) != 0) {
+		printf("Error: 7 tsb shared take failed\n");
+		error_counter++;
+	}
+
+	/* consuming unchecked tokens results in a debt, which is paid back */
+	lf_tsb_shared_consume(&bucket, 10, ns_now);
+	ns_now += NS_IN_S / 100;
+	if (lf_tsb_shared_check(&bucket, 1, ns_now) == 0) {
+		printf("Error: 8 tsb shared check failed\n");
+		error_counter++;
+	}
+	ns_now += NS_IN_S / 100;
+	if (lf_tsb_shared_check(&bucket, 9, ns_now) != 0) {
+		printf("Error: 9 tsb shared check failed\n");
+		error_counter++;
+	}
+
+	/* the burst size limits the tokens after a long idle time */
+	ns_now += 10 * NS_IN_S;
+	tokens = lf_tsb_shared_take(&bucket, 1, 1000, ns_now);
+	if (tokens < 99 || tokens > 100) {
+		printf("Error: 10 tsb shared take failed (%" PRIu64 " tokens)\n",
+				tokens);
+		error_counter++;
+	}
+
+	/* rate limit 0 */
+	lf_tsb_shared_set(&bucket, 0, 0);
+	ns_now += 10 * NS_IN_S;
+	if (lf_tsb_shared_check(&bucket, 1, ns_now) == 0 ||
+			lf_tsb_shared_take(&bucket, 1, 1, ns_now) != 0) {
+		printf("Error: 11 tsb shared check failed\n");
+		error_counter++;
+	}
+
+	return error_counter;
+}
+
+int
+main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	int error_counter = 0;
+
+	error_counter += test_lf_tsb_ratelimit();
+	error_counter += test_lf_tsb_high_rate();
+	error_counter += test_lf_tsb_large_tokens();
+	error_counter += test_lf_tsb_shared();
+
+	if (error_counter > 0) {
+		printf("Error Count: %d\n", error_counter);
+		return 1;
+	}
+
+	printf("All tests passed!\n");
+	return 0;
+}
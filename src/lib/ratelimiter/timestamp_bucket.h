@@ -9,263 +9,351 @@
 #include <stdint.h>
 
 /**
- * Ratelimiter struct for the timestamp based token algorithm.
+ * Timestamp based token bucket.
  *
+ * Instead of the number of tokens, the bucket stores a timestamp. The tokens
+ * available correspond to the time between the bucket's timestamp and the
+ * current time, limited by the time required to collect burst tokens.
+ * Consuming tokens advances the bucket's timestamp by the time required to
+ * collect them. Hence, checking and consuming tokens requires neither a
+ * division nor a multiplication with the elapsed time.
  *
+ * The timestamp is a fixed-point number of nanoseconds with LF_TSB_FRAC_BITS
+ * fractional bits, such that sub-nanosecond token times (high byte rates) are
+ * accumulated precisely. The timestamp wraps around every
+ * 2^(64 - LF_TSB_FRAC_BITS) nanoseconds, which is handled by comparing
+ * differences only, as long as a bucket is not idle for more than half of this
+ * period (about a year). The time per token and the burst time are only used as
+ * factor and bound. Therefore, they are stored as single precision floats,
+ * such that the bucket only requires 16 bytes.
  */
+#define LF_TSB_FRAC_BITS 8
+/* Limits of the time per token and burst time (fixed-point) */
+#define LF_TSB_MAX_TIME_PER_TOKEN ((float)(UINT64_C(1) << 40))
+#define LF_TSB_MAX_BURST_TIME     ((float)(UINT64_C(1) << 55))
+/* Saturation of the time needed for a number of tokens (fixed-point) */
+#define LF_TSB_MAX_TIME_NEEDED ((float)(UINT64_C(1) << 62))
+
 struct lf_tsb {
-	int64_t time;
+	uint64_t time; /* fixed-point nanoseconds */
 
-	/**
-	 * Time required to obtain new token.
-	 * 0 if no rate limit is applied.
-	 * -1 if the rate limit is 0.
-	 */
-	int64_t time_per_token;
-	int64_t burst_time;
+	_Atomic(float) time_per_token; /* fixed-point nanoseconds */
+	_Atomic(float) burst_time;     /* fixed-point nanoseconds */
 };
 
-static inline int
-lf_tsb_init(struct lf_tsb *bucket, int64_t time_per_token, int64_t burst_size)
+/**
+ * Set the rate and burst size of the timestamp bucket.
+ * IMPORTANT: To set the rate limit to 0, the rate and burst size must be set to
+ * 0! Otherwise, the tokens are still refilled very slowly.
+ *
+ * @param rate Token rate in token/s
+ * @param burst Maximum size of burst token
+ */
+static inline void
+lf_tsb_set(struct lf_tsb *bucket, uint64_t rate, uint64_t burst)
 {
-	if (time_per_token < -1 || burst_size < 0) {
-		return -1;
+	double time_per_token, burst_time;
+
+	if (rate == 0) {
+		time_per_token = LF_TSB_MAX_TIME_PER_TOKEN;
+	} else {
+		time_per_token = 1e9 * (double)(UINT64_C(1) << LF_TSB_FRAC_BITS) /
+		                 (double)rate;
+		if (time_per_token > LF_TSB_MAX_TIME_PER_TOKEN) {
+			time_per_token = LF_TSB_MAX_TIME_PER_TOKEN;
+		}
+	}
+	burst_time = (double)burst * time_per_token;
+	if (burst_time > LF_TSB_MAX_BURST_TIME) {
+		burst_time = LF_TSB_MAX_BURST_TIME;
 	}
 
-	bucket->time = INT64_MIN;
-	bucket->time_per_token = time_per_token;
-	bucket->burst_time = burst_size * time_per_token;
-	return 0;
+	atomic_store_explicit(&bucket->time_per_token, (float)time_per_token,
+			memory_order_relaxed);
+	atomic_store_explicit(&bucket->burst_time, (float)burst_time,
+			memory_order_relaxed);
 }
 
-static inline int
-lf_tsb_set(struct lf_tsb *bucket, int64_t time_per_token, int64_t burst_size)
+/**
+ * Initiate the timestamp bucket structure.
+ * The bucket is filled (burst tokens) when it is checked the first time.
+ *
+ * @param rate Token rate in token/s
+ * @param burst Maximum size of burst token
+ */
+static inline void
+lf_tsb_init(struct lf_tsb *bucket, uint64_t rate, uint64_t burst)
 {
-	if (time_per_token < -1 || burst_size < 0) {
-		return -1;
-	}
-	bucket->time_per_token = time_per_token;
-	bucket->burst_time = burst_size * time_per_token;
-	return 0;
+	bucket->time = 0;
+	lf_tsb_set(bucket, rate, burst);
 }
 
-static inline int
-lf_tsb_check(const struct lf_tsb *bucket, int64_t tokens, int64_t time_now)
+/**
+ * Time required to collect the tokens with the given time per token
+ * (fixed-point). The number of tokens must be smaller than 2^63, e.g., the
+ * bytes of a whole burst of packets. The result saturates at
+ * LF_TSB_MAX_TIME_NEEDED, which exceeds the maximum burst time, such that a
+ * check for too many tokens fails instead of overflowing.
+ */
+static inline uint64_t
+lf_tsb_tokens_to_time(float time_per_token, uint64_t tokens)
 {
-	/* rate limit is 0 */
-	if (bucket->time_per_token == -1) {
-		return -1;
-	}
+	/* the signed conversion is a single instruction */
+	float time = (float)(int64_t)tokens * time_per_token;
 
-	/* no rate limit */
-	if (bucket->time_per_token == 0) {
-		return 0;
+	if (time > LF_TSB_MAX_TIME_NEEDED) {
+		time = LF_TSB_MAX_TIME_NEEDED;
 	}
+	return (uint64_t)(int64_t)time;
+}
 
-	if (tokens <= 0) {
-		return 0;
-	}
-
-	const int64_t time_per_token = bucket->time_per_token;
-	const int64_t burst_time = bucket->burst_time;
-
-	/* the time required to collect the requested amount of tokens */
-	const int64_t time_needed = tokens * time_per_token;
+/**
+ * Time required to collect the tokens (fixed-point).
+ * See lf_tsb_tokens_to_time() for the limits.
+ */
+static inline uint64_t
+lf_tsb_time_needed(const struct lf_tsb *bucket, uint64_t tokens)
+{
+	return lf_tsb_tokens_to_time(
+			atomic_load_explicit(&bucket->time_per_token, memory_order_relaxed),
+			tokens);
+}
 
-	const int64_t time_min = time_now - burst_time;
+/**
+ * Check if enough tokens are available. Same semantic as
+ * lf_token_bucket_check().
+ *
+ * @return 0 if enough tokens are available, otherwise -1.
+ */
+static inline int
+lf_tsb_check(struct lf_tsb *bucket, uint64_t tokens, uint64_t ns_now)
+{
+	const uint64_t time_now = ns_now << LF_TSB_FRAC_BITS;
+	const int64_t burst_time = (int64_t)atomic_load_explicit(
+			&bucket->burst_time, memory_order_relaxed);
 
-	/* time = max(time_min, bucket->time) */
-	int64_t time = bucket->time;
-	if (time_min > time) {
-		time = time_min;
+	/*
+	 * Limit the available time to the burst time. The difference is signed,
+	 * because the timestamp can be slightly ahead of the current time if the
+	 * time per token has been increased between check and consume. A
+	 * timestamp of 0 indicates a new bucket.
+	 */
+	if (bucket->time == 0 ||
+			(int64_t)(time_now - bucket->time) > burst_time) {
+		bucket->time = time_now - (uint64_t)burst_time;
 	}
 
-	if (time + time_needed > time_now) {
-		/* not enough tokens */
+	if ((int64_t)(time_now - bucket->time) <
+			(int64_t)lf_tsb_time_needed(bucket, tokens)) {
 		return -1;
 	}
-
-	return time_needed;
+	return 0;
 }
 
-static inline int
-lf_tsb_consume(struct lf_tsb *bucket, const int64_t time_needed,
-		int64_t time_now)
+/**
+ * Consume tokens, which must have been checked with lf_tsb_check().
+ */
+static inline void
+lf_tsb_consume(struct lf_tsb *bucket, uint64_t tokens)
 {
-	const int64_t burst_time = bucket->burst_time;
-	const int64_t time_min = time_now - burst_time;
+	bucket->time += lf_tsb_time_needed(bucket, tokens);
+}
 
-	/* time = max(time_min, bucket->time) */
-	int64_t time = bucket->time;
-	if (time_min > time) {
-		time = time_min;
-	}
+/**
+ * Add tokens to the bucket. The tokens are discarded by the next check if
+ * they exceed the burst size.
+ */
+static inline void
+lf_tsb_add(struct lf_tsb *bucket, uint64_t tokens)
+{
+	bucket->time -= lf_tsb_time_needed(bucket, tokens);
+}
 
-	bucket->time = time + time_needed;
+struct lf_tsb_ratelimit {
+	struct lf_tsb packet;
+	struct lf_tsb byte;
+};
 
-	/*
-	 * Inform that the limit has been succeeded.
-	 */
-	if (bucket->time > time_now) {
-		return 1;
-	}
+static inline void
+lf_tsb_ratelimit_init(struct lf_tsb_ratelimit *rl, uint64_t packets_rate,
+		uint64_t packets_burst, uint64_t bytes_rate, uint64_t bytes_burst)
+{
+	lf_tsb_init(&rl->packet, packets_rate, packets_burst);
+	lf_tsb_init(&rl->byte, bytes_rate, bytes_burst);
+}
 
-	return 0;
+static inline void
+lf_tsb_ratelimit_set(struct lf_tsb_ratelimit *rl, uint64_t packets_rate,
+		uint64_t packets_burst, uint64_t bytes_rate, uint64_t bytes_burst)
+{
+	lf_tsb_set(&rl->packet, packets_rate, packets_burst);
+	lf_tsb_set(&rl->byte, bytes_rate, bytes_burst);
 }
 
 static inline int
-lf_tsb_apply(struct lf_tsb *bucket, const int64_t tokens, int64_t time_now)
+lf_tsb_ratelimit_apply(struct lf_tsb_ratelimit *rl, uint64_t packets,
+		uint64_t bytes, uint64_t ns_now)
 {
-	int64_t time_needed;
-	time_needed = lf_tsb_check(bucket, tokens, time_now);
-	if (time_needed < 0) {
+	if (lf_tsb_check(&rl->packet, packets, ns_now) != 0) {
 		return -1;
 	}
-	return lf_tsb_consume(bucket, time_needed, time_now);
+	if (lf_tsb_check(&rl->byte, bytes, ns_now) != 0) {
+		return -2;
+	}
+
+	lf_tsb_consume(&rl->packet, packets);
+	lf_tsb_consume(&rl->byte, bytes);
+	return 0;
 }
 
 
-/********************************************************
+/**
+ * Shared timestamp bucket.
  *
- * A lock-free implementation of the token bucket using atomics.
- * (fstreun) ATTENTION!
- * If the bucket's time is far in the past, it first has to be set to the
- * time_now - burst_time before adding time_needed. If two threads are
- * performing this operation in one atomic operation, the addition might
- * overshoot way too much.
+ * Lock-free variant of the timestamp bucket, which can be used by multiple
+ * threads concurrently. The timestamp is updated with a compare-and-swap, such
+ * that the timestamp is raised to the burst limit and advanced by the consumed
+ * tokens in one atomic operation. (Adding the time needed with a single atomic
+ * addition would apply the burst limit twice if multiple threads raise the
+ * timestamp concurrently.)
  *
- ********************************************************/
-
+ * Checking and consuming tokens are separate operations. Hence, another thread
+ * might consume the tokens in between, and the timestamp of the bucket moves
+ * slightly ahead of the current time. The following checks fail until the
+ * current time has caught up, i.e., the overshoot is paid back.
+ */
 struct lf_tsb_shared {
-	_Atomic(int64_t) time; /* some time unit */
+	_Atomic(uint64_t) time; /* fixed-point nanoseconds */
 
-	_Atomic(int64_t) time_per_token; /* tokens per time unit */
-	_Atomic(int64_t) burst_time;     /* time unit */
+	_Atomic(float) time_per_token; /* fixed-point nanoseconds */
+	_Atomic(float) burst_time;     /* fixed-point nanoseconds */
 };
 
-static inline int
-lf_tsb_shared_init(struct lf_tsb_shared *bucket, int64_t time_per_token,
-		int64_t burst_size)
+/**
+ * Set the rate and burst size of the shared timestamp bucket. Same semantic as
+ * lf_tsb_set().
+ */
+static inline void
+lf_tsb_shared_set(struct lf_tsb_shared *bucket, uint64_t rate, uint64_t burst)
 {
-	if (time_per_token < -1 || burst_size < 0) {
-		return -1;
-	}
-
-	atomic_store(&bucket->time, INT64_MIN);
+	struct lf_tsb tmp;
 
-	atomic_store(&bucket->time_per_token, time_per_token);
-	atomic_store(&bucket->burst_time, burst_size * time_per_token);
-
-	return 0;
-}
-
-static inline int
-lf_tsb_shared_set(struct lf_tsb_shared *bucket, int64_t time_per_token,
-		int64_t burst_size)
-{
-	if (time_per_token < -1 || burst_size < 0) {
-		return -1;
-	}
-
-	atomic_store_explicit(&bucket->time_per_token, time_per_token,
+	lf_tsb_set(&tmp, rate, burst);
+	atomic_store_explicit(&bucket->time_per_token,
+			atomic_load_explicit(&tmp.time_per_token, memory_order_relaxed),
 			memory_order_relaxed);
-	atomic_store_explicit(&bucket->burst_time, burst_size * time_per_token,
+	atomic_store_explicit(&bucket->burst_time,
+			atomic_load_explicit(&tmp.burst_time, memory_order_relaxed),
 			memory_order_relaxed);
-
-	return 0;
 }
 
-static inline int
-lf_tsb_shared_check(const struct lf_tsb_shared *bucket, const int64_t tokens,
-		int64_t time_now)
+static inline void
+lf_tsb_shared_init(struct lf_tsb_shared *bucket, uint64_t rate,
+		uint64_t burst)
 {
-	const int64_t time_per_token =
-			atomic_load_explicit(&bucket->time_per_token, memory_order_relaxed);
-
-	const int64_t burst_time =
-			atomic_load_explicit(&bucket->burst_time, memory_order_relaxed);
+	atomic_store_explicit(&bucket->time, 0, memory_order_relaxed);
+	lf_tsb_shared_set(bucket, rate, burst);
+}
 
-	/* rate limit is 0 */
-	if (time_per_token == -1) {
-		return -1;
-	}
+static inline uint64_t
+lf_tsb_shared_time_needed(const struct lf_tsb_shared *bucket, uint64_t tokens)
+{
+	return lf_tsb_tokens_to_time(
+			atomic_load_explicit(&bucket->time_per_token, memory_order_relaxed),
+			tokens);
+}
 
-	/* no rate limit */
-	if (time_per_token == 0) {
-		return 0;
-	}
+/**
+ * The bucket's timestamp limited by the burst time, i.e., the time from which
+ * on tokens are available.
+ */
+static inline uint64_t
+lf_tsb_shared_start(const struct lf_tsb_shared *bucket, uint64_t time,
+		uint64_t time_now)
+{
+	const int64_t burst_time = (int64_t)atomic_load_explicit(
+			&bucket->burst_time, memory_order_relaxed);
 
-	if (tokens <= 0) {
-		return 0;
+	if (time == 0 || (int64_t)(time_now - time) > burst_time) {
+		return time_now - (uint64_t)burst_time;
 	}
+	return time;
+}
 
-	/* the time required to collect the requested amount of tokens */
-	const int64_t time_needed = tokens * time_per_token;
-
-	const int64_t time_min = time_now - burst_time;
-
-	/* time = max(time_min, bucket->time) */
-	int64_t time = atomic_load_explicit(&bucket->time, memory_order_relaxed);
-	if (time_min > time) {
-		time = time_min;
-	}
+/**
+ * Check if enough tokens are available without consuming them.
+ *
+ * @return 0 if enough tokens are available, otherwise -1.
+ */
+static inline int
+lf_tsb_shared_check(const struct lf_tsb_shared *bucket, uint64_t tokens,
+		uint64_t ns_now)
+{
+	const uint64_t time_now = ns_now << LF_TSB_FRAC_BITS;
+	const uint64_t start = lf_tsb_shared_start(bucket,
+			atomic_load_explicit(&bucket->time, memory_order_relaxed),
+			time_now);
 
-	if (time + time_needed > time_now) {
-		/* not enough tockens */
+	if ((int64_t)(time_now - start) <
+			(int64_t)lf_tsb_shared_time_needed(bucket, tokens)) {
 		return -1;
 	}
-
-	return time_needed;
+	return 0;
 }
 
-static inline int
-lf_tsb_shared_consume(struct lf_tsb_shared *bucket, const int64_t time_needed,
-		int64_t time_now)
+/**
+ * Consume tokens, which should have been checked with lf_tsb_shared_check().
+ */
+static inline void
+lf_tsb_shared_consume(struct lf_tsb_shared *bucket, uint64_t tokens,
+		uint64_t ns_now)
 {
-	const int64_t burst_time =
-			atomic_load_explicit(&bucket->burst_time, memory_order_relaxed);
-	const int64_t time_min = time_now - burst_time;
-
-	/* time = max(time_min, bucket->time) */
-	int64_t time = atomic_load_explicit(&bucket->time, memory_order_relaxed);
-	if (time_min > time) {
-		time = time_min;
-	}
+	const uint64_t time_now = ns_now << LF_TSB_FRAC_BITS;
+	const uint64_t time_needed = lf_tsb_shared_time_needed(bucket, tokens);
+	uint64_t time = atomic_load_explicit(&bucket->time, memory_order_relaxed);
 
-	int64_t actual_time = atomic_fetch_add_explicit(&bucket->time,
-			time + time_needed, memory_order_relaxed);
-
-
-	/*
-	 * Inform that the limit has been succeeded.
-	 */
-	if (actual_time + time_needed > time_now) {
-		return 1;
+	while (!atomic_compare_exchange_weak_explicit(&bucket->time, &time,
+			lf_tsb_shared_start(bucket, time, time_now) + time_needed,
+			memory_order_relaxed, memory_order_relaxed)) {
 	}
-
-	return 0;
 }
 
-static inline int
-lf_tsb_shared_apply(struct lf_tsb_shared *bucket, const int64_t tokens,
-		int64_t time_now)
+/**
+ * Take at least min_tokens and at most max_tokens from the bucket, e.g., to
+ * cache them locally.
+ *
+ * @return Number of tokens taken. 0 if less than min_tokens are available.
+ */
+static inline uint64_t
+lf_tsb_shared_take(struct lf_tsb_shared *bucket, uint64_t min_tokens,
+		uint64_t max_tokens, uint64_t ns_now)
 {
-	int64_t time_needed;
-	time_needed = lf_tsb_shared_check(bucket, tokens, time_now);
-	if (time_needed < 0) {
-		return -1;
-	}
-	/*
-	 * We accept a race condition here!
-	 * The bucket->time value might has changed between the previous if clause
-	 * and the following addition.
-	 * Therefore, bucket->time + time_needed can become bigger than time_now,
-	 * i.e., be in the future. If this happens, there are two possible
-	 * reactions.
-	 * 1. Accept it and allow that the burst rate has been exceeded temporarily.
-	 * 2. Decline it and loose some tokens.
-	 */
-	return lf_tsb_shared_consume(bucket, time_needed, time_now);
+	const uint64_t time_now = ns_now << LF_TSB_FRAC_BITS;
+	const float time_per_token =
+			atomic_load_explicit(&bucket->time_per_token, memory_order_relaxed);
+	uint64_t time, start, tokens;
+	int64_t time_available;
+
+	time = atomic_load_explicit(&bucket->time, memory_order_relaxed);
+	do {
+		start = lf_tsb_shared_start(bucket, time, time_now);
+		time_available = (int64_t)(time_now - start);
+		if (time_available < (int64_t)lf_tsb_shared_time_needed(bucket,
+									 min_tokens)) {
+			return 0;
+		}
+		tokens = (uint64_t)((float)time_available / time_per_token);
+		if (tokens > max_tokens) {
+			tokens = max_tokens;
+		} else if (tokens < min_tokens) {
+			/* rounding */
+			tokens = min_tokens;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&bucket->time, &time,
+			start + lf_tsb_shared_time_needed(bucket, tokens),
+			memory_order_relaxed, memory_order_relaxed));
+
+	return tokens;
 }
 
 #endif /* LF_TIMESTAMP_BUCKET_H */
\ No newline at end of file
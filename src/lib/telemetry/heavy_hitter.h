@@ -0,0 +1,278 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_TELEMETRY_HEAVY_HITTER_H
+#define LF_TELEMETRY_HEAVY_HITTER_H
+
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * Heavy hitter detection with constant memory and constant update cost.
+ *
+ * A count-min sketch estimates the number of packets of every key, and a small
+ * space-saving list holds the candidates with the largest estimates. A key
+ * that is not yet in the candidate list replaces the candidate with the
+ * smallest estimate as soon as its own sketch estimate exceeds it. The packets
+ * seen before the key has been admitted are only known through the sketch and
+ * are recorded as the entry's error, i.e., pkts + error is an upper bound of
+ * the key's actual packet count, while pkts, bytes, and drop_pkts are exact
+ * since admission.
+ *
+ * The structure is not thread-safe and is intended to be used per worker (see
+ * statistics).
+ */
+
+/* Number of rows (independent hash functions) of the count-min sketch. */
+#define LF_HEAVY_HITTER_ROWS 4
+/* Number of counters per row (must be a power of 2 and at most 2^16). */
+#define LF_HEAVY_HITTER_COLS 512
+/* Number of heavy hitter candidates. */
+#define LF_HEAVY_HITTER_TOP 16
+
+struct lf_heavy_hitter_entry {
+	uint64_t key;
+	uint64_t pkts;
+	uint64_t bytes;
+	uint64_t drop_pkts;
+	/* packets possibly counted for the key before its admission */
+	uint64_t error;
+};
+
+struct lf_heavy_hitter {
+	uint32_t sketch[LF_HEAVY_HITTER_ROWS][LF_HEAVY_HITTER_COLS];
+	struct lf_heavy_hitter_entry top[LF_HEAVY_HITTER_TOP];
+	uint16_t nb_entries;
+	/* index of the candidate with the smallest estimate */
+	uint16_t min_index;
+};
+
+/**
+ * Hash function for the sketch (finalizer of splitmix64). Each row uses a
+ * different 16 bit part of the hash as column index.
+ */
+static inline uint64_t
+lf_heavy_hitter_hash(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= UINT64_C(0xbf58476d1ce4e5b9);
+	key ^= key >> 27;
+	key *= UINT64_C(0x94d049bb133111eb);
+	key ^= key >> 31;
+	return key;
+}
+
+#define lf_heavy_hitter_col(hash, row) \
+	(((hash) >> (16 * (row))) & (LF_HEAVY_HITTER_COLS - 1))
+
+static inline uint64_t
+lf_heavy_hitter_entry_estimate(const struct lf_heavy_hitter_entry *entry)
+{
+	return entry->pkts + entry->error;
+}
+
+static inline void
+lf_heavy_hitter_reset(struct lf_heavy_hitter *hh)
+{
+	memset(hh, 0, sizeof(*hh));
+}
+
+static inline void
+lf_heavy_hitter_update_min(struct lf_heavy_hitter *hh)
+{
+	uint16_t i;
+	uint16_t min_index = 0;
+
+	for (i = 1; i < hh->nb_entries; i++) {
+		if (lf_heavy_hitter_entry_estimate(&hh->top[i]) <
+				lf_heavy_hitter_entry_estimate(&hh->top[min_index])) {
+			min_index = i;
+		}
+	}
+	hh->min_index = min_index;
+}
+
+/**
+ * Find the candidate entry of a key.
+ * @return Index of the entry, or -1 if the key is not a candidate.
+ */
+static inline int
+lf_heavy_hitter_find(const struct lf_heavy_hitter *hh, uint64_t key)
+{
+	int i;
+
+	for (i = 0; i < hh->nb_entries; i++) {
+		if (hh->top[i].key == key) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Get the sketch's estimate of the number of packets of a key.
+ */
+static inline uint64_t
+lf_heavy_hitter_estimate(const struct lf_heavy_hitter *hh, uint64_t key)
+{
+	int row;
+	uint32_t min = UINT32_MAX;
+	uint64_t hash = lf_heavy_hitter_hash(key);
+
+	for (row = 0; row < LF_HEAVY_HITTER_ROWS; row++) {
+		if (hh->sketch[row][lf_heavy_hitter_col(hash, row)] < min) {
+			min = hh->sketch[row][lf_heavy_hitter_col(hash, row)];
+		}
+	}
+	return min;
+}
+
+/**
+ * Admit the key as candidate if there is space left or if its estimate exceeds
+ * the smallest candidate's estimate.
+ *
+ * @param estimate Estimate of the packets of the key, including the packets of
+ * the entry.
+ * @return Index of the new entry, or -1 if the key has not been admitted.
+ */
+static inline int
+lf_heavy_hitter_admit(struct lf_heavy_hitter *hh, uint64_t key,
+		uint64_t estimate, const struct lf_heavy_hitter_entry *entry)
+{
+	int index;
+
+	if (hh->nb_entries < LF_HEAVY_HITTER_TOP) {
+		index = hh->nb_entries++;
+	} else if (estimate >
+			   lf_heavy_hitter_entry_estimate(&hh->top[hh->min_index])) {
+		index = hh->min_index;
+	} else {
+		return -1;
+	}
+
+	hh->top[index] = *entry;
+	hh->top[index].key = key;
+	hh->top[index].error = estimate - entry->pkts;
+	return index;
+}
+
+/**
+ * Account a packet to the key.
+ *
+ * @param key Key, e.g., the source AS.
+ * @param pkt_len Packet length in bytes.
+ * @param drop True if the packet is dropped.
+ */
+static inline void
+lf_heavy_hitter_add(struct lf_heavy_hitter *hh, uint64_t key,
+		uint32_t pkt_len, int drop)
+{
+	int row, index;
+	uint32_t *counter;
+	uint32_t min = UINT32_MAX;
+	uint64_t hash = lf_heavy_hitter_hash(key);
+	struct lf_heavy_hitter_entry *entry;
+
+	for (row = 0; row < LF_HEAVY_HITTER_ROWS; row++) {
+		counter = &hh->sketch[row][lf_heavy_hitter_col(hash, row)];
+		if (*counter != UINT32_MAX) {
+			(*counter)++;
+		}
+		if (*counter < min) {
+			min = *counter;
+		}
+	}
+
+	index = lf_heavy_hitter_find(hh, key);
+	if (index < 0) {
+		index = lf_heavy_hitter_admit(hh, key, min,
+				&(struct lf_heavy_hitter_entry){ .pkts = 1,
+						.bytes = pkt_len,
+						.drop_pkts = drop ? 1 : 0 });
+		if (index >= 0) {
+			lf_heavy_hitter_update_min(hh);
+		}
+		return;
+	}
+
+	entry = &hh->top[index];
+	entry->pkts++;
+	entry->bytes += pkt_len;
+	entry->drop_pkts += drop ? 1 : 0;
+	if (index == hh->min_index) {
+		lf_heavy_hitter_update_min(hh);
+	}
+}
+
+/**
+ * Merge the sketch and candidates of src into dst. Candidates of the same key
+ * are summed. Since a key might not be a candidate in all merged structures,
+ * the merged counters are lower bounds of the sum of the keys' counters.
+ */
+static inline void
+lf_heavy_hitter_merge(struct lf_heavy_hitter *dst,
+		const struct lf_heavy_hitter *src)
+{
+	int row, col, i, index;
+	uint32_t sum;
+	struct lf_heavy_hitter_entry *entry;
+
+	for (row = 0; row < LF_HEAVY_HITTER_ROWS; row++) {
+		for (col = 0; col < LF_HEAVY_HITTER_COLS; col++) {
+			sum = dst->sketch[row][col] + src->sketch[row][col];
+			dst->sketch[row][col] =
+					sum < dst->sketch[row][col] ? UINT32_MAX : sum;
+		}
+	}
+
+	for (i = 0; i < src->nb_entries; i++) {
+		index = lf_heavy_hitter_find(dst, src->top[i].key);
+		if (index < 0) {
+			(void)lf_heavy_hitter_admit(dst, src->top[i].key,
+					lf_heavy_hitter_entry_estimate(&src->top[i]),
+					&src->top[i]);
+		} else {
+			entry = &dst->top[index];
+			entry->pkts += src->top[i].pkts;
+			entry->bytes += src->top[i].bytes;
+			entry->drop_pkts += src->top[i].drop_pkts;
+			entry->error += src->top[i].error;
+		}
+		lf_heavy_hitter_update_min(dst);
+	}
+}
+
+/**
+ * Get the candidates sorted by their estimate (descending).
+ *
+ * @param top Returns up to n entries.
+ * @param n Maximum number of entries to be returned.
+ * @return Number of entries returned.
+ */
+static inline int
+lf_heavy_hitter_get_top(const struct lf_heavy_hitter *hh,
+		struct lf_heavy_hitter_entry *top, int n)
+{
+	int i, j;
+	struct lf_heavy_hitter_entry sorted[LF_HEAVY_HITTER_TOP];
+
+	for (i = 0; i < hh->nb_entries; i++) {
+		for (j = i; j > 0 && lf_heavy_hitter_entry_estimate(&sorted[j - 1]) <
+									 lf_heavy_hitter_entry_estimate(&hh->top[i]);
+				j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = hh->top[i];
+	}
+
+	if (n > hh->nb_entries) {
+		n = hh->nb_entries;
+	}
+	memcpy(top, sorted, n * sizeof(*top));
+	return n;
+}
+
+#undef lf_heavy_hitter_col
+
+#endif /* LF_TELEMETRY_HEAVY_HITTER_H */
@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "../heavy_hitter.h"
+
+/* Simple deterministic pseudo random number generator (xorshift). */
+static uint64_t
+next_rand(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+int
+test_exact()
+{
+	int i, n;
+	int error_counter = 0;
+	struct lf_heavy_hitter hh;
+	struct lf_heavy_hitter_entry top[LF_HEAVY_HITTER_TOP];
+
+	lf_heavy_hitter_reset(&hh);
+
+	/* less keys than candidates: all counters are exact */
+	for (i = 0; i < 100; i++) {
+		lf_heavy_hitter_add(&hh, 1, 100, 0);
+	}
+	for (i = 0; i < 50; i++) {
+		lf_heavy_hitter_add(&hh, 2, 10, i % 2);
+	}
+	lf_heavy_hitter_add(&hh, 3, 1, 1);
+
+	n = lf_heavy_hitter_get_top(&hh, top, LF_HEAVY_HITTER_TOP);
+	if (n != 3) {
+		printf("Error: expected 3 entries, got %d\n", n);
+		return 1;
+	}
+
+	if (top[0].key != 1 || top[0].pkts != 100 || top[0].bytes != 10000 ||
+			top[0].drop_pkts != 0 || top[0].error != 0) {
+		printf("Error: unexpected first entry\n");
+		error_counter++;
+	}
+	if (top[1].key != 2 || top[1].pkts != 50 || top[1].bytes != 500 ||
+			top[1].drop_pkts != 25) {
+		printf("Error: unexpected second entry\n");
+		error_counter++;
+	}
+	if (top[2].key != 3 || top[2].pkts != 1 || top[2].drop_pkts != 1) {
+		printf("Error: unexpected third entry\n");
+		error_counter++;
+	}
+
+	if (lf_heavy_hitter_estimate(&hh, 1) < 100) {
+		printf("Error: sketch underestimates key 1\n");
+		error_counter++;
+	}
+
+	n = lf_heavy_hitter_get_top(&hh, top, 1);
+	if (n != 1 || top[0].key != 1) {
+		printf("Error: expected only the first entry\n");
+		error_counter++;
+	}
+
+	return error_counter;
+}
+
+int
+test_heavy_hitters_in_noise()
+{
+	int i, j, n;
+	int error_counter = 0;
+	int found;
+	uint64_t rand_state = 42;
+	struct lf_heavy_hitter hh;
+	struct lf_heavy_hitter_entry top[LF_HEAVY_HITTER_TOP];
+
+	lf_heavy_hitter_reset(&hh);
+
+	/*
+	 * Four heavy hitters (keys 1 to 4) send 10% of the packets each, while
+	 * the rest is spread over many keys with a single packet each.
+	 */
+	for (i = 0; i < 100000; i++) {
+		if (i % 10 < 4) {
+			lf_heavy_hitter_add(&hh, i % 10 + 1, 100, 0);
+		} else {
+			lf_heavy_hitter_add(&hh, next_rand(&rand_state) | 0x100, 100, 1);
+		}
+	}
+
+	n = lf_heavy_hitter_get_top(&hh, top, 4);
+	if (n != 4) {
+		printf("Error: expected 4 entries, got %d\n", n);
+		return 1;
+	}
+
+	for (j = 1; j <= 4; j++) {
+		found = 0;
+		for (i = 0; i < n; i++) {
+			if (top[i].key == (uint64_t)j) {
+				found = 1;
+				if (top[i].pkts + top[i].error < 10000) {
+					printf("Error: heavy hitter %d underestimated\n", j);
+					error_counter++;
+				}
+			}
+		}
+		if (!found) {
+			printf("Error: heavy hitter %d not found\n", j);
+			error_counter++;
+		}
+	}
+
+	return error_counter;
+}
+
+int
+test_merge()
+{
+	int i, n;
+	int error_counter = 0;
+	struct lf_heavy_hitter a, b;
+	struct lf_heavy_hitter_entry top[LF_HEAVY_HITTER_TOP];
+
+	lf_heavy_hitter_reset(&a);
+	lf_heavy_hitter_reset(&b);
+
+	for (i = 0; i < 10; i++) {
+		lf_heavy_hitter_add(&a, 1, 1, 0);
+		lf_heavy_hitter_add(&b, 1, 1, 1);
+		lf_heavy_hitter_add(&b, 2, 1, 0);
+	}
+	lf_heavy_hitter_add(&b, 2, 1, 0);
+
+	lf_heavy_hitter_merge(&a, &b);
+
+	n = lf_heavy_hitter_get_top(&a, top, LF_HEAVY_HITTER_TOP);
+	if (n != 2) {
+		printf("Error: expected 2 merged entries, got %d\n", n);
+		return 1;
+	}
+	if (top[0].key != 1 || top[0].pkts != 20 || top[0].drop_pkts != 10) {
+		printf("Error: unexpected merged first entry\n");
+		error_counter++;
+	}
+	if (top[1].key != 2 || top[1].pkts != 11) {
+		printf("Error: unexpected merged second entry\n");
+		error_counter++;
+	}
+	if (lf_heavy_hitter_estimate(&a, 1) < 20) {
+		printf("Error: merged sketch underestimates key 1\n");
+		error_counter++;
+	}
+
+	return error_counter;
+}
+
+int
+main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	int error_counter = 0;
+
+	error_counter += test_exact();
+	error_counter += test_heavy_hitters_in_noise();
+	error_counter += test_merge();
+
+	if (error_counter > 0) {
+		printf("Error Count: %d\n", error_counter);
+		return 1;
+	}
+
+	printf("All tests passed!\n");
+	return 0;
+}
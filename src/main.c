@@ -22,12 +22,14 @@
 #include "config.h"
 #include "configmanager.h"
 #include "duplicate_filter.h"
+#include "egress.h"
 #include "keymanager.h"
 #include "lf.h"
 #include "lib/ipc/ipc.h"
 #include "lib/log/log.h"
 #include "lib/mirror/mirror.h"
 #include "lib/time/time.h"
+#include "overload.h"
 #include "params.h"
 #include "plugins/plugins.h"
 #include "ratelimiter.h"
@@ -54,7 +56,9 @@ static struct lf_configmanager configmanager;
 static struct lf_statistics statistics;
 static struct lf_keymanager keymanager;
 static struct lf_ratelimiter ratelimiter;
+static struct lf_overload overload;
 static struct lf_duplicate_filter duplicate_filter;
+static struct lf_egress egress;
 static struct lf_mirror mirror_ctx;
 
 /**
@@ -296,10 +300,11 @@ launch_lcores()
 int
 main(int argc, char **argv)
 {
-	int res;
+	int res, i;
 	uint16_t lcore_id, worker_id, worker_counter;
 	struct lf_params params;
 	struct lf_ratelimiter_worker *ratelimiter_workers[RTE_MAX_LCORE];
+	struct lf_overload_worker *overload_workers[RTE_MAX_LCORE];
 
 	/* Worker RCU QS Variable */
 	struct rte_rcu_qsbr *qsv;
@@ -356,6 +361,12 @@ main(int argc, char **argv)
 	if (res != 0) {
 		return -1;
 	}
+	if (params.be_drr) {
+		res = lf_egress_register_dynfield();
+		if (res != 0) {
+			return -1;
+		}
+	}
 
 	/*
 	 * Setup Ports and Queues
@@ -425,6 +436,8 @@ main(int argc, char **argv)
 	/*
 	 * Setup Crypto Context
 	 */
+	LF_LOG(INFO, "CBC-MAC implementation: %s\n",
+			lf_crypto_drkey_impl_str(lf_crypto_drkey_impl_detect()));
 	RTE_LCORE_FOREACH(lcore_id) {
 		if (!lf_worker_lcores[lcore_id]) {
 			continue;
@@ -434,6 +447,13 @@ main(int argc, char **argv)
 		if (res != 0) {
 			rte_exit(EXIT_FAILURE, "Init crypto hash context failed\n");
 		}
+		for (i = 0; i < LF_MAX_PKT_BURST; i++) {
+			res = lf_crypto_hash_ctx_init(
+					&worker_contexts[lcore_id].crypto_hash_burst_ctx[i]);
+			if (res != 0) {
+				rte_exit(EXIT_FAILURE, "Init crypto hash context failed\n");
+			}
+		}
 		res = lf_crypto_drkey_ctx_init(
 				&worker_contexts[lcore_id].crypto_drkey_ctx);
 		if (res != 0) {
@@ -445,10 +465,23 @@ main(int argc, char **argv)
 	 * Setup Key Manager
 	 */
 	LF_LOG(NOTICE, "Prepare Key Manager\n");
-	res = lf_keymanager_init(&keymanager, lf_nb_workers, params.km_size, qsv);
+	res = lf_keymanager_init(&keymanager, lf_worker_lcore_map, lf_nb_workers,
+			params.km_size, qsv);
 	if (res < 0) {
 		rte_exit(EXIT_FAILURE, "Unable to initiate keymanager\n");
 	}
+	if (params.km_on_demand) {
+		res = lf_keymanager_on_demand_init(&keymanager);
+		if (res != 0) {
+			rte_exit(EXIT_FAILURE, "Unable to enable on-demand key fetching\n");
+		}
+	}
+	if (params.km_cache_file[0] != '\0') {
+		res = lf_keymanager_cache_init(&keymanager, params.km_cache_file);
+		if (res != 0) {
+			LF_LOG(WARNING, "Unable to restore keys from key cache\n");
+		}
+	}
 	worker_id = 0;
 	RTE_LCORE_FOREACH(lcore_id) {
 		if (!lf_worker_lcores[lcore_id]) {
@@ -479,7 +512,8 @@ main(int argc, char **argv)
 		worker_id++;
 	}
 	res = lf_ratelimiter_init(&ratelimiter, lf_worker_lcore_map, lf_nb_workers,
-			params.rl_size, qsv, ratelimiter_workers);
+			params.rl_size, params.rl_redistribute, params.rl_cache, qsv,
+			ratelimiter_workers);
 	if (res < 0) {
 		rte_exit(EXIT_FAILURE, "Unable to initiate ratelimiter\n");
 	}
@@ -487,16 +521,92 @@ main(int argc, char **argv)
 	if (res != 0) {
 		rte_exit(EXIT_FAILURE, "Unable to register ratelimiter IPC\n");
 	}
+	res = lf_ratelimiter_register_telemetry(&ratelimiter);
+	if (res != 0) {
+		rte_exit(EXIT_FAILURE, "Unable to register ratelimiter telemetry\n");
+	}
+
+	/*
+	 * Setup Overload Control
+	 * The overload control samples the workers' receive queues and scales the
+	 * rate limits, hence, it is set up after the queues and the rate limiter.
+	 */
+	if (params.rl_overload) {
+		LF_LOG(NOTICE, "Prepare Overload Control\n");
+		worker_id = 0;
+		RTE_LCORE_FOREACH(lcore_id) {
+			if (!lf_worker_lcores[lcore_id]) {
+				continue;
+			}
+			overload_workers[worker_id] = &worker_contexts[lcore_id].overload;
+			worker_id++;
+		}
+		res = lf_overload_init(&overload, &ratelimiter, overload_workers,
+				lf_nb_workers);
+		if (res != 0) {
+			rte_exit(EXIT_FAILURE, "Unable to initiate overload control\n");
+		}
+		RTE_LCORE_FOREACH(lcore_id) {
+			if (!lf_worker_lcores[lcore_id]) {
+				continue;
+			}
+			for (i = 0; i < worker_contexts[lcore_id].max_rx_tx_index; ++i) {
+				(void)lf_overload_add_queue(&overload,
+						worker_contexts[lcore_id].rx_port_id[i],
+						worker_contexts[lcore_id].rx_queue_id[i]);
+			}
+		}
+		res = lf_overload_register_telemetry(&overload);
+		if (res != 0) {
+			rte_exit(EXIT_FAILURE,
+					"Unable to register overload control telemetry\n");
+		}
+	}
+
+	/*
+	 * Setup Egress Scheduler
+	 */
+	if (params.be_drr) {
+		LF_LOG(NOTICE, "Prepare Egress Scheduler\n");
+		res = lf_egress_init(&egress, lf_worker_lcore_map, lf_nb_workers);
+		if (res != 0) {
+			rte_exit(EXIT_FAILURE, "Unable to initiate egress scheduler\n");
+		}
+		res = lf_egress_register_telemetry(&egress);
+		if (res != 0) {
+			rte_exit(EXIT_FAILURE,
+					"Unable to register egress scheduler telemetry\n");
+		}
+	}
+	worker_id = 0;
+	RTE_LCORE_FOREACH(lcore_id) {
+		if (!lf_worker_lcores[lcore_id]) {
+			continue;
+		}
+		worker_contexts[lcore_id].egress =
+				params.be_drr ? egress.workers[worker_id] : NULL;
+		worker_id++;
+	}
 
 	/*
 	 * Setup Duplicate Filter
 	 */
 	res = lf_duplicate_filter_init(&duplicate_filter, lf_worker_lcore_map,
-			lf_nb_workers, params.bf_nb, params.bf_period * LF_TIME_NS_IN_MS,
+			lf_nb_workers,
+			params.df_cuckoo ? LF_DUPLICATE_FILTER_BACKEND_CUCKOO
+			                 : LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			params.bf_blocked ? LF_DUPLICATE_FILTER_MODE_BLOCKED
+			                  : LF_DUPLICATE_FILTER_MODE_STANDARD,
+			params.bf_shared, params.bf_nb, params.bf_period * LF_TIME_NS_IN_MS,
 			params.bf_hashes, params.bf_bytes, (unsigned int)rte_rand());
 	if (res < 0) {
 		rte_exit(EXIT_FAILURE, "Unable to initiate duplicate detection\n");
 	}
+	res = lf_duplicate_filter_register_telemetry(&duplicate_filter);
+	if (res != 0) {
+		rte_exit(EXIT_FAILURE,
+				"Unable to register duplicate filter telemetry\n");
+	}
 	worker_id = 0;
 	RTE_LCORE_FOREACH(lcore_id) {
 		if (!lf_worker_lcores[lcore_id]) {
@@ -515,6 +625,10 @@ main(int argc, char **argv)
 	if (res < 0) {
 		rte_exit(EXIT_FAILURE, "Unable to initiate statistics\n");
 	}
+	res = lf_statistics_register_ipc(&statistics);
+	if (res != 0) {
+		rte_exit(EXIT_FAILURE, "Unable to register statistics IPC\n");
+	}
 	worker_id = 0;
 	RTE_LCORE_FOREACH(lcore_id) {
 		if (!lf_worker_lcores[lcore_id]) {
@@ -573,6 +687,20 @@ main(int argc, char **argv)
 
 	LF_LOG(NOTICE, "Initialization completed\n");
 
+	/*
+	 * The main lcore runs the overload control service, which includes the
+	 * ratelimiter service, if enabled. Otherwise, it runs the ratelimiter
+	 * service if the rate limits are redistributed among the workers. The
+	 * services return when the force-quit flag is set.
+	 */
+	if (params.rl_overload) {
+		LF_LOG(NOTICE, "Launch Overload Control Service\n");
+		(void)lf_overload_service_launch(&overload);
+	} else if (params.rl_redistribute) {
+		LF_LOG(NOTICE, "Launch Ratelimiter Service\n");
+		(void)lf_ratelimiter_service_launch(&ratelimiter);
+	}
+
 	/*
 	 * Wait for termination
 	 * TODO: (fstreun) the main lcore currently waste a lot of cycles. Use the
@@ -599,6 +727,7 @@ main(int argc, char **argv)
 
 	lf_duplicate_filter_close(&duplicate_filter);
 	lf_ratelimiter_close(&ratelimiter);
+	lf_egress_close(&egress);
 	lf_keymanager_close(&keymanager);
 	lf_statistics_close(&statistics);
 
@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_spinlock.h>
+#include <rte_telemetry.h>
+
+#include "lf.h"
+#include "lib/log/log.h"
+#include "lib/time/time.h"
+#include "overload.h"
+#include "ratelimiter.h"
+
+/**
+ * Log function for overload control (not on data path).
+ * Format: "Overload: log message here"
+ */
+#define LF_OVERLOAD_LOG(level, ...) LF_LOG(level, "Overload: " __VA_ARGS__)
+
+static const char *const state_names[] = {
+	[LF_OVERLOAD_STATE_NORMAL] = "normal",
+	[LF_OVERLOAD_STATE_BEST_EFFORT] = "best_effort",
+	[LF_OVERLOAD_STATE_AUTH_PEERS] = "auth_peers",
+};
+
+int
+lf_overload_init(struct lf_overload *ov, struct lf_ratelimiter *rl,
+		struct lf_overload_worker *workers[LF_MAX_WORKER],
+		uint16_t nb_workers)
+{
+	uint16_t worker_id;
+
+	LF_OVERLOAD_LOG(DEBUG, "Init\n");
+
+	ov->rl = rl;
+	ov->nb_workers = nb_workers;
+	for (worker_id = 0; worker_id < nb_workers; ++worker_id) {
+		atomic_store_explicit(&workers[worker_id]->busy_cycles, 0,
+				memory_order_relaxed);
+		ov->workers[worker_id] = workers[worker_id];
+		ov->last_busy_cycles[worker_id] = 0;
+	}
+	ov->last_tsc = rte_rdtsc();
+	ov->nb_queues = 0;
+
+	rte_spinlock_init(&ov->lock);
+	ov->state = LF_OVERLOAD_STATE_NORMAL;
+	ov->best_effort_scale = LF_RATELIMITER_SCALE_ONE;
+	ov->auth_peers_scale = LF_RATELIMITER_SCALE_ONE;
+	ov->occupancy = 0;
+	ov->busy = 0;
+	ov->nb_overloaded = 0;
+	ov->nb_tightened = 0;
+	ov->nb_relaxed = 0;
+
+	return lf_ratelimiter_set_scale(rl, ov->best_effort_scale,
+			ov->auth_peers_scale);
+}
+
+int
+lf_overload_add_queue(struct lf_overload *ov, uint16_t port_id,
+		uint16_t queue_id)
+{
+	struct rte_eth_rxq_info qinfo;
+
+	if (ov->nb_queues >= LF_OVERLOAD_MAX_QUEUES) {
+		LF_OVERLOAD_LOG(ERR, "Too many receive queues.\n");
+		return -1;
+	}
+
+	if (rte_eth_rx_queue_info_get(port_id, queue_id, &qinfo) != 0 ||
+			qinfo.nb_desc == 0 ||
+			rte_eth_rx_queue_count(port_id, queue_id) < 0) {
+		LF_OVERLOAD_LOG(WARNING,
+				"Receive queue %u of port %u does not report its "
+				"occupancy.\n",
+				queue_id, port_id);
+		return -1;
+	}
+
+	ov->queues[ov->nb_queues].port_id = port_id;
+	ov->queues[ov->nb_queues].queue_id = queue_id;
+	ov->queues[ov->nb_queues].nb_desc = qinfo.nb_desc;
+	ov->nb_queues++;
+
+	return 0;
+}
+
+static inline uint32_t
+halve_scale(uint32_t scale)
+{
+	return RTE_MAX(scale / 2, (uint32_t)LF_OVERLOAD_MIN_SCALE);
+}
+
+static inline uint32_t
+relax_scale(uint32_t scale)
+{
+	return RTE_MIN(scale + LF_OVERLOAD_RELAX_STEP,
+			(uint32_t)LF_RATELIMITER_SCALE_ONE);
+}
+
+void
+lf_overload_update(struct lf_overload *ov, uint32_t occupancy, uint32_t busy)
+{
+	bool overloaded, draining;
+	uint32_t best_effort_scale, auth_peers_scale;
+	enum lf_overload_state state;
+
+	rte_spinlock_lock(&ov->lock);
+
+	best_effort_scale = ov->best_effort_scale;
+	auth_peers_scale = ov->auth_peers_scale;
+
+	overloaded = occupancy >= LF_OVERLOAD_HIGH_OCCUPANCY ||
+	             (busy >= LF_OVERLOAD_HIGH_BUSY &&
+	                     occupancy >= LF_OVERLOAD_LOW_OCCUPANCY);
+	/* the last tightening already takes effect */
+	draining = occupancy < ov->occupancy;
+
+	if (overloaded) {
+		ov->nb_overloaded++;
+		if (!draining) {
+			/* tighten the best-effort rate limit first */
+			if (best_effort_scale > LF_OVERLOAD_MIN_SCALE) {
+				best_effort_scale = halve_scale(best_effort_scale);
+			} else {
+				auth_peers_scale = halve_scale(auth_peers_scale);
+			}
+		}
+	} else if (occupancy < LF_OVERLOAD_LOW_OCCUPANCY) {
+		/* relax the auth peers rate limit first */
+		if (auth_peers_scale < LF_RATELIMITER_SCALE_ONE) {
+			auth_peers_scale = relax_scale(auth_peers_scale);
+		} else {
+			best_effort_scale = relax_scale(best_effort_scale);
+		}
+	}
+
+	if (best_effort_scale < ov->best_effort_scale ||
+			auth_peers_scale < ov->auth_peers_scale) {
+		ov->nb_tightened++;
+	} else if (best_effort_scale > ov->best_effort_scale ||
+			   auth_peers_scale > ov->auth_peers_scale) {
+		ov->nb_relaxed++;
+	}
+	if (best_effort_scale != ov->best_effort_scale ||
+			auth_peers_scale != ov->auth_peers_scale) {
+		(void)lf_ratelimiter_set_scale(ov->rl, best_effort_scale,
+				auth_peers_scale);
+		ov->best_effort_scale = best_effort_scale;
+		ov->auth_peers_scale = auth_peers_scale;
+	}
+
+	if (auth_peers_scale < LF_RATELIMITER_SCALE_ONE) {
+		state = LF_OVERLOAD_STATE_AUTH_PEERS;
+	} else if (best_effort_scale < LF_RATELIMITER_SCALE_ONE) {
+		state = LF_OVERLOAD_STATE_BEST_EFFORT;
+	} else {
+		state = LF_OVERLOAD_STATE_NORMAL;
+	}
+	if (state != ov->state) {
+		LF_OVERLOAD_LOG(NOTICE,
+				"State %s -> %s (occupancy: %u%%, busy: %u%%)\n",
+				state_names[ov->state], state_names[state], occupancy, busy);
+		ov->state = state;
+	}
+
+	ov->occupancy = occupancy;
+	ov->busy = busy;
+
+	rte_spinlock_unlock(&ov->lock);
+}
+
+void
+lf_overload_service_update(struct lf_overload *ov)
+{
+	int count;
+	uint16_t i;
+	uint32_t occupancy = 0, busy = 0;
+	uint64_t current_tsc, busy_cycles = 0, worker_busy_cycles;
+	struct lf_overload_queue *queue;
+
+	current_tsc = rte_rdtsc();
+	for (i = 0; i < ov->nb_workers; ++i) {
+		worker_busy_cycles = atomic_load_explicit(&ov->workers[i]->busy_cycles,
+				memory_order_relaxed);
+		busy_cycles += worker_busy_cycles - ov->last_busy_cycles[i];
+		ov->last_busy_cycles[i] = worker_busy_cycles;
+	}
+	if (current_tsc > ov->last_tsc && ov->nb_workers > 0) {
+		busy = (uint32_t)RTE_MIN(100 * busy_cycles /
+										 ((current_tsc - ov->last_tsc) *
+												 ov->nb_workers),
+				UINT64_C(100));
+	}
+	ov->last_tsc = current_tsc;
+
+	for (i = 0; i < ov->nb_queues; ++i) {
+		queue = &ov->queues[i];
+		count = rte_eth_rx_queue_count(queue->port_id, queue->queue_id);
+		if (count <= 0) {
+			continue;
+		}
+		occupancy = RTE_MAX(occupancy,
+				RTE_MIN(100 * (uint32_t)count / queue->nb_desc, 100U));
+	}
+	if (ov->nb_queues == 0) {
+		/* without queue occupancy, saturated workers indicate full queues */
+		occupancy = busy >= LF_OVERLOAD_HIGH_BUSY ? 100 : 0;
+	}
+
+	lf_overload_update(ov, occupancy, busy);
+}
+
+int
+lf_overload_service_launch(struct lf_overload *ov)
+{
+	uint64_t current_tsc, last_update_tsc, last_redistribution_tsc, hz;
+	uint64_t period_tsc, redistribution_period_tsc;
+
+	/* measure time using the time stamp counter */
+	last_update_tsc = rte_rdtsc();
+	last_redistribution_tsc = last_update_tsc;
+	hz = rte_get_timer_hz();
+	period_tsc = (uint64_t)((double)hz * LF_OVERLOAD_INTERVAL);
+	redistribution_period_tsc =
+			(uint64_t)((double)hz * LF_RATELIMITER_REDISTRIBUTION_INTERVAL);
+
+	while (!lf_force_quit) {
+		current_tsc = rte_rdtsc();
+		if (current_tsc - last_redistribution_tsc >=
+				redistribution_period_tsc) {
+			lf_ratelimiter_service_update(ov->rl,
+					(uint64_t)((double)(current_tsc - last_redistribution_tsc) /
+							   (double)hz * (double)LF_TIME_NS_IN_S));
+			last_redistribution_tsc = current_tsc;
+		}
+		if (current_tsc - last_update_tsc >= period_tsc) {
+			lf_overload_service_update(ov);
+			last_update_tsc = current_tsc;
+
+			/* potentially the clock speed has changed */
+			hz = rte_get_timer_hz();
+			period_tsc = (uint64_t)((double)hz * LF_OVERLOAD_INTERVAL);
+			redistribution_period_tsc = (uint64_t)((double)hz *
+					LF_RATELIMITER_REDISTRIBUTION_INTERVAL);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Overload Control Telemetry Functionalities
+ */
+
+/* Overload control context used when telemetry commands are processed. */
+static struct lf_overload *tel_ctx;
+
+static int
+handle_overload(const char *cmd __rte_unused, const char *params __rte_unused,
+		struct rte_tel_data *d)
+{
+	rte_spinlock_lock(&tel_ctx->lock);
+
+	rte_tel_data_start_dict(d);
+	rte_tel_data_add_dict_string(d, "state", state_names[tel_ctx->state]);
+	rte_tel_data_add_dict_uint(d, "best_effort_scale_percent",
+			100 * tel_ctx->best_effort_scale / LF_RATELIMITER_SCALE_ONE);
+	rte_tel_data_add_dict_uint(d, "auth_peers_scale_percent",
+			100 * tel_ctx->auth_peers_scale / LF_RATELIMITER_SCALE_ONE);
+	rte_tel_data_add_dict_uint(d, "occupancy_percent", tel_ctx->occupancy);
+	rte_tel_data_add_dict_uint(d, "busy_percent", tel_ctx->busy);
+	rte_tel_data_add_dict_uint(d, "rx_queues", tel_ctx->nb_queues);
+	rte_tel_data_add_dict_uint(d, "overloaded", tel_ctx->nb_overloaded);
+	rte_tel_data_add_dict_uint(d, "tightened", tel_ctx->nb_tightened);
+	rte_tel_data_add_dict_uint(d, "relaxed", tel_ctx->nb_relaxed);
+
+	rte_spinlock_unlock(&tel_ctx->lock);
+
+	return 0;
+}
+
+int
+lf_overload_register_telemetry(struct lf_overload *ov)
+{
+	int res;
+	tel_ctx = ov;
+
+	res = rte_telemetry_register_cmd(LF_TELEMETRY_PREFIX "/overload",
+			handle_overload,
+			"Returns the state of the overload control, the scales of the "
+			"best-effort and auth peers rate limits, and the last samples.");
+	if (res != 0) {
+		return -1;
+	}
+
+	return 0;
+}
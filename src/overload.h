@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#ifndef LF_OVERLOAD_H
+#define LF_OVERLOAD_H
+
+#include <inttypes.h>
+#include <stdatomic.h>
+
+#include <rte_common.h>
+#include <rte_spinlock.h>
+
+#include "lf.h"
+#include "ratelimiter.h"
+
+/**
+ * The overload control protects the workers when they are saturated. Without
+ * it, packets accumulate in the receive queues and are eventually dropped by
+ * the NIC, regardless of whether they are authenticated or not.
+ *
+ * A feedback controller periodically (LF_OVERLOAD_INTERVAL) samples the
+ * occupancy of the workers' receive queues as well as the fraction of cycles
+ * the workers spend processing packets. While the workers are overloaded and
+ * the queues do not drain, the controller halves the scale of the best-effort
+ * rate limit and, once the best-effort rate limit reached its minimal scale,
+ * the scale of the auth peers rate limit (lf_ratelimiter_set_scale()). When
+ * the queues are drained, the rate limits are relaxed again in reverse order.
+ *
+ * The occupancy and busy fraction are percentages. If no receive queue
+ * reports its occupancy, the controller relies on the busy fraction only.
+ */
+
+/* Interval between two updates of the controller (seconds) */
+#define LF_OVERLOAD_INTERVAL 0.01
+
+/* Occupancy of the fullest receive queue above which the workers are
+ * overloaded. */
+#define LF_OVERLOAD_HIGH_OCCUPANCY 50
+/* Occupancy of the fullest receive queue below which the queues are
+ * considered drained. */
+#define LF_OVERLOAD_LOW_OCCUPANCY 10
+/* Busy fraction above which the workers are overloaded if the queues are not
+ * drained. */
+#define LF_OVERLOAD_HIGH_BUSY 95
+
+/* Minimal scale of a tightened rate limit */
+#define LF_OVERLOAD_MIN_SCALE (LF_RATELIMITER_SCALE_ONE / 64)
+/* Scale by which a tightened rate limit is relaxed per update */
+#define LF_OVERLOAD_RELAX_STEP (LF_RATELIMITER_SCALE_ONE / 16)
+
+/* Maximum number of sampled receive queues */
+#define LF_OVERLOAD_MAX_QUEUES (LF_MAX_WORKER * 4)
+
+enum lf_overload_state {
+	/* rate limits are not tightened */
+	LF_OVERLOAD_STATE_NORMAL = 0,
+	/* best-effort rate limit is tightened */
+	LF_OVERLOAD_STATE_BEST_EFFORT,
+	/* best-effort and auth peers rate limits are tightened */
+	LF_OVERLOAD_STATE_AUTH_PEERS,
+};
+
+struct lf_overload_worker {
+	/* TSC cycles spent processing bursts (only written by the worker) */
+	_Atomic(uint64_t) busy_cycles;
+} __rte_cache_aligned;
+
+struct lf_overload_queue {
+	uint16_t port_id;
+	uint16_t queue_id;
+	uint16_t nb_desc;
+};
+
+struct lf_overload {
+	struct lf_ratelimiter *rl;
+
+	struct lf_overload_worker *workers[LF_MAX_WORKER];
+	uint16_t nb_workers;
+	uint64_t last_busy_cycles[LF_MAX_WORKER];
+	uint64_t last_tsc;
+
+	/* receive queues reporting their occupancy */
+	struct lf_overload_queue queues[LF_OVERLOAD_MAX_QUEUES];
+	uint16_t nb_queues;
+
+	/* controller state (protected by the lock for telemetry) */
+	rte_spinlock_t lock;
+	enum lf_overload_state state;
+	uint32_t best_effort_scale;
+	uint32_t auth_peers_scale;
+	/* last samples (percent) */
+	uint32_t occupancy;
+	uint32_t busy;
+	/* number of updates with overloaded workers and rate limit changes */
+	uint64_t nb_overloaded;
+	uint64_t nb_tightened;
+	uint64_t nb_relaxed;
+};
+
+/**
+ * Account the cycles spent processing a burst.
+ */
+static inline void
+lf_overload_worker_add_busy(struct lf_overload_worker *worker, uint64_t cycles)
+{
+	atomic_store_explicit(&worker->busy_cycles,
+			atomic_load_explicit(&worker->busy_cycles, memory_order_relaxed) +
+					cycles,
+			memory_order_relaxed);
+}
+
+/**
+ * Initialize the overload control. The receive queues are added afterwards
+ * with lf_overload_add_queue().
+ *
+ * @param rl Ratelimiter whose best-effort and auth peers rate limits are
+ * tightened. It must already be initialized, since the initial scale is
+ * applied immediately.
+ * @param workers The workers' overload structs.
+ */
+int
+lf_overload_init(struct lf_overload *ov, struct lf_ratelimiter *rl,
+		struct lf_overload_worker *workers[LF_MAX_WORKER],
+		uint16_t nb_workers);
+
+/**
+ * Add a receive queue to be sampled. Queues that do not report their
+ * occupancy are ignored.
+ *
+ * @return Returns 0 if the queue is sampled, and -1 otherwise.
+ */
+int
+lf_overload_add_queue(struct lf_overload *ov, uint16_t port_id,
+		uint16_t queue_id);
+
+/**
+ * Run one step of the controller with the given samples and adjust the rate
+ * limits' scales accordingly.
+ *
+ * @param occupancy Occupancy of the fullest receive queue (percent).
+ * @param busy Fraction of cycles the workers spent processing (percent).
+ */
+void
+lf_overload_update(struct lf_overload *ov, uint32_t occupancy, uint32_t busy);
+
+/**
+ * Sample the receive queues and the workers' busy cycles and run one step of
+ * the controller.
+ */
+void
+lf_overload_service_update(struct lf_overload *ov);
+
+/**
+ * Launch the overload control service, which periodically calls
+ * lf_overload_service_update() until lf_force_quit is set. Because both run on
+ * the main lcore, the service also performs the ratelimiter's redistribution
+ * (lf_ratelimiter_service_update()).
+ */
+int
+lf_overload_service_launch(struct lf_overload *ov);
+
+/**
+ * Register the overload control's telemetry command, which exposes the
+ * controller's state.
+ */
+int
+lf_overload_register_telemetry(struct lf_overload *ov);
+
+#endif /* LF_OVERLOAD_H */
@@ -34,6 +34,9 @@ static const struct lf_params default_params = {
 	.tf_threshold = 1000,
 
 	/* duplicate filter (bloom filter) */
+	.df_cuckoo = false,
+	.bf_blocked = false,
+	.bf_shared = false,
 	.bf_nb = 3,
 	.bf_period = 500,
 	.bf_hashes = 7,     /* roughly -log2(0.01) */
@@ -41,9 +44,17 @@ static const struct lf_params default_params = {
 
 	/* ratelimiter */
 	.rl_size = 1024,
+	.rl_redistribute = false,
+	.rl_cache = 0,
+	.rl_overload = false,
+
+	/* egress */
+	.be_drr = false,
 
 	/* keymanager */
 	.km_size = 1024,
+	.km_cache_file = "",
+	.km_on_demand = false,
 };
 
 #define LF_MAX_PORTPAIRS (2 * RTE_MAX_ETHPORTS)
@@ -68,13 +79,22 @@ static const char short_options[] = "v:" /* version */
 #define CMD_LINE_OPT_PORTMAP         "portmap"
 #define CMD_LINE_OPT_MTU             "mtu"
 #define CMD_LINE_OPT_TF_THRESHOLD    "tf-threshold"
+#define CMD_LINE_OPT_DF_BACKEND      "df-backend"
+#define CMD_LINE_OPT_BF_BLOCKED      "bf-blocked"
+#define CMD_LINE_OPT_BF_SHARED       "bf-shared"
 #define CMD_LINE_OPT_BF_NB           "bf-nb"
 #define CMD_LINE_OPT_BF_PERIOD       "bf-period"
 #define CMD_LINE_OPT_BF_HASHES       "bf-hashes"
 #define CMD_LINE_OPT_BF_BYTES        "bf-bytes"
 #define CMD_LINE_OPT_RL_SIZE         "rl-size"
+#define CMD_LINE_OPT_RL_REDISTRIBUTE "rl-redistribute"
+#define CMD_LINE_OPT_RL_CACHE        "rl-cache"
+#define CMD_LINE_OPT_RL_OVERLOAD     "rl-overload"
 #define CMD_LINE_OPT_KM_SIZE         "km-size"
+#define CMD_LINE_OPT_KM_CACHE        "km-cache"
+#define CMD_LINE_OPT_KM_ON_DEMAND    "km-on-demand"
 #define CMD_LINE_OPT_DISABLE_MIRRORS "disable-mirrors"
+#define CMD_LINE_OPT_BE_DRR          "be-drr"
 
 /* map long options to number */
 enum {
@@ -88,15 +108,24 @@ enum {
 	CMD_LINE_OPT_PORTMAP_NUM,
 	CMD_LINE_OPT_MTU_NUM,
 	CMD_LINE_OPT_TF_THRESHOLD_NUM,
+	CMD_LINE_OPT_DF_BACKEND_NUM,
+	CMD_LINE_OPT_BF_BLOCKED_NUM,
+	CMD_LINE_OPT_BF_SHARED_NUM,
 	CMD_LINE_OPT_BF_NB_NUM,
 	CMD_LINE_OPT_BF_PERIOD_NUM,
 	CMD_LINE_OPT_BF_HASHES_NUM,
 	CMD_LINE_OPT_BF_BYTES_NUM,
 	CMD_LINE_OPT_RL_CONFIG_FILE_NUM,
 	CMD_LINE_OPT_RL_SIZE_NUM,
+	CMD_LINE_OPT_RL_REDISTRIBUTE_NUM,
+	CMD_LINE_OPT_RL_CACHE_NUM,
+	CMD_LINE_OPT_RL_OVERLOAD_NUM,
 	CMD_LINE_OPT_KM_CONFIG_FILE_NUM,
 	CMD_LINE_OPT_KM_SIZE_NUM,
+	CMD_LINE_OPT_KM_CACHE_NUM,
+	CMD_LINE_OPT_KM_ON_DEMAND_NUM,
 	CMD_LINE_OPT_DISABLE_MIRRORS_NUM,
+	CMD_LINE_OPT_BE_DRR_NUM,
 };
 
 static const struct option long_options[] = {
@@ -110,6 +139,10 @@ static const struct option long_options[] = {
 	{ CMD_LINE_OPT_MTU, required_argument, 0, CMD_LINE_OPT_MTU_NUM },
 	{ CMD_LINE_OPT_TF_THRESHOLD, required_argument, 0,
 			CMD_LINE_OPT_TF_THRESHOLD_NUM },
+	{ CMD_LINE_OPT_DF_BACKEND, required_argument, 0,
+			CMD_LINE_OPT_DF_BACKEND_NUM },
+	{ CMD_LINE_OPT_BF_BLOCKED, no_argument, 0, CMD_LINE_OPT_BF_BLOCKED_NUM },
+	{ CMD_LINE_OPT_BF_SHARED, no_argument, 0, CMD_LINE_OPT_BF_SHARED_NUM },
 	{ CMD_LINE_OPT_BF_NB, required_argument, 0, CMD_LINE_OPT_BF_NB_NUM },
 	{ CMD_LINE_OPT_BF_PERIOD, required_argument, 0,
 			CMD_LINE_OPT_BF_PERIOD_NUM },
@@ -117,9 +150,17 @@ static const struct option long_options[] = {
 			CMD_LINE_OPT_BF_HASHES_NUM },
 	{ CMD_LINE_OPT_BF_BYTES, required_argument, 0, CMD_LINE_OPT_BF_BYTES_NUM },
 	{ CMD_LINE_OPT_RL_SIZE, required_argument, 0, CMD_LINE_OPT_RL_SIZE_NUM },
+	{ CMD_LINE_OPT_RL_REDISTRIBUTE, no_argument, 0,
+			CMD_LINE_OPT_RL_REDISTRIBUTE_NUM },
+	{ CMD_LINE_OPT_RL_CACHE, required_argument, 0, CMD_LINE_OPT_RL_CACHE_NUM },
+	{ CMD_LINE_OPT_RL_OVERLOAD, no_argument, 0, CMD_LINE_OPT_RL_OVERLOAD_NUM },
 	{ CMD_LINE_OPT_KM_SIZE, required_argument, 0, CMD_LINE_OPT_KM_SIZE_NUM },
+	{ CMD_LINE_OPT_KM_CACHE, required_argument, 0, CMD_LINE_OPT_KM_CACHE_NUM },
+	{ CMD_LINE_OPT_KM_ON_DEMAND, no_argument, 0,
+			CMD_LINE_OPT_KM_ON_DEMAND_NUM },
 	{ CMD_LINE_OPT_DISABLE_MIRRORS, no_argument, 0,
 			CMD_LINE_OPT_DISABLE_MIRRORS_NUM },
+	{ CMD_LINE_OPT_BE_DRR, no_argument, 0, CMD_LINE_OPT_BE_DRR_NUM },
 	{ NULL, 0, 0, 0 },
 };
 
@@ -149,6 +190,17 @@ lf_usage(const char *prgname)
 			"  --tf-threshold=NUM:\n"
 			"         Timestamp filter threshold in milliseconds "
 			"(default: 1000)\n"
+			"  --df-backend=NAME\n"
+			"         Duplicate filter backend: bloom (default) or cuckoo\n"
+			"         The cuckoo filter uses the memory of the Bloom filters\n"
+			"         and its entries expire after bf-nb periods\n"
+			"  --bf-blocked\n"
+			"         Use blocked Bloom filters, which access a single cache\n"
+			"         line per filter. Requires bf-bytes of at least 64\n"
+			"  --bf-shared\n"
+			"         Share the Bloom filters among all workers on the same\n"
+			"         socket, such that duplicates are also detected across\n"
+			"         workers\n"
 			"  --bf-nb=NUMBER:\n"
 			"         Number of Bloom filters used\n"
 			"  --bf-period=PERIOD:\n"
@@ -160,10 +212,34 @@ lf_usage(const char *prgname)
 			"         Must be a power of 2 and at least 8\n"
 			"  --rl-size=NUM\n"
 			"         Size of ratelimiter hash table.\n"
+			"  --rl-redistribute\n"
+			"         Redistribute the rate limits among the workers\n"
+			"         according to their demand. Runs the ratelimiter\n"
+			"         service on the main lcore.\n"
+			"  --rl-cache=NUM\n"
+			"         Enables the compact rate limiter with NUM cached peers\n"
+			"         per worker and peer buckets shared per NUMA node.\n"
+			"         Must be a power of 2 and at least 4 (0 = disabled).\n"
+			"  --rl-overload\n"
+			"         Tighten the best-effort and auth peers rate limits\n"
+			"         while the workers are overloaded. Runs the overload\n"
+			"         control service on the main lcore.\n"
 			"  --km-size=NUM\n"
 			"         Size of keymanager hash table.\n"
+			"  --km-cache=FILE\n"
+			"         Persist the fetched DRKeys in FILE and restore them\n"
+			"         on startup instead of fetching them again.\n"
+			"  --km-on-demand\n"
+			"         Fetch the DRKeys of the peers the workers encounter\n"
+			"         instead of all configured peers, and evict the least\n"
+			"         recently used keys if the keymanager hash table is\n"
+			"         full.\n"
 			"  --disable-mirrors\n"
-			"         Disables mirrors for all ports.\n",
+			"         Disables mirrors for all ports.\n"
+			"  --be-drr\n"
+			"         Queue best-effort packets per source AS and send them\n"
+			"         with deficit round robin at the best-effort rate\n"
+			"         instead of dropping them.\n",
 			prgname);
 }
 
@@ -476,6 +552,22 @@ lf_params_parse(int argc, char **argv, struct lf_params *params)
 				return -1;
 			}
 			break;
+		case CMD_LINE_OPT_DF_BACKEND_NUM:
+			if (strcmp(optarg, "bloom") == 0) {
+				params->df_cuckoo = false;
+			} else if (strcmp(optarg, "cuckoo") == 0) {
+				params->df_cuckoo = true;
+			} else {
+				LF_LOG(ERR, "Invalid df-backend\n");
+				return -1;
+			}
+			break;
+		case CMD_LINE_OPT_BF_BLOCKED_NUM:
+			params->bf_blocked = true;
+			break;
+		case CMD_LINE_OPT_BF_SHARED_NUM:
+			params->bf_shared = true;
+			break;
 		case CMD_LINE_OPT_BF_NB_NUM:
 			res = parse_uint(optarg, &params->bf_period);
 			if (res != 0 || params->bf_nb == 0) {
@@ -511,6 +603,19 @@ lf_params_parse(int argc, char **argv, struct lf_params *params)
 				return -1;
 			}
 			break;
+		case CMD_LINE_OPT_RL_REDISTRIBUTE_NUM:
+			params->rl_redistribute = true;
+			break;
+		case CMD_LINE_OPT_RL_CACHE_NUM:
+			res = parse_uint(optarg, &params->rl_cache);
+			if (res != 0) {
+				LF_LOG(ERR, "Invalid rl-cache\n");
+				return -1;
+			}
+			break;
+		case CMD_LINE_OPT_RL_OVERLOAD_NUM:
+			params->rl_overload = true;
+			break;
 		case CMD_LINE_OPT_KM_SIZE_NUM:
 			res = parse_uint(optarg, &params->km_size);
 			if (res != 0 || params->km_size == 0) {
@@ -518,10 +623,23 @@ lf_params_parse(int argc, char **argv, struct lf_params *params)
 				return -1;
 			}
 			break;
+		case CMD_LINE_OPT_KM_CACHE_NUM:
+			if (strlen(optarg) >= PATH_MAX || strlen(optarg) == 0) {
+				LF_LOG(ERR, "Invalid km-cache file name\n");
+				return -1;
+			}
+			(void)strcpy(params->km_cache_file, optarg);
+			break;
+		case CMD_LINE_OPT_KM_ON_DEMAND_NUM:
+			params->km_on_demand = true;
+			break;
 		/* disable mirrors for all ports */
 		case CMD_LINE_OPT_DISABLE_MIRRORS_NUM:
 			params->disable_mirrors = true;
 			break;
+		case CMD_LINE_OPT_BE_DRR_NUM:
+			params->be_drr = true;
+			break;
 		/* unknown option */
 		default:
 			(void)lf_usage(prgname);
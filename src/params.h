@@ -52,6 +52,9 @@ struct lf_params {
 	/*
 	 * Duplicate Filter
 	 */
+	bool df_cuckoo;  /* cuckoo filter instead of Bloom filters */
+	bool bf_blocked; /* blocked Bloom filter layout */
+	bool bf_shared;  /* Bloom filters shared per socket */
 	unsigned int bf_nb;
 	unsigned int bf_period; /* rotation period in milliseconds */
 	unsigned int bf_hashes;
@@ -61,11 +64,21 @@ struct lf_params {
 	 * Rate Limiter
 	 */
 	unsigned int rl_size;
+	bool rl_redistribute; /* redistribute rate limits among workers */
+	unsigned int rl_cache; /* per-worker cache size (0 = compact mode off) */
+	bool rl_overload; /* tighten rate limits while workers are overloaded */
+
+	/*
+	 * Egress
+	 */
+	bool be_drr; /* schedule best-effort packets with deficit round robin */
 
 	/*
 	 * Keymanager
 	 */
 	unsigned int km_size;
+	char km_cache_file[PATH_MAX]; /* persistent key cache (empty = disabled) */
+	bool km_on_demand;            /* fetch keys of the encountered peers */
 };
 
 int
@@ -9,9 +9,11 @@
 #include <stdlib.h>
 
 #include <rte_branch_prediction.h>
+#include <rte_cycles.h>
 #include <rte_hash.h>
 #include <rte_jhash.h>
 #include <rte_malloc.h>
+#include <rte_telemetry.h>
 
 #include "config.h"
 #include "lf.h"
@@ -19,7 +21,7 @@
 #include "lib/log/log.h"
 #include "lib/math/sat_op.h"
 #include "lib/math/util.h"
-#include "lib/ratelimiter/token_bucket.h"
+#include "lib/time/time.h"
 #include "lib/utils/parse.h"
 #include "ratelimiter.h"
 
@@ -33,11 +35,19 @@
  * removed. Since only the manager accesses the data stored in the dictionary,
  * it can be freed without synchronizing with the workers.
  *
+ * The workers do not access this dictionary but a replica on their socket,
+ * which maps the peers to their key_id. The manager updates the replicas
+ * together with the dictionary. A peer is added to the replicas after its
+ * rate limits are set and removed from them before its key_id can be reused.
+ *
  * Updates to a worker's bucket, i.e., changing a bucket's rate and burst, is
  * always performed atomically with relaxed memory order.
  *
  * The manager lock ensures that updates to the dictionary and the workers'
  * buckets cannot interleave.
+ *
+ * In the compact mode, the peers' buckets are shared among the workers of a
+ * socket (lf_tsb_shared) and are updated with atomic operations only.
  */
 
 /**
@@ -57,38 +67,27 @@ dictionary_data_set(struct lf_ratelimiter_data *dict_data, uint64_t byte_rate,
 	dict_data->packet_burst = packet_burst;
 }
 
+/**
+ * Add the peer to the dictionary (if not yet present) and set its rate limit in
+ * the peers' rate limits, which are indexed by the key_id. Requires the
+ * management lock!
+ *
+ * @return The peer's key_id, or a negative value on failure.
+ */
 static int
-dictionary_set(struct rte_hash *dict,
+dictionary_set(struct lf_ratelimiter *rl,
 		const struct lf_ratelimiter_key *dictionary_key, uint64_t byte_rate,
 		uint64_t byte_burst, uint64_t packet_rate, uint64_t packet_burst)
 {
-	int res, key_id;
-	struct lf_ratelimiter_data *dictionary_data;
-
-	key_id = rte_hash_lookup_data(dict, dictionary_key,
-			(void **)&dictionary_data);
+	int key_id;
 
+	key_id = rte_hash_add_key(rl->dict, dictionary_key);
 	if (key_id < 0) {
-		/* entry does not exist yet */
-		dictionary_data =
-				rte_zmalloc(NULL, sizeof(struct lf_ratelimiter_data), 0);
-		if (dictionary_data == NULL) {
-			LF_RATELIMITER_LOG(ERR, "Fail to allocate memory for dictionary "
-									"entry.\n");
-			return key_id;
-		}
-		res = rte_hash_add_key_data(dict, dictionary_key,
-				(void *)dictionary_data);
-		if (res != 0) {
-			LF_RATELIMITER_LOG(ERR, "Fail to add dictionary entry.\n");
-			rte_free(dictionary_data);
-			return res;
-		}
-		key_id = rte_hash_lookup(dict, dictionary_key);
-		assert(key_id >= 0);
+		LF_RATELIMITER_LOG(ERR, "Fail to add dictionary entry.\n");
+		return key_id;
 	}
-	dictionary_data_set(dictionary_data, byte_rate, byte_burst, packet_rate,
-			packet_burst);
+	dictionary_data_set(&rl->peer_limits[key_id], byte_rate, byte_burst,
+			packet_rate, packet_burst);
 
 	LF_RATELIMITER_LOG(DEBUG,
 			"Set ratelimit for AS " PRIISDAS
@@ -100,8 +99,11 @@ dictionary_set(struct rte_hash *dict,
 	return key_id;
 }
 
+/**
+ * @param socket NUMA socket on which the hash table is allocated.
+ */
 static struct rte_hash *
-dictionary_new(uint32_t size)
+dictionary_new(uint32_t size, int socket)
 {
 	struct rte_hash *dic;
 	struct rte_hash_parameters params = { 0 };
@@ -128,9 +130,7 @@ dictionary_new(uint32_t size)
 	/* hash function */
 	params.hash_func = rte_jhash;
 	params.hash_func_init_val = 0;
-	/* TODO: (fstreun) potentially use multiple hash tables for different
-	 * NUMA sockets */
-	params.socket_id = (int)rte_socket_id();
+	params.socket_id = socket;
 	/* ensure that insertion always succeeds */
 	params.extra_flag = RTE_HASH_EXTRA_FLAGS_EXT_TABLE;
 	/* Lock Free Read Write */
@@ -155,18 +155,174 @@ dictionary_new(uint32_t size)
 	return dic;
 }
 
+/**
+ * Add the peer with the given key_id to the socket replicas of the
+ * dictionary. Requires the management lock!
+ */
+static int
+replicas_set(struct lf_ratelimiter *rl,
+		const struct lf_ratelimiter_key *dictionary_key, int key_id)
+{
+	int res;
+	unsigned int socket;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (rl->socket_dict[socket] == NULL) {
+			continue;
+		}
+		res = rte_hash_add_key_data(rl->socket_dict[socket], dictionary_key,
+				(void *)(uintptr_t)key_id);
+		if (res != 0) {
+			LF_RATELIMITER_LOG(ERR,
+					"Fail to add dictionary entry on socket %u.\n", socket);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Remove the peer from the socket replicas of the dictionary. The replicas
+ * free the key positions through their RCU defer queues. Requires the
+ * management lock!
+ */
 static void
-dictionary_free(struct rte_hash *dict)
+replicas_del(struct lf_ratelimiter *rl,
+		const struct lf_ratelimiter_key *dictionary_key)
 {
-	uint32_t iterator;
-	struct lf_ratelimiter_dictionary_key *key_ptr;
-	struct lf_ratelimiter_dictionary_data *data;
+	unsigned int socket;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (rl->socket_dict[socket] != NULL) {
+			(void)rte_hash_del_key(rl->socket_dict[socket], dictionary_key);
+		}
+	}
+}
+
+/**
+ * Get the worker's rate limit with the given id.
+ */
+static struct lf_ratelimiter_limit *
+worker_ratelimit(struct lf_ratelimiter_worker *rlw, uint32_t id)
+{
+	switch (id) {
+	case LF_RATELIMITER_OVERALL_ID:
+		return &rlw->overall;
+	case LF_RATELIMITER_AUTH_PEERS_ID:
+		return &rlw->auth_peers;
+	case LF_RATELIMITER_BEST_EFFORT_ID:
+		return &rlw->best_effort;
+	default:
+		return &rlw->buckets[id - LF_RATELIMITER_PEER_OFFSET];
+	}
+}
+
+/**
+ * Set the peer's shared limits (compact mode). Each socket gets the share of
+ * the rate limit corresponding to its number of workers. Requires the
+ * management lock!
+ */
+static void
+set_shared_limits(struct lf_ratelimiter *rl, uint32_t key_id,
+		uint64_t byte_rate, uint64_t byte_burst, uint64_t packet_rate,
+		uint64_t packet_burst)
+{
+	unsigned int socket;
+	uint64_t nb_socket_workers;
+	struct lf_ratelimiter_shared_limit *shared;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (rl->shared[socket] == NULL) {
+			continue;
+		}
+		nb_socket_workers = rl->nb_socket_workers[socket];
+		shared = &rl->shared[socket][key_id];
+		lf_tsb_shared_set(&shared->byte,
+				byte_rate / rl->nb_workers * nb_socket_workers,
+				byte_burst / rl->nb_workers * nb_socket_workers);
+		lf_tsb_shared_set(&shared->packet,
+				packet_rate / rl->nb_workers * nb_socket_workers,
+				packet_burst / rl->nb_workers * nb_socket_workers);
+	}
+}
+
+/**
+ * Split the rate limit with the given id equally among the workers.
+ * In the compact mode, the peers' rate limits are set to the shared limits
+ * instead, which are not redistributed.
+ * If the redistribution is enabled, the pool's share is subtracted and the
+ * pool is emptied. The service then redistributes the rate limit according to
+ * the workers' demand. Requires the management lock!
+ */
+static void
+set_worker_limits(struct lf_ratelimiter *rl, uint32_t id, uint64_t byte_rate,
+		uint64_t byte_burst, uint64_t packet_rate, uint64_t packet_burst)
+{
+	int worker_id;
+	struct lf_ratelimiter_limit *ratelimit;
+
+	if (rl->nb_workers == 0) {
+		return;
+	}
+
+	if (rl->cache_size != 0 && id >= LF_RATELIMITER_PEER_OFFSET) {
+		set_shared_limits(rl, id - LF_RATELIMITER_PEER_OFFSET, byte_rate,
+				byte_burst, packet_rate, packet_burst);
+		return;
+	}
 
-	for (iterator = 0; rte_hash_iterate(dict, (void *)&key_ptr, (void **)&data,
-							   &iterator) >= 0;) {
-		rte_free(data);
+	if (rl->redistribute) {
+		byte_rate -= byte_rate / LF_RATELIMITER_POOL_SHARE;
+		byte_burst -= byte_burst / LF_RATELIMITER_POOL_SHARE;
+		packet_rate -= packet_rate / LF_RATELIMITER_POOL_SHARE;
+		packet_burst -= packet_burst / LF_RATELIMITER_POOL_SHARE;
+		atomic_store_explicit(&rl->pool[id].byte, 0, memory_order_relaxed);
+		atomic_store_explicit(&rl->pool[id].packet, 0, memory_order_relaxed);
+		rl->refill_ns[id] = rl->redistribution_ns;
 	}
-	rte_hash_free(dict);
+
+	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
+		ratelimit = worker_ratelimit(rl->workers[worker_id], id);
+		lf_ratelimiter_bucket_set(&ratelimit->byte,
+				byte_rate / rl->nb_workers, byte_burst / rl->nb_workers);
+		lf_ratelimiter_bucket_set(&ratelimit->packet,
+				packet_rate / rl->nb_workers, packet_burst / rl->nb_workers);
+	}
+}
+
+/**
+ * Scale the value (see LF_RATELIMITER_SCALE_ONE) without overflowing.
+ */
+static inline uint64_t
+scale_value(uint64_t value, uint32_t scale)
+{
+	return value / LF_RATELIMITER_SCALE_ONE * scale +
+	       value % LF_RATELIMITER_SCALE_ONE * scale / LF_RATELIMITER_SCALE_ONE;
+}
+
+static struct lf_ratelimiter_data
+scale_data(const struct lf_ratelimiter_data *data, uint32_t scale)
+{
+	return (struct lf_ratelimiter_data){
+		.byte_rate = scale_value(data->byte_rate, scale),
+		.byte_burst = scale_value(data->byte_burst, scale),
+		.packet_rate = scale_value(data->packet_rate, scale),
+		.packet_burst = scale_value(data->packet_burst, scale),
+	};
+}
+
+/**
+ * Split the scaled rate limit equally among the workers. Requires the
+ * management lock!
+ */
+static void
+set_scaled_worker_limits(struct lf_ratelimiter *rl, uint32_t id,
+		const struct lf_ratelimiter_data *data, uint32_t scale)
+{
+	struct lf_ratelimiter_data scaled = scale_data(data, scale);
+
+	set_worker_limits(rl, id, scaled.byte_rate, scaled.byte_burst,
+			scaled.packet_rate, scaled.packet_burst);
 }
 
 /**
@@ -179,23 +335,22 @@ set_as_limit(struct lf_ratelimiter *rl, uint64_t isd_as,
 {
 	int key_id;
 	struct lf_ratelimiter_key dictionary_key;
-	int worker_id;
 
 	dictionary_key.as = isd_as;
 	dictionary_key.drkey_protocol = drkey_protocol;
-	key_id = dictionary_set(rl->dict, &dictionary_key, byte_rate, byte_burst,
+	key_id = dictionary_set(rl, &dictionary_key, byte_rate, byte_burst,
 			packet_rate, packet_burst);
 	if (key_id < 0) {
 		/* potentially there is no space in the dictionary */
 		return -1;
 	}
-	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
-		lf_token_bucket_set(&rl->workers[worker_id]->buckets[key_id].byte,
-				byte_rate / rl->nb_workers, byte_burst / rl->nb_workers);
-		lf_token_bucket_set(&rl->workers[worker_id]->buckets[key_id].packet,
-				packet_rate / rl->nb_workers, packet_burst / rl->nb_workers);
+	set_worker_limits(rl, key_id + LF_RATELIMITER_PEER_OFFSET, byte_rate,
+			byte_burst, packet_rate, packet_burst);
+	/* the workers find the peer only after its rate limits are set */
+	if (replicas_set(rl, &dictionary_key, key_id) != 0) {
+		return -1;
 	}
-	if (rl->nb_workers > 0) {
+	if (rl->nb_workers > 0 && !rl->redistribute && rl->cache_size == 0) {
 		LF_RATELIMITER_LOG(DEBUG,
 				"Per-worker rate limit: byte rate = %" PRIu64
 				" , packet rate = %" PRIu64 ".\n",
@@ -205,6 +360,82 @@ set_as_limit(struct lf_ratelimiter *rl, uint64_t isd_as,
 	return 0;
 }
 
+/**
+ * Set the host rate limit of the peer with the given key_id, which is split
+ * equally among the workers. Requires the management lock!
+ */
+static void
+set_host_limit(struct lf_ratelimiter *rl, int key_id, bool enabled,
+		const struct lf_config_ratelimit *ratelimit)
+{
+	struct lf_ratelimiter_host_limit *host_limit = &rl->host_limits[key_id];
+
+	if (rl->nb_workers == 0) {
+		return;
+	}
+
+	atomic_store_explicit(&host_limit->byte_rate,
+			ratelimit->byte_rate / rl->nb_workers, memory_order_relaxed);
+	atomic_store_explicit(&host_limit->byte_burst,
+			ratelimit->byte_burst / rl->nb_workers, memory_order_relaxed);
+	atomic_store_explicit(&host_limit->packet_rate,
+			ratelimit->packet_rate / rl->nb_workers, memory_order_relaxed);
+	atomic_store_explicit(&host_limit->packet_burst,
+			ratelimit->packet_burst / rl->nb_workers, memory_order_relaxed);
+	atomic_store_explicit(&host_limit->enabled, enabled, memory_order_relaxed);
+}
+
+/**
+ * Allocate the workers' host tables, unless they are already allocated. The
+ * tables are zeroed, i.e., all entries are unused, before they are published to
+ * the workers. Requires the management lock!
+ */
+static int
+host_tables_alloc(struct lf_ratelimiter *rl)
+{
+	int worker_id;
+	struct lf_ratelimiter_host_entry *hosts;
+
+	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
+		if (rl->workers[worker_id]->hosts != NULL) {
+			continue;
+		}
+		hosts = rte_calloc_socket(NULL,
+				LF_RATELIMITER_HOST_SETS * LF_RATELIMITER_HOST_WAYS,
+				sizeof(*hosts), RTE_CACHE_LINE_SIZE,
+				(int)rl->worker_socket[worker_id]);
+		if (hosts == NULL) {
+			LF_RATELIMITER_LOG(ERR,
+					"Fail to allocate memory for worker host table.\n");
+			return -1;
+		}
+		atomic_thread_fence(memory_order_release);
+		rl->workers[worker_id]->hosts = hosts;
+	}
+	return 0;
+}
+
+/**
+ * Invalidate the entries of the workers' host tables, such that the hosts'
+ * buckets are initialized with the current rate limits. Requires the
+ * management lock!
+ */
+static void
+invalidate_host_entries(struct lf_ratelimiter *rl)
+{
+	int worker_id;
+
+	rl->host_generation++;
+	if (rl->host_generation == 0) {
+		/* 0 indicates an unused entry */
+		rl->host_generation = 1;
+	}
+	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
+		atomic_store_explicit(&rl->workers[worker_id]->host_generation,
+				rl->host_generation, memory_order_relaxed);
+	}
+}
+
 /**
  * Set overall rate limit. Requires the managements lock!
  */
@@ -212,19 +443,14 @@ static int
 set_overall_limit(struct lf_ratelimiter *rl, uint64_t byte_rate,
 		uint64_t byte_burst, uint64_t packet_rate, uint64_t packet_burst)
 {
-	int worker_id;
 	LF_RATELIMITER_LOG(DEBUG,
 			"Set overall ratelimit (byte_rate: %ld, "
 			"packet_rate: %ld\n",
 			byte_rate, packet_rate);
 	dictionary_data_set(&rl->overall, byte_rate, byte_burst, packet_rate,
 			packet_burst);
-	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
-		lf_token_bucket_set(&rl->workers[worker_id]->overall.byte,
-				byte_rate / rl->nb_workers, byte_burst / rl->nb_workers);
-		lf_token_bucket_set(&rl->workers[worker_id]->overall.packet,
-				packet_rate / rl->nb_workers, packet_burst / rl->nb_workers);
-	}
+	set_worker_limits(rl, LF_RATELIMITER_OVERALL_ID, byte_rate, byte_burst,
+			packet_rate, packet_burst);
 
 	return 0;
 }
@@ -236,19 +462,14 @@ static int
 set_auth_peers_limit(struct lf_ratelimiter *rl, uint64_t byte_rate,
 		uint64_t byte_burst, uint64_t packet_rate, uint64_t packet_burst)
 {
-	int worker_id;
 	LF_RATELIMITER_LOG(DEBUG,
 			"Set auth peers rate limit (byte_rate: %ld, "
 			"packet_rate: %ld\n",
 			byte_rate, packet_rate);
 	dictionary_data_set(&rl->auth_peers, byte_rate, byte_burst, packet_rate,
 			packet_burst);
-	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
-		lf_token_bucket_set(&rl->workers[worker_id]->auth_peers.byte,
-				byte_rate / rl->nb_workers, byte_burst / rl->nb_workers);
-		lf_token_bucket_set(&rl->workers[worker_id]->auth_peers.packet,
-				packet_rate / rl->nb_workers, packet_burst / rl->nb_workers);
-	}
+	set_scaled_worker_limits(rl, LF_RATELIMITER_AUTH_PEERS_ID, &rl->auth_peers,
+			rl->auth_peers_scale);
 
 	return 0;
 }
@@ -260,19 +481,14 @@ static int
 set_besteffort_limit(struct lf_ratelimiter *rl, uint64_t byte_rate,
 		uint64_t byte_burst, uint64_t packet_rate, uint64_t packet_burst)
 {
-	int worker_id;
 	LF_RATELIMITER_LOG(DEBUG,
 			"Set best-effort ratelimit (byte_rate: %ld, "
 			"packet_rate: %ld\n",
 			byte_rate, packet_rate);
 	dictionary_data_set(&rl->best_effort, byte_rate, byte_burst, packet_rate,
 			packet_burst);
-	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
-		lf_token_bucket_set(&rl->workers[worker_id]->best_effort.byte,
-				byte_rate / rl->nb_workers, byte_burst / rl->nb_workers);
-		lf_token_bucket_set(&rl->workers[worker_id]->best_effort.packet,
-				packet_rate / rl->nb_workers, packet_burst / rl->nb_workers);
-	}
+	set_scaled_worker_limits(rl, LF_RATELIMITER_BEST_EFFORT_ID,
+			&rl->best_effort, rl->best_effort_scale);
 
 	return 0;
 }
@@ -283,6 +499,11 @@ synchronize_worker(struct lf_ratelimiter *rl)
 	rte_rcu_qsbr_synchronize(rl->qsv, RTE_QSBR_THRID_INVALID);
 }
 
+/* the dictionary keys are looked up in the config's peer set */
+static_assert(sizeof(struct lf_ratelimiter_key) ==
+					  sizeof(struct lf_config_peer_key),
+		"unexpected dictionary key size");
+
 int
 lf_ratelimiter_apply_config(struct lf_ratelimiter *rl, struct lf_config *config)
 {
@@ -290,11 +511,11 @@ lf_ratelimiter_apply_config(struct lf_ratelimiter *rl, struct lf_config *config)
 	int key_id;
 	uint32_t ratelimit_counter;
 	uint32_t iterator;
-	bool is_in_list;
 	struct lf_ratelimiter_key *key_ptr;
-	struct lf_ratelimiter_data *dictionary_data;
+	struct lf_ratelimiter_key dictionary_key;
+	void *dictionary_data;
 	struct lf_config_peer *peer;
-	int worker_id;
+	struct rte_hash *peer_set;
 
 	rte_spinlock_lock(&rl->management_lock);
 	LF_RATELIMITER_LOG(NOTICE, "Apply config...\n");
@@ -318,35 +539,51 @@ lf_ratelimiter_apply_config(struct lf_ratelimiter *rl, struct lf_config *config)
 		goto exit;
 	}
 
-	/* remove dictionary entries which are not anymore in config */
-	for (iterator = 0; (key_id = rte_hash_iterate(rl->dict, (void *)&key_ptr,
-								(void **)&dictionary_data, &iterator)) >= 0;) {
-		is_in_list = false;
-		for (peer = config->peers; peer != NULL; peer = peer->next) {
-			if (peer->isd_as == key_ptr->as &&
-					peer->drkey_protocol == key_ptr->drkey_protocol) {
-				is_in_list = true;
-				break;
-			}
+	/* the host tables are allocated once host rate limits are configured */
+	for (peer = config->peers; peer != NULL; peer = peer->next) {
+		if (peer->host_ratelimit_option) {
+			err = host_tables_alloc(rl);
+			break;
 		}
+	}
+	if (err != 0) {
+		goto exit;
+	}
 
-		if (!is_in_list) {
+	peer_set = lf_config_peer_set_new(config);
+	if (peer_set == NULL) {
+		err = -1;
+		goto exit;
+	}
 
+	/* remove dictionary entries which are not anymore in config */
+	for (iterator = 0; (key_id = rte_hash_iterate(rl->dict, (void *)&key_ptr,
+								(void **)&dictionary_data, &iterator)) >= 0;) {
+		if (rte_hash_lookup(peer_set, key_ptr) < 0) {
 			LF_RATELIMITER_LOG(DEBUG,
 					"Remove entry for AS " PRIISDAS " DRKey protocol %u\n",
 					PRIISDAS_VAL(rte_be_to_cpu_64(key_ptr->as)),
 					key_ptr->drkey_protocol);
-			(void)rte_hash_del_key(rl->dict, key_ptr);
-			rte_free(dictionary_data);
-
-			for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
-				lf_token_bucket_set(
-						&rl->workers[worker_id]->buckets[key_id].byte, 0, 0);
-				lf_token_bucket_set(
-						&rl->workers[worker_id]->buckets[key_id].packet, 0, 0);
-			}
+			replicas_del(rl, key_ptr);
+			/* the dictionary is not accessed by the workers, i.e., the key
+			 * position can be freed immediately. It is not reassigned before
+			 * the workers have been synchronized below. */
+			(void)rte_hash_free_key_with_position(rl->dict,
+					rte_hash_del_key(rl->dict, key_ptr));
+
+			set_worker_limits(rl, key_id + LF_RATELIMITER_PEER_OFFSET, 0, 0, 0,
+					0);
+			set_host_limit(rl, key_id, false, &(struct lf_config_ratelimit){ 0 });
 		}
 	}
+	rte_hash_free(peer_set);
+
+	/*
+	 * The host entries are identified by the peer's key_id, which might be
+	 * reassigned to another peer. Hence, they are invalidated before adding
+	 * new entries.
+	 */
+	invalidate_host_entries(rl);
 
 	/*
 	 * Wait for all workers to observe the removal of entries.
@@ -367,8 +604,18 @@ lf_ratelimiter_apply_config(struct lf_ratelimiter *rl, struct lf_config *config)
 		if (err != 0) {
 			goto exit;
 		}
+
+		dictionary_key.as = peer->isd_as;
+		dictionary_key.drkey_protocol = peer->drkey_protocol;
+		key_id = rte_hash_lookup(rl->dict, &dictionary_key);
+		assert(key_id >= 0);
+		set_host_limit(rl, key_id, peer->host_ratelimit_option,
+				&peer->host_ratelimit);
 	}
 
+	/* the host buckets are initialized with the new host rate limits */
+	invalidate_host_entries(rl);
+
 	/* set overall rate limit */
 	(void)set_overall_limit(rl, config->ratelimit.byte_rate,
 			config->ratelimit.byte_burst, config->ratelimit.packet_rate,
@@ -399,27 +646,249 @@ exit:
 	return 0;
 }
 
+/*
+ * Token Redistribution
+ */
+
+/**
+ * Every worker obtains at least 1 / (LF_RATELIMITER_MIN_SHARE * nb_workers) of
+ * the rate limit assigned to the workers, such that an idle worker can serve
+ * packets until the next redistribution.
+ */
+#define LF_RATELIMITER_MIN_SHARE 4
+
+static inline _Atomic(uint64_t) *
+demand_tokens(struct lf_ratelimiter_demand *demand, bool bytes)
+{
+	return bytes ? &demand->byte : &demand->packet;
+}
+
+static inline _Atomic(uint64_t) *
+pool_tokens(struct lf_ratelimiter_pool *pool, bool bytes)
+{
+	return bytes ? &pool->byte : &pool->packet;
+}
+
+static inline struct lf_ratelimiter_bucket *
+ratelimit_bucket(struct lf_ratelimiter_limit *ratelimit, bool bytes)
+{
+	return bytes ? &ratelimit->byte : &ratelimit->packet;
+}
+
+/**
+ * Redistribute the byte or packet rate of the rate limit with the given id
+ * according to the workers' demand since the last update and refill the pool.
+ * Requires the management lock!
+ */
+static void
+redistribute_tokens(struct lf_ratelimiter *rl, uint32_t id, bool bytes,
+		uint64_t rate, uint64_t burst, uint64_t elapsed_ns)
+{
+	uint16_t worker_id;
+	uint64_t current, last, total_demand = 0;
+	uint64_t demand[LF_MAX_WORKER];
+	uint64_t worker_rate, worker_burst;
+	uint64_t pool_burst, refill, available, refilled;
+	double share;
+	_Atomic(uint64_t) *pool;
+
+	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
+		current = atomic_load_explicit(
+				demand_tokens(&rl->workers[worker_id]->demand[id], bytes),
+				memory_order_relaxed);
+		last = atomic_load_explicit(
+				demand_tokens(&rl->last_demand[worker_id][id], bytes),
+				memory_order_relaxed);
+		atomic_store_explicit(
+				demand_tokens(&rl->last_demand[worker_id][id], bytes), current,
+				memory_order_relaxed);
+		demand[worker_id] = current - last;
+		total_demand += demand[worker_id];
+	}
+
+	worker_rate = rate - rate / LF_RATELIMITER_POOL_SHARE;
+	worker_burst = burst - burst / LF_RATELIMITER_POOL_SHARE;
+	for (worker_id = 0; worker_id < rl->nb_workers; ++worker_id) {
+		if (total_demand == 0) {
+			share = 1.0 / rl->nb_workers;
+		} else {
+			share = 1.0 / (LF_RATELIMITER_MIN_SHARE * rl->nb_workers) +
+			        (1.0 - 1.0 / LF_RATELIMITER_MIN_SHARE) *
+			                (double)demand[worker_id] / (double)total_demand;
+		}
+		lf_ratelimiter_bucket_set(
+				ratelimit_bucket(worker_ratelimit(rl->workers[worker_id], id),
+						bytes),
+				(uint64_t)((double)worker_rate * share),
+				(uint64_t)((double)worker_burst * share));
+	}
+
+	/* refill the pool up to the pool's burst size */
+	pool = pool_tokens(&rl->pool[id], bytes);
+	pool_burst = burst / LF_RATELIMITER_POOL_SHARE;
+	refill = (uint64_t)MIN((double)(rate / LF_RATELIMITER_POOL_SHARE) *
+	                               (double)elapsed_ns / (double)LF_TIME_NS_IN_S,
+			(double)pool_burst);
+	available = atomic_load_explicit(pool, memory_order_relaxed);
+	do {
+		refilled = MIN(available + refill, pool_burst);
+	} while (!atomic_compare_exchange_weak_explicit(pool, &available, refilled,
+			memory_order_relaxed, memory_order_relaxed));
+}
+
+/**
+ * Redistribute the rate limit and refill its pool according to the time since
+ * its last redistribution. Requires the management lock!
+ */
+static void
+redistribute_limit(struct lf_ratelimiter *rl, uint32_t id,
+		const struct lf_ratelimiter_data *data)
+{
+	uint64_t elapsed_ns = rl->redistribution_ns - rl->refill_ns[id];
+
+	redistribute_tokens(rl, id, true, data->byte_rate, data->byte_burst,
+			elapsed_ns);
+	redistribute_tokens(rl, id, false, data->packet_rate, data->packet_burst,
+			elapsed_ns);
+	rl->refill_ns[id] = rl->redistribution_ns;
+}
+
+void
+lf_ratelimiter_service_update(struct lf_ratelimiter *rl, uint64_t elapsed_ns)
+{
+	int key_id;
+	uint32_t nb_peers;
+	struct lf_ratelimiter_key *key_ptr;
+	void *dictionary_data;
+	struct lf_ratelimiter_data scaled;
+
+	if (!rl->redistribute || rl->nb_workers == 0) {
+		return;
+	}
+
+	rte_spinlock_lock(&rl->management_lock);
+
+	rl->redistribution_ns += elapsed_ns;
+	redistribute_limit(rl, LF_RATELIMITER_OVERALL_ID, &rl->overall);
+	scaled = scale_data(&rl->auth_peers, rl->auth_peers_scale);
+	redistribute_limit(rl, LF_RATELIMITER_AUTH_PEERS_ID, &scaled);
+	scaled = scale_data(&rl->best_effort, rl->best_effort_scale);
+	redistribute_limit(rl, LF_RATELIMITER_BEST_EFFORT_ID, &scaled);
+	/* the peers' shared limits of the compact mode are not redistributed */
+	if (rl->cache_size != 0) {
+		rte_spinlock_unlock(&rl->management_lock);
+		return;
+	}
+
+	/* continue with the next batch of peers, and start over at the end */
+	for (nb_peers = 0; nb_peers < LF_RATELIMITER_REDISTRIBUTION_BATCH;
+			++nb_peers) {
+		key_id = rte_hash_iterate(rl->dict, (void *)&key_ptr,
+				(void **)&dictionary_data, &rl->redistribution_iterator);
+		if (key_id < 0) {
+			rl->redistribution_iterator = 0;
+			break;
+		}
+		redistribute_limit(rl, key_id + LF_RATELIMITER_PEER_OFFSET,
+				&rl->peer_limits[key_id]);
+	}
+
+	rte_spinlock_unlock(&rl->management_lock);
+}
+
+int
+lf_ratelimiter_set_scale(struct lf_ratelimiter *rl, uint32_t best_effort_scale,
+		uint32_t auth_peers_scale)
+{
+	if (best_effort_scale > LF_RATELIMITER_SCALE_ONE ||
+			auth_peers_scale > LF_RATELIMITER_SCALE_ONE) {
+		return -1;
+	}
+
+	rte_spinlock_lock(&rl->management_lock);
+	if (best_effort_scale != rl->best_effort_scale) {
+		rl->best_effort_scale = best_effort_scale;
+		set_scaled_worker_limits(rl, LF_RATELIMITER_BEST_EFFORT_ID,
+				&rl->best_effort, best_effort_scale);
+	}
+	if (auth_peers_scale != rl->auth_peers_scale) {
+		rl->auth_peers_scale = auth_peers_scale;
+		set_scaled_worker_limits(rl, LF_RATELIMITER_AUTH_PEERS_ID,
+				&rl->auth_peers, auth_peers_scale);
+	}
+	rte_spinlock_unlock(&rl->management_lock);
+
+	return 0;
+}
+
+int
+lf_ratelimiter_service_launch(struct lf_ratelimiter *rl)
+{
+	uint64_t current_tsc, last_update_tsc, period_tsc, hz;
+
+	/* measure time using the time stamp counter */
+	last_update_tsc = rte_rdtsc();
+	hz = rte_get_timer_hz();
+	period_tsc =
+			(uint64_t)((double)hz * LF_RATELIMITER_REDISTRIBUTION_INTERVAL);
+
+	while (!lf_force_quit) {
+		current_tsc = rte_rdtsc();
+		if (current_tsc - last_update_tsc >= period_tsc) {
+			lf_ratelimiter_service_update(rl,
+					(uint64_t)((double)(current_tsc - last_update_tsc) /
+							   (double)hz * (double)LF_TIME_NS_IN_S));
+			last_update_tsc = current_tsc;
+
+			/* potentially the clock speed has changed */
+			hz = rte_get_timer_hz();
+			period_tsc = (uint64_t)((double)hz *
+									LF_RATELIMITER_REDISTRIBUTION_INTERVAL);
+		}
+	}
+
+	return 0;
+}
+
 void
 lf_ratelimiter_close(struct lf_ratelimiter *rl)
 {
 	size_t i;
-
-	rte_hash_free(rl->dict);
+	unsigned int socket;
 
 	for (i = 0; i < rl->nb_workers; i++) {
-		rte_free(rl->workers[i]);
+		rte_free(rl->workers[i]->buckets);
+		rte_free(rl->workers[i]->cache);
+		rte_free(rl->workers[i]->demand);
+		rte_free(rl->last_demand[i]);
+		rte_free(rl->workers[i]->hosts);
+	}
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		rte_free(rl->shared[socket]);
+		rl->shared[socket] = NULL;
+		/* the replicas' data are key_ids and not allocated */
+		rte_hash_free(rl->socket_dict[socket]);
+		rl->socket_dict[socket] = NULL;
 	}
+	rte_free(rl->pool);
+	rte_free(rl->refill_ns);
+	rte_free(rl->host_limits);
+	rte_free(rl->peer_limits);
 
-	dictionary_free(rl->dict);
+	rte_hash_free(rl->dict);
 }
 
 int
 lf_ratelimiter_init(struct lf_ratelimiter *rl,
 		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
-		uint32_t initial_size, struct rte_rcu_qsbr *qsv,
+		uint32_t initial_size, bool redistribute, uint32_t cache_size,
+		struct rte_rcu_qsbr *qsv,
 		struct lf_ratelimiter_worker *workers[LF_MAX_WORKER])
 {
 	size_t i;
+	uint32_t nb_ids, key_id;
+	unsigned int socket;
+	struct rte_hash_rcu_config rcu_config = { 0 };
 
 	LF_RATELIMITER_LOG(DEBUG, "Init\n");
 
@@ -436,36 +905,265 @@ lf_ratelimiter_init(struct lf_ratelimiter *rl,
 	// NOLINTEND(readability-magic-numbers)
 
 	rl->size = initial_size;
-	rl->dict = dictionary_new(initial_size);
+	rl->dict = dictionary_new(initial_size, (int)rte_socket_id());
 	if (rl->dict == NULL) {
 		return -1;
 	}
 
 	rte_spinlock_init(&rl->management_lock);
 
+	if (cache_size != 0 && (!rte_is_power_of_2(cache_size) ||
+								   cache_size < LF_RATELIMITER_CACHE_WAYS)) {
+		LF_RATELIMITER_LOG(ERR,
+				"Cache size must be a power of 2 and at least %d.\n",
+				LF_RATELIMITER_CACHE_WAYS);
+		return -1;
+	}
+	rl->cache_size = cache_size;
+
+	/*
+	 * Rate limits with demand counters and pools (peers and the others).
+	 * In the compact mode, only the others.
+	 */
+	nb_ids = initial_size + LF_RATELIMITER_PEER_OFFSET;
+	if (cache_size != 0) {
+		nb_ids = LF_RATELIMITER_PEER_OFFSET;
+	}
+	rl->redistribute = redistribute;
+	rl->pool = NULL;
+	rl->refill_ns = NULL;
+	rl->redistribution_ns = 0;
+	rl->redistribution_iterator = 0;
+	if (redistribute) {
+		rl->pool = rte_calloc(NULL, nb_ids, sizeof(*rl->pool),
+				RTE_CACHE_LINE_SIZE);
+		rl->refill_ns = rte_calloc(NULL, nb_ids, sizeof(*rl->refill_ns), 0);
+		if (rl->pool == NULL || rl->refill_ns == NULL) {
+			LF_RATELIMITER_LOG(ERR,
+					"Fail to allocate memory for token pools.\n");
+			return -1;
+		}
+		LF_RATELIMITER_LOG(INFO, "Token redistribution enabled\n");
+	}
+
+	/* rate limits of the peers, indexed by the key_id */
+	rl->peer_limits = rte_calloc(NULL, initial_size, sizeof(*rl->peer_limits),
+			RTE_CACHE_LINE_SIZE);
+	if (rl->peer_limits == NULL) {
+		LF_RATELIMITER_LOG(ERR,
+				"Fail to allocate memory for peer rate limits.\n");
+		return -1;
+	}
+
+	/* host rate limits of the peers (disabled) */
+	rl->host_generation = 1;
+	rl->host_limits = rte_calloc(NULL, initial_size, sizeof(*rl->host_limits),
+			RTE_CACHE_LINE_SIZE);
+	if (rl->host_limits == NULL) {
+		LF_RATELIMITER_LOG(ERR,
+				"Fail to allocate memory for host rate limits.\n");
+		return -1;
+	}
+
 	/* init overall rate limit */
 	dictionary_data_set(&rl->overall, 0, 0, 0, 0);
 	/* init auth peers rate limit */
 	dictionary_data_set(&rl->auth_peers, 0, 0, 0, 0);
 	/* init best-effort rate limit */
 	dictionary_data_set(&rl->best_effort, 0, 0, 0, 0);
+	rl->auth_peers_scale = LF_RATELIMITER_SCALE_ONE;
+	rl->best_effort_scale = LF_RATELIMITER_SCALE_ONE;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		rl->shared[socket] = NULL;
+		rl->nb_socket_workers[socket] = 0;
+		rl->socket_dict[socket] = NULL;
+	}
 
 	for (i = 0; i < nb_workers; ++i) {
-		workers[i]->dict = rl->dict;
+		workers[i]->buckets = NULL;
+		workers[i]->shared = NULL;
+		workers[i]->cache = NULL;
+		workers[i]->cache_mask = 0;
+		socket = rte_lcore_to_socket_id(worker_lcores[i]);
+
+		/* the first worker on the socket creates the dictionary replica */
+		if (rl->socket_dict[socket] == NULL) {
+			rl->socket_dict[socket] = dictionary_new(initial_size, (int)socket);
+			if (rl->socket_dict[socket] == NULL) {
+				return -1;
+			}
+			/* free the key positions of removed peers once no worker
+			 * accesses them anymore */
+			rcu_config.v = qsv;
+			rcu_config.mode = RTE_HASH_QSBR_MODE_DQ;
+			if (rte_hash_rcu_qsbr_add(rl->socket_dict[socket], &rcu_config) !=
+					0) {
+				LF_RATELIMITER_LOG(ERR,
+						"Fail to add RCU to dictionary on socket %u.\n",
+						socket);
+				return -1;
+			}
+		}
+		workers[i]->dict = rl->socket_dict[socket];
+
+		if (cache_size == 0) {
+			/* init workers' buckets */
+			workers[i]->buckets = rte_calloc_socket(NULL, initial_size,
+					sizeof(*workers[i]->buckets), RTE_CACHE_LINE_SIZE,
+					(int)socket);
+			if (workers[i]->buckets == NULL) {
+				LF_RATELIMITER_LOG(ERR, "Fail to allocate memory for worker "
+										"dictionary data.\n");
+				return -1;
+			}
+		} else {
+			/* the first worker on the socket allocates the shared limits,
+			 * which block all traffic until they are set */
+			if (rl->shared[socket] == NULL) {
+				rl->shared[socket] = rte_calloc_socket(NULL, initial_size,
+						sizeof(*rl->shared[socket]), RTE_CACHE_LINE_SIZE,
+						(int)socket);
+				if (rl->shared[socket] == NULL) {
+					LF_RATELIMITER_LOG(ERR, "Fail to allocate memory for "
+											"shared rate limits.\n");
+					return -1;
+				}
+				for (key_id = 0; key_id < initial_size; ++key_id) {
+					lf_tsb_shared_init(&rl->shared[socket][key_id].byte, 0, 0);
+					lf_tsb_shared_init(&rl->shared[socket][key_id].packet, 0,
+							0);
+				}
+			}
+			rl->nb_socket_workers[socket]++;
+			workers[i]->shared = rl->shared[socket];
+
+			/* init workers' caches */
+			workers[i]->cache_mask = cache_size / LF_RATELIMITER_CACHE_WAYS - 1;
+			workers[i]->cache = rte_calloc_socket(NULL, cache_size,
+					sizeof(*workers[i]->cache), RTE_CACHE_LINE_SIZE,
+					(int)socket);
+			if (workers[i]->cache == NULL) {
+				LF_RATELIMITER_LOG(ERR,
+						"Fail to allocate memory for worker cache.\n");
+				return -1;
+			}
+		}
 
-		/* init workers' buckets */
-		workers[i]->buckets = rte_calloc_socket(NULL, initial_size,
-				sizeof(*workers[i]->buckets), RTE_CACHE_LINE_SIZE,
-				(int)rte_lcore_to_socket_id(worker_lcores[i]));
-		if (workers[i]->buckets == NULL) {
-			LF_RATELIMITER_LOG(ERR,
-					"Fail to allocate memory for worker dictionary data.\n");
+		/* the workers' host tables are allocated with the first config
+		 * defining host rate limits */
+		workers[i]->host_limits = rl->host_limits;
+		workers[i]->host_generation = rl->host_generation;
+		workers[i]->hosts = NULL;
+		rl->worker_socket[i] = socket;
+
+		workers[i]->demand = NULL;
+		workers[i]->pool = rl->pool;
+		rl->last_demand[i] = NULL;
+		if (redistribute) {
+			workers[i]->demand = rte_calloc_socket(NULL, nb_ids,
+					sizeof(*workers[i]->demand), RTE_CACHE_LINE_SIZE,
+					(int)socket);
+			rl->last_demand[i] = rte_calloc(NULL, nb_ids,
+					sizeof(*rl->last_demand[i]), 0);
+			if (workers[i]->demand == NULL || rl->last_demand[i] == NULL) {
+				LF_RATELIMITER_LOG(ERR,
+						"Fail to allocate memory for worker demand.\n");
+				return -1;
+			}
 		}
 
 		/* update worker's context */
 		rl->workers[i] = workers[i];
 	}
 
+	if (cache_size != 0) {
+		LF_RATELIMITER_LOG(INFO,
+				"Compact mode enabled (cache size per worker: %u)\n",
+				cache_size);
+	}
+
+	return 0;
+}
+
+/*
+ * Ratelimiter Telemetry Functionalities
+ */
+
+/* Ratelimiter context used when telemetry commands are processed. */
+static struct lf_ratelimiter *tel_ctx;
+
+static int
+handle_memory(const char *cmd __rte_unused, const char *params __rte_unused,
+		struct rte_tel_data *d)
+{
+	uint16_t worker_id;
+	unsigned int socket;
+	uint64_t nb_ids;
+	uint64_t buckets = 0, cache = 0, shared = 0, hosts = 0, demand = 0;
+
+	nb_ids = tel_ctx->cache_size == 0
+	               ? tel_ctx->size + LF_RATELIMITER_PEER_OFFSET
+	               : LF_RATELIMITER_PEER_OFFSET;
+
+	for (worker_id = 0; worker_id < tel_ctx->nb_workers; ++worker_id) {
+		if (tel_ctx->workers[worker_id]->buckets != NULL) {
+			buckets += (uint64_t)tel_ctx->size *
+			           sizeof(*tel_ctx->workers[worker_id]->buckets);
+		}
+		cache += (uint64_t)tel_ctx->cache_size *
+		         sizeof(*tel_ctx->workers[worker_id]->cache);
+		if (tel_ctx->workers[worker_id]->hosts != NULL) {
+			hosts += (uint64_t)LF_RATELIMITER_HOST_SETS *
+			         LF_RATELIMITER_HOST_WAYS *
+			         sizeof(*tel_ctx->workers[worker_id]->hosts);
+		}
+		if (tel_ctx->redistribute) {
+			demand += nb_ids *
+			          (sizeof(*tel_ctx->workers[worker_id]->demand) +
+			           sizeof(*tel_ctx->last_demand[worker_id]));
+		}
+	}
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; ++socket) {
+		if (tel_ctx->shared[socket] != NULL) {
+			shared += (uint64_t)tel_ctx->size *
+			          sizeof(*tel_ctx->shared[socket]);
+		}
+	}
+	if (tel_ctx->redistribute) {
+		demand += nb_ids *
+		          (sizeof(*tel_ctx->pool) + sizeof(*tel_ctx->refill_ns));
+	}
+	hosts += (uint64_t)tel_ctx->size * sizeof(*tel_ctx->host_limits);
+
+	rte_tel_data_start_dict(d);
+	rte_tel_data_add_dict_uint(d, "memory_bytes",
+			buckets + cache + shared + hosts + demand);
+	rte_tel_data_add_dict_uint(d, "worker_buckets_bytes", buckets);
+	rte_tel_data_add_dict_uint(d, "worker_cache_bytes", cache);
+	rte_tel_data_add_dict_uint(d, "shared_buckets_bytes", shared);
+	rte_tel_data_add_dict_uint(d, "host_tables_bytes", hosts);
+	rte_tel_data_add_dict_uint(d, "demand_bytes", demand);
+	rte_tel_data_add_dict_uint(d, "peers", tel_ctx->size);
+	rte_tel_data_add_dict_uint(d, "cache_size", tel_ctx->cache_size);
+
+	return 0;
+}
+
+int
+lf_ratelimiter_register_telemetry(struct lf_ratelimiter *rl)
+{
+	int res;
+	tel_ctx = rl;
+
+	res = rte_telemetry_register_cmd(LF_TELEMETRY_PREFIX "/ratelimiter/memory",
+			handle_memory,
+			"Returns the memory used by the rate limiter (bytes), excluding "
+			"the dictionary.");
+	if (res != 0) {
+		return -1;
+	}
+
 	return 0;
 }
 
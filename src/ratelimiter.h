@@ -5,29 +5,286 @@
 #ifndef LF_RATELIMITER_H
 #define LF_RATELIMITER_H
 
+#include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdatomic.h>
+#include <string.h>
 
+#include <rte_branch_prediction.h>
 #include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_prefetch.h>
 #include <rte_rcu_qsbr.h>
 #include <rte_spinlock.h>
 
 #include "config.h"
 #include "lf.h"
+#include "lib/math/util.h"
+#include "lib/ratelimiter/timestamp_bucket.h"
+#if !LF_RATELIMITER_TSB
 #include "lib/ratelimiter/token_bucket.h"
+#endif
 
 /**
  * This module provides the rate limiting functionalities.
  */
 
+/**
+ * Bucket engine:
+ * Per default, the rate limits are enforced with token buckets
+ * (lf_token_bucket). With the build option LF_RATELIMITER_TSB, timestamp
+ * buckets (lf_tsb) are used instead, which do not require a division per check
+ * and only require 32 bytes per rate limit (packets and bytes), i.e., two rate
+ * limits fit into a cache line.
+ */
+struct lf_ratelimiter_bucket {
+#if LF_RATELIMITER_TSB
+	struct lf_tsb tsb;
+#else
+	struct lf_token_bucket tb;
+#endif
+};
+
+struct lf_ratelimiter_limit {
+	struct lf_ratelimiter_bucket packet;
+	struct lf_ratelimiter_bucket byte;
+};
+
+/**
+ * Set the rate (token/s) and burst size of the bucket.
+ * IMPORTANT: To set the rate limit to 0, the rate and burst size must be set to
+ * 0!
+ */
+static inline void
+lf_ratelimiter_bucket_set(struct lf_ratelimiter_bucket *bucket, uint64_t rate,
+		uint64_t burst)
+{
+#if LF_RATELIMITER_TSB
+	lf_tsb_set(&bucket->tsb, rate, burst);
+#else
+	lf_token_bucket_set(&bucket->tb, rate, burst);
+#endif
+}
+
+/**
+ * @return Returns 0 if enough tokens are available, otherwise -1.
+ */
+static inline int
+lf_ratelimiter_bucket_check(struct lf_ratelimiter_bucket *bucket,
+		uint64_t tokens, uint64_t ns_now)
+{
+#if LF_RATELIMITER_TSB
+	return lf_tsb_check(&bucket->tsb, tokens, ns_now);
+#else
+	return lf_token_bucket_check(&bucket->tb, tokens, ns_now);
+#endif
+}
+
+/**
+ * Consume tokens, which must have been checked before.
+ */
+static inline void
+lf_ratelimiter_bucket_consume(struct lf_ratelimiter_bucket *bucket,
+		uint64_t tokens)
+{
+#if LF_RATELIMITER_TSB
+	lf_tsb_consume(&bucket->tsb, tokens);
+#else
+	(void)lf_token_bucket_consume(&bucket->tb, tokens);
+#endif
+}
+
+/**
+ * Number of tokens missing after a failed check.
+ * The timestamp bucket does not provide the number of available tokens without
+ * a division. Hence, all requested tokens are reported as missing.
+ */
+static inline uint64_t
+lf_ratelimiter_bucket_deficit(const struct lf_ratelimiter_bucket *bucket,
+		uint64_t tokens)
+{
+#if LF_RATELIMITER_TSB
+	(void)bucket;
+	return tokens;
+#else
+	return tokens - bucket->tb.tokens;
+#endif
+}
+
+/**
+ * Add tokens to the bucket, e.g., borrowed from a pool.
+ */
+static inline void
+lf_ratelimiter_bucket_add(struct lf_ratelimiter_bucket *bucket,
+		uint64_t tokens)
+{
+#if LF_RATELIMITER_TSB
+	lf_tsb_add(&bucket->tsb, tokens);
+#else
+	bucket->tb.tokens += tokens;
+#endif
+}
+
+/**
+ * Token redistribution:
+ * Instead of splitting the rate limits statically among the workers, the rate
+ * limits can be redistributed according to the workers' demand. Each worker
+ * counts the tokens requested per rate limit, and the ratelimiter service
+ * periodically (LF_RATELIMITER_REDISTRIBUTION_INTERVAL) sets the workers'
+ * rates and bursts proportionally to the demand measured since the last
+ * period (lf_ratelimiter_service_update()).
+ * A share of each rate limit (1 / LF_RATELIMITER_POOL_SHARE) is not assigned
+ * to a worker but refills a token pool shared by all workers. A worker whose
+ * bucket runs out of tokens borrows the missing tokens from the pool.
+ *
+ * The demand counters and pools are indexed by the rate limit id: the overall,
+ * auth peers and best-effort rate limits, followed by the peers' rate limits
+ * (key_id + LF_RATELIMITER_PEER_OFFSET).
+ *
+ * The overall, auth peers and best-effort rate limits are redistributed in
+ * every period, the peers' rate limits in batches of
+ * LF_RATELIMITER_REDISTRIBUTION_BATCH peers, such that a period's work and the
+ * time the management lock is held do not grow with the number of peers. A
+ * pool is refilled according to the time since its last redistribution. If
+ * the dictionary changes, a peer might be skipped or visited twice in one
+ * round.
+ */
+#define LF_RATELIMITER_REDISTRIBUTION_INTERVAL 0.01 /* seconds */
+#define LF_RATELIMITER_REDISTRIBUTION_BATCH    256
+#define LF_RATELIMITER_POOL_SHARE              8
+#define LF_RATELIMITER_OVERALL_ID              0
+#define LF_RATELIMITER_AUTH_PEERS_ID           1
+#define LF_RATELIMITER_BEST_EFFORT_ID          2
+#define LF_RATELIMITER_PEER_OFFSET             3
+
+/**
+ * Tokens requested by a worker. Only written by the worker itself.
+ */
+struct lf_ratelimiter_demand {
+	_Atomic(uint64_t) packet;
+	_Atomic(uint64_t) byte;
+};
+
+/**
+ * Tokens available to all workers.
+ */
+struct lf_ratelimiter_pool {
+	_Atomic(uint64_t) packet;
+	_Atomic(uint64_t) byte;
+};
+
+/**
+ * Host rate limits:
+ * In addition to the peer's rate limit, a rate limit can be defined for each
+ * source host of a peer, such that a single host cannot use up the peer's rate
+ * limit. Each worker stores the hosts' buckets in a fixed-size, set-associative
+ * table (LF_RATELIMITER_HOST_SETS sets of LF_RATELIMITER_HOST_WAYS entries). If
+ * all entries of a set are in use, the least recently used one is replaced.
+ * Hence, the memory is bounded, independent of the number of hosts.
+ *
+ * A host without entry is checked against a full bucket. Entries are only
+ * added when tokens are consumed, i.e., for packets that passed all checks
+ * including the MAC check. Therefore, packets with spoofed source addresses
+ * cannot evict the entries of other hosts.
+ * The entries are invalidated with a generation number when the configuration
+ * changes. Host rate limits are split equally among the workers and are not
+ * redistributed.
+ * The host tables are only allocated once a configuration defines host rate
+ * limits, and are kept until the rate limiter is closed.
+ */
+#define LF_RATELIMITER_HOST_SETS      (1 << 14)
+#define LF_RATELIMITER_HOST_WAYS      4
+#define LF_RATELIMITER_HOST_ADDR_SIZE 16
+
+struct lf_ratelimiter_host_key {
+	uint32_t key_id; /* peer's position in the dictionary */
+	uint8_t type_length;
+	uint8_t addr[LF_RATELIMITER_HOST_ADDR_SIZE];
+} __attribute__((__packed__));
+
+struct lf_ratelimiter_host_entry {
+	/* the entry is only valid if the generation matches the worker's */
+	uint32_t generation;
+	struct lf_ratelimiter_host_key key;
+	uint64_t last_used; /* nanoseconds */
+	struct lf_ratelimiter_limit ratelimit;
+};
+
+/**
+ * Per-worker host rate limit of a peer. Shared by all workers.
+ */
+struct lf_ratelimiter_host_limit {
+	_Atomic(bool) enabled;
+	_Atomic(uint64_t) byte_rate;
+	_Atomic(uint64_t) byte_burst;
+	_Atomic(uint64_t) packet_rate;
+	_Atomic(uint64_t) packet_burst;
+};
+
+/**
+ * Compact mode:
+ * Per default, every worker holds the buckets of all peers, i.e., the memory
+ * grows with the number of peers times the number of workers, even if a worker
+ * only sees a few peers. In the compact mode, the peers' rate limits are
+ * enforced by shared buckets (lf_tsb_shared), one per peer and NUMA socket,
+ * which are used by all workers on the socket and limit the socket's share of
+ * the rate limit. Each worker caches tokens taken from the shared buckets for
+ * the peers it recently saw in a small set-associative table (LRU
+ * replacement), such that the atomic operation on the shared bucket is only
+ * required about once per LF_RATELIMITER_CACHE_BATCH packets.
+ *
+ * Like host entries, cache entries are only added when tokens are consumed, and
+ * they are invalidated together with the host entries. Tokens left in an
+ * evicted entry are lost. The peers' rate limits are not redistributed in the
+ * compact mode, because the shared buckets already balance them among the
+ * workers of a socket.
+ */
+#define LF_RATELIMITER_CACHE_WAYS  4
+#define LF_RATELIMITER_CACHE_BATCH 16
+
+struct lf_ratelimiter_shared_limit {
+	struct lf_tsb_shared packet;
+	struct lf_tsb_shared byte;
+};
+
+struct lf_ratelimiter_cache_entry {
+	/* the entry is only valid if the generation matches the worker's */
+	uint32_t generation;
+	uint32_t key_id;
+	uint64_t last_used; /* nanoseconds */
+	/* tokens taken from the shared limit */
+	uint64_t packets;
+	uint64_t bytes;
+};
+
 struct lf_ratelimiter_worker {
+	/* replica of the dictionary on the worker's socket (key_id as data) */
 	struct rte_hash *dict;
 
-	struct lf_token_bucket_ratelimit *buckets;
+	/* peers' buckets (NULL in compact mode) */
+	struct lf_ratelimiter_limit *buckets;
+
+	/* compact mode: shared limits of the worker's socket (indexed by the
+	 * peers' key_id) and cache (number of sets - 1 as mask) */
+	struct lf_ratelimiter_shared_limit *shared;
+	struct lf_ratelimiter_cache_entry *cache;
+	uint32_t cache_mask;
 
-	struct lf_token_bucket_ratelimit overall;
-	struct lf_token_bucket_ratelimit auth_peers;
-	struct lf_token_bucket_ratelimit best_effort;
+	struct lf_ratelimiter_limit overall;
+	struct lf_ratelimiter_limit auth_peers;
+	struct lf_ratelimiter_limit best_effort;
+
+	/* token redistribution (NULL if disabled) */
+	struct lf_ratelimiter_demand *demand;
+	struct lf_ratelimiter_pool *pool;
+
+	/* host rate limits (indexed by the peers' key_id) and buckets (NULL if no
+	 * host rate limits have been configured) */
+	const struct lf_ratelimiter_host_limit *host_limits;
+	struct lf_ratelimiter_host_entry *hosts;
+	/* generation of the host and cache entries */
+	_Atomic(uint32_t) host_generation;
 };
 
 struct lf_ratelimiter_data {
@@ -41,13 +298,45 @@ struct lf_ratelimiter {
 	struct lf_ratelimiter_worker *workers[LF_MAX_WORKER];
 	uint16_t nb_workers;
 
+	/* dictionary of the peers (only accessed by the manager) and its replicas
+	 * for each socket with workers, which map a peer to its position in the
+	 * dictionary (key_id) */
 	struct rte_hash *dict;
+	struct rte_hash *socket_dict[RTE_MAX_NUMA_NODES];
 	/* max number of entries */
 	uint32_t size;
+	/* rate limits of the peers, indexed by the key_id */
+	struct lf_ratelimiter_data *peer_limits;
 
 	struct lf_ratelimiter_data overall;
 	struct lf_ratelimiter_data auth_peers;
 	struct lf_ratelimiter_data best_effort;
+	/* scales of the auth peers and best-effort rate limits */
+	uint32_t auth_peers_scale;
+	uint32_t best_effort_scale;
+
+	/* token redistribution */
+	bool redistribute;
+	struct lf_ratelimiter_pool *pool;
+	/* demand of each worker observed at the last redistribution */
+	struct lf_ratelimiter_demand *last_demand[LF_MAX_WORKER];
+	/* time passed in the service updates, the time each pool has been
+	 * refilled last, and the position of the next batch of peers */
+	uint64_t redistribution_ns;
+	uint64_t *refill_ns;
+	uint32_t redistribution_iterator;
+
+	/* host rate limits, and the workers' sockets, on which their host tables
+	 * are allocated once a peer defines host rate limits */
+	struct lf_ratelimiter_host_limit *host_limits;
+	uint32_t host_generation;
+	unsigned int worker_socket[LF_MAX_WORKER];
+
+	/* compact mode: entries of the workers' caches (0 if disabled) and the
+	 * shared limits of each socket */
+	uint32_t cache_size;
+	struct lf_ratelimiter_shared_limit *shared[RTE_MAX_NUMA_NODES];
+	uint16_t nb_socket_workers[RTE_MAX_NUMA_NODES];
 
 	/* synchronize management */
 	rte_spinlock_t management_lock;
@@ -62,9 +351,32 @@ struct lf_ratelimiter_key {
 
 struct lf_ratelimiter_pkt_ctx {
 	/* either peer rate limit or auth peers rate limit */
-	struct lf_token_bucket_ratelimit *peer_ratelimit;
+	struct lf_ratelimiter_limit *peer_ratelimit;
 	/* overall rate limit */
-	struct lf_token_bucket_ratelimit *overall_ratelimit;
+	struct lf_ratelimiter_limit *overall_ratelimit;
+
+	/* token redistribution (NULL if disabled) */
+	struct lf_ratelimiter_demand *peer_demand;
+	struct lf_ratelimiter_pool *peer_pool;
+	struct lf_ratelimiter_demand *overall_demand;
+	struct lf_ratelimiter_pool *overall_pool;
+
+	/* compact mode: peer's shared limit (otherwise NULL) and cache set */
+	struct lf_ratelimiter_shared_limit *peer_shared;
+	struct lf_ratelimiter_cache_entry *cache_set;
+	uint32_t key_id;
+	uint32_t cache_generation;
+	/* time at which the shared limit has been checked */
+	uint64_t peer_ns_check;
+
+	/* host rate limit (NULL if not defined for the peer) */
+	const struct lf_ratelimiter_host_limit *host_limit;
+	struct lf_ratelimiter_host_entry *host_set;
+	struct lf_ratelimiter_host_key host_key;
+	uint32_t host_hash;
+	uint32_t host_generation;
+	/* time at which the host rate limit has been checked */
+	uint64_t host_ns_check;
 };
 
 #define LF_RATELIMITER_RES_BYTES             (1 << 0)
@@ -73,6 +385,98 @@ struct lf_ratelimiter_pkt_ctx {
 #define LF_RATELIMITER_RES_OVERALL_PKTS      (1 << 3)
 #define LF_RATELIMITER_RES_BEST_EFFORT_BYTES (1 << 4)
 #define LF_RATELIMITER_RES_BEST_EFFORT_PKTS  (1 << 5)
+#define LF_RATELIMITER_RES_HOST_BYTES        (1 << 6)
+#define LF_RATELIMITER_RES_HOST_PKTS         (1 << 7)
+
+/**
+ * Set the rate limit context for a packet from the result of the dictionary
+ * lookup.
+ *
+ * @param key_id Position of the peer in the dictionary, or < 0 if no rate limit
+ * is defined for the peer.
+ */
+static inline void
+lf_ratelimiter_worker_set_pkt_ctx(struct lf_ratelimiter_worker *rl,
+		int key_id, struct lf_ratelimiter_pkt_ctx *pkt_ctx)
+{
+	int id;
+
+	/* per-AS rate limit */
+	pkt_ctx->peer_shared = NULL;
+	if (key_id < 0) {
+		pkt_ctx->peer_ratelimit = &rl->auth_peers;
+		id = LF_RATELIMITER_AUTH_PEERS_ID;
+	} else if (rl->buckets == NULL) {
+		/* compact mode: the cache set is prefetched */
+		pkt_ctx->peer_ratelimit = NULL;
+		pkt_ctx->peer_shared = &rl->shared[key_id];
+		pkt_ctx->key_id = (uint32_t)key_id;
+		pkt_ctx->cache_set = &rl->cache[((uint32_t)key_id & rl->cache_mask) *
+										LF_RATELIMITER_CACHE_WAYS];
+		pkt_ctx->cache_generation = atomic_load_explicit(&rl->host_generation,
+				memory_order_relaxed);
+		rte_prefetch0(pkt_ctx->cache_set);
+		id = -1;
+	} else {
+		pkt_ctx->peer_ratelimit = &rl->buckets[key_id];
+		id = key_id + LF_RATELIMITER_PEER_OFFSET;
+	}
+
+	/* overall rate limit */
+	pkt_ctx->overall_ratelimit = &rl->overall;
+
+	if (rl->demand == NULL) {
+		pkt_ctx->peer_demand = NULL;
+		pkt_ctx->peer_pool = NULL;
+		pkt_ctx->overall_demand = NULL;
+		pkt_ctx->overall_pool = NULL;
+	} else {
+		pkt_ctx->peer_demand = id < 0 ? NULL : &rl->demand[id];
+		pkt_ctx->peer_pool = id < 0 ? NULL : &rl->pool[id];
+		pkt_ctx->overall_demand = &rl->demand[LF_RATELIMITER_OVERALL_ID];
+		pkt_ctx->overall_pool = &rl->pool[LF_RATELIMITER_OVERALL_ID];
+	}
+}
+
+/**
+ * Set the host rate limit context for a packet. The host's set in the table is
+ * prefetched.
+ *
+ * @param key_id Position of the peer in the dictionary, or < 0 if no rate limit
+ * is defined for the peer.
+ * @param host Packet's source address. If NULL, no host rate limit is applied.
+ */
+static inline void
+lf_ratelimiter_worker_set_host_ctx(struct lf_ratelimiter_worker *rl,
+		int key_id, const struct lf_host_addr *host,
+		struct lf_ratelimiter_pkt_ctx *pkt_ctx)
+{
+	const struct lf_ratelimiter_host_limit *host_limit;
+	struct lf_ratelimiter_host_key *key = &pkt_ctx->host_key;
+
+	pkt_ctx->host_limit = NULL;
+	if (key_id < 0 || host == NULL || rl->hosts == NULL) {
+		return;
+	}
+	host_limit = &rl->host_limits[key_id];
+	if (!atomic_load_explicit(&host_limit->enabled, memory_order_relaxed)) {
+		return;
+	}
+
+	memset(key, 0, sizeof *key);
+	key->key_id = (uint32_t)key_id;
+	key->type_length = host->type_length;
+	memcpy(key->addr, host->addr, LF_HOST_ADDR_LENGTH(host));
+
+	pkt_ctx->host_hash = rte_hash_crc(key, sizeof *key, 0);
+	pkt_ctx->host_set = &rl->hosts[(pkt_ctx->host_hash &
+											(LF_RATELIMITER_HOST_SETS - 1)) *
+								   LF_RATELIMITER_HOST_WAYS];
+	pkt_ctx->host_generation =
+			atomic_load_explicit(&rl->host_generation, memory_order_relaxed);
+	pkt_ctx->host_limit = host_limit;
+	rte_prefetch0(pkt_ctx->host_set);
+}
 
 /**
  * Get the rate limit context for a packet, which then can be used for the
@@ -80,34 +484,461 @@ struct lf_ratelimiter_pkt_ctx {
  * If no rate limit is defined for the specified AS and DRKey protocol, i.e.,
  * peer, the best-effort rate limit is used.
  *
+ * @param host Packet's source address for the host rate limit. Can be NULL.
  * @param pkt_ctx Returns the rate limit context for the packet.
  * @return Returns 0 on success.
  */
 static inline int
 lf_ratelimiter_worker_get_pkt_ctx(struct lf_ratelimiter_worker *rl, uint64_t as,
-		uint16_t drkey_protocol, struct lf_ratelimiter_pkt_ctx *pkt_ctx)
+		uint16_t drkey_protocol, const struct lf_host_addr *host,
+		struct lf_ratelimiter_pkt_ctx *pkt_ctx)
 {
 	int key_id;
-
-	const struct rte_hash *dict = rl->dict;
+	void *data;
 	const struct lf_ratelimiter_key as_key = {
 		.as = as,
 		.drkey_protocol = drkey_protocol,
 	};
 
-	/* per-AS rate limit */
-	key_id = rte_hash_lookup(dict, &as_key);
-	if (key_id < 0) {
-		pkt_ctx->peer_ratelimit = &rl->auth_peers;
-	} else {
-		pkt_ctx->peer_ratelimit = &rl->buckets[key_id];
+	key_id = rte_hash_lookup_data(rl->dict, &as_key, &data);
+	if (key_id >= 0) {
+		key_id = (int)(uintptr_t)data;
 	}
+	lf_ratelimiter_worker_set_pkt_ctx(rl, key_id, pkt_ctx);
+	lf_ratelimiter_worker_set_host_ctx(rl, key_id, host, pkt_ctx);
+	return 0;
+}
 
-	/* overall rate limit */
-	pkt_ctx->overall_ratelimit = &rl->overall;
+#if LF_MAX_PKT_BURST > RTE_HASH_LOOKUP_BULK_MAX
+#error LF_MAX_PKT_BURST exceeds the maximum number of keys of a bulk lookup
+#endif
+
+/**
+ * Get the rate limit contexts for a burst of packets with a single bulk
+ * lookup in the dictionary. Same as lf_ratelimiter_worker_get_pkt_ctx() for
+ * each packet.
+ *
+ * @param as Packets' source AS (network byte order).
+ * @param drkey_protocol Packets' DRKey protocol (network byte order).
+ * @param host Packets' source address. Can be NULL.
+ * @param nb_pkts Number of packets (at most LF_MAX_PKT_BURST).
+ * @param pkt_ctx Returns the rate limit context for each packet.
+ * @return Returns 0 on success.
+ */
+static inline int
+lf_ratelimiter_worker_get_pkt_ctx_burst(struct lf_ratelimiter_worker *rl,
+		const uint64_t as[], const uint16_t drkey_protocol[],
+		const struct lf_host_addr *const host[], uint16_t nb_pkts,
+		struct lf_ratelimiter_pkt_ctx pkt_ctx[])
+{
+	int res;
+	uint16_t i;
+	struct lf_ratelimiter_key as_key[LF_MAX_PKT_BURST];
+	const void *as_key_ptr[LF_MAX_PKT_BURST];
+	void *data[LF_MAX_PKT_BURST];
+	uint64_t hit_mask;
+	int key_id;
+
+	assert(nb_pkts <= LF_MAX_PKT_BURST);
+
+	if (unlikely(nb_pkts == 0)) {
+		return 0;
+	}
+
+	for (i = 0; i < nb_pkts; i++) {
+		as_key[i].as = as[i];
+		as_key[i].drkey_protocol = drkey_protocol[i];
+		as_key_ptr[i] = &as_key[i];
+	}
+
+	res = rte_hash_lookup_bulk_data(rl->dict, as_key_ptr, nb_pkts, &hit_mask,
+			data);
+	if (unlikely(res < 0)) {
+		return res;
+	}
+
+	for (i = 0; i < nb_pkts; i++) {
+		key_id = (hit_mask & (UINT64_C(1) << i)) ? (int)(uintptr_t)data[i]
+		                                         : -ENOENT;
+		lf_ratelimiter_worker_set_pkt_ctx(rl, key_id, &pkt_ctx[i]);
+		lf_ratelimiter_worker_set_host_ctx(rl, key_id,
+				host == NULL ? NULL : host[i], &pkt_ctx[i]);
+	}
 	return 0;
 }
 
+/**
+ * Count tokens requested by the worker for the redistribution.
+ */
+static inline void
+lf_ratelimiter_demand_add(struct lf_ratelimiter_demand *demand,
+		uint64_t packets, uint64_t bytes)
+{
+	/* the counters are only written by this worker */
+	atomic_store_explicit(&demand->packet,
+			atomic_load_explicit(&demand->packet, memory_order_relaxed) +
+					packets,
+			memory_order_relaxed);
+	atomic_store_explicit(&demand->byte,
+			atomic_load_explicit(&demand->byte, memory_order_relaxed) + bytes,
+			memory_order_relaxed);
+}
+
+/**
+ * Check the token bucket and, if there are not enough tokens, borrow the
+ * missing tokens from the shared pool.
+ * The borrowed tokens are added to the bucket, i.e., they remain in the bucket
+ * if the packet is dropped due to another rate limit.
+ *
+ * @param pool Shared pool of the rate limit.
+ * @return Returns 0 if enough tokens are available.
+ */
+static inline int
+lf_ratelimiter_bucket_check_pool(struct lf_ratelimiter_bucket *bucket,
+		_Atomic(uint64_t) *pool, uint64_t tokens, uint64_t ns_now)
+{
+	uint64_t deficit, available;
+
+	if (lf_ratelimiter_bucket_check(bucket, tokens, ns_now) == 0) {
+		return 0;
+	}
+
+	deficit = lf_ratelimiter_bucket_deficit(bucket, tokens);
+	available = atomic_load_explicit(pool, memory_order_relaxed);
+	do {
+		if (available < deficit) {
+			return -1;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(pool, &available,
+			available - deficit, memory_order_relaxed, memory_order_relaxed));
+	lf_ratelimiter_bucket_add(bucket, deficit);
+	return 0;
+}
+
+/**
+ * Check the packet and byte buckets of a rate limit for the given number of
+ * packets and bytes. The demand is not counted.
+ *
+ * @param pool Shared pools of the rate limit. NULL if the redistribution is
+ * disabled.
+ * @param res_bytes Result flag if the byte rate limit is exceeded.
+ * @param res_pkts Result flag if the packet rate limit is exceeded.
+ * @return Returns 0 if the packets would not exceed the rate limit. Otherwise,
+ * the result flags of the exceeded rate limits.
+ */
+static inline int
+lf_ratelimiter_ratelimit_check_tokens(struct lf_ratelimiter_limit *ratelimit,
+		struct lf_ratelimiter_pool *pool, uint64_t packets, uint64_t bytes,
+		uint64_t ns_now, int res_bytes, int res_pkts)
+{
+	int res = 0;
+
+	if (pool == NULL) {
+		if (lf_ratelimiter_bucket_check(&ratelimit->byte, bytes, ns_now) !=
+				0) {
+			res |= res_bytes;
+		}
+		if (lf_ratelimiter_bucket_check(&ratelimit->packet, packets,
+					ns_now) != 0) {
+			res |= res_pkts;
+		}
+		return res;
+	}
+
+	if (lf_ratelimiter_bucket_check_pool(&ratelimit->byte, &pool->byte, bytes,
+				ns_now) != 0) {
+		res |= res_bytes;
+	}
+	if (lf_ratelimiter_bucket_check_pool(&ratelimit->packet, &pool->packet,
+				packets, ns_now) != 0) {
+		res |= res_pkts;
+	}
+	return res;
+}
+
+/**
+ * Check the packet and byte buckets of a rate limit for a single packet.
+ *
+ * @param demand Worker's demand counters of the rate limit. NULL if the
+ * redistribution is disabled.
+ * @param pool Shared pools of the rate limit.
+ * @param res_bytes Result flag if the byte rate limit is exceeded.
+ * @param res_pkts Result flag if the packet rate limit is exceeded.
+ * @return Returns 0 if the packet would not exceed the rate limit. Otherwise,
+ * the result flags of the exceeded rate limits.
+ */
+static inline int
+lf_ratelimiter_ratelimit_check(struct lf_ratelimiter_limit *ratelimit,
+		struct lf_ratelimiter_demand *demand, struct lf_ratelimiter_pool *pool,
+		uint32_t pkt_len, uint64_t ns_now, int res_bytes, int res_pkts)
+{
+	if (demand != NULL) {
+		lf_ratelimiter_demand_add(demand, 1, pkt_len);
+	}
+	return lf_ratelimiter_ratelimit_check_tokens(ratelimit, pool, 1, pkt_len,
+			ns_now, res_bytes, res_pkts);
+}
+
+/**
+ * Consume the tokens of the packet and byte buckets of a rate limit, which
+ * must have been checked before.
+ */
+static inline void
+lf_ratelimiter_ratelimit_consume(struct lf_ratelimiter_limit *ratelimit,
+		uint64_t packets, uint64_t bytes)
+{
+	lf_ratelimiter_bucket_consume(&ratelimit->byte, bytes);
+	lf_ratelimiter_bucket_consume(&ratelimit->packet, packets);
+}
+
+/**
+ * Find the peer's entry in the worker's cache (compact mode).
+ *
+ * @return Returns the entry, or NULL if the peer has no valid entry.
+ */
+static inline struct lf_ratelimiter_cache_entry *
+lf_ratelimiter_cache_lookup(const struct lf_ratelimiter_pkt_ctx *pkt_ctx)
+{
+	int way;
+	struct lf_ratelimiter_cache_entry *entry;
+
+	for (way = 0; way < LF_RATELIMITER_CACHE_WAYS; way++) {
+		entry = &pkt_ctx->cache_set[way];
+		if (entry->generation == pkt_ctx->cache_generation &&
+				entry->key_id == pkt_ctx->key_id) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Check the peer's shared limit (compact mode) for the given number of packets
+ * and bytes. If the peer has a cache entry, the missing tokens are taken from
+ * the shared limit together with the tokens for about
+ * LF_RATELIMITER_CACHE_BATCH further packets. Otherwise, the shared limit is
+ * checked directly.
+ *
+ * @return Returns 0 if the packets would not exceed the rate limit. Otherwise,
+ * the result flags of the exceeded rate limits.
+ */
+static inline int
+lf_ratelimiter_shared_check_tokens(struct lf_ratelimiter_pkt_ctx *pkt_ctx,
+		uint64_t packets, uint64_t bytes, uint64_t ns_now, int res_bytes,
+		int res_pkts)
+{
+	int res = 0;
+	uint64_t tokens;
+	struct lf_ratelimiter_cache_entry *entry;
+	struct lf_ratelimiter_shared_limit *shared = pkt_ctx->peer_shared;
+
+	pkt_ctx->peer_ns_check = ns_now;
+	entry = lf_ratelimiter_cache_lookup(pkt_ctx);
+	if (entry == NULL) {
+		if (lf_tsb_shared_check(&shared->byte, bytes, ns_now) != 0) {
+			res |= res_bytes;
+		}
+		if (lf_tsb_shared_check(&shared->packet, packets, ns_now) != 0) {
+			res |= res_pkts;
+		}
+		return res;
+	}
+
+	if (entry->bytes < bytes) {
+		tokens = lf_tsb_shared_take(&shared->byte, bytes - entry->bytes,
+				bytes - entry->bytes +
+						LF_RATELIMITER_CACHE_BATCH * bytes / MAX(packets, 1),
+				ns_now);
+		if (tokens == 0) {
+			res |= res_bytes;
+		}
+		entry->bytes += tokens;
+	}
+	if (entry->packets < packets) {
+		tokens = lf_tsb_shared_take(&shared->packet, packets - entry->packets,
+				packets - entry->packets + LF_RATELIMITER_CACHE_BATCH, ns_now);
+		if (tokens == 0) {
+			res |= res_pkts;
+		}
+		entry->packets += tokens;
+	}
+	return res;
+}
+
+/**
+ * Consume the tokens of the peer's shared limit (compact mode), which must have
+ * been checked before. The tokens are taken from the peer's cache entry. If the
+ * peer has no entry, they are consumed from the shared limit, and the least
+ * recently used entry of the set is replaced.
+ */
+static inline void
+lf_ratelimiter_shared_consume(const struct lf_ratelimiter_pkt_ctx *pkt_ctx,
+		uint64_t packets, uint64_t bytes)
+{
+	int way;
+	struct lf_ratelimiter_cache_entry *entry, *victim;
+
+	entry = lf_ratelimiter_cache_lookup(pkt_ctx);
+	if (entry != NULL) {
+		entry->packets -= MIN(entry->packets, packets);
+		entry->bytes -= MIN(entry->bytes, bytes);
+		entry->last_used = pkt_ctx->peer_ns_check;
+		return;
+	}
+
+	lf_tsb_shared_consume(&pkt_ctx->peer_shared->byte, bytes,
+			pkt_ctx->peer_ns_check);
+	lf_tsb_shared_consume(&pkt_ctx->peer_shared->packet, packets,
+			pkt_ctx->peer_ns_check);
+
+	victim = &pkt_ctx->cache_set[0];
+	for (way = 0; way < LF_RATELIMITER_CACHE_WAYS; way++) {
+		entry = &pkt_ctx->cache_set[way];
+		if (entry->generation != pkt_ctx->cache_generation) {
+			victim = entry;
+			break;
+		}
+		if (entry->last_used < victim->last_used) {
+			victim = entry;
+		}
+	}
+	victim->generation = pkt_ctx->cache_generation;
+	victim->key_id = pkt_ctx->key_id;
+	victim->last_used = pkt_ctx->peer_ns_check;
+	victim->packets = 0;
+	victim->bytes = 0;
+}
+
+/**
+ * Check the peer or best-effort rate limit of the packet's context for the
+ * given number of packets and bytes. The demand is not counted.
+ */
+static inline int
+lf_ratelimiter_peer_check_tokens(struct lf_ratelimiter_pkt_ctx *pkt_ctx,
+		uint64_t packets, uint64_t bytes, uint64_t ns_now)
+{
+	if (pkt_ctx->peer_shared != NULL) {
+		return lf_ratelimiter_shared_check_tokens(pkt_ctx, packets, bytes,
+				ns_now, LF_RATELIMITER_RES_BYTES, LF_RATELIMITER_RES_PKTS);
+	}
+	return lf_ratelimiter_ratelimit_check_tokens(pkt_ctx->peer_ratelimit,
+			pkt_ctx->peer_pool, packets, bytes, ns_now,
+			LF_RATELIMITER_RES_BYTES, LF_RATELIMITER_RES_PKTS);
+}
+
+/**
+ * Consume the tokens of the peer or best-effort rate limit of the packet's
+ * context.
+ */
+static inline void
+lf_ratelimiter_peer_consume(const struct lf_ratelimiter_pkt_ctx *pkt_ctx,
+		uint64_t packets, uint64_t bytes)
+{
+	if (pkt_ctx->peer_shared != NULL) {
+		lf_ratelimiter_shared_consume(pkt_ctx, packets, bytes);
+	} else {
+		lf_ratelimiter_ratelimit_consume(pkt_ctx->peer_ratelimit, packets,
+				bytes);
+	}
+}
+
+/**
+ * Find the host's entry in the worker's table.
+ *
+ * @return Returns the entry, or NULL if the host has no valid entry.
+ */
+static inline struct lf_ratelimiter_host_entry *
+lf_ratelimiter_host_lookup(const struct lf_ratelimiter_pkt_ctx *pkt_ctx)
+{
+	int way;
+	struct lf_ratelimiter_host_entry *entry;
+
+	for (way = 0; way < LF_RATELIMITER_HOST_WAYS; way++) {
+		entry = &pkt_ctx->host_set[way];
+		if (entry->generation == pkt_ctx->host_generation &&
+				memcmp(&entry->key, &pkt_ctx->host_key,
+						sizeof(entry->key)) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Initialize a full bucket with the host rate limit.
+ */
+static inline void
+lf_ratelimiter_host_ratelimit_init(const struct lf_ratelimiter_host_limit *limit,
+		struct lf_ratelimiter_limit *ratelimit, uint64_t ns_now)
+{
+	memset(ratelimit, 0, sizeof *ratelimit);
+	lf_ratelimiter_bucket_set(&ratelimit->byte,
+			atomic_load_explicit(&limit->byte_rate, memory_order_relaxed),
+			atomic_load_explicit(&limit->byte_burst, memory_order_relaxed));
+	lf_ratelimiter_bucket_set(&ratelimit->packet,
+			atomic_load_explicit(&limit->packet_rate, memory_order_relaxed),
+			atomic_load_explicit(&limit->packet_burst, memory_order_relaxed));
+
+	/* fill the bucket */
+	(void)lf_ratelimiter_bucket_check(&ratelimit->byte, 0, ns_now);
+	(void)lf_ratelimiter_bucket_check(&ratelimit->packet, 0, ns_now);
+}
+
+/**
+ * Get the host's rate limit for a check. If the host has no entry, the
+ * provided rate limit is initialized as full bucket and returned instead.
+ */
+static inline struct lf_ratelimiter_limit *
+lf_ratelimiter_host_ratelimit(struct lf_ratelimiter_pkt_ctx *pkt_ctx,
+		struct lf_ratelimiter_limit *fresh, uint64_t ns_now)
+{
+	struct lf_ratelimiter_host_entry *entry;
+
+	pkt_ctx->host_ns_check = ns_now;
+	entry = lf_ratelimiter_host_lookup(pkt_ctx);
+	if (entry != NULL) {
+		return &entry->ratelimit;
+	}
+	lf_ratelimiter_host_ratelimit_init(pkt_ctx->host_limit, fresh, ns_now);
+	return fresh;
+}
+
+/**
+ * Consume the tokens of the host rate limit, which must have been checked
+ * before. If the host has no entry, the least recently used entry of the set
+ * is replaced.
+ */
+static inline void
+lf_ratelimiter_host_consume(const struct lf_ratelimiter_pkt_ctx *pkt_ctx,
+		uint64_t packets, uint64_t bytes)
+{
+	int way;
+	struct lf_ratelimiter_host_entry *entry, *victim;
+
+	entry = lf_ratelimiter_host_lookup(pkt_ctx);
+	if (entry == NULL) {
+		victim = &pkt_ctx->host_set[0];
+		for (way = 0; way < LF_RATELIMITER_HOST_WAYS; way++) {
+			entry = &pkt_ctx->host_set[way];
+			if (entry->generation != pkt_ctx->host_generation) {
+				victim = entry;
+				break;
+			}
+			if (entry->last_used < victim->last_used) {
+				victim = entry;
+			}
+		}
+		entry = victim;
+		entry->generation = pkt_ctx->host_generation;
+		entry->key = pkt_ctx->host_key;
+		lf_ratelimiter_host_ratelimit_init(pkt_ctx->host_limit,
+				&entry->ratelimit, pkt_ctx->host_ns_check);
+	}
+
+	entry->last_used = pkt_ctx->host_ns_check;
+	lf_ratelimiter_ratelimit_consume(&entry->ratelimit, packets, bytes);
+}
+
 /**
  * @return Returns 0 if the packet would not exceed the rate limit. Otherwise a
  * positive number.
@@ -119,23 +950,23 @@ lf_ratelimiter_worker_check(struct lf_ratelimiter_pkt_ctx *pkt_ctx,
 	int res = 0;
 
 	/* overall rate limit */
-	if (lf_token_bucket_check(&pkt_ctx->overall_ratelimit->byte, pkt_len,
-				ns_now) != 0) {
-		res |= LF_RATELIMITER_RES_OVERALL_BYTES;
-	}
-	if (lf_token_bucket_check(&pkt_ctx->overall_ratelimit->packet, 1, ns_now) !=
-			0) {
-		res |= LF_RATELIMITER_RES_OVERALL_PKTS;
-	}
+	res |= lf_ratelimiter_ratelimit_check(pkt_ctx->overall_ratelimit,
+			pkt_ctx->overall_demand, pkt_ctx->overall_pool, pkt_len, ns_now,
+			LF_RATELIMITER_RES_OVERALL_BYTES, LF_RATELIMITER_RES_OVERALL_PKTS);
 
 	/* peer or best-effort rate limit */
-	if (lf_token_bucket_check(&pkt_ctx->peer_ratelimit->byte, pkt_len,
-				ns_now) != 0) {
-		res |= LF_RATELIMITER_RES_BYTES;
+	if (pkt_ctx->peer_demand != NULL) {
+		lf_ratelimiter_demand_add(pkt_ctx->peer_demand, 1, pkt_len);
 	}
-	if (lf_token_bucket_check(&pkt_ctx->peer_ratelimit->packet, 1, ns_now) !=
-			0) {
-		res |= LF_RATELIMITER_RES_PKTS;
+	res |= lf_ratelimiter_peer_check_tokens(pkt_ctx, 1, pkt_len, ns_now);
+
+	/* host rate limit */
+	if (pkt_ctx->host_limit != NULL) {
+		struct lf_ratelimiter_limit fresh;
+		res |= lf_ratelimiter_ratelimit_check_tokens(
+				lf_ratelimiter_host_ratelimit(pkt_ctx, &fresh, ns_now), NULL,
+				1, pkt_len, ns_now, LF_RATELIMITER_RES_HOST_BYTES,
+				LF_RATELIMITER_RES_HOST_PKTS);
 	}
 
 	return res;
@@ -145,10 +976,330 @@ static inline void
 lf_ratelimiter_worker_consume(struct lf_ratelimiter_pkt_ctx *pkt_ctx,
 		uint32_t pkt_len)
 {
-	(void)lf_token_bucket_consume(&pkt_ctx->overall_ratelimit->byte, pkt_len);
-	(void)lf_token_bucket_consume(&pkt_ctx->overall_ratelimit->packet, 1);
-	(void)lf_token_bucket_consume(&pkt_ctx->peer_ratelimit->byte, pkt_len);
-	(void)lf_token_bucket_consume(&pkt_ctx->peer_ratelimit->packet, 1);
+	lf_ratelimiter_ratelimit_consume(pkt_ctx->overall_ratelimit, 1, pkt_len);
+	lf_ratelimiter_peer_consume(pkt_ctx, 1, pkt_len);
+	if (pkt_ctx->host_limit != NULL) {
+		lf_ratelimiter_host_consume(pkt_ctx, 1, pkt_len);
+	}
+}
+
+/**
+ * Burst processing:
+ * The packets of a burst are grouped by their peer rate limit, such that the
+ * tokens of a peer are checked and consumed once per burst instead of once per
+ * packet. All packets of a burst share the overall rate limit, i.e., form a
+ * single group for it. Hence, a flood from a single peer requires one update
+ * of the peer's and the overall buckets per burst.
+ *
+ * The check accounts for all packets of a group at once. Therefore, the tokens
+ * consumed for the packets passing all other checks are always available, and
+ * the rate limit does not have to be checked again before consuming them.
+ */
+/* Size of the table to group the packets (power of 2, > LF_MAX_PKT_BURST) */
+#define LF_RATELIMITER_BURST_TABLE_SIZE 64
+/* Group of packets without host rate limit */
+#define LF_RATELIMITER_BURST_NO_GROUP UINT8_MAX
+
+struct lf_ratelimiter_burst_ctx {
+	uint16_t nb_groups;
+	/* rate limit context of the first packet of each group */
+	struct lf_ratelimiter_pkt_ctx *group_ctx[LF_MAX_PKT_BURST];
+	/* group of each packet */
+	uint8_t group[LF_MAX_PKT_BURST];
+
+	/* same for the packets with a host rate limit */
+	uint16_t nb_host_groups;
+	struct lf_ratelimiter_pkt_ctx *host_group_ctx[LF_MAX_PKT_BURST];
+	uint8_t host_group[LF_MAX_PKT_BURST];
+};
+
+/**
+ * Check a group of packets sharing a rate limit. If the rate limit does not
+ * allow all packets of the group, the packets are admitted in order as long
+ * as the rate limit allows them.
+ *
+ * @param shared_ctx If not NULL, the shared limit of the context is checked
+ * instead of ratelimit and pool (compact mode).
+ * @param group Group of the packets to check. Packets of other groups, as well
+ * as packets with res[i] != 0, are ignored. If NULL, all packets are checked.
+ * @param packets Number of packets of the group.
+ * @param bytes Number of bytes of the group.
+ * @param res Result flags of the packets exceeding the rate limit are set.
+ */
+static inline void
+lf_ratelimiter_ratelimit_check_group(struct lf_ratelimiter_limit *ratelimit,
+		struct lf_ratelimiter_demand *demand, struct lf_ratelimiter_pool *pool,
+		struct lf_ratelimiter_pkt_ctx *shared_ctx, const uint8_t group[],
+		uint8_t group_id, uint64_t packets, uint64_t bytes,
+		const uint32_t pkt_len[], uint16_t nb_pkts, uint64_t ns_now,
+		int res_bytes, int res_pkts, int res[])
+{
+	uint16_t i;
+	int res_group;
+
+	if (demand != NULL) {
+		lf_ratelimiter_demand_add(demand, packets, bytes);
+	}
+
+	if (shared_ctx != NULL) {
+		res_group = lf_ratelimiter_shared_check_tokens(shared_ctx, packets,
+				bytes, ns_now, res_bytes, res_pkts);
+	} else {
+		res_group = lf_ratelimiter_ratelimit_check_tokens(ratelimit, pool,
+				packets, bytes, ns_now, res_bytes, res_pkts);
+	}
+	if (likely(res_group == 0)) {
+		return;
+	}
+
+	/* admit the packets in order while the rate limit allows them */
+	packets = 0;
+	bytes = 0;
+	res_group = 0;
+	for (i = 0; i < nb_pkts; i++) {
+		if (res[i] != 0 || (group != NULL && group[i] != group_id)) {
+			continue;
+		}
+		if (res_group == 0 && shared_ctx != NULL) {
+			res_group = lf_ratelimiter_shared_check_tokens(shared_ctx,
+					packets + 1, bytes + pkt_len[i], ns_now, res_bytes,
+					res_pkts);
+		} else if (res_group == 0) {
+			res_group = lf_ratelimiter_ratelimit_check_tokens(ratelimit, pool,
+					packets + 1, bytes + pkt_len[i], ns_now, res_bytes,
+					res_pkts);
+		}
+		if (res_group != 0) {
+			res[i] = res_group;
+			continue;
+		}
+		packets += 1;
+		bytes += pkt_len[i];
+	}
+}
+
+/**
+ * Check the host rate limits of a burst of packets, grouped by the hosts.
+ */
+static inline void
+lf_ratelimiter_worker_check_hosts_burst(
+		struct lf_ratelimiter_burst_ctx *burst_ctx,
+		struct lf_ratelimiter_pkt_ctx pkt_ctx[], const uint32_t pkt_len[],
+		uint16_t nb_pkts, uint64_t ns_now, int res[])
+{
+	uint16_t i;
+	uint8_t g;
+	uint32_t slot;
+	uint8_t table[LF_RATELIMITER_BURST_TABLE_SIZE];
+	uint64_t group_packets[LF_MAX_PKT_BURST];
+	uint64_t group_bytes[LF_MAX_PKT_BURST];
+	struct lf_ratelimiter_limit fresh[LF_MAX_PKT_BURST];
+	struct lf_ratelimiter_pkt_ctx *ctx;
+
+	memset(table, 0, sizeof table);
+	burst_ctx->nb_host_groups = 0;
+	for (i = 0; i < nb_pkts; i++) {
+		if (res[i] != 0 || pkt_ctx[i].host_limit == NULL) {
+			burst_ctx->host_group[i] = LF_RATELIMITER_BURST_NO_GROUP;
+			continue;
+		}
+		for (slot = pkt_ctx[i].host_hash;; slot++) {
+			slot &= LF_RATELIMITER_BURST_TABLE_SIZE - 1;
+			if (table[slot] == 0) {
+				g = burst_ctx->nb_host_groups++;
+				table[slot] = g + 1;
+				burst_ctx->host_group_ctx[g] = &pkt_ctx[i];
+				group_packets[g] = 0;
+				group_bytes[g] = 0;
+				break;
+			}
+			g = table[slot] - 1;
+			ctx = burst_ctx->host_group_ctx[g];
+			if (ctx->host_hash == pkt_ctx[i].host_hash &&
+					memcmp(&ctx->host_key, &pkt_ctx[i].host_key,
+							sizeof(ctx->host_key)) == 0) {
+				break;
+			}
+		}
+		burst_ctx->host_group[i] = g;
+		group_packets[g] += 1;
+		group_bytes[g] += pkt_len[i];
+	}
+
+	for (g = 0; g < burst_ctx->nb_host_groups; g++) {
+		lf_ratelimiter_ratelimit_check_group(
+				lf_ratelimiter_host_ratelimit(burst_ctx->host_group_ctx[g],
+						&fresh[g], ns_now),
+				NULL, NULL, NULL, burst_ctx->host_group, g, group_packets[g],
+				group_bytes[g], pkt_len, nb_pkts, ns_now,
+				LF_RATELIMITER_RES_HOST_BYTES, LF_RATELIMITER_RES_HOST_PKTS,
+				res);
+	}
+}
+
+/**
+ * Check the rate limits of a burst of packets. The packets are grouped by
+ * their peer rate limit, which is stored in the burst context for
+ * lf_ratelimiter_worker_consume_burst().
+ *
+ * @param pkt_ctx Rate limit context of each packet.
+ * @param pkt_len Length of each packet.
+ * @param nb_pkts Number of packets (at most LF_MAX_PKT_BURST).
+ * @param res Packets with res[i] != 0 are ignored. For the other packets,
+ * returns 0 if the packet does not exceed the rate limits. Otherwise, the
+ * result flags of the exceeded rate limits (see
+ * lf_ratelimiter_worker_check()).
+ */
+static inline void
+lf_ratelimiter_worker_check_burst(struct lf_ratelimiter_burst_ctx *burst_ctx,
+		struct lf_ratelimiter_pkt_ctx pkt_ctx[], const uint32_t pkt_len[],
+		uint16_t nb_pkts, uint64_t ns_now, int res[])
+{
+	uint16_t i;
+	uint8_t g;
+	uint32_t slot;
+	uint8_t table[LF_RATELIMITER_BURST_TABLE_SIZE];
+	uint64_t group_packets[LF_MAX_PKT_BURST];
+	uint64_t group_bytes[LF_MAX_PKT_BURST];
+	uint64_t packets = 0, bytes = 0;
+	struct lf_ratelimiter_pkt_ctx *ctx;
+	struct lf_ratelimiter_pkt_ctx *overall_ctx = NULL;
+
+	static_assert(LF_RATELIMITER_BURST_TABLE_SIZE > LF_MAX_PKT_BURST,
+			"burst table too small");
+	static_assert((LF_RATELIMITER_BURST_TABLE_SIZE &
+						  (LF_RATELIMITER_BURST_TABLE_SIZE - 1)) == 0,
+			"burst table size must be a power of 2");
+	assert(nb_pkts <= LF_MAX_PKT_BURST);
+
+	/*
+	 * Group the packets by their peer rate limit. The table maps a rate limit
+	 * to its group (+ 1) with linear probing.
+	 */
+	memset(table, 0, sizeof table);
+	burst_ctx->nb_groups = 0;
+	for (i = 0; i < nb_pkts; i++) {
+		if (res[i] != 0) {
+			continue;
+		}
+		if (pkt_ctx[i].peer_ratelimit != NULL) {
+			slot = (uint32_t)((uintptr_t)pkt_ctx[i].peer_ratelimit /
+					sizeof(struct lf_ratelimiter_limit));
+		} else {
+			slot = (uint32_t)((uintptr_t)pkt_ctx[i].peer_shared /
+					sizeof(struct lf_ratelimiter_shared_limit));
+		}
+		for (;; slot++) {
+			slot &= LF_RATELIMITER_BURST_TABLE_SIZE - 1;
+			if (table[slot] == 0) {
+				g = burst_ctx->nb_groups++;
+				table[slot] = g + 1;
+				burst_ctx->group_ctx[g] = &pkt_ctx[i];
+				group_packets[g] = 0;
+				group_bytes[g] = 0;
+				break;
+			}
+			g = table[slot] - 1;
+			if (burst_ctx->group_ctx[g]->peer_ratelimit ==
+							pkt_ctx[i].peer_ratelimit &&
+					burst_ctx->group_ctx[g]->peer_shared ==
+							pkt_ctx[i].peer_shared) {
+				break;
+			}
+		}
+		burst_ctx->group[i] = g;
+		group_packets[g] += 1;
+		group_bytes[g] += pkt_len[i];
+	}
+
+	/* peer or best-effort rate limits */
+	for (g = 0; g < burst_ctx->nb_groups; g++) {
+		ctx = burst_ctx->group_ctx[g];
+		lf_ratelimiter_ratelimit_check_group(ctx->peer_ratelimit,
+				ctx->peer_demand, ctx->peer_pool,
+				ctx->peer_shared != NULL ? ctx : NULL, burst_ctx->group, g,
+				group_packets[g], group_bytes[g], pkt_len, nb_pkts, ns_now,
+				LF_RATELIMITER_RES_BYTES, LF_RATELIMITER_RES_PKTS, res);
+	}
+
+	/* host rate limits for the packets within their peer rate limit */
+	lf_ratelimiter_worker_check_hosts_burst(burst_ctx, pkt_ctx, pkt_len,
+			nb_pkts, ns_now, res);
+
+	/* overall rate limit for the packets within the other rate limits */
+	for (i = 0; i < nb_pkts; i++) {
+		if (res[i] != 0) {
+			continue;
+		}
+		overall_ctx = &pkt_ctx[i];
+		packets += 1;
+		bytes += pkt_len[i];
+	}
+	if (overall_ctx == NULL) {
+		return;
+	}
+	lf_ratelimiter_ratelimit_check_group(overall_ctx->overall_ratelimit,
+			overall_ctx->overall_demand, overall_ctx->overall_pool, NULL, NULL,
+			0, packets, bytes, pkt_len, nb_pkts, ns_now,
+			LF_RATELIMITER_RES_OVERALL_BYTES, LF_RATELIMITER_RES_OVERALL_PKTS,
+			res);
+}
+
+/**
+ * Consume the tokens of a burst of packets, which have been checked with
+ * lf_ratelimiter_worker_check_burst() before.
+ *
+ * @param consume Tokens are only consumed for packets with consume[i] set.
+ */
+static inline void
+lf_ratelimiter_worker_consume_burst(
+		const struct lf_ratelimiter_burst_ctx *burst_ctx,
+		const uint32_t pkt_len[], const bool consume[], uint16_t nb_pkts)
+{
+	uint16_t i;
+	uint8_t g;
+	uint64_t group_packets[LF_MAX_PKT_BURST] = { 0 };
+	uint64_t group_bytes[LF_MAX_PKT_BURST] = { 0 };
+	uint64_t host_group_packets[LF_MAX_PKT_BURST] = { 0 };
+	uint64_t host_group_bytes[LF_MAX_PKT_BURST] = { 0 };
+	uint64_t packets = 0, bytes = 0;
+
+	for (i = 0; i < nb_pkts; i++) {
+		if (!consume[i]) {
+			continue;
+		}
+		g = burst_ctx->group[i];
+		group_packets[g] += 1;
+		group_bytes[g] += pkt_len[i];
+		packets += 1;
+		bytes += pkt_len[i];
+		g = burst_ctx->host_group[i];
+		if (g != LF_RATELIMITER_BURST_NO_GROUP) {
+			host_group_packets[g] += 1;
+			host_group_bytes[g] += pkt_len[i];
+		}
+	}
+
+	if (packets == 0) {
+		return;
+	}
+
+	for (g = 0; g < burst_ctx->nb_groups; g++) {
+		if (group_packets[g] == 0) {
+			continue;
+		}
+		lf_ratelimiter_peer_consume(burst_ctx->group_ctx[g], group_packets[g],
+				group_bytes[g]);
+	}
+	for (g = 0; g < burst_ctx->nb_host_groups; g++) {
+		if (host_group_packets[g] == 0) {
+			continue;
+		}
+		lf_ratelimiter_host_consume(burst_ctx->host_group_ctx[g],
+				host_group_packets[g], host_group_bytes[g]);
+	}
+	lf_ratelimiter_ratelimit_consume(burst_ctx->group_ctx[0]->overall_ratelimit,
+			packets, bytes);
 }
 
 /**
@@ -161,31 +1312,35 @@ lf_ratelimiter_worker_apply_best_effort(struct lf_ratelimiter_worker *rl,
 		uint32_t pkt_len, uint64_t ns_now)
 {
 	int res = 0;
-	/* overall rate limit */
-	if (lf_token_bucket_check(&rl->overall.byte, pkt_len, ns_now) != 0) {
-		res |= LF_RATELIMITER_RES_OVERALL_BYTES;
-	}
-	if (lf_token_bucket_check(&rl->overall.packet, 1, ns_now) != 0) {
-		res |= LF_RATELIMITER_RES_OVERALL_PKTS;
+	struct lf_ratelimiter_demand *overall_demand = NULL;
+	struct lf_ratelimiter_demand *best_effort_demand = NULL;
+	struct lf_ratelimiter_pool *overall_pool = NULL;
+	struct lf_ratelimiter_pool *best_effort_pool = NULL;
+
+	if (rl->demand != NULL) {
+		overall_demand = &rl->demand[LF_RATELIMITER_OVERALL_ID];
+		overall_pool = &rl->pool[LF_RATELIMITER_OVERALL_ID];
+		best_effort_demand = &rl->demand[LF_RATELIMITER_BEST_EFFORT_ID];
+		best_effort_pool = &rl->pool[LF_RATELIMITER_BEST_EFFORT_ID];
 	}
 
+	/* overall rate limit */
+	res |= lf_ratelimiter_ratelimit_check(&rl->overall, overall_demand,
+			overall_pool, pkt_len, ns_now, LF_RATELIMITER_RES_OVERALL_BYTES,
+			LF_RATELIMITER_RES_OVERALL_PKTS);
+
 	/* best-effort rate limit */
-	if (lf_token_bucket_check(&rl->best_effort.byte, pkt_len, ns_now) != 0) {
-		res |= LF_RATELIMITER_RES_BYTES;
-	}
-	if (lf_token_bucket_check(&rl->best_effort.packet, 1, ns_now) != 0) {
-		res |= LF_RATELIMITER_RES_PKTS;
-	}
+	res |= lf_ratelimiter_ratelimit_check(&rl->best_effort, best_effort_demand,
+			best_effort_pool, pkt_len, ns_now, LF_RATELIMITER_RES_BYTES,
+			LF_RATELIMITER_RES_PKTS);
 
 	if (res != 0) {
 		return res;
 	}
 
 	/* subtract tokens from bucket */
-	(void)lf_token_bucket_consume(&rl->overall.byte, pkt_len);
-	(void)lf_token_bucket_consume(&rl->overall.packet, 1);
-	(void)lf_token_bucket_consume(&rl->best_effort.byte, pkt_len);
-	(void)lf_token_bucket_consume(&rl->best_effort.packet, 1);
+	lf_ratelimiter_ratelimit_consume(&rl->overall, 1, pkt_len);
+	lf_ratelimiter_ratelimit_consume(&rl->best_effort, 1, pkt_len);
 
 	return 0;
 }
@@ -195,18 +1350,21 @@ lf_ratelimiter_worker_apply_best_effort(struct lf_ratelimiter_worker *rl,
  * available and consume them.
  *
  * @param as: Packet's source AS (network order).
+ * @param host: Packet's source address for the host rate limit. Can be NULL.
  * @param pkt_len: Packet length.
  * @return 0 if the rate limit is not exceeded. > 0 if the rate limits would be
  * exceeded. < 0 if an error occurred.
  */
 static inline int
 lf_ratelimiter_worker_apply(struct lf_ratelimiter_worker *rl, uint64_t as,
-		uint16_t drkey_protocol, uint32_t pkt_len, uint64_t ns_now)
+		uint16_t drkey_protocol, const struct lf_host_addr *host,
+		uint32_t pkt_len, uint64_t ns_now)
 {
 	int res;
 	struct lf_ratelimiter_pkt_ctx pkt_ctx;
 
-	res = lf_ratelimiter_worker_get_pkt_ctx(rl, as, drkey_protocol, &pkt_ctx);
+	res = lf_ratelimiter_worker_get_pkt_ctx(rl, as, drkey_protocol, host,
+			&pkt_ctx);
 	if (res != 0) {
 		return -1;
 	}
@@ -247,17 +1405,70 @@ lf_ratelimiter_close(struct lf_ratelimiter *rl);
  * Initialize ratelimiter structures.
  *
  * @param workers: Initializes nb_workers ratelimiter workers contexts.
+ * @param redistribute: Redistribute the rate limits among the workers
+ * according to their demand instead of splitting them equally. Requires the
+ * ratelimiter service to run (lf_ratelimiter_service_launch()).
+ * @param cache_size: Number of cache entries per worker for the compact mode.
+ * Must be a power of 2 and at least LF_RATELIMITER_CACHE_WAYS. If 0, the
+ * compact mode is disabled and every worker holds the buckets of all peers.
  */
 int
 lf_ratelimiter_init(struct lf_ratelimiter *rl,
 		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
-		uint32_t initial_size, struct rte_rcu_qsbr *qsv,
+		uint32_t initial_size, bool redistribute, uint32_t cache_size,
+		struct rte_rcu_qsbr *qsv,
 		struct lf_ratelimiter_worker *workers[LF_MAX_WORKER]);
 
+/**
+ * Redistribute the rate limits among the workers according to the demand
+ * measured since the last update and refill the shared token pools.
+ * Does nothing if the redistribution is disabled.
+ *
+ * @param elapsed_ns Time since the last update (nanoseconds).
+ */
+void
+lf_ratelimiter_service_update(struct lf_ratelimiter *rl, uint64_t elapsed_ns);
+
+/**
+ * Scaling:
+ * The best-effort and auth peers rate limits can be scaled down temporarily,
+ * e.g., by the overload control, without changing the configured rate limits
+ * (lf_ratelimiter_set_scale()). The scales are fixed-point numbers, where
+ * LF_RATELIMITER_SCALE_ONE corresponds to the configured rate limit, and are
+ * kept when the configuration changes.
+ */
+#define LF_RATELIMITER_SCALE_ONE 1024
+
+/**
+ * Scale the best-effort and auth peers rate limits (see
+ * LF_RATELIMITER_SCALE_ONE). The workers' rate limits are only updated if the
+ * scales change.
+ *
+ * @return Returns 0 on success, and -1 if a scale exceeds
+ * LF_RATELIMITER_SCALE_ONE.
+ */
+int
+lf_ratelimiter_set_scale(struct lf_ratelimiter *rl, uint32_t best_effort_scale,
+		uint32_t auth_peers_scale);
+
+/**
+ * Launch the ratelimiter service, which periodically calls
+ * lf_ratelimiter_service_update() until lf_force_quit is set.
+ */
+int
+lf_ratelimiter_service_launch(struct lf_ratelimiter *rl);
+
 /**
  * Register ratelimiter IPC commands for the provided context.
  */
 int
 lf_ratelimiter_register_ipc(struct lf_ratelimiter *rl);
 
+/**
+ * Register the ratelimiter's telemetry commands, which expose the memory used
+ * by the rate limiter.
+ */
+int
+lf_ratelimiter_register_telemetry(struct lf_ratelimiter *rl);
+
 #endif /* LF_ratelimiter_H */
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <rte_lcore.h>
 #include <rte_malloc.h>
 
+#include "egress.h"
 #include "lf.h"
 #include "lib/log/log.h"
 #include "lib/mirror/mirror.h"
@@ -479,6 +480,10 @@ lf_setup_ports(bool workers[RTE_MAX_LCORE], const struct lf_params *params,
 
 	unsigned int pool_nb_mbufs = calculate_nb_mbufs(nb_workers, nb_ports,
 			nb_workers, LF_SETUP_MAX_RX_DESC, nb_workers, LF_SETUP_MAX_TX_DESC);
+	if (params->be_drr) {
+		/* packets held by the workers' egress schedulers */
+		pool_nb_mbufs += nb_workers * LF_EGRESS_MAX_PKTS;
+	}
 
 	/* initialize mirror context */
 	res = lf_mirror_init(mirror_ctx);
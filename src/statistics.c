@@ -5,6 +5,7 @@
 #include <inttypes.h>
 #include <stdatomic.h>
 
+#include <rte_byteorder.h>
 #include <rte_cycles.h>
 #include <rte_lcore.h>
 #include <rte_malloc.h>
@@ -13,6 +14,8 @@
 #include <rte_telemetry.h>
 
 #include "lf.h"
+#include "lib/crypto/crypto.h"
+#include "lib/ipc/ipc.h"
 #include "lib/log/log.h"
 #include "lib/time/time.h"
 #include "statistics.h"
@@ -141,6 +144,9 @@ aggregate_worker_statistics(struct lf_statistics *stats)
 		atomic_store_explicit(&stats->worker[worker_id]->active_counter,
 				&stats->worker[worker_id]->counter[stats->current_state],
 				memory_order_relaxed);
+		atomic_store_explicit(&stats->worker[worker_id]->active_heavy_hitter,
+				&stats->worker[worker_id]->heavy_hitter[stats->current_state],
+				memory_order_relaxed);
 	}
 
 	/*
@@ -162,7 +168,74 @@ aggregate_worker_statistics(struct lf_statistics *stats)
 
 		/* reset worker counter */
 		reset_worker_statistics(&stats->worker[worker_id]->counter[read_state]);
+
+		/* update and reset heavy hitters */
+		lf_heavy_hitter_merge(&stats->heavy_hitter_current,
+				&stats->worker[worker_id]->heavy_hitter[read_state]);
+		lf_heavy_hitter_reset(
+				&stats->worker[worker_id]->heavy_hitter[read_state]);
+	}
+
+	/* complete the heavy hitter window */
+	if (ns_now >= stats->heavy_hitter_window_start +
+						  LF_STATISTICS_HEAVY_HITTER_WINDOW * LF_TIME_NS_IN_S) {
+		stats->heavy_hitter_last = stats->heavy_hitter_current;
+		stats->heavy_hitter_last_duration =
+				ns_now - stats->heavy_hitter_window_start;
+		lf_heavy_hitter_reset(&stats->heavy_hitter_current);
+		stats->heavy_hitter_window_start = ns_now;
+	}
+}
+
+/**
+ * Get the heavy hitters of the last completed window. If no window has been
+ * completed yet, the heavy hitters of the current window are returned.
+ *
+ * @param top Returns up to n heavy hitters, sorted by their estimate.
+ * @param duration Returns the duration of the window (ns).
+ * @return Number of heavy hitters returned.
+ */
+static int
+get_heavy_hitters(struct lf_statistics *stats,
+		struct lf_heavy_hitter_entry *top, int n, uint64_t *duration)
+{
+	int nb_top;
+	uint64_t ns_now = 0;
+
+	rte_spinlock_lock(&stats->lock);
+	aggregate_worker_statistics(stats);
+	if (stats->heavy_hitter_last_duration != 0) {
+		nb_top = lf_heavy_hitter_get_top(&stats->heavy_hitter_last, top, n);
+		*duration = stats->heavy_hitter_last_duration;
+	} else {
+		nb_top = lf_heavy_hitter_get_top(&stats->heavy_hitter_current, top,
+				n);
+		(void)lf_time_get(&ns_now);
+		*duration = ns_now - stats->heavy_hitter_window_start;
 	}
+	rte_spinlock_unlock(&stats->lock);
+
+	return nb_top;
+}
+
+/**
+ * Parse the optional number of requested heavy hitters.
+ * @return Number of heavy hitters, or -1 if the parameter is invalid.
+ */
+static int
+parse_heavy_hitter_params(const char *params)
+{
+	int n;
+
+	if (params == NULL || params[0] == '\0') {
+		return LF_HEAVY_HITTER_TOP;
+	}
+
+	n = atoi(params);
+	if (n <= 0 || n > LF_HEAVY_HITTER_TOP) {
+		return -1;
+	}
+	return n;
 }
 
 static int
@@ -202,6 +275,46 @@ handle_worker_stats(const char *cmd __rte_unused, const char *params,
 	return 0;
 }
 
+static int
+handle_heavy_hitters(const char *cmd __rte_unused, const char *params,
+		struct rte_tel_data *d)
+{
+	int i, n;
+	uint64_t duration;
+	char isd_as_str[32], rank_str[8];
+	struct lf_heavy_hitter_entry top[LF_HEAVY_HITTER_TOP];
+	struct rte_tel_data *entry_d;
+
+	n = parse_heavy_hitter_params(params);
+	if (n < 0) {
+		return -EINVAL;
+	}
+	n = get_heavy_hitters(telemetry_ctx, top, n, &duration);
+
+	rte_tel_data_start_dict(d);
+	rte_tel_data_add_dict_uint(d, "window_ms", duration / LF_TIME_NS_IN_MS);
+	for (i = 0; i < n; i++) {
+		entry_d = rte_tel_data_alloc();
+		if (entry_d == NULL) {
+			return -ENOMEM;
+		}
+		(void)snprintf(isd_as_str, sizeof(isd_as_str), PRIISDAS,
+				PRIISDAS_VAL(rte_be_to_cpu_64(top[i].key)));
+		rte_tel_data_start_dict(entry_d);
+		rte_tel_data_add_dict_string(entry_d, "isd_as", isd_as_str);
+		rte_tel_data_add_dict_uint(entry_d, "pkts", top[i].pkts);
+		rte_tel_data_add_dict_uint(entry_d, "bytes", top[i].bytes);
+		rte_tel_data_add_dict_uint(entry_d, "drop_pkts", top[i].drop_pkts);
+		rte_tel_data_add_dict_uint(entry_d, "error", top[i].error);
+
+		/* entries are named by their rank, starting with 1 */
+		(void)snprintf(rank_str, sizeof(rank_str), "%d", i + 1);
+		rte_tel_data_add_dict_container(d, rank_str, entry_d, 0);
+	}
+
+	return 0;
+}
+
 #define ESCAPED_STRING_LENGTH 1024
 
 static int
@@ -226,7 +339,8 @@ handle_version(const char *cmd __rte_unused, const char *params,
 		rte_tel_data_add_dict_string(d, "worker", xstr(LF_WORKER));
 		rte_tel_data_add_dict_string(d, "drkey_fetcher",
 				xstr(LF_DRKEY_FETCHER));
-		rte_tel_data_add_dict_string(d, "cbc_mac", xstr(LF_CBCMAC));
+		rte_tel_data_add_dict_string(d, "cbc_mac",
+				lf_crypto_drkey_impl_str(lf_crypto_drkey_impl_detect()));
 		rte_tel_data_add_dict_int(d, "log_dp_level", LF_LOG_DP_LEVEL);
 		return 0;
 	} else if (strcmp(params, "all") == 0) {
@@ -242,6 +356,39 @@ handle_version(const char *cmd __rte_unused, const char *params,
 	return -1;
 }
 
+static int
+ipc_heavy_hitters(const char *cmd __rte_unused, const char *p, char *out_buf,
+		size_t buf_len)
+{
+	int i, n;
+	int used = 0;
+	uint64_t duration;
+	struct lf_heavy_hitter_entry top[LF_HEAVY_HITTER_TOP];
+
+	n = parse_heavy_hitter_params(p);
+	if (n < 0) {
+		return -1;
+	}
+	n = get_heavy_hitters(telemetry_ctx, top, n, &duration);
+
+	used += snprintf(out_buf + used, buf_len - used,
+			"window: %" PRIu64 " ms\n"
+			"rank isd_as pkts bytes drop_pkts error\n",
+			duration / LF_TIME_NS_IN_MS);
+	for (i = 0; i < n && (size_t)used < buf_len; i++) {
+		used += snprintf(out_buf + used, buf_len - used,
+				"%d " PRIISDAS " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+				"\n",
+				i + 1, PRIISDAS_VAL(rte_be_to_cpu_64(top[i].key)),
+				top[i].pkts, top[i].bytes, top[i].drop_pkts, top[i].error);
+	}
+
+	if ((size_t)used >= buf_len) {
+		return -1;
+	}
+	return used;
+}
+
 void
 lf_statistics_close(struct lf_statistics *stats)
 {
@@ -284,10 +431,20 @@ lf_statistics_init(struct lf_statistics *stats,
 
 		stats->worker[worker_id]->active_counter =
 				&stats->worker[worker_id]->counter[stats->current_state];
+
+		lf_heavy_hitter_reset(&stats->worker[worker_id]->heavy_hitter[0]);
+		lf_heavy_hitter_reset(&stats->worker[worker_id]->heavy_hitter[1]);
+		stats->worker[worker_id]->active_heavy_hitter =
+				&stats->worker[worker_id]->heavy_hitter[stats->current_state];
 	}
 
 	reset_worker_statistics(&stats->aggregate_global);
 
+	lf_heavy_hitter_reset(&stats->heavy_hitter_current);
+	lf_heavy_hitter_reset(&stats->heavy_hitter_last);
+	stats->heavy_hitter_last_duration = 0;
+	(void)lf_time_get(&stats->heavy_hitter_window_start);
+
 	rte_spinlock_init(&stats->lock);
 
 	/*
@@ -313,5 +470,35 @@ lf_statistics_init(struct lf_statistics *stats,
 		LF_STATISTICS_LOG(ERR, "Failed to register telemetry: %d\n", res);
 	}
 
+	/* register /worker/heavy_hitters */
+	res = rte_telemetry_register_cmd(LF_TELEMETRY_PREFIX
+			"/worker/heavy_hitters",
+			handle_heavy_hitters,
+			"Returns the source ASes with the most packets (aggregated over all "
+			"workers). Parameters: None or number of heavy hitters");
+	if (res != 0) {
+		LF_STATISTICS_LOG(ERR, "Failed to register telemetry: %d\n", res);
+	}
+
+	return 0;
+}
+
+int
+lf_statistics_register_ipc(struct lf_statistics *stats)
+{
+	int res;
+
+	res = lf_ipc_register_cmd("/worker/heavy_hitters", ipc_heavy_hitters,
+			"Print the source ASes with the most packets "
+			"(aggregated over all workers).\n"
+			"parameter: None or number of heavy hitters");
+	if (res != 0) {
+		LF_STATISTICS_LOG(ERR, "Failed to register IPC command\n");
+		return -1;
+	}
+
+	/* set ipc context */
+	telemetry_ctx = stats;
+
 	return 0;
 }
\ No newline at end of file
@@ -13,6 +13,7 @@
 
 #include "lf.h"
 #include "lib/telemetry/counters.h"
+#include "lib/telemetry/heavy_hitter.h"
 
 /**
  * This statistics module provides an interface for workers to collect metrics.
@@ -25,6 +26,13 @@
  */
 #define LF_STATISTICS_MIN_AGGREGATION_INTERVAL 0.5 /* seconds */
 
+/**
+ * Minimal duration of a heavy hitter window. The heavy hitters are reported
+ * for the last completed window, which ends with the first aggregation after
+ * this duration has passed.
+ */
+#define LF_STATISTICS_HEAVY_HITTER_WINDOW 10 /* seconds */
+
 /**
  * Declaration of the worker counter with all its fields.
  */
@@ -80,6 +88,10 @@ struct lf_statistics_worker_counter {
 struct lf_statistics_worker {
 	_Atomic(struct lf_statistics_worker_counter *) active_counter;
 	struct lf_statistics_worker_counter counter[2];
+
+	/* heavy hitter sketch (source AS), swapped together with the counter */
+	_Atomic(struct lf_heavy_hitter *) active_heavy_hitter;
+	struct lf_heavy_hitter heavy_hitter[2];
 } __rte_cache_aligned;
 
 struct lf_statistics {
@@ -94,6 +106,13 @@ struct lf_statistics {
 	struct lf_statistics_worker_counter aggregate_global;
 	struct lf_statistics_worker_counter aggregate_worker[LF_MAX_WORKER];
 
+	/* heavy hitters of the current and the last completed window */
+	struct lf_heavy_hitter heavy_hitter_current;
+	struct lf_heavy_hitter heavy_hitter_last;
+	/* start of the current window and duration of the last window (ns) */
+	uint64_t heavy_hitter_window_start;
+	uint64_t heavy_hitter_last_duration;
+
 	/* timestamp of last statistics aggregation (nanoseconds) */
 	uint64_t last_aggregate;
 
@@ -109,6 +128,24 @@ struct lf_statistics {
 #define lf_statistics_worker_counter_inc(statistics_worker, field) \
 	lf_statistics_worker_counter_add(statistics_worker, field, 1)
 
+/**
+ * Account a packet to the source AS in the worker's heavy hitter sketch.
+ *
+ * @param src_as Source AS (network byte order).
+ * @param pkt_len Packet length in bytes.
+ * @param drop True if the packet is dropped.
+ */
+inline static void
+lf_statistics_worker_add_heavy_hitter(
+		struct lf_statistics_worker *statistics_worker, uint64_t src_as,
+		uint32_t pkt_len, int drop)
+{
+	lf_heavy_hitter_add(atomic_load_explicit(
+								&statistics_worker->active_heavy_hitter,
+								memory_order_relaxed),
+			src_as, pkt_len, drop);
+}
+
 inline static void
 lf_statistics_worker_add_burst(struct lf_statistics_worker *statistics_worker,
 		unsigned int burst_size)
@@ -159,4 +196,13 @@ lf_statistics_init(struct lf_statistics *stats,
 		uint16_t worker_lcores[LF_MAX_WORKER], uint16_t nb_workers,
 		struct rte_rcu_qsbr *qsv);
 
+/**
+ * Register the IPC commands of the statistics, i.e., the heavy hitter export.
+ *
+ * @param stats Initialized statistics struct.
+ * @return 0 on success.
+ */
+int
+lf_statistics_register_ipc(struct lf_statistics *stats);
+
 #endif /* LF_STATISTICS_H */
\ No newline at end of file
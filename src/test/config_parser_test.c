@@ -131,6 +131,13 @@ init_test1_config(struct lf_config *config)
 			.packet_rate = 1,
 			.packet_burst = 1, /* per default same as rate */
 		},
+		.host_ratelimit_option = true,
+		.host_ratelimit = {
+			.byte_rate = 2,
+			.byte_burst = 3,
+			.packet_rate = 4,
+			.packet_burst = 4, /* per default same as rate */
+		},
 	};
 
 	struct lf_config_peer *peer2;
@@ -250,6 +257,21 @@ check_peer(struct lf_config_peer *peer, struct lf_config_peer *peer_exp)
 		}
 	}
 
+	if (peer->host_ratelimit_option != peer_exp->host_ratelimit_option) {
+		printf("Error: host_ratelimit_option = %d, expected = %d\n",
+				peer->host_ratelimit_option, peer_exp->host_ratelimit_option);
+		error_count++;
+	}
+
+	if (peer->host_ratelimit_option) {
+		res = check_ratelimit(&peer->host_ratelimit,
+				&peer_exp->host_ratelimit);
+		if (res != 0) {
+			printf("Error: peer host rate limit");
+			error_count += res;
+		}
+	}
+
 	if (peer->drkey_protocol != peer_exp->drkey_protocol) {
 		error_count++;
 		printf("Error: drkey_protocol = %u, expected = %u\n",
@@ -19,7 +19,8 @@
  * @return number of errors.
  */
 int
-duplicate_filter_worker()
+duplicate_filter_worker(enum lf_duplicate_filter_backend backend,
+		enum lf_duplicate_filter_mode mode, unsigned int bf_bytes)
 {
 	int res;
 	int error_count;
@@ -28,11 +29,10 @@ duplicate_filter_worker()
 	uint64_t ns_now = 0;
 	unsigned int bf_period = 1000;
 	unsigned int bf_hashes = 4;
-	unsigned int bf_bytes = 4;
 	unsigned int secret = 0;
 
-	df = lf_duplicate_filter_worker_new(0, 4, bf_period, bf_hashes, bf_bytes,
-			secret);
+	df = lf_duplicate_filter_worker_new(0, backend, mode, 4, bf_period,
+			bf_hashes, bf_bytes, secret);
 	if (df == NULL) {
 		printf("FAILED: init");
 		return 1;
@@ -87,6 +87,490 @@ duplicate_filter_worker()
 	return error_count;
 }
 
+/**
+ * Insert many distinct keys into a blocked Bloom filter, which must not be
+ * detected as duplicates (apart from a few false positives), while all of them
+ * must be detected when inserted again.
+ *
+ * @return number of errors.
+ */
+int
+duplicate_filter_worker_blocked()
+{
+	int res;
+	int error_count = 0;
+	unsigned int i, false_positives = 0;
+	uint8_t key[16] = { 0 };
+	struct lf_duplicate_filter_worker *df;
+
+	const unsigned int nb_keys = 1000;
+	const unsigned int bf_bytes = 1 << 16;
+
+	/* too small for a single block */
+	df = lf_duplicate_filter_worker_new(0, LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			LF_DUPLICATE_FILTER_MODE_BLOCKED, 2, 1000, 7,
+			LF_DUPLICATE_FILTER_BLOCK_SIZE / 2, 1);
+	if (df != NULL) {
+		printf("Failed: blocked filter smaller than a block\n");
+		lf_duplicate_filter_worker_free(df);
+		error_count++;
+	}
+
+	df = lf_duplicate_filter_worker_new(0, LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			LF_DUPLICATE_FILTER_MODE_BLOCKED, 2, 1000, 7, bf_bytes, 1);
+	if (df == NULL) {
+		printf("FAILED: init");
+		return error_count + 1;
+	}
+
+	for (i = 0; i < nb_keys; ++i) {
+		memcpy(key, &i, sizeof i);
+		res = lf_duplicate_filter_apply(df, key, 0);
+		if (res != 0) {
+			false_positives++;
+		}
+	}
+
+	/* expected false positive rate is far below 1% */
+	if (false_positives > nb_keys / 100) {
+		printf("Failed: %u false positives\n", false_positives);
+		error_count++;
+	}
+
+	for (i = 0; i < nb_keys; ++i) {
+		memcpy(key, &i, sizeof i);
+		res = lf_duplicate_filter_apply(df, key, 0);
+		if (res == 0) {
+			printf("Failed: key %u not detected as duplicate\n", i);
+			error_count++;
+			break;
+		}
+	}
+
+	lf_duplicate_filter_worker_free(df);
+
+	return error_count;
+}
+
+/**
+ * Check that a key is detected as duplicate if it is only contained in the
+ * last filter, i.e., the filter with the highest index.
+ *
+ * @return number of errors.
+ */
+int
+duplicate_filter_worker_last_bf(enum lf_duplicate_filter_mode mode)
+{
+	int res;
+	int error_count = 0;
+	unsigned int i;
+	uint64_t ns_now = 0;
+	uint8_t key[16] = { 0 };
+	uint8_t other_key[16] = { 0 };
+	struct lf_duplicate_filter_worker *df;
+
+	const unsigned int nb_bf = 4;
+	const unsigned int bf_period = 1000;
+
+	df = lf_duplicate_filter_worker_new(0, LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			mode, nb_bf, bf_period, 4, LF_DUPLICATE_FILTER_BLOCK_SIZE, 1);
+	if (df == NULL) {
+		printf("FAILED: init");
+		return error_count + 1;
+	}
+	key[0] = 1;
+
+	/* rotate until the last filter is the current one */
+	for (i = 1; i < nb_bf - 1; ++i) {
+		ns_now += bf_period + 1;
+		other_key[0] = 1 + i;
+		(void)lf_duplicate_filter_apply(df, other_key, ns_now);
+	}
+	ns_now += bf_period + 1;
+	res = lf_duplicate_filter_apply(df, key, ns_now);
+	if (res != 0 || df->current_bf != nb_bf - 1) {
+		printf("Failed: insert into last filter (res = %d, current_bf = %u)\n",
+				res, df->current_bf);
+		error_count++;
+	}
+
+	/* the first filter becomes the current one, the key is only in the last */
+	ns_now += bf_period + 1;
+	res = lf_duplicate_filter_apply(df, key, ns_now);
+	if (res != 1) {
+		printf("Failed: duplicate in last filter not detected\n");
+		error_count++;
+	}
+
+	lf_duplicate_filter_worker_free(df);
+
+	return error_count;
+}
+
+/**
+ * Check that the spare Bloom filter is cleared incrementally and that the
+ * rotation also works if the spare filter has not been cleared completely.
+ *
+ * @return number of errors.
+ */
+int
+duplicate_filter_worker_clear()
+{
+	int res;
+	int error_count = 0;
+	unsigned int i, j, nb_chunks;
+	uint64_t ns_now = 0;
+	struct lf_duplicate_filter_worker *df;
+
+	const unsigned int bf_period = 1000;
+	const unsigned int bf_bytes = 4 * LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE;
+	const uint8_t in1[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+		'a', 'b', 'c', 'd', 'e', 'f' };
+	const uint8_t in2[16] = { '1', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+		'a', 'b', 'c', 'd', 'e', 'f' };
+
+	df = lf_duplicate_filter_worker_new(0, LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			LF_DUPLICATE_FILTER_MODE_STANDARD, 3, bf_period, 4, bf_bytes, 0);
+	if (df == NULL) {
+		printf("FAILED: init");
+		return 1;
+	}
+
+	res = lf_duplicate_filter_apply(df, in1, ns_now);
+	if (res != 0) {
+		printf("Failed: in1\n");
+		error_count++;
+	}
+
+	/* clear the spare filter completely only every second rotation */
+	for (i = 0; i < df->nb_bf; ++i) {
+		ns_now = ns_now + bf_period + 1;
+		res = lf_duplicate_filter_apply(df, in1, ns_now);
+		if (res == 0) {
+			printf("Failed: in1 at %" PRId64 "\n", ns_now);
+			error_count++;
+		}
+
+		nb_chunks = (i % 2 == 0) ? bf_bytes / LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE
+		                         : 1;
+		for (j = 0; j < nb_chunks; ++j) {
+			lf_duplicate_filter_clear_chunk(df);
+		}
+
+		if (i % 2 == 0) {
+			for (j = 0; j < bf_bytes; ++j) {
+				if (df->bf_arrays[df->nb_bf][j] != 0) {
+					printf("Failed: spare filter not cleared\n");
+					error_count++;
+					break;
+				}
+			}
+		}
+	}
+
+	/* rotate out all filters containing in1 without clearing the spare filter */
+	for (i = 0; i < df->nb_bf; ++i) {
+		ns_now = ns_now + bf_period + 1;
+		(void)lf_duplicate_filter_apply(df, in2, ns_now);
+	}
+
+	res = lf_duplicate_filter_apply(df, in1, ns_now);
+	if (res != 0) {
+		printf("Failed: in1 after rotations\n");
+		error_count++;
+	}
+
+	lf_duplicate_filter_worker_free(df);
+
+	return error_count;
+}
+
+/**
+ * Check that workers sharing the Bloom filters detect duplicates across
+ * workers and agree on the rotation.
+ *
+ * @return number of errors.
+ */
+int
+duplicate_filter_worker_shared(enum lf_duplicate_filter_mode mode)
+{
+	int res;
+	int error_count = 0;
+	unsigned int i;
+	uint64_t ns_now = 0;
+	struct lf_duplicate_filter_shared *shared;
+	struct lf_duplicate_filter_worker *df1, *df2;
+
+	const unsigned int nb_bf = 3;
+	const unsigned int bf_period = 1000;
+	const unsigned int bf_bytes = 2 * LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE;
+	const uint8_t in1[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+		'a', 'b', 'c', 'd', 'e', 'f' };
+	const uint8_t in2[16] = { '1', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+		'a', 'b', 'c', 'd', 'e', 'f' };
+	const uint8_t in3[16] = { '2', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+		'a', 'b', 'c', 'd', 'e', 'f' };
+
+	shared = lf_duplicate_filter_shared_new(0, nb_bf, bf_bytes);
+	if (shared == NULL) {
+		printf("FAILED: init shared");
+		return 1;
+	}
+	df1 = lf_duplicate_filter_worker_new_shared(0, shared, mode, bf_period, 4,
+			0);
+	df2 = lf_duplicate_filter_worker_new_shared(0, shared, mode, bf_period, 4,
+			0);
+	if (df1 == NULL || df2 == NULL) {
+		printf("FAILED: init");
+		lf_duplicate_filter_worker_free(df1);
+		lf_duplicate_filter_worker_free(df2);
+		lf_duplicate_filter_shared_free(shared);
+		return 1;
+	}
+
+	/* duplicates are detected across workers */
+	res = lf_duplicate_filter_apply(df1, in1, ns_now);
+	if (res != 0) {
+		printf("Failed: in1\n");
+		error_count++;
+	}
+	res = lf_duplicate_filter_apply(df2, in1, ns_now);
+	if (res == 0) {
+		printf("Failed: in1 on second worker\n");
+		error_count++;
+	}
+	if (df1->statistics.shared_updates == 0) {
+		printf("Failed: shared_updates not counted\n");
+		error_count++;
+	}
+
+	/* the first worker observing the new epoch claims the rotation */
+	ns_now = ns_now + bf_period + 1;
+	res = lf_duplicate_filter_apply(df2, in2, ns_now);
+	if (res != 0) {
+		printf("Failed: in2\n");
+		error_count++;
+	}
+	res = lf_duplicate_filter_apply(df1, in2, ns_now);
+	if (res == 0) {
+		printf("Failed: in2 on first worker\n");
+		error_count++;
+	}
+	if (df2->clear_offset != 0 || df1->clear_offset != bf_bytes) {
+		printf("Failed: spare filter clearing not claimed by second worker\n");
+		error_count++;
+	}
+
+	/* the claiming worker clears the spare filter for the next epoch */
+	for (i = 0; i < bf_bytes / LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE; ++i) {
+		lf_duplicate_filter_clear_chunk(df1);
+		lf_duplicate_filter_clear_chunk(df2);
+	}
+	if (atomic_load(&shared->cleared_epoch) != df2->epoch + 1) {
+		printf("Failed: spare filter not cleared\n");
+		error_count++;
+	}
+
+	/* in1 is still detected on both workers */
+	res = lf_duplicate_filter_apply(df2, in1, ns_now);
+	if (res == 0) {
+		printf("Failed: in1 after rotation\n");
+		error_count++;
+	}
+
+	/* rotate out all filters containing in1 */
+	for (i = 0; i < nb_bf; ++i) {
+		ns_now = ns_now + bf_period + 1;
+		(void)lf_duplicate_filter_apply(df1, in3, ns_now);
+		(void)lf_duplicate_filter_apply(df2, in3, ns_now);
+	}
+	if (df1->current_bf != df2->current_bf ||
+			df1->bf_arrays[df1->current_bf] != df2->bf_arrays[df2->current_bf]) {
+		printf("Failed: workers disagree on current filter\n");
+		error_count++;
+	}
+	res = lf_duplicate_filter_apply(df1, in1, ns_now);
+	if (res != 0) {
+		printf("Failed: in1 after rotations\n");
+		error_count++;
+	}
+	res = lf_duplicate_filter_apply(df2, in1, ns_now);
+	if (res == 0) {
+		printf("Failed: in1 on second worker after rotations\n");
+		error_count++;
+	}
+
+	lf_duplicate_filter_worker_free(df1);
+	lf_duplicate_filter_worker_free(df2);
+	lf_duplicate_filter_shared_free(shared);
+
+	return error_count;
+}
+
+/**
+ * Insert many distinct keys into a cuckoo filter, which must not be detected as
+ * duplicates (apart from very few false positives), while all of them must be
+ * detected when inserted again. Further, check that the expired entries are
+ * removed and that insertions into a full filter are counted.
+ *
+ * @return number of errors.
+ */
+int
+duplicate_filter_worker_cuckoo()
+{
+	int res;
+	int error_count = 0;
+	unsigned int i, false_positives = 0;
+	uint64_t ns_now = 0;
+	uint8_t key[16] = { 0 };
+	struct lf_duplicate_filter_worker *df;
+
+	const unsigned int nb_keys = 1000;
+	const unsigned int bf_period = 1000;
+
+	/* too small for a single cache line */
+	df = lf_duplicate_filter_worker_new(0, LF_DUPLICATE_FILTER_BACKEND_CUCKOO,
+			LF_DUPLICATE_FILTER_MODE_STANDARD, 1, bf_period, 7, 8, 1);
+	if (df != NULL) {
+		printf("Failed: cuckoo filter smaller than a cache line\n");
+		lf_duplicate_filter_worker_free(df);
+		error_count++;
+	}
+
+	/* 2 * 2^14 bytes, i.e., 8192 entries */
+	df = lf_duplicate_filter_worker_new(0, LF_DUPLICATE_FILTER_BACKEND_CUCKOO,
+			LF_DUPLICATE_FILTER_MODE_STANDARD, 1, bf_period, 7, 1 << 14, 1);
+	if (df == NULL) {
+		printf("FAILED: init");
+		return error_count + 1;
+	}
+
+	for (i = 0; i < nb_keys; ++i) {
+		memcpy(key, &i, sizeof i);
+		res = lf_duplicate_filter_apply(df, key, ns_now);
+		if (res != 0) {
+			false_positives++;
+		}
+	}
+
+	/* expected false positive rate is far below 0.1% */
+	if (false_positives > nb_keys / 1000) {
+		printf("Failed: %u false positives\n", false_positives);
+		error_count++;
+	}
+
+	for (i = 0; i < nb_keys; ++i) {
+		memcpy(key, &i, sizeof i);
+		res = lf_duplicate_filter_apply(df, key, ns_now);
+		if (res == 0) {
+			printf("Failed: key %u not detected as duplicate\n", i);
+			error_count++;
+			break;
+		}
+	}
+
+	/* after a rotation, the entries have expired and are removed */
+	ns_now = ns_now + bf_period + 1;
+	memcpy(key, &nb_keys, sizeof nb_keys);
+	(void)lf_duplicate_filter_apply(df, key, ns_now);
+	for (i = 0; i < df->bf_size / LF_DUPLICATE_FILTER_CLEAR_CHUNK_SIZE; ++i) {
+		lf_duplicate_filter_clear_chunk(df);
+	}
+	for (i = 0; i < df->bf_size / sizeof(uint32_t); ++i) {
+		if (df->cuckoo_table[i] != 0 &&
+				(uint8_t)df->cuckoo_table[i] != df->slice) {
+			printf("Failed: expired entry not removed\n");
+			error_count++;
+			break;
+		}
+	}
+
+	for (i = 0; i < nb_keys; ++i) {
+		memcpy(key, &i, sizeof i);
+		res = lf_duplicate_filter_apply(df, key, ns_now);
+		if (res != 0) {
+			printf("Failed: key %u detected after expiry\n", i);
+			error_count++;
+			break;
+		}
+	}
+
+	/* overfill the filter */
+	for (i = 0; i < 2 * df->bf_size / sizeof(uint32_t); ++i) {
+		memcpy(key, &i, sizeof i);
+		key[8] = 1;
+		(void)lf_duplicate_filter_apply(df, key, ns_now);
+	}
+	if (df->statistics.cuckoo_insert_failures == 0) {
+		printf("Failed: insert failures not counted\n");
+		error_count++;
+	}
+
+	lf_duplicate_filter_worker_free(df);
+
+	return error_count;
+}
+
+/**
+ * Check that applying a burst of keys gives the same results as applying the
+ * keys one after the other, including duplicates within the burst, for both
+ * the AES hash (if supported) and murmurhash.
+ *
+ * @return number of errors.
+ */
+int
+duplicate_filter_worker_burst(enum lf_duplicate_filter_backend backend,
+		enum lf_duplicate_filter_mode mode)
+{
+	int res;
+	int error_count = 0;
+	unsigned int i, aesni;
+	int res_burst[LF_MAX_PKT_BURST];
+	uint8_t keys[LF_MAX_PKT_BURST][16] = { { 0 } };
+	const uint8_t *key_ptrs[LF_MAX_PKT_BURST];
+	struct lf_duplicate_filter_worker *df, *df_burst;
+
+	for (i = 0; i < LF_MAX_PKT_BURST; ++i) {
+		/* every fourth key repeats the previous key */
+		keys[i][0] = (uint8_t)(i - (i % 4 == 3));
+		keys[i][15] = 0xaa;
+		key_ptrs[i] = keys[i];
+	}
+
+	for (aesni = 0; aesni < 2; ++aesni) {
+		df = lf_duplicate_filter_worker_new(0, backend, mode, 3, 1000, 7,
+				1 << 12, 42);
+		df_burst = lf_duplicate_filter_worker_new(0, backend, mode, 3, 1000, 7,
+				1 << 12, 42);
+		if (df == NULL || df_burst == NULL) {
+			printf("FAILED: init");
+			lf_duplicate_filter_worker_free(df);
+			lf_duplicate_filter_worker_free(df_burst);
+			return error_count + 1;
+		}
+		df->hash_aesni = df->hash_aesni && aesni;
+		df_burst->hash_aesni = df_burst->hash_aesni && aesni;
+
+		lf_duplicate_filter_apply_burst(df_burst, key_ptrs, LF_MAX_PKT_BURST,
+				0, res_burst);
+		for (i = 0; i < LF_MAX_PKT_BURST; ++i) {
+			res = lf_duplicate_filter_apply(df, keys[i], 0);
+			if ((res != 0) != (res_burst[i] != 0)) {
+				printf("Failed: burst result differs for key %u\n", i);
+				error_count++;
+			}
+			if ((i % 4 == 3) != (res_burst[i] != 0)) {
+				printf("Failed: burst duplicate result for key %u\n", i);
+				error_count++;
+			}
+		}
+
+		lf_duplicate_filter_worker_free(df);
+		lf_duplicate_filter_worker_free(df_burst);
+	}
+
+	return error_count;
+}
 
 int
 main(int argc, char *argv[])
@@ -97,7 +581,29 @@ main(int argc, char *argv[])
 	}
 	int error_counter = 0;
 
-	error_counter += duplicate_filter_worker();
+	error_counter += duplicate_filter_worker(LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			LF_DUPLICATE_FILTER_MODE_STANDARD, 4);
+	error_counter += duplicate_filter_worker(LF_DUPLICATE_FILTER_BACKEND_BLOOM,
+			LF_DUPLICATE_FILTER_MODE_BLOCKED, LF_DUPLICATE_FILTER_BLOCK_SIZE);
+	error_counter += duplicate_filter_worker(LF_DUPLICATE_FILTER_BACKEND_CUCKOO,
+			LF_DUPLICATE_FILTER_MODE_STANDARD, 64);
+	error_counter += duplicate_filter_worker_blocked();
+	error_counter += duplicate_filter_worker_cuckoo();
+	error_counter += duplicate_filter_worker_burst(
+			LF_DUPLICATE_FILTER_BACKEND_BLOOM, LF_DUPLICATE_FILTER_MODE_STANDARD);
+	error_counter += duplicate_filter_worker_burst(
+			LF_DUPLICATE_FILTER_BACKEND_BLOOM, LF_DUPLICATE_FILTER_MODE_BLOCKED);
+	error_counter += duplicate_filter_worker_burst(
+			LF_DUPLICATE_FILTER_BACKEND_CUCKOO, LF_DUPLICATE_FILTER_MODE_STANDARD);
+	error_counter += duplicate_filter_worker_clear();
+	error_counter +=
+			duplicate_filter_worker_last_bf(LF_DUPLICATE_FILTER_MODE_STANDARD);
+	error_counter +=
+			duplicate_filter_worker_last_bf(LF_DUPLICATE_FILTER_MODE_BLOCKED);
+	error_counter +=
+			duplicate_filter_worker_shared(LF_DUPLICATE_FILTER_MODE_STANDARD);
+	error_counter +=
+			duplicate_filter_worker_shared(LF_DUPLICATE_FILTER_MODE_BLOCKED);
 
 	if (error_counter > 0) {
 		printf("Error Count: %d\n", error_counter);
@@ -0,0 +1,302 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_eal.h>
+#include <rte_mbuf.h>
+
+#include "../egress.h"
+#include "../lib/time/time.h"
+#include "../ratelimiter.h"
+
+#define NB_MBUFS 1024
+#define PKT_LEN  100
+
+int lf_pkt_action_dynfield_offset = -1;
+
+static struct lf_egress_worker egress;
+static struct lf_ratelimiter_worker rlw;
+static struct rte_mbuf mbufs[NB_MBUFS];
+
+/**
+ * Reset the egress scheduler and set the best-effort rate limit (the overall
+ * rate limit is unlimited).
+ */
+static void
+reset(uint64_t packet_rate, uint64_t packet_burst)
+{
+	int i;
+
+	memset(&egress, 0, sizeof(egress));
+	memset(&rlw, 0, sizeof(rlw));
+	lf_ratelimiter_bucket_set(&rlw.overall.byte, UINT32_MAX, UINT32_MAX);
+	lf_ratelimiter_bucket_set(&rlw.overall.packet, UINT32_MAX, UINT32_MAX);
+	lf_ratelimiter_bucket_set(&rlw.best_effort.byte, UINT32_MAX, UINT32_MAX);
+	lf_ratelimiter_bucket_set(&rlw.best_effort.packet, packet_rate,
+			packet_burst);
+
+	for (i = 0; i < NB_MBUFS; ++i) {
+		memset(&mbufs[i], 0, sizeof(mbufs[i]));
+		mbufs[i].pkt_len = PKT_LEN;
+	}
+}
+
+/**
+ * Find n source ASes that are mapped to different queues.
+ */
+static void
+distinct_sources(uint64_t *src_as, int n)
+{
+	int i, found = 0;
+	uint64_t candidate;
+
+	for (candidate = 1; found < n; ++candidate) {
+		for (i = 0; i < found; ++i) {
+			if (lf_egress_queue_index(src_as[i]) ==
+					lf_egress_queue_index(candidate)) {
+				break;
+			}
+		}
+		if (i == found) {
+			src_as[found++] = candidate;
+		}
+	}
+}
+
+/**
+ * A light source is served although a heavy source fills its queue.
+ */
+int
+test_fairness()
+{
+	int i, nb_light = 0, nb_drop = 0, error_count = 0;
+	uint16_t n;
+	uint64_t src_as[2];
+	struct rte_mbuf *pkts[LF_MAX_PKT_BURST];
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	reset(UINT32_MAX, UINT32_MAX);
+	distinct_sources(src_as, 2);
+
+	for (i = 0; i < 100; ++i) {
+		if (lf_egress_worker_enqueue(&egress, &mbufs[i], src_as[0]) != NULL) {
+			nb_drop++;
+		}
+	}
+	for (i = 100; i < 105; ++i) {
+		if (lf_egress_worker_enqueue(&egress, &mbufs[i], src_as[1]) != NULL) {
+			nb_drop++;
+		}
+	}
+
+	if (nb_drop != 100 - LF_EGRESS_QUEUE_SIZE ||
+			egress.statistics.dropped_pkts != (uint64_t)nb_drop) {
+		printf("Error: expected %d dropped packets, got %d\n",
+				100 - LF_EGRESS_QUEUE_SIZE, nb_drop);
+		error_count++;
+	}
+
+	/* the heavy source sends one quantum, then the light source */
+	n = lf_egress_worker_dequeue(&egress, &rlw, pkts, LF_MAX_PKT_BURST,
+			ns_now);
+	if (n != LF_MAX_PKT_BURST) {
+		printf("Error: expected %d dequeued packets, got %u\n",
+				LF_MAX_PKT_BURST, n);
+		error_count++;
+	}
+	for (i = 0; i < n; ++i) {
+		if (pkts[i] >= &mbufs[100]) {
+			nb_light++;
+		}
+	}
+	if (nb_light != 5) {
+		printf("Error: expected 5 packets of the light source, got %d\n",
+				nb_light);
+		error_count++;
+	}
+	if (pkts[0] != &mbufs[0] ||
+			pkts[LF_EGRESS_QUANTUM / PKT_LEN] != &mbufs[100]) {
+		printf("Error: unexpected round-robin order\n");
+		error_count++;
+	}
+
+	/* the remaining packets of the heavy source */
+	n = lf_egress_worker_dequeue(&egress, &rlw, pkts, LF_MAX_PKT_BURST,
+			ns_now);
+	if (n != LF_EGRESS_QUEUE_SIZE + 5 - LF_MAX_PKT_BURST ||
+			egress.nb_pkts != 0 || egress.nb_active != 0) {
+		printf("Error: expected empty scheduler, dequeued %u\n", n);
+		error_count++;
+	}
+
+	return error_count;
+}
+
+/**
+ * Packets are only dequeued as long as the best-effort rate limit permits.
+ */
+int
+test_ratelimit()
+{
+	int i, error_count = 0;
+	uint16_t n;
+	uint64_t src_as[1];
+	struct rte_mbuf *pkts[LF_MAX_PKT_BURST];
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	/* 10 packets per second */
+	reset(10, 10);
+	distinct_sources(src_as, 1);
+
+	for (i = 0; i < 20; ++i) {
+		(void)lf_egress_worker_enqueue(&egress, &mbufs[i], src_as[0]);
+	}
+
+	n = lf_egress_worker_dequeue(&egress, &rlw, pkts, LF_MAX_PKT_BURST,
+			ns_now);
+	if (n != 10) {
+		printf("Error: expected 10 packets within the burst, got %u\n", n);
+		error_count++;
+	}
+	n = lf_egress_worker_dequeue(&egress, &rlw, pkts, LF_MAX_PKT_BURST,
+			ns_now);
+	if (n != 0) {
+		printf("Error: expected no packets without tokens, got %u\n", n);
+		error_count++;
+	}
+
+	/* the remaining packets are sent once the bucket is refilled */
+	ns_now += LF_TIME_NS_IN_S;
+	n = lf_egress_worker_dequeue(&egress, &rlw, pkts, LF_MAX_PKT_BURST,
+			ns_now);
+	if (n != 10 || pkts[0] != &mbufs[10] || egress.nb_pkts != 0) {
+		printf("Error: expected the remaining 10 packets, got %u\n", n);
+		error_count++;
+	}
+
+	return error_count;
+}
+
+/**
+ * If all queues are full, the head of the longest queue is dropped.
+ */
+int
+test_overflow()
+{
+	int i, j, k = 0, longest = 0, error_count = 0;
+	int nb_heavy = LF_EGRESS_MAX_PKTS / LF_EGRESS_QUEUE_SIZE;
+	uint64_t src_as[LF_EGRESS_MAX_PKTS / LF_EGRESS_QUEUE_SIZE + 1];
+	struct rte_mbuf *drop;
+
+	reset(UINT32_MAX, UINT32_MAX);
+	distinct_sources(src_as, nb_heavy + 1);
+
+	for (i = 0; i < nb_heavy; ++i) {
+		/* ties are resolved in favor of the queue with the lowest index */
+		if (lf_egress_queue_index(src_as[i]) <
+				lf_egress_queue_index(src_as[longest])) {
+			longest = i;
+		}
+		for (j = 0; j < LF_EGRESS_QUEUE_SIZE; ++j) {
+			(void)lf_egress_worker_enqueue(&egress, &mbufs[k++], src_as[i]);
+		}
+	}
+	if (egress.nb_pkts != LF_EGRESS_MAX_PKTS) {
+		printf("Error: expected full scheduler\n");
+		error_count++;
+	}
+
+	/* the light source's packet replaces the head of a longest queue */
+	drop = lf_egress_worker_enqueue(&egress, &mbufs[k], src_as[nb_heavy]);
+	if (drop != &mbufs[longest * LF_EGRESS_QUEUE_SIZE] || egress.nb_pkts != LF_EGRESS_MAX_PKTS) {
+		printf("Error: expected the head of the longest queue to be "
+			   "dropped\n");
+		error_count++;
+	}
+
+	return error_count;
+}
+
+/**
+ * Best-effort packets with the source AS 0 are scheduled and rate limited like
+ * any other best-effort packet. Unmarked and dropped packets are kept in the
+ * burst.
+ */
+int
+test_src_as_zero()
+{
+	int i, error_count = 0;
+	uint16_t n;
+	struct rte_mbuf *pkts[LF_MAX_PKT_BURST];
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	/* 10 packets per second */
+	reset(10, 10);
+
+	for (i = 0; i < 22; ++i) {
+		pkts[i] = &mbufs[i];
+		*lf_pkt_action(&mbufs[i]) = LF_PKT_ACTION_FORWARD;
+		lf_egress_unmark(&mbufs[i]);
+	}
+	for (i = 0; i < 20; ++i) {
+		lf_egress_mark(&mbufs[i], 0);
+	}
+	/* a dropped best-effort packet is not scheduled */
+	*lf_pkt_action(&mbufs[0]) = LF_PKT_ACTION_DROP;
+
+	n = lf_egress_worker_enqueue_burst(&egress, pkts, 22);
+	if (n != 3 || pkts[0] != &mbufs[0] || pkts[1] != &mbufs[20] ||
+			pkts[2] != &mbufs[21] || egress.nb_pkts != 19) {
+		printf("Error: expected 3 kept and 19 scheduled packets, got %u and "
+			   "%u\n",
+				n, egress.nb_pkts);
+		error_count++;
+	}
+
+	n = lf_egress_worker_dequeue(&egress, &rlw, pkts, LF_MAX_PKT_BURST,
+			ns_now);
+	if (n != 10 || egress.nb_pkts != 9) {
+		printf("Error: expected 10 rate limited packets, got %u\n", n);
+		error_count++;
+	}
+
+	return error_count;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int res = rte_eal_init(argc, argv);
+	if (res < 0) {
+		return -1;
+	}
+	int error_counter = 0;
+
+	static const struct rte_mbuf_dynfield pkt_action_dynfield_desc = {
+		.name = LF_PKT_ACTION_DYNFIELD_NAME,
+		.size = sizeof(lf_pkt_action_t),
+		.align = __alignof__(lf_pkt_action_t),
+	};
+	lf_pkt_action_dynfield_offset =
+			rte_mbuf_dynfield_register(&pkt_action_dynfield_desc);
+	if (lf_pkt_action_dynfield_offset < 0 ||
+			lf_egress_register_dynfield() != 0) {
+		return -1;
+	}
+
+	error_counter += test_fairness();
+	error_counter += test_ratelimit();
+	error_counter += test_overflow();
+	error_counter += test_src_as_zero();
+
+	if (error_counter > 0) {
+		printf("Error Count: %d\n", error_counter);
+		return 1;
+	}
+
+	printf("All tests passed!\n");
+	return 0;
+}
@@ -0,0 +1,250 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright (c) 2021 ETH Zurich
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_eal.h>
+
+#include "../fetch_engine.h"
+#include "../lib/time/time.h"
+
+#define NB_THREADS 4
+
+/* request tags interpreted by the mock fetcher */
+#define TAG_FAIL_TWICE 1
+#define TAG_FAIL       2
+
+/*
+ * Mock fetcher, which simulates the round trip to the DRKey service by
+ * sleeping and fails requests according to their tag.
+ */
+static _Atomic(int) mock_running;
+static _Atomic(int) mock_max_running;
+static unsigned int mock_latency_us;
+
+static int
+mock_fetch(void *ctx, struct lf_fetch_request *request)
+{
+	int running, max_running;
+	(void)ctx;
+
+	running = atomic_fetch_add(&mock_running, 1) + 1;
+	max_running = atomic_load(&mock_max_running);
+	while (running > max_running &&
+			!atomic_compare_exchange_weak(&mock_max_running, &max_running,
+					running)) {
+	}
+	(void)usleep(mock_latency_us);
+	(void)atomic_fetch_sub(&mock_running, 1);
+
+	if (request->tag == TAG_FAIL ||
+			(request->tag == TAG_FAIL_TWICE && request->attempts < 2)) {
+		return -1;
+	}
+
+	memset(&request->key, 0, sizeof(request->key));
+	request->key.validity_not_before = request->ns_valid;
+	request->key.validity_not_after = request->ns_valid + LF_TIME_NS_IN_S;
+	return 0;
+}
+
+static void
+mock_reset(unsigned int latency_us)
+{
+	atomic_store(&mock_running, 0);
+	atomic_store(&mock_max_running, 0);
+	mock_latency_us = latency_us;
+}
+
+/**
+ * Wait until all queued requests have been fetched.
+ */
+static void
+wait_fetched(struct lf_fetch_engine *engine)
+{
+	uint16_t i;
+	bool busy;
+
+	do {
+		(void)usleep(1000);
+		busy = false;
+		(void)pthread_mutex_lock(&engine->lock);
+		for (i = 0; i < LF_FETCH_ENGINE_WINDOW; ++i) {
+			if (engine->slots[i].state == LF_FETCH_REQUEST_QUEUED ||
+					engine->slots[i].state == LF_FETCH_REQUEST_RUNNING) {
+				busy = true;
+			}
+		}
+		(void)pthread_mutex_unlock(&engine->lock);
+	} while (busy);
+}
+
+/**
+ * Requests are fetched concurrently and the window bounds the number of
+ * requests in flight.
+ */
+int
+test_window()
+{
+	int res, error_count = 0;
+	uint16_t i, nb_completed = 0;
+	struct lf_fetch_engine engine;
+	struct lf_fetch_request request = { 0 };
+	struct lf_fetch_request completed[LF_FETCH_ENGINE_WINDOW];
+
+	mock_reset(1000);
+	res = lf_fetch_engine_init(&engine, NB_THREADS, mock_fetch, NULL);
+	if (res != 0) {
+		printf("Error: lf_fetch_engine_init\n");
+		return 1;
+	}
+
+	for (i = 0; i < LF_FETCH_ENGINE_WINDOW; ++i) {
+		request.ns_valid = i;
+		res = lf_fetch_engine_submit(&engine, &request);
+		if (res != 0) {
+			printf("Error: submit %u failed\n", i);
+			error_count++;
+		}
+	}
+
+	res = lf_fetch_engine_submit(&engine, &request);
+	if (res == 0 || engine.statistics.requests_rejected != 1) {
+		printf("Error: expected submit to fail with a full window\n");
+		error_count++;
+	}
+
+	while (nb_completed < LF_FETCH_ENGINE_WINDOW) {
+		wait_fetched(&engine);
+		nb_completed += lf_fetch_engine_poll(&engine, 0, completed,
+				LF_FETCH_ENGINE_WINDOW);
+	}
+	for (i = 0; i < LF_FETCH_ENGINE_WINDOW; ++i) {
+		if (completed[i].res != 0 || completed[i].attempts != 1 ||
+				completed[i].key.validity_not_before !=
+						completed[i].ns_valid) {
+			printf("Error: unexpected result of request %u\n", i);
+			error_count++;
+			break;
+		}
+	}
+
+	if (atomic_load(&mock_max_running) < 2) {
+		printf("Error: expected concurrent fetches, got %d\n",
+				atomic_load(&mock_max_running));
+		error_count++;
+	}
+	if (!lf_fetch_engine_has_capacity(&engine) ||
+			engine.statistics.requests_completed != LF_FETCH_ENGINE_WINDOW) {
+		printf("Error: expected empty window\n");
+		error_count++;
+	}
+
+	lf_fetch_engine_close(&engine);
+	return error_count;
+}
+
+/**
+ * Failed requests are retried after the backoff, and returned as failed after
+ * the maximum number of attempts.
+ */
+int
+test_retry()
+{
+	int res, error_count = 0;
+	uint32_t attempt;
+	uint16_t nb_completed;
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+	struct lf_fetch_engine engine;
+	struct lf_fetch_request request = { 0 };
+	struct lf_fetch_request completed[2];
+
+	mock_reset(0);
+	res = lf_fetch_engine_init(&engine, NB_THREADS, mock_fetch, NULL);
+	if (res != 0) {
+		printf("Error: lf_fetch_engine_init\n");
+		return 1;
+	}
+
+	request.tag = TAG_FAIL_TWICE;
+	(void)lf_fetch_engine_submit(&engine, &request);
+	request.tag = TAG_FAIL;
+	(void)lf_fetch_engine_submit(&engine, &request);
+
+	/* first attempt fails for both requests */
+	wait_fetched(&engine);
+	nb_completed = lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+	if (nb_completed != 0 || engine.statistics.requests_retried != 2) {
+		printf("Error: expected both requests to be retried\n");
+		error_count++;
+	}
+
+	/* requests are not retried before the backoff passed */
+	nb_completed = lf_fetch_engine_poll(&engine,
+			ns_now + LF_FETCH_ENGINE_BACKOFF_MIN - 1, completed, 2);
+	wait_fetched(&engine);
+	if (nb_completed != 0 || engine.nb_queued != 0 ||
+			engine.statistics.requests_retried != 2) {
+		printf("Error: expected requests to back off\n");
+		error_count++;
+	}
+
+	/* second attempt fails for both requests, third attempt succeeds */
+	ns_now += LF_FETCH_ENGINE_BACKOFF_MIN;
+	(void)lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+	wait_fetched(&engine);
+	(void)lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+	ns_now += 2 * LF_FETCH_ENGINE_BACKOFF_MIN;
+	(void)lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+	wait_fetched(&engine);
+	nb_completed = lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+	if (nb_completed != 1 || completed[0].tag != TAG_FAIL_TWICE ||
+			completed[0].res != 0 || completed[0].attempts != 3) {
+		printf("Error: expected the third attempt to succeed\n");
+		error_count++;
+	}
+
+	/* the other request fails until the maximum number of attempts */
+	nb_completed = 0;
+	for (attempt = 3; attempt < LF_FETCH_ENGINE_MAX_ATTEMPTS; ++attempt) {
+		ns_now += LF_FETCH_ENGINE_BACKOFF_MAX;
+		(void)lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+		wait_fetched(&engine);
+		nb_completed = lf_fetch_engine_poll(&engine, ns_now, completed, 2);
+	}
+	if (nb_completed != 1 || completed[0].tag != TAG_FAIL ||
+			completed[0].res == 0 ||
+			completed[0].attempts != LF_FETCH_ENGINE_MAX_ATTEMPTS ||
+			engine.statistics.requests_failed != 1 || engine.nb_inflight != 0) {
+		printf("Error: expected the request to fail\n");
+		error_count++;
+	}
+
+	lf_fetch_engine_close(&engine);
+	return error_count;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int res = rte_eal_init(argc, argv);
+	if (res < 0) {
+		return -1;
+	}
+	int error_counter = 0;
+
+	error_counter += test_window();
+	error_counter += test_retry();
+
+	if (error_counter > 0) {
+		printf("Error Count: %d\n", error_counter);
+		return 1;
+	}
+
+	printf("All tests passed!\n");
+	return 0;
+}
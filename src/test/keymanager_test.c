@@ -2,9 +2,12 @@
  * Copyright (c) 2021 ETH Zurich
  */
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <rte_malloc.h>
+#include <rte_mempool.h>
 #include <rte_rcu_qsbr.h>
 
 #include "../config.h"
@@ -19,6 +22,8 @@
 #define TEST2_JSON "keymanager_test2.json"
 #define TEST3_JSON "keymanager_test3.json"
 
+#define TEST_KEYCACHE "/tmp/lf_keymanager_test.cache"
+
 #define LF_TEST_NO_RCU 1
 
 volatile bool lf_force_quit = false;
@@ -75,8 +80,14 @@ new_test_context()
 	int res;
 	struct lf_keymanager *keymanager;
 	int nb_workers = 2;
+	int worker_id;
+	uint16_t worker_lcores[LF_MAX_WORKER];
 	struct rte_rcu_qsbr *qsv;
 
+	for (worker_id = 0; worker_id < nb_workers; ++worker_id) {
+		worker_lcores[worker_id] = worker_id;
+	}
+
 	qsv = new_rcu_qs(nb_workers);
 	if (qsv == NULL) {
 		return NULL;
@@ -89,7 +100,7 @@ new_test_context()
 		return NULL;
 	}
 
-	res = lf_keymanager_init(keymanager, nb_workers, 10, qsv);
+	res = lf_keymanager_init(keymanager, worker_lcores, nb_workers, 10, qsv);
 	if (res < 0) {
 		printf("Error: lf_keymanager_init\n");
 		free(keymanager);
@@ -100,6 +111,31 @@ new_test_context()
 	return keymanager;
 }
 
+/**
+ * Apply the config and wait until the keys of the added peers, which are
+ * fetched asynchronously, have been applied.
+ *
+ * @return 0 on success.
+ */
+static int
+apply_config_and_fetch(struct lf_keymanager *km, struct lf_config *config)
+{
+	int i, res;
+
+	res = lf_keymanager_apply_config(km, config);
+	if (res != 0) {
+		return res;
+	}
+	for (i = 0; i < 10000; ++i) {
+		lf_keymanager_service_update(km);
+		if (km->fetch_engine.nb_inflight == 0) {
+			return 0;
+		}
+		(void)usleep(1000);
+	}
+	return -1;
+}
+
 void
 print_keys(uint8_t expected[LF_CRYPTO_DRKEY_SIZE],
 		uint8_t actual[LF_CRYPTO_DRKEY_SIZE])
@@ -144,7 +180,7 @@ test1()
 		return 1;
 	}
 
-	res = lf_keymanager_apply_config(km, config);
+	res = apply_config_and_fetch(km, config);
 	if (res != 0) {
 		printf("Error: lf_keymanager_apply_config\n");
 		return 1;
@@ -251,7 +287,7 @@ test2()
 		printf("Error: lf_config_new_from_file\n");
 		return 1;
 	}
-	res = lf_keymanager_apply_config(km1, config1);
+	res = apply_config_and_fetch(km1, config1);
 	if (res != 0) {
 		printf("Error: lf_keymanager_apply_config\n");
 		return 1;
@@ -283,7 +319,7 @@ test2()
 		printf("Error: lf_config_new_from_file\n");
 		return 1;
 	}
-	res = lf_keymanager_apply_config(km2, config2);
+	res = apply_config_and_fetch(km2, config2);
 	if (res != 0) {
 		printf("Error: lf_keymanager_apply_config\n");
 		return 1;
@@ -453,7 +489,7 @@ test4()
 		goto exit;
 	}
 
-	res = lf_keymanager_apply_config(km, config1);
+	res = apply_config_and_fetch(km, config1);
 	if (res != 0) {
 		printf("Error: lf_keymanager_apply_config\n");
 		error_count = 1;
@@ -477,7 +513,7 @@ test4()
 	}
 
 	// apply new config with additional key
-	res = lf_keymanager_apply_config(km, config3);
+	res = apply_config_and_fetch(km, config3);
 	if (res != 0) {
 		printf("Error: lf_keymanager_apply_config\n");
 		error_count = 1;
@@ -519,6 +555,753 @@ exit:
 	return error_count;
 }
 
+/**
+ * Test that the workers' host-to-host DRKey cache returns the same keys as the
+ * derivation from the AS-AS DRKey and that it is invalidated when the config is
+ * applied.
+ *
+ * @return int
+ */
+int
+test5()
+{
+	int res = 0, error_count = 0;
+	struct lf_keymanager *km;
+	struct lf_keymanager_worker *kmw;
+	struct lf_config *config;
+	uint64_t ns_now, ns_drkey_epoch_start;
+	uint32_t generation;
+	struct lf_crypto_drkey drkey, cached_drkey, expected_drkey;
+	struct lf_keymanager_dictionary_key key;
+	struct lf_keymanager_dictionary_data *dict_node;
+	struct lf_host_addr src_host_addr;
+	struct lf_host_addr dst_host_addr;
+
+	uint32_t src_addr = 0x0202f80a; // 10.248.2.2
+	uint32_t dst_addr = 0x0505f80a; // 10.248.5.5
+
+	src_host_addr.addr = &src_addr;
+	src_host_addr.type_length = LF_HOST_ADDR_TL_IPV4;
+	dst_host_addr.addr = &dst_addr;
+	dst_host_addr.type_length = LF_HOST_ADDR_TL_IPV4;
+
+	km = new_test_context();
+	if (km == NULL) {
+		return 1;
+	}
+	kmw = &km->workers[0];
+
+	config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		free_test_context(km);
+		return 1;
+	}
+
+	res = apply_config_and_fetch(km, config);
+	if (res != 0) {
+		printf("Error: lf_keymanager_apply_config\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	res = lf_time_get(&ns_now);
+	if (res != 0) {
+		printf("Error: Failed to get time (res = %d)\n", res);
+		error_count = 1;
+		goto exit;
+	}
+
+	key.as = config->peers->isd_as;
+	key.drkey_protocol = config->peers->drkey_protocol;
+	res = rte_hash_lookup_data(km->dict, &key, (void **)&dict_node);
+	if (res < 0) {
+		printf("Error: rte_hash_lookup_data\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	uint64_t ns_rel_time = ns_now - dict_node->inbound_key.validity_not_before;
+
+	/* the second query is served by the cache */
+	for (int i = 0; i < 2; i++) {
+		res = lf_keymanager_worker_inbound_get_drkey(kmw, key.as,
+				&src_host_addr, &dst_host_addr, key.drkey_protocol, ns_now,
+				ns_rel_time, &ns_drkey_epoch_start, &drkey);
+		if (res != 0) {
+			printf("Error: lf_keymanager_worker_inbound_get_drkey (res = "
+				   "%d)\n",
+					res);
+			error_count += 1;
+		}
+		if (i == 0) {
+			cached_drkey = drkey;
+		}
+	}
+	lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
+			&dict_node->inbound_key.key, &dst_host_addr, &src_host_addr,
+			key.drkey_protocol, &expected_drkey);
+	if (memcmp(expected_drkey.key, cached_drkey.key, LF_CRYPTO_DRKEY_SIZE) !=
+					0 ||
+			memcmp(expected_drkey.key, drkey.key, LF_CRYPTO_DRKEY_SIZE) != 0) {
+		printf("Error: Cached inbound DRKey differs\n");
+		print_keys(expected_drkey.key, drkey.key);
+		error_count += 1;
+	}
+
+	/* different host must not be served by the cached entry */
+	src_addr = 0x0303f80a; // 10.248.3.3
+	res = lf_keymanager_worker_inbound_get_drkey(kmw, key.as, &src_host_addr,
+			&dst_host_addr, key.drkey_protocol, ns_now, ns_rel_time,
+			&ns_drkey_epoch_start, &drkey);
+	if (res != 0) {
+		printf("Error: lf_keymanager_worker_inbound_get_drkey (res = %d)\n",
+				res);
+		error_count += 1;
+	}
+	lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
+			&dict_node->inbound_key.key, &dst_host_addr, &src_host_addr,
+			key.drkey_protocol, &expected_drkey);
+	if (memcmp(expected_drkey.key, drkey.key, LF_CRYPTO_DRKEY_SIZE) != 0) {
+		printf("Error: Inbound DRKey for different host differs\n");
+		print_keys(expected_drkey.key, drkey.key);
+		error_count += 1;
+	}
+
+	/* same hosts in the outbound direction must not be served by the cached
+	 * inbound entry */
+	res = lf_keymanager_worker_outbound_get_drkey(kmw, key.as, &src_host_addr,
+			&dst_host_addr, key.drkey_protocol, ns_now, &ns_drkey_epoch_start,
+			&drkey);
+	if (res != 0) {
+		printf("Error: lf_keymanager_worker_outbound_get_drkey (res = %d)\n",
+				res);
+		error_count += 1;
+	}
+	lf_drkey_derive_host_host_from_as_as(&kmw->drkey_ctx,
+			&dict_node->outbound_key.key, &src_host_addr, &dst_host_addr,
+			key.drkey_protocol, &expected_drkey);
+	if (memcmp(expected_drkey.key, drkey.key, LF_CRYPTO_DRKEY_SIZE) != 0) {
+		printf("Error: Outbound DRKey differs\n");
+		print_keys(expected_drkey.key, drkey.key);
+		error_count += 1;
+	}
+
+	/* applying a config invalidates the cache */
+	generation = atomic_load(&km->generation);
+	res = apply_config_and_fetch(km, config);
+	if (res != 0) {
+		printf("Error: lf_keymanager_apply_config\n");
+		error_count += 1;
+	}
+	if (atomic_load(&km->generation) == generation) {
+		printf("Error: Generation not increased by config apply\n");
+		error_count += 1;
+	}
+
+exit:
+	free(config);
+	free_test_context(km);
+
+	return error_count;
+}
+
+/**
+ * Test that applying a config schedules the refresh of the inbound and outbound
+ * key of each peer before the key expires.
+ *
+ * @return int
+ */
+int
+test6()
+{
+	int res = 0, error_count = 0;
+	uint32_t i;
+	struct lf_keymanager *km;
+	struct lf_config *config;
+	struct lf_keymanager_refresh *refresh;
+	struct lf_keymanager_dictionary_data *dict_node;
+	struct lf_keymanager_key_container *container;
+
+	km = new_test_context();
+	if (km == NULL) {
+		return 1;
+	}
+
+	config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		free_test_context(km);
+		return 1;
+	}
+
+	res = apply_config_and_fetch(km, config);
+	if (res != 0) {
+		printf("Error: lf_keymanager_apply_config\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	if (km->refresh_nb != 2 * config->nb_peers) {
+		printf("Error: Expected %zu scheduled refreshes, got %u\n",
+				2 * config->nb_peers, km->refresh_nb);
+		error_count += 1;
+	}
+
+	for (i = 0; i < km->refresh_nb; ++i) {
+		refresh = &km->refresh_heap[i];
+		if (refresh->ns_due < km->refresh_heap[0].ns_due) {
+			printf("Error: Refresh %u is due before the heap's first\n", i);
+			error_count += 1;
+		}
+
+		res = rte_hash_lookup_data(km->dict, &refresh->key,
+				(void **)&dict_node);
+		if (res < 0) {
+			printf("Error: Refresh %u for unknown entry\n", i);
+			error_count += 1;
+			continue;
+		}
+		if (refresh->direction == LF_KEYMANAGER_DIRECTION_INBOUND) {
+			container = &dict_node->inbound_key;
+		} else {
+			container = &dict_node->outbound_key;
+		}
+		if (refresh->validity_not_after != container->validity_not_after ||
+				refresh->ns_due + LF_DRKEY_PREFETCHING_PERIOD >
+						container->validity_not_after ||
+				refresh->ns_due + LF_DRKEY_PREFETCHING_PERIOD +
+								LF_KEYMANAGER_REFRESH_JITTER <
+						container->validity_not_after) {
+			printf("Error: Unexpected due time of refresh %u\n", i);
+			error_count += 1;
+		}
+	}
+
+exit:
+	free(config);
+	free_test_context(km);
+
+	return error_count;
+}
+
+/**
+ * Test that the data of removed entries are returned to the mempools, and that
+ * the replicas' data are only returned once reclaimed from the defer queue.
+ *
+ * @return int
+ */
+int
+test7()
+{
+	int res = 0, error_count = 0;
+	unsigned int socket = rte_lcore_to_socket_id(0);
+	struct lf_keymanager *km;
+	struct lf_config *config1, *config3;
+
+	km = new_test_context();
+	if (km == NULL) {
+		return 1;
+	}
+
+	config1 = lf_config_new_from_file(TEST1_JSON);
+	config3 = lf_config_new_from_file(TEST3_JSON);
+	if (config1 == NULL || config3 == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	res = apply_config_and_fetch(km, config1);
+	if (res != 0) {
+		printf("Error: lf_keymanager_apply_config\n");
+		error_count = 1;
+		goto exit;
+	}
+	/* the replica entries replaced by the fetched keys are reclaimed */
+	(void)rte_rcu_qsbr_dq_reclaim(km->dq, UINT32_MAX, NULL, NULL, NULL);
+	if (rte_mempool_in_use_count(km->dict_pool) != config1->nb_peers ||
+			rte_mempool_in_use_count(km->socket_pool[socket]) !=
+					config1->nb_peers) {
+		printf("Error: Expected %zu entries in use\n", config1->nb_peers);
+		error_count += 1;
+	}
+
+	/* config 3 removes a peer */
+	res = apply_config_and_fetch(km, config3);
+	if (res != 0) {
+		printf("Error: lf_keymanager_apply_config\n");
+		error_count = 1;
+		goto exit;
+	}
+	if (rte_mempool_in_use_count(km->dict_pool) != config3->nb_peers) {
+		printf("Error: Expected the removed entry to be freed\n");
+		error_count += 1;
+	}
+
+	/* no worker is online, i.e., all deferred data can be reclaimed */
+	(void)rte_rcu_qsbr_dq_reclaim(km->dq, UINT32_MAX, NULL, NULL, NULL);
+	if (rte_mempool_in_use_count(km->socket_pool[socket]) !=
+			config3->nb_peers) {
+		printf("Error: Expected the removed replica entry to be reclaimed\n");
+		error_count += 1;
+	}
+
+exit:
+	free(config1);
+	free(config3);
+	free_test_context(km);
+
+	return error_count;
+}
+
+/**
+ * Test that the keys checkpointed into the key cache are restored by a new key
+ * manager instead of fetched, and that a corrupted key cache is not restored.
+ *
+ * @return int
+ */
+int
+test8()
+{
+	int res = 0, error_count = 0;
+	uint32_t iterator;
+	int fd;
+	uint8_t byte;
+	struct lf_keymanager *km1 = NULL, *km2 = NULL, *km3 = NULL;
+	struct lf_config *config;
+	struct lf_keymanager_dictionary_key *key_ptr;
+	struct lf_keymanager_dictionary_data *data1, *data2;
+
+	(void)unlink(TEST_KEYCACHE);
+
+	config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+
+	km1 = new_test_context();
+	km2 = new_test_context();
+	km3 = new_test_context();
+	if (km1 == NULL || km2 == NULL || km3 == NULL) {
+		error_count = 1;
+		goto exit;
+	}
+
+	res = lf_keymanager_cache_init(km1, TEST_KEYCACHE);
+	res |= apply_config_and_fetch(km1, config);
+	res |= lf_keymanager_checkpoint(km1);
+	if (res != 0 || km1->statistics.keys_restored != 0) {
+		printf("Error: Fail to checkpoint keys\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	res = lf_keymanager_cache_init(km2, TEST_KEYCACHE);
+	res |= apply_config_and_fetch(km2, config);
+	if (res != 0) {
+		printf("Error: Fail to restore keys\n");
+		error_count = 1;
+		goto exit;
+	}
+	if (km2->statistics.keys_restored != 2 * config->nb_peers) {
+		printf("Error: Expected %zu restored keys, got %" PRIu64 "\n",
+				2 * config->nb_peers, km2->statistics.keys_restored);
+		error_count += 1;
+	}
+
+	for (iterator = 0; rte_hash_iterate(km1->dict, (void *)&key_ptr,
+							   (void **)&data1, &iterator) >= 0;) {
+		res = rte_hash_lookup_data(km2->dict, key_ptr, (void **)&data2);
+		if (res < 0 ||
+				memcmp(&data1->inbound_key, &data2->inbound_key,
+						sizeof(data1->inbound_key)) != 0 ||
+				memcmp(&data1->outbound_key, &data2->outbound_key,
+						sizeof(data1->outbound_key)) != 0) {
+			printf("Error: Restored keys differ from checkpointed keys\n");
+			error_count += 1;
+		}
+	}
+
+	/* flip a bit of the last key in the cache file */
+	fd = open(TEST_KEYCACHE, O_RDWR);
+	if (fd < 0 || lseek(fd, -1, SEEK_END) < 0 || read(fd, &byte, 1) != 1 ||
+			lseek(fd, -1, SEEK_END) < 0) {
+		printf("Error: Fail to read cache file\n");
+		error_count += 1;
+	} else {
+		byte ^= 1;
+		if (write(fd, &byte, 1) != 1) {
+			printf("Error: Fail to write cache file\n");
+			error_count += 1;
+		}
+	}
+	if (fd >= 0) {
+		(void)close(fd);
+	}
+
+	res = lf_keymanager_cache_init(km3, TEST_KEYCACHE);
+	if (res == 0) {
+		printf("Error: Corrupted cache file restored\n");
+		error_count += 1;
+	}
+	res = apply_config_and_fetch(km3, config);
+	if (res != 0 || km3->statistics.keys_restored != 0) {
+		printf("Error: Keys restored from corrupted cache file\n");
+		error_count += 1;
+	}
+
+exit:
+	free(config);
+	if (km1 != NULL) {
+		free_test_context(km1);
+	}
+	if (km2 != NULL) {
+		free_test_context(km2);
+	}
+	if (km3 != NULL) {
+		free_test_context(km3);
+	}
+	(void)unlink(TEST_KEYCACHE);
+
+	return error_count;
+}
+
+/**
+ * Wait until the key manager has applied the fetched key of the peer to the
+ * worker's dictionary replica.
+ *
+ * @return 0 if the key has been applied.
+ */
+static int
+wait_on_demand_key(struct lf_keymanager *km, struct lf_keymanager_worker *kmw,
+		const struct lf_keymanager_dictionary_key *key)
+{
+	int i;
+
+	for (i = 0; i < 1000; ++i) {
+		lf_keymanager_service_update(km);
+		if (rte_hash_lookup(kmw->dict, key) >= 0) {
+			return 0;
+		}
+		(void)usleep(1000);
+	}
+	return -1;
+}
+
+/**
+ * Test that with on-demand fetching, the keys of the peers reported by the
+ * workers are fetched, that reported peers whose keys cannot be fetched do not
+ * evict entries, and that the least recently used and idle entries are
+ * removed.
+ *
+ * @return int
+ */
+int
+test9()
+{
+	int res = 0, error_count = 0;
+	uint32_t i;
+	struct lf_keymanager *km;
+	struct lf_keymanager_worker *kmw;
+	struct lf_config *config;
+	uint64_t ns_now, ns_drkey_epoch_start, submitted;
+	struct lf_crypto_drkey drkey;
+	struct lf_keymanager_dictionary_key key, other_key, unknown_key;
+	struct lf_host_addr src_host_addr;
+	struct lf_host_addr dst_host_addr;
+
+	uint32_t src_addr = 0x0202f80a; // 10.248.2.2
+	uint32_t dst_addr = 0x0505f80a; // 10.248.5.5
+
+	src_host_addr.addr = &src_addr;
+	src_host_addr.type_length = LF_HOST_ADDR_TL_IPV4;
+	dst_host_addr.addr = &dst_addr;
+	dst_host_addr.type_length = LF_HOST_ADDR_TL_IPV4;
+
+	km = new_test_context();
+	if (km == NULL) {
+		return 1;
+	}
+	kmw = &km->workers[0];
+
+	config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		free_test_context(km);
+		return 1;
+	}
+
+	res = lf_keymanager_on_demand_init(km);
+	res |= lf_keymanager_apply_config(km, config);
+	res |= lf_time_get(&ns_now);
+	if (res != 0) {
+		printf("Error: Fail to set up on-demand fetching\n");
+		error_count = 1;
+		goto exit;
+	}
+	if (rte_hash_count(km->dict) != 0) {
+		printf("Error: Expected no keys to be fetched for the config\n");
+		error_count += 1;
+	}
+
+	/* the first packet of a peer misses and reports the peer */
+	key.as = config->peers->isd_as;
+	key.drkey_protocol = config->peers->drkey_protocol;
+	res = lf_keymanager_worker_inbound_get_drkey(kmw, key.as, &src_host_addr,
+			&dst_host_addr, key.drkey_protocol, ns_now, 0,
+			&ns_drkey_epoch_start, &drkey);
+	if (res != -1) {
+		printf("Error: Expected a miss for the unknown peer (res = %d)\n", res);
+		error_count += 1;
+	}
+	res = wait_on_demand_key(km, kmw, &key);
+	if (res != 0 || km->statistics.on_demand_added != 1) {
+		printf("Error: Expected the reported peer's key to be fetched\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	/*
+	 * Reports of peers whose keys cannot be fetched neither add nor evict
+	 * entries, even if the dictionary is full. The peers exceeding the pending
+	 * table are dropped.
+	 */
+	km->size = 1;
+	unknown_key.drkey_protocol = key.drkey_protocol;
+	for (i = 0; i < 2 * LF_KEYMANAGER_ON_DEMAND_PENDING; ++i) {
+		unknown_key.as = rte_cpu_to_be_64(0x0100000000ff0000 + i);
+		lf_keymanager_worker_report(kmw, &unknown_key,
+				ns_now + i * LF_KEYMANAGER_REPORT_INTERVAL);
+	}
+	lf_keymanager_service_update(km);
+	if (km->statistics.on_demand_dropped != LF_KEYMANAGER_ON_DEMAND_PENDING) {
+		printf("Error: Expected %u dropped reports, got %" PRIu64 "\n",
+				LF_KEYMANAGER_ON_DEMAND_PENDING,
+				km->statistics.on_demand_dropped);
+		error_count += 1;
+	}
+	for (i = 0; i < 5000 && km->statistics.on_demand_failed <
+								   LF_KEYMANAGER_ON_DEMAND_PENDING;
+			++i) {
+		(void)usleep(1000);
+		lf_keymanager_service_update(km);
+	}
+	if (km->statistics.on_demand_failed != LF_KEYMANAGER_ON_DEMAND_PENDING ||
+			km->statistics.on_demand_added != 1 ||
+			km->statistics.on_demand_evicted != 0 ||
+			rte_hash_lookup(km->dict, &key) < 0 ||
+			rte_hash_lookup(kmw->dict, &key) < 0) {
+		printf("Error: Expected failed fetches not to evict entries\n");
+		error_count += 1;
+	}
+
+	/* a failed peer is not requested again before the retry time */
+	unknown_key.as = rte_cpu_to_be_64(0x0100000000ff0000);
+	lf_keymanager_worker_report(kmw, &unknown_key,
+			ns_now + 1000 * LF_KEYMANAGER_REPORT_INTERVAL);
+	submitted = km->fetch_engine.statistics.requests_submitted;
+	lf_keymanager_service_update(km);
+	if (km->fetch_engine.statistics.requests_submitted != submitted) {
+		printf("Error: Expected the failed peer not to be requested again\n");
+		error_count += 1;
+	}
+
+	/* a peer whose key has been fetched evicts the least recently used entry */
+	other_key.as = config->peers->next->isd_as;
+	other_key.drkey_protocol = config->peers->next->drkey_protocol;
+	lf_keymanager_worker_report(kmw, &other_key, ns_now);
+	res = wait_on_demand_key(km, kmw, &other_key);
+	if (res != 0 || rte_hash_lookup(km->dict, &key) >= 0 ||
+			km->statistics.on_demand_evicted != 1) {
+		printf("Error: Expected the least recently used entry to be "
+			   "evicted\n");
+		error_count += 1;
+	}
+	if (rte_hash_lookup(kmw->dict, &key) >= 0) {
+		printf("Error: Expected the evicted entry to be removed from the "
+			   "replica\n");
+		error_count += 1;
+	}
+
+	/* the least recently used entry is removed once idle */
+	km->lru[km->lru_tail].ns_last_used = 0;
+	lf_keymanager_service_update(km);
+	if (km->statistics.on_demand_expired != 1 ||
+			rte_hash_count(km->dict) != 0) {
+		printf("Error: Expected the idle entry to be removed\n");
+		error_count += 1;
+	}
+
+exit:
+	free(config);
+	free_test_context(km);
+
+	return error_count;
+}
+
+/**
+ * Test that with on-demand fetching, applying a config keeps the fetched keys
+ * of the reported peers, unless the local AS changes.
+ *
+ * @return int
+ */
+int
+test10()
+{
+	int res = 0, error_count = 0;
+	struct lf_keymanager *km;
+	struct lf_keymanager_worker *kmw;
+	struct lf_config *config1, *config2, *config3;
+	struct lf_keymanager_dictionary_key key, other_key;
+	uint64_t ns_now;
+
+	km = new_test_context();
+	if (km == NULL) {
+		return 1;
+	}
+	kmw = &km->workers[0];
+
+	config1 = lf_config_new_from_file(TEST1_JSON);
+	config2 = lf_config_new_from_file(TEST2_JSON);
+	config3 = lf_config_new_from_file(TEST3_JSON);
+	if (config1 == NULL || config2 == NULL || config3 == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	res = lf_keymanager_on_demand_init(km);
+	res |= lf_keymanager_apply_config(km, config1);
+	res |= lf_time_get(&ns_now);
+	if (res != 0) {
+		printf("Error: Fail to set up on-demand fetching\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	key.as = config1->peers->isd_as;
+	key.drkey_protocol = config1->peers->drkey_protocol;
+	other_key.as = config1->peers->next->isd_as;
+	other_key.drkey_protocol = config1->peers->next->drkey_protocol;
+	lf_keymanager_worker_report(kmw, &key, ns_now);
+	lf_keymanager_worker_report(kmw, &other_key, ns_now);
+	res = wait_on_demand_key(km, kmw, &key);
+	res |= wait_on_demand_key(km, kmw, &other_key);
+	if (res != 0) {
+		printf("Error: Expected the reported peers' keys to be fetched\n");
+		error_count = 1;
+		goto exit;
+	}
+
+	/* reloading the config keeps the entries */
+	res = lf_keymanager_apply_config(km, config1);
+	if (res != 0 || rte_hash_count(km->dict) != 2 ||
+			rte_hash_lookup(kmw->dict, &key) < 0 ||
+			rte_hash_lookup(kmw->dict, &other_key) < 0) {
+		printf("Error: Expected the reported peers' keys to survive the "
+			   "reload\n");
+		error_count += 1;
+	}
+
+	/* a config without the peer keeps its entry until it is idle */
+	res = lf_keymanager_apply_config(km, config3);
+	if (res != 0 || rte_hash_lookup(km->dict, &other_key) < 0 ||
+			rte_hash_lookup(kmw->dict, &other_key) < 0) {
+		printf("Error: Expected the unconfigured peer's key to survive the "
+			   "reload\n");
+		error_count += 1;
+	}
+
+	/* a config with another local AS removes the entries */
+	res = lf_keymanager_apply_config(km, config2);
+	if (res != 0 || rte_hash_count(km->dict) != 0 ||
+			rte_hash_lookup(kmw->dict, &key) >= 0) {
+		printf("Error: Expected the entries to be removed for another local "
+			   "AS\n");
+		error_count += 1;
+	}
+
+exit:
+	free(config1);
+	free(config2);
+	free(config3);
+	free_test_context(km);
+
+	return error_count;
+}
+
+/**
+ * Test that applying a config does not fetch the keys synchronously: the new
+ * peers are added without valid keys and their keys are requested from the
+ * fetch engine, which are applied by the service.
+ *
+ * @return int
+ */
+int
+test11()
+{
+	int i, res = 0, error_count = 0;
+	uint32_t iterator;
+	struct lf_keymanager *km;
+	struct lf_config *config;
+	struct lf_keymanager_dictionary_key *key_ptr;
+	struct lf_keymanager_dictionary_data *data;
+
+	km = new_test_context();
+	if (km == NULL) {
+		return 1;
+	}
+
+	config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		free_test_context(km);
+		return 1;
+	}
+
+	res = lf_keymanager_apply_config(km, config);
+	if (res != 0 || rte_hash_count(km->dict) != (int32_t)config->nb_peers ||
+			km->fetch_engine.statistics.requests_submitted !=
+					2 * config->nb_peers) {
+		printf("Error: Expected the peers' keys to be requested\n");
+		error_count = 1;
+		goto exit;
+	}
+	for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
+							   (void **)&data, &iterator) >= 0;) {
+		if (data->inbound_key.validity_not_after != 0 ||
+				data->outbound_key.validity_not_after != 0 ||
+				!(data->fetch_pending & (1 << LF_KEYMANAGER_DIRECTION_INBOUND)) ||
+				!(data->fetch_pending &
+						(1 << LF_KEYMANAGER_DIRECTION_OUTBOUND))) {
+			printf("Error: Expected the new entry's keys to be pending\n");
+			error_count += 1;
+		}
+	}
+
+	for (i = 0; i < 10000 && km->fetch_engine.nb_inflight != 0; ++i) {
+		(void)usleep(1000);
+		lf_keymanager_service_update(km);
+	}
+	for (iterator = 0; rte_hash_iterate(km->dict, (void *)&key_ptr,
+							   (void **)&data, &iterator) >= 0;) {
+		if (data->inbound_key.validity_not_after == 0 ||
+				data->outbound_key.validity_not_after == 0 ||
+				data->fetch_pending != 0) {
+			printf("Error: Expected the fetched keys to be applied\n");
+			error_count += 1;
+		}
+	}
+
+exit:
+	free(config);
+	free_test_context(km);
+
+	return error_count;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -532,6 +1315,13 @@ main(int argc, char *argv[])
 	error_counter += test2();
 	error_counter += test3();
 	error_counter += test4();
+	error_counter += test5();
+	error_counter += test6();
+	error_counter += test7();
+	error_counter += test8();
+	error_counter += test9();
+	error_counter += test10();
+	error_counter += test11();
 
 	if (error_counter > 0) {
 		printf("Error Count: %d\n", error_counter);
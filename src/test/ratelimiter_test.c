@@ -4,6 +4,7 @@
 
 #include <pthread.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <rte_malloc.h>
 #include <rte_rcu_qsbr.h>
@@ -12,6 +13,7 @@
 #include "../lf.h"
 #include "../lib/log/log.h"
 #include "../lib/time/time.h"
+#include "../overload.h"
 #include "../ratelimiter.h"
 
 #define TEST1_JSON "ratelimiter_test1.json"
@@ -60,7 +62,7 @@ free_rcu_qs(struct rte_rcu_qsbr *qsv)
 }
 
 struct lf_ratelimiter *
-new_ratelimiter()
+new_ratelimiter_cache(bool redistribute, uint32_t cache_size)
 {
 	int res;
 	struct lf_ratelimiter *ratelimiter;
@@ -71,6 +73,8 @@ new_ratelimiter()
 
 	/* create worker context pointer array */
 	for (worker_id = 0; worker_id < nb_workers; ++worker_id) {
+		memset(&ratelimiter_workers[worker_id], 0,
+				sizeof(ratelimiter_workers[worker_id]));
 		worker_lcores[worker_id] = worker_id;
 		ratelimiter_workers_ptr[worker_id] = &ratelimiter_workers[worker_id];
 	}
@@ -87,8 +91,8 @@ new_ratelimiter()
 		return NULL;
 	}
 
-	res = lf_ratelimiter_init(ratelimiter, worker_lcores, nb_workers, 10, qsv,
-			ratelimiter_workers_ptr);
+	res = lf_ratelimiter_init(ratelimiter, worker_lcores, nb_workers, 10,
+			redistribute, cache_size, qsv, ratelimiter_workers_ptr);
 	if (res < 0) {
 		printf("Error: lf_ratelimiter_init\n");
 		free(ratelimiter);
@@ -99,6 +103,12 @@ new_ratelimiter()
 	return ratelimiter;
 }
 
+struct lf_ratelimiter *
+new_ratelimiter(bool redistribute)
+{
+	return new_ratelimiter_cache(redistribute, 0);
+}
+
 int
 test1()
 {
@@ -110,7 +120,7 @@ test1()
 
 	struct lf_config_peer *peers[4];
 
-	rl = new_ratelimiter();
+	rl = new_ratelimiter(false);
 	if (rl == NULL) {
 		return 1;
 	}
@@ -138,7 +148,7 @@ test1()
 	assert(res == 0);
 
 	/* unknown key (AS and protocol) */
-	res = lf_ratelimiter_worker_get_pkt_ctx(rlw, 1, 1, &rl_pkt_ctx);
+	res = lf_ratelimiter_worker_get_pkt_ctx(rlw, 1, 1, NULL, &rl_pkt_ctx);
 	if (res != 0) {
 		printf("Error: lf_ratelimiter_worker_get_pkt_ctx expected 0, got %d\n",
 				res);
@@ -152,7 +162,7 @@ test1()
 
 	/* AS packet rate limited */
 	res = lf_ratelimiter_worker_apply(rlw, peers[1]->isd_as,
-			peers[1]->drkey_protocol, 1, ns_now);
+			peers[1]->drkey_protocol, NULL, 1, ns_now);
 	if ((res & LF_RATELIMITER_RES_PKTS) == 0) {
 		printf("Error: lf_ratelimiter_worker_apply expected "
 			   "LF_RATELIMITER_RES_PKTS, got %d\n",
@@ -162,7 +172,7 @@ test1()
 
 	/* AS byte rate limited */
 	res = lf_ratelimiter_worker_apply(rlw, peers[2]->isd_as,
-			peers[2]->drkey_protocol, 1, ns_now);
+			peers[2]->drkey_protocol, NULL, 1, ns_now);
 	if ((res & LF_RATELIMITER_RES_BYTES) == 0) {
 		printf("Error: lf_ratelimiter_worker_apply expected "
 			   "LF_RATELIMITER_RES_BYTES, got %d\n",
@@ -172,7 +182,7 @@ test1()
 
 	/* AS rate limited */
 	res = lf_ratelimiter_worker_apply(rlw, peers[3]->isd_as,
-			peers[3]->drkey_protocol, 1, ns_now);
+			peers[3]->drkey_protocol, NULL, 1, ns_now);
 	if ((res & (LF_RATELIMITER_RES_BYTES | LF_RATELIMITER_RES_PKTS)) == 0) {
 		printf("Error: lf_ratelimiter_worker_apply expected "
 			   "LF_RATELIMITER_RES_BYTES | LF_RATELIMITER_RES_PKTS, got %d\n",
@@ -182,7 +192,7 @@ test1()
 
 	/* overall rate limited */
 	res = lf_ratelimiter_worker_apply(rlw, peers[0]->isd_as,
-			peers[0]->drkey_protocol, 10000, ns_now);
+			peers[0]->drkey_protocol, NULL, 10000, ns_now);
 	if ((res & (LF_RATELIMITER_RES_OVERALL_BYTES |
 					   LF_RATELIMITER_RES_OVERALL_PKTS)) == 0) {
 		printf("Error: lf_ratelimiter_worker_apply expected "
@@ -194,7 +204,7 @@ test1()
 
 	/* Not rate limited (AS and System) */
 	res = lf_ratelimiter_worker_apply(rlw, peers[0]->isd_as,
-			peers[0]->drkey_protocol, 10, ns_now);
+			peers[0]->drkey_protocol, NULL, 10, ns_now);
 	if (res != 0) {
 		printf("Error: lf_ratelimiter_worker_apply expected 0, got %d\n", res);
 		error_count += 1;
@@ -236,7 +246,7 @@ test1()
 
 	/* Change to rate limited */
 	res = lf_ratelimiter_worker_apply(rlw, peers[0]->isd_as,
-			peers[0]->drkey_protocol, 1, ns_now);
+			peers[0]->drkey_protocol, NULL, 1, ns_now);
 	if (res == 0) {
 		printf("Error: lf_ratelimiter_worker_apply expected != 0, got %d\n",
 				res);
@@ -248,6 +258,842 @@ test1()
 	return error_count;
 }
 
+/**
+ * Count the best-effort packets (of size 1) that pass the rate limit.
+ */
+static int
+apply_best_effort_n(struct lf_ratelimiter_worker *rlw, int nb_pkts,
+		uint64_t ns_now)
+{
+	int i, passed = 0;
+	for (i = 0; i < nb_pkts; ++i) {
+		if (lf_ratelimiter_worker_apply_best_effort(rlw, 1, ns_now) == 0) {
+			passed++;
+		}
+	}
+	return passed;
+}
+
+/**
+ * Token redistribution: All best-effort packets are received by worker 0.
+ */
+int
+test2()
+{
+	int res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_ratelimiter_worker *rlw0, *rlw1;
+	int passed0, passed1;
+	/* use a small timestamp to avoid overflows when the buckets are filled */
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	rl = new_ratelimiter(true);
+	if (rl == NULL) {
+		return 1;
+	}
+	rlw0 = rl->workers[0];
+	rlw1 = rl->workers[1];
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+	config->ratelimit.byte_rate = 1000000;
+	config->ratelimit.byte_burst = 1000000;
+	config->ratelimit.packet_rate = 1000000;
+	config->ratelimit.packet_burst = 1000000;
+	config->best_effort.ratelimit.byte_rate = 800;
+	config->best_effort.ratelimit.byte_burst = 800;
+	config->best_effort.ratelimit.packet_rate = 800;
+	config->best_effort.ratelimit.packet_burst = 800;
+
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+
+	/* 1/8 of the rate limit is assigned to the pool, the rest split equally */
+	res = apply_best_effort_n(rlw0, 400, ns_now);
+	if (res != 350) {
+		printf("Error: expected 350 packets to pass before redistribution, "
+			   "got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	/* worker 0's share increases according to its demand */
+	lf_ratelimiter_service_update(rl, LF_TIME_NS_IN_S);
+
+	/* the bucket is empty, i.e., the tokens are borrowed from the pool */
+	res = apply_best_effort_n(rlw0, 200, ns_now);
+	if (res != 100) {
+		printf("Error: expected 100 packets to pass with pool tokens, got "
+			   "%d\n",
+				res);
+		error_count += 1;
+	}
+
+	/* after the buckets have been refilled, worker 0 obtains most tokens */
+	ns_now += 2 * LF_TIME_NS_IN_S;
+	passed0 = apply_best_effort_n(rlw0, 800, ns_now);
+	passed1 = apply_best_effort_n(rlw1, 800, ns_now);
+	if (passed1 == 0 || passed0 <= 4 * passed1 || passed0 + passed1 > 700) {
+		printf("Error: unexpected redistribution, worker 0 passed %d and "
+			   "worker 1 passed %d packets\n",
+				passed0, passed1);
+		error_count += 1;
+	}
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Burst processing: The packets of a burst are grouped by their peer, and the
+ * rate limits are checked and consumed per group.
+ */
+int
+test3()
+{
+	int res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_ratelimiter_worker *rlw;
+	struct lf_config_peer *peers[2];
+	struct lf_ratelimiter_pkt_ctx pkt_ctx[12];
+	struct lf_ratelimiter_burst_ctx burst_ctx;
+	uint64_t as[12];
+	uint16_t drkey_protocol[12];
+	uint32_t pkt_len[12];
+	int pkt_res[12];
+	bool consume[12];
+	uint16_t i, nb_pkts = 12;
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	rl = new_ratelimiter(false);
+	if (rl == NULL) {
+		return 1;
+	}
+	rlw = rl->workers[0];
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+	peers[0] = config->peers;
+	peers[1] = peers[0]->next;
+
+	/* the rate limits are split among the two workers */
+	config->ratelimit.byte_rate = 1000000;
+	config->ratelimit.byte_burst = 1000000;
+	config->ratelimit.packet_rate = 20;
+	config->ratelimit.packet_burst = 20;
+	peers[1]->ratelimit.byte_rate = 1000000;
+	peers[1]->ratelimit.byte_burst = 1000000;
+	peers[1]->ratelimit.packet_rate = 10;
+	peers[1]->ratelimit.packet_burst = 10;
+
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+
+	/* alternate between peer 0 (no rate limit) and peer 1 */
+	for (i = 0; i < nb_pkts; i++) {
+		as[i] = peers[i % 2]->isd_as;
+		drkey_protocol[i] = peers[i % 2]->drkey_protocol;
+		pkt_len[i] = 1;
+		pkt_res[i] = 0;
+	}
+
+	res = lf_ratelimiter_worker_get_pkt_ctx_burst(rlw, as, drkey_protocol,
+			NULL, nb_pkts, pkt_ctx);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_worker_get_pkt_ctx_burst expected 0, "
+			   "got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	lf_ratelimiter_worker_check_burst(&burst_ctx, pkt_ctx, pkt_len, nb_pkts,
+			ns_now, pkt_res);
+	if (burst_ctx.nb_groups != 2) {
+		printf("Error: expected 2 groups, got %u\n", burst_ctx.nb_groups);
+		error_count += 1;
+	}
+
+	/*
+	 * Peer 1 allows 5 packets, such that its 6th packet (11) is rate limited.
+	 * Of the remaining 11 packets, the overall rate limit allows the first 10.
+	 */
+	for (i = 0; i < nb_pkts; i++) {
+		if (i == 11 && (pkt_res[i] & LF_RATELIMITER_RES_PKTS) == 0) {
+			printf("Error: expected packet %u to be peer rate limited, got "
+				   "%d\n",
+					i, pkt_res[i]);
+			error_count += 1;
+		} else if (i == 10 &&
+				   (pkt_res[i] & LF_RATELIMITER_RES_OVERALL_PKTS) == 0) {
+			printf("Error: expected packet %u to be overall rate limited, got "
+				   "%d\n",
+					i, pkt_res[i]);
+			error_count += 1;
+		} else if (i < 10 && pkt_res[i] != 0) {
+			printf("Error: expected packet %u to pass, got %d\n", i,
+					pkt_res[i]);
+			error_count += 1;
+		}
+		consume[i] = pkt_res[i] == 0;
+	}
+
+	lf_ratelimiter_worker_consume_burst(&burst_ctx, pkt_len, consume,
+			nb_pkts);
+
+	/* the tokens have been consumed */
+	for (i = 0; i < nb_pkts; i++) {
+		pkt_res[i] = 0;
+	}
+	lf_ratelimiter_worker_check_burst(&burst_ctx, pkt_ctx, pkt_len, nb_pkts,
+			ns_now, pkt_res);
+	for (i = 0; i < nb_pkts; i++) {
+		if (pkt_res[i] == 0) {
+			printf("Error: expected packet %u to be rate limited\n", i);
+			error_count += 1;
+		}
+	}
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Host rate limits: Each source host of a peer is rate limited separately,
+ * for single packets as well as for bursts.
+ */
+int
+test4()
+{
+	int res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_ratelimiter_worker *rlw;
+	struct lf_config_peer *peer;
+	struct lf_ratelimiter_pkt_ctx pkt_ctx[8];
+	struct lf_ratelimiter_burst_ctx burst_ctx;
+	uint32_t addr[3] = { 0x0a000001, 0x0a000002, 0x0a000003 };
+	struct lf_host_addr hosts[3];
+	const struct lf_host_addr *host[8];
+	uint64_t as[8];
+	uint16_t drkey_protocol[8];
+	uint32_t pkt_len[8];
+	int pkt_res[8];
+	bool consume[8];
+	int i, passed, nb_pkts = 8;
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	rl = new_ratelimiter(false);
+	if (rl == NULL) {
+		return 1;
+	}
+	rlw = rl->workers[0];
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+	config->ratelimit.byte_rate = 1000000;
+	config->ratelimit.byte_burst = 1000000;
+	config->ratelimit.packet_rate = 1000000;
+	config->ratelimit.packet_burst = 1000000;
+
+	/* peer 0 has no rate limit, but each host is limited to 4 packets */
+	peer = config->peers;
+	peer->host_ratelimit_option = true;
+	peer->host_ratelimit.byte_rate = 1000000;
+	peer->host_ratelimit.byte_burst = 1000000;
+	peer->host_ratelimit.packet_rate = 8;
+	peer->host_ratelimit.packet_burst = 8;
+
+	/* the host tables are only allocated once host rate limits are set */
+	if (rlw->hosts != NULL) {
+		printf("Error: expected no host table before the config\n");
+		error_count += 1;
+	}
+
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+	if (rlw->hosts == NULL || rl->workers[1]->hosts == NULL) {
+		printf("Error: expected the host tables to be allocated\n");
+		error_count += 1;
+	}
+
+	for (i = 0; i < 3; i++) {
+		hosts[i].type_length = LF_HOST_ADDR_TL_IPV4;
+		hosts[i].addr = &addr[i];
+	}
+
+	/* host 0 uses up its rate limit */
+	passed = 0;
+	for (i = 0; i < 10; i++) {
+		if (lf_ratelimiter_worker_apply(rlw, peer->isd_as,
+					peer->drkey_protocol, &hosts[0], 1, ns_now) == 0) {
+			passed++;
+		}
+	}
+	if (passed != 4) {
+		printf("Error: expected 4 packets of host 0 to pass, got %d\n",
+				passed);
+		error_count += 1;
+	}
+	res = lf_ratelimiter_worker_apply(rlw, peer->isd_as, peer->drkey_protocol,
+			&hosts[0], 1, ns_now);
+	if ((res & LF_RATELIMITER_RES_HOST_PKTS) == 0) {
+		printf("Error: lf_ratelimiter_worker_apply expected "
+			   "LF_RATELIMITER_RES_HOST_PKTS, got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	/* other hosts and packets without host are not affected */
+	res = lf_ratelimiter_worker_apply(rlw, peer->isd_as, peer->drkey_protocol,
+			&hosts[1], 1, ns_now);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_worker_apply expected 0 for host 1, got "
+			   "%d\n",
+				res);
+		error_count += 1;
+	}
+	res = lf_ratelimiter_worker_apply(rlw, peer->isd_as, peer->drkey_protocol,
+			NULL, 1, ns_now);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_worker_apply expected 0 without host, "
+			   "got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	/*
+	 * Burst of hosts 1 and 2: host 1 has 3 tokens left and host 2 has all 4
+	 * tokens. Host 2 is not added to the table before its tokens are
+	 * consumed.
+	 */
+	for (i = 0; i < nb_pkts; i++) {
+		as[i] = peer->isd_as;
+		drkey_protocol[i] = peer->drkey_protocol;
+		host[i] = &hosts[1 + i % 2];
+		pkt_len[i] = 1;
+		pkt_res[i] = 0;
+	}
+	res = lf_ratelimiter_worker_get_pkt_ctx_burst(rlw, as, drkey_protocol,
+			host, nb_pkts, pkt_ctx);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_worker_get_pkt_ctx_burst expected 0, "
+			   "got %d\n",
+				res);
+		error_count += 1;
+	}
+	lf_ratelimiter_worker_check_burst(&burst_ctx, pkt_ctx, pkt_len, nb_pkts,
+			ns_now, pkt_res);
+	if (burst_ctx.nb_host_groups != 2) {
+		printf("Error: expected 2 host groups, got %u\n",
+				burst_ctx.nb_host_groups);
+		error_count += 1;
+	}
+	for (i = 0; i < nb_pkts; i++) {
+		if ((i == 6) != ((pkt_res[i] & LF_RATELIMITER_RES_HOST_PKTS) != 0)) {
+			printf("Error: unexpected result for packet %d, got %d\n", i,
+					pkt_res[i]);
+			error_count += 1;
+		}
+		consume[i] = pkt_res[i] == 0;
+	}
+	lf_ratelimiter_worker_consume_burst(&burst_ctx, pkt_len, consume,
+			nb_pkts);
+
+	res = lf_ratelimiter_worker_apply(rlw, peer->isd_as, peer->drkey_protocol,
+			&hosts[2], 1, ns_now);
+	if ((res & LF_RATELIMITER_RES_HOST_PKTS) == 0) {
+		printf("Error: lf_ratelimiter_worker_apply expected "
+			   "LF_RATELIMITER_RES_HOST_PKTS for host 2, got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	/* a config update resets the hosts' buckets */
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+	res = lf_ratelimiter_worker_apply(rlw, peer->isd_as, peer->drkey_protocol,
+			&hosts[0], 1, ns_now);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_worker_apply expected 0 after config "
+			   "update, got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Compact mode: The workers share the peers' rate limits, and each worker
+ * caches tokens taken from the shared limit.
+ */
+int
+test5()
+{
+	int res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_config_peer *peer;
+	struct lf_ratelimiter_pkt_ctx pkt_ctx[12];
+	struct lf_ratelimiter_burst_ctx burst_ctx;
+	uint64_t as[12];
+	uint16_t drkey_protocol[12];
+	uint32_t pkt_len[12];
+	int pkt_res[12];
+	bool consume[12];
+	uint16_t i, nb_pkts = 12;
+	int nb_passed;
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	rl = new_ratelimiter_cache(false, 8);
+	if (rl == NULL) {
+		return 1;
+	}
+
+	if (rl->workers[0]->buckets != NULL || rl->workers[0]->cache == NULL ||
+			rl->workers[0]->shared != rl->workers[1]->shared) {
+		printf("Error: expected workers without buckets sharing the limits\n");
+		error_count += 1;
+	}
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+	peer = config->peers->next;
+
+	config->ratelimit.byte_rate = 1000000;
+	config->ratelimit.byte_burst = 1000000;
+	config->ratelimit.packet_rate = 1000;
+	config->ratelimit.packet_burst = 1000;
+	peer->ratelimit.byte_rate = 1000000;
+	peer->ratelimit.byte_burst = 1000000;
+	peer->ratelimit.packet_rate = 10;
+	peer->ratelimit.packet_burst = 10;
+
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+
+	/*
+	 * Both workers draw from the same shared limit, i.e., the peer's burst of
+	 * 10 packets is not split among them.
+	 */
+	nb_passed = 0;
+	for (i = 0; i < 20; i++) {
+		res = lf_ratelimiter_worker_apply(rl->workers[i % 2], peer->isd_as,
+				peer->drkey_protocol, NULL, 1, ns_now);
+		if (res < 0) {
+			printf("Error: lf_ratelimiter_worker_apply failed\n");
+			error_count += 1;
+		} else if (res == 0) {
+			nb_passed += 1;
+		}
+	}
+	if (nb_passed != 10) {
+		printf("Error: expected 10 packets to pass, got %d\n", nb_passed);
+		error_count += 1;
+	}
+
+	/* after a second, the burst is available again */
+	ns_now += LF_TIME_NS_IN_S;
+	for (i = 0; i < nb_pkts; i++) {
+		as[i] = peer->isd_as;
+		drkey_protocol[i] = peer->drkey_protocol;
+		pkt_len[i] = 1;
+		pkt_res[i] = 0;
+	}
+
+	res = lf_ratelimiter_worker_get_pkt_ctx_burst(rl->workers[1], as,
+			drkey_protocol, NULL, nb_pkts, pkt_ctx);
+	if (res != 0 || pkt_ctx[0].peer_shared == NULL) {
+		printf("Error: expected packet context with shared limit\n");
+		error_count += 1;
+	}
+
+	lf_ratelimiter_worker_check_burst(&burst_ctx, pkt_ctx, pkt_len, nb_pkts,
+			ns_now, pkt_res);
+	if (burst_ctx.nb_groups != 1) {
+		printf("Error: expected 1 group, got %u\n", burst_ctx.nb_groups);
+		error_count += 1;
+	}
+	for (i = 0; i < nb_pkts; i++) {
+		if (i < 10 && pkt_res[i] != 0) {
+			printf("Error: expected packet %u to pass, got %d\n", i,
+					pkt_res[i]);
+			error_count += 1;
+		} else if (i >= 10 && (pkt_res[i] & LF_RATELIMITER_RES_PKTS) == 0) {
+			printf("Error: expected packet %u to be peer rate limited, got "
+				   "%d\n",
+					i, pkt_res[i]);
+			error_count += 1;
+		}
+		consume[i] = pkt_res[i] == 0;
+	}
+	lf_ratelimiter_worker_consume_burst(&burst_ctx, pkt_len, consume,
+			nb_pkts);
+
+	/* the cached tokens have been consumed */
+	res = lf_ratelimiter_worker_apply(rl->workers[1], peer->isd_as,
+			peer->drkey_protocol, NULL, 1, ns_now);
+	if (res <= 0) {
+		printf("Error: expected packet to be rate limited, got %d\n", res);
+		error_count += 1;
+	}
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Dictionary replicas: The workers look up the peers in the replica of their
+ * socket, which is updated together with the manager's dictionary.
+ */
+int
+test6()
+{
+	int res = 0, error_count = 0;
+	int key_id;
+	struct lf_ratelimiter *rl;
+	struct lf_ratelimiter_worker *rlw;
+	struct lf_ratelimiter_pkt_ctx pkt_ctx;
+	struct lf_config_peer *peers[3];
+	struct lf_ratelimiter_key key;
+
+	rl = new_ratelimiter(false);
+	if (rl == NULL) {
+		return 1;
+	}
+	rlw = rl->workers[0];
+
+	if (rlw->dict == NULL || rlw->dict == rl->dict ||
+			rlw->dict != rl->workers[1]->dict) {
+		printf("Error: expected the workers to share a replica\n");
+		error_count += 1;
+	}
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+	peers[0] = config->peers;
+	peers[1] = peers[0]->next;
+	peers[2] = peers[1]->next;
+
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+
+	/* the worker obtains the peer's position in the manager's dictionary */
+	key.as = peers[1]->isd_as;
+	key.drkey_protocol = peers[1]->drkey_protocol;
+	key_id = rte_hash_lookup(rl->dict, &key);
+	(void)lf_ratelimiter_worker_get_pkt_ctx(rlw, peers[1]->isd_as,
+			peers[1]->drkey_protocol, NULL, &pkt_ctx);
+	if (key_id < 0 || pkt_ctx.peer_ratelimit != &rlw->buckets[key_id]) {
+		printf("Error: expected the peer's bucket (key_id %d)\n", key_id);
+		error_count += 1;
+	}
+
+	/* removed peers are removed from the replicas */
+	peers[0]->next = peers[2];
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+	(void)lf_ratelimiter_worker_get_pkt_ctx(rlw, peers[1]->isd_as,
+			peers[1]->drkey_protocol, NULL, &pkt_ctx);
+	if (pkt_ctx.peer_ratelimit != &rlw->auth_peers) {
+		printf("Error: expected auth peers rate limit for removed peer\n");
+		error_count += 1;
+	}
+	peers[0]->next = peers[1];
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Scaling: The best-effort rate limit is scaled down and up again, also across
+ * configuration changes.
+ */
+int
+test7()
+{
+	int res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_ratelimiter_worker *rlw0;
+	uint64_t ns_now = LF_TIME_NS_IN_S;
+
+	rl = new_ratelimiter(false);
+	if (rl == NULL) {
+		return 1;
+	}
+	rlw0 = rl->workers[0];
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+	config->ratelimit.byte_rate = 1000000;
+	config->ratelimit.byte_burst = 1000000;
+	config->ratelimit.packet_rate = 1000000;
+	config->ratelimit.packet_burst = 1000000;
+	config->best_effort.ratelimit.byte_rate = 800;
+	config->best_effort.ratelimit.byte_burst = 800;
+	config->best_effort.ratelimit.packet_rate = 800;
+	config->best_effort.ratelimit.packet_burst = 800;
+
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+
+	if (lf_ratelimiter_set_scale(rl, LF_RATELIMITER_SCALE_ONE + 1,
+				LF_RATELIMITER_SCALE_ONE) == 0) {
+		printf("Error: expected scale above one to be rejected\n");
+		error_count += 1;
+	}
+
+	/* each worker gets half of its share of the rate limit */
+	res = lf_ratelimiter_set_scale(rl, LF_RATELIMITER_SCALE_ONE / 2,
+			LF_RATELIMITER_SCALE_ONE);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_set_scale\n");
+		error_count += 1;
+	}
+	res = apply_best_effort_n(rlw0, 400, ns_now);
+	if (res != 200) {
+		printf("Error: expected 200 packets to pass with half scale, got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	/* the scale is kept when the configuration is applied again */
+	res = lf_ratelimiter_apply_config(rl, config);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_apply_config\n");
+		return 1;
+	}
+	ns_now += 2 * LF_TIME_NS_IN_S;
+	res = apply_best_effort_n(rlw0, 400, ns_now);
+	if (res != 200) {
+		printf("Error: expected 200 packets to pass after config change, got "
+			   "%d\n",
+				res);
+		error_count += 1;
+	}
+
+	res = lf_ratelimiter_set_scale(rl, LF_RATELIMITER_SCALE_ONE,
+			LF_RATELIMITER_SCALE_ONE);
+	if (res != 0) {
+		printf("Error: lf_ratelimiter_set_scale\n");
+		error_count += 1;
+	}
+	ns_now += 2 * LF_TIME_NS_IN_S;
+	res = apply_best_effort_n(rlw0, 800, ns_now);
+	if (res != 400) {
+		printf("Error: expected 400 packets to pass with full scale, got %d\n",
+				res);
+		error_count += 1;
+	}
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Overload control: The controller first tightens the best-effort rate limit,
+ * then the auth peers rate limit, and relaxes them in reverse order once the
+ * receive queues are drained.
+ */
+int
+test8()
+{
+	int i, res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_overload overload;
+	struct lf_overload_worker overload_workers[2];
+	struct lf_overload_worker *overload_workers_ptr[LF_MAX_WORKER] = {
+		&overload_workers[0], &overload_workers[1]
+	};
+
+	rl = new_ratelimiter(false);
+	if (rl == NULL) {
+		return 1;
+	}
+
+	res = lf_overload_init(&overload, rl, overload_workers_ptr, 2);
+	if (res != 0) {
+		printf("Error: lf_overload_init\n");
+		return 1;
+	}
+
+	/* neither overloaded nor drained */
+	lf_overload_update(&overload, 30, 50);
+	if (overload.state != LF_OVERLOAD_STATE_NORMAL) {
+		printf("Error: expected normal state\n");
+		error_count += 1;
+	}
+
+	/* the best-effort rate limit is halved until its minimal scale */
+	for (i = 0; i < 6; ++i) {
+		lf_overload_update(&overload, 80, 100);
+	}
+	if (overload.state != LF_OVERLOAD_STATE_BEST_EFFORT ||
+			rl->best_effort_scale != LF_OVERLOAD_MIN_SCALE ||
+			rl->auth_peers_scale != LF_RATELIMITER_SCALE_ONE) {
+		printf("Error: expected tightened best-effort rate limit (scale "
+			   "%u)\n",
+				rl->best_effort_scale);
+		error_count += 1;
+	}
+
+	/* then, the auth peers rate limit is tightened */
+	lf_overload_update(&overload, 80, 100);
+	if (overload.state != LF_OVERLOAD_STATE_AUTH_PEERS ||
+			rl->auth_peers_scale != LF_RATELIMITER_SCALE_ONE / 2) {
+		printf("Error: expected tightened auth peers rate limit (scale %u)\n",
+				rl->auth_peers_scale);
+		error_count += 1;
+	}
+
+	/* busy workers with draining queues are not tightened further */
+	lf_overload_update(&overload, 20, 100);
+	if (rl->auth_peers_scale != LF_RATELIMITER_SCALE_ONE / 2) {
+		printf("Error: expected unchanged auth peers rate limit\n");
+		error_count += 1;
+	}
+
+	/* the auth peers rate limit is relaxed first */
+	for (i = 0; i < 8; ++i) {
+		lf_overload_update(&overload, 0, 10);
+	}
+	if (overload.state != LF_OVERLOAD_STATE_BEST_EFFORT ||
+			rl->auth_peers_scale != LF_RATELIMITER_SCALE_ONE ||
+			rl->best_effort_scale != LF_OVERLOAD_MIN_SCALE) {
+		printf("Error: expected relaxed auth peers rate limit\n");
+		error_count += 1;
+	}
+
+	for (i = 0; i < 16; ++i) {
+		lf_overload_update(&overload, 0, 10);
+	}
+	if (overload.state != LF_OVERLOAD_STATE_NORMAL ||
+			rl->best_effort_scale != LF_RATELIMITER_SCALE_ONE) {
+		printf("Error: expected relaxed best-effort rate limit\n");
+		error_count += 1;
+	}
+
+	if (overload.nb_tightened != 7 || overload.nb_relaxed != 24) {
+		printf("Error: unexpected counters (tightened: %" PRIu64
+			   ", relaxed: %" PRIu64 ")\n",
+				overload.nb_tightened, overload.nb_relaxed);
+		error_count += 1;
+	}
+
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
+/**
+ * Peer churn: Replacing all peers repeatedly frees the key positions of the
+ * removed peers in the dictionary and its replicas, such that new peers can
+ * always be added.
+ */
+int
+test9()
+{
+	int i, res = 0, error_count = 0;
+	struct lf_ratelimiter *rl;
+	struct lf_config_peer *peer;
+	struct lf_ratelimiter_key key;
+
+	rl = new_ratelimiter(false);
+	if (rl == NULL) {
+		return 1;
+	}
+
+	struct lf_config *config = lf_config_new_from_file(TEST1_JSON);
+	if (config == NULL) {
+		printf("Error: lf_config_new_from_file\n");
+		return 1;
+	}
+
+	for (i = 0; i < 10 * (int)rl->size; ++i) {
+		/* replace all peers by new ones */
+		for (peer = config->peers; peer != NULL; peer = peer->next) {
+			peer->isd_as = rte_cpu_to_be_64(
+					rte_be_to_cpu_64(peer->isd_as) + config->nb_peers);
+		}
+		res = lf_ratelimiter_apply_config(rl, config);
+		if (res != 0) {
+			printf("Error: lf_ratelimiter_apply_config failed in round %d\n",
+					i);
+			error_count += 1;
+			break;
+		}
+		for (peer = config->peers; peer != NULL; peer = peer->next) {
+			key.as = peer->isd_as;
+			key.drkey_protocol = peer->drkey_protocol;
+			if (rte_hash_lookup(rl->workers[0]->dict, &key) < 0) {
+				printf("Error: peer missing in replica in round %d\n", i);
+				error_count += 1;
+			}
+		}
+		if (error_count != 0) {
+			break;
+		}
+	}
+
+	if (rte_hash_count(rl->dict) != (int32_t)config->nb_peers) {
+		printf("Error: expected %zu peers, got %d\n", config->nb_peers,
+				rte_hash_count(rl->dict));
+		error_count += 1;
+	}
+
+	free(config);
+	lf_ratelimiter_close(rl);
+
+	return error_count;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -258,6 +1104,14 @@ main(int argc, char *argv[])
 	int error_counter = 0;
 
 	error_counter += test1();
+	error_counter += test2();
+	error_counter += test3();
+	error_counter += test4();
+	error_counter += test5();
+	error_counter += test6();
+	error_counter += test7();
+	error_counter += test8();
+	error_counter += test9();
 
 	if (error_counter > 0) {
 		printf("Error Count: %d\n", error_counter);
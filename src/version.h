@@ -36,7 +36,6 @@
 #define LF_VERSION_MAIN_OPTIONS(M) \
 	M(LF_WORKER)                   \
 	M(LF_DRKEY_FETCHER)            \
-	M(LF_CBCMAC)                   \
 	M(LF_LOG_DP_LEVEL)
 #define LF_VERSION_MAIN_OPTIONS_STRING \
 	LF_VERSION_MAIN_OPTIONS(LF_VERSION_OPTIONS_STRING)
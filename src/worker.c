@@ -6,6 +6,7 @@
 
 #include <rte_branch_prediction.h>
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_ethdev.h>
 #include <rte_ether.h>
 #include <rte_ip.h>
@@ -16,10 +17,12 @@
 
 #include "config.h"
 #include "duplicate_filter.h"
+#include "egress.h"
 #include "lf.h"
 #include "lib/log/log.h"
 #include "lib/mirror/mirror.h"
 #include "lib/utils/packet.h"
+#include "overload.h"
 #include "plugins/plugins.h"
 #include "ratelimiter.h"
 #include "statistics.h"
@@ -342,12 +345,36 @@ lf_worker_tx(struct lf_worker_context *worker,
 	return nb_fwd;
 }
 
+/**
+ * Egress stage: Transmit the best-effort packets the egress scheduler releases
+ * according to the best-effort rate limit.
+ */
+static inline void
+egress_tx(struct lf_worker_context *worker)
+{
+	uint64_t ns_now;
+	uint16_t nb_pkts;
+	struct rte_mbuf *pkts[LF_MAX_PKT_BURST];
+
+	if (worker->egress->nb_pkts == 0) {
+		return;
+	}
+
+	(void)lf_time_worker_get(&worker->time, &ns_now);
+	nb_pkts = lf_egress_worker_dequeue(worker->egress, &worker->ratelimiter,
+			pkts, LF_MAX_PKT_BURST, ns_now);
+	if (nb_pkts > 0) {
+		lf_worker_tx(worker, pkts, nb_pkts);
+	}
+}
+
 /* main processing loop */
 static void
 lf_worker_main_loop(struct lf_worker_context *worker_context)
 {
 	unsigned int i;
-	uint16_t nb_rx;
+	uint16_t nb_rx, nb_tx;
+	uint64_t burst_tsc;
 
 	/* packet buffers */
 	struct rte_mbuf *rx_pkts[LF_MAX_PKT_BURST];
@@ -373,14 +400,36 @@ lf_worker_main_loop(struct lf_worker_context *worker_context)
 		 * updates it.
 		 */
 		(void)lf_time_worker_update(time);
+
+#if !LF_WORKER_OMIT_DUPLICATE_CHECK
+		/*
+		 * Incrementally clear the spare Bloom filter, such that rotating the
+		 * duplicate filter does not stall the worker.
+		 */
+		lf_duplicate_filter_clear_chunk(worker_context->duplicate_filter);
+#endif /* !LF_WORKER_OMIT_DUPLICATE_CHECK */
+
 		nb_rx = lf_worker_rx(worker_context, rx_pkts);
 
 		if (unlikely(nb_rx <= 0)) {
+			/* queued best-effort packets are sent while idle */
+			if (worker_context->egress != NULL) {
+				egress_tx(worker_context);
+			}
 			continue;
 		}
 
+		/* cycles spent on the burst are reported to the overload control */
+		burst_tsc = rte_rdtsc();
+
 		(void)lf_statistics_worker_add_burst(stats, nb_rx);
 
+		if (worker_context->egress != NULL) {
+			for (i = 0; i < nb_rx; ++i) {
+				lf_egress_unmark(rx_pkts[i]);
+			}
+		}
+
 		for (i = 0; i < nb_rx; ++i) {
 			pkt_res[i] = LF_PKT_UNKNOWN;
 			pkt_res[i] = lf_plugins_pre(worker_context, rx_pkts[i], pkt_res[i]);
@@ -398,7 +447,24 @@ lf_worker_main_loop(struct lf_worker_context *worker_context)
 			set_pkt_action(rx_pkts[i], pkt_res[i]);
 		}
 
-		lf_worker_tx(worker_context, rx_pkts, nb_rx);
+		/*
+		 * Best-effort packets are scheduled by the egress stage after the
+		 * other packets of the burst have been transmitted.
+		 */
+		nb_tx = nb_rx;
+		if (worker_context->egress != NULL) {
+			nb_tx = lf_egress_worker_enqueue_burst(worker_context->egress,
+					rx_pkts, nb_rx);
+		}
+
+		lf_worker_tx(worker_context, rx_pkts, nb_tx);
+
+		if (worker_context->egress != NULL) {
+			egress_tx(worker_context);
+		}
+
+		lf_overload_worker_add_busy(&worker_context->overload,
+				rte_rdtsc() - burst_tsc);
 	}
 }
 
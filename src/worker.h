@@ -15,12 +15,14 @@
 #include <rte_mempool.h>
 
 #include "config.h"
+#include "egress.h"
 #include "keymanager.h"
 #include "lf.h"
 #include "lib/crypto/crypto.h"
 #include "lib/log/log.h"
 #include "lib/mirror/mirror.h"
 #include "lib/time/time.h"
+#include "overload.h"
 #include "ratelimiter.h"
 
 /**
@@ -41,6 +43,11 @@
 	LF_LOG_DP(level, RTE_FMT("Worker [%d]: " RTE_FMT_HEAD(__VA_ARGS__, ), \
 							 rte_lcore_id(), RTE_FMT_TAIL(__VA_ARGS__, )))
 
+/**
+ * Number of packets to prefetch ahead when processing a burst stage-wise.
+ */
+#define LF_WORKER_PREFETCH_OFFSET 3
+
 struct lf_worker_context {
 	uint16_t lcore_id;
 
@@ -69,9 +76,14 @@ struct lf_worker_context {
 	struct lf_keymanager_worker *key_manager;
 	struct lf_duplicate_filter_worker *duplicate_filter;
 	struct lf_ratelimiter_worker ratelimiter;
+	struct lf_overload_worker overload;
+	/* best-effort egress scheduler (NULL if disabled) */
+	struct lf_egress_worker *egress;
 	struct lf_statistics_worker *statistics;
 	struct lf_time_worker time;
 	struct lf_crypto_hash_ctx crypto_hash_ctx;
+	/* Hash contexts to compute the packet hashes of a burst together. */
+	struct lf_crypto_hash_ctx crypto_hash_burst_ctx[LF_MAX_PKT_BURST];
 	struct lf_crypto_drkey_ctx crypto_drkey_ctx;
 	struct lf_mirror_worker *mirror_ctx;
 
@@ -185,15 +197,34 @@ enum lf_check_state
 lf_worker_check_pkt(struct lf_worker_context *worker_context,
 		const struct lf_pkt_data *pkt_data);
 
+/**
+ * Check a burst of packets stage-wise, i.e., each check is applied to all
+ * packets of the burst before the next check is performed. Packets that fail a
+ * check are excluded from the following stages.
+ * The result is the same as calling lf_worker_check_pkt() for each packet,
+ * except that all packets of the burst are checked against the same timestamp.
+ *
+ * @param pkt_data Array of packet data structs to perform the checks.
+ * @param nb_pkts Number of packets in the burst (at most LF_MAX_PKT_BURST).
+ * @param check_state Returns the result of the packet check for each packet.
+ */
+void
+lf_worker_check_pkt_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts,
+		enum lf_check_state check_state[]);
+
 /**
  * Check if packet can pass as a best-effort packet.
  * Therefore, this function applies rate limiting.
  *
+ * @param src_as Source AS (network byte order), which is only used for the
+ * heavy hitter detection. Set to 0 if unknown.
+ * @param pkt_len Packet length in bytes.
  * @return enum lf_check_state.
  */
 enum lf_check_state
 lf_worker_check_best_effort_pkt(struct lf_worker_context *worker_context,
-		uint32_t pkt_len);
+		uint64_t src_as, uint32_t pkt_len);
 
 /**
  * This function modifies the packet (ethernet and IP header) according the
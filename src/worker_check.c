@@ -10,6 +10,7 @@
 #include <rte_ether.h>
 #include <rte_ip.h>
 #include <rte_mbuf.h>
+#include <rte_prefetch.h>
 #include <rte_rcu_qsbr.h>
 #include <rte_tcp.h>
 #include <rte_udp.h>
@@ -38,20 +39,21 @@
  * The function returns the result of the checks as an enum lf_check_state.
  * The function also updates the rate limiter state and the duplicate filter
  * state.
+ *
+ * lf_worker_check_pkt_burst() performs the same checks for a whole burst of
+ * packets, stage by stage, to keep the instruction and data caches warm.
  */
 
 /**
- * Check if the packet is within the rate limit (without consuming tokens).
- * If this check is disable, the check is not performed and the function just
- * returns 0.
+ * Get the rate limiter context for the packet.
+ * If the rate limit check is disable, the function just returns 0.
  *
  * @param rl_pkt_ctx Returns the rate limiter context for this specific packet.
- * @return Returns 0 if withing the rate limit. Otherwise, returns > 0 if AS
- * rate limiter, or < 0 if overall rate limited.
+ * @return Returns 0 on success.
  */
 static inline int
-check_ratelimit(struct lf_worker_context *worker_context, uint64_t src_as,
-		uint16_t drkey_protocol, uint32_t pkt_len, uint64_t ns_now,
+get_ratelimit_ctx(struct lf_worker_context *worker_context, uint64_t src_as,
+		uint16_t drkey_protocol, const struct lf_host_addr *src_addr,
 		struct lf_ratelimiter_pkt_ctx *rl_pkt_ctx)
 {
 #if LF_WORKER_OMIT_RATELIMIT_CHECK
@@ -61,7 +63,7 @@ check_ratelimit(struct lf_worker_context *worker_context, uint64_t src_as,
 
 	/* get packet rate limit context */
 	res = lf_ratelimiter_worker_get_pkt_ctx(&worker_context->ratelimiter,
-			src_as, drkey_protocol, rl_pkt_ctx);
+			src_as, drkey_protocol, src_addr, rl_pkt_ctx);
 	if (res != 0) {
 		LF_WORKER_LOG_DP(DEBUG,
 				"Failed to get packet rate limit context for " PRIISDAS
@@ -72,22 +74,93 @@ check_ratelimit(struct lf_worker_context *worker_context, uint64_t src_as,
 		return 1;
 	}
 
-	res = lf_ratelimiter_worker_check(rl_pkt_ctx, pkt_len, ns_now);
-	if (likely(res != 0)) {
+	return 0;
+}
+
+/**
+ * Get the rate limiter contexts for a burst of packets.
+ * If the rate limit check is disable, the function just returns 0.
+ *
+ * @param rl_pkt_ctx Returns the rate limiter context for each packet.
+ * @return Returns 0 on success.
+ */
+static inline int
+get_ratelimit_ctx_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts,
+		struct lf_ratelimiter_pkt_ctx rl_pkt_ctx[])
+{
+#if LF_WORKER_OMIT_RATELIMIT_CHECK
+	return 0;
+#endif
+	int res;
+	uint16_t i;
+	uint64_t src_as[LF_MAX_PKT_BURST];
+	uint16_t drkey_protocol[LF_MAX_PKT_BURST];
+	const struct lf_host_addr *src_addr[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts; i++) {
+		src_as[i] = pkt_data[i].src_as;
+		drkey_protocol[i] = pkt_data[i].drkey_protocol;
+		src_addr[i] = &pkt_data[i].src_addr;
+	}
+
+	res = lf_ratelimiter_worker_get_pkt_ctx_burst(&worker_context->ratelimiter,
+			src_as, drkey_protocol, src_addr, nb_pkts, rl_pkt_ctx);
+	if (unlikely(res != 0)) {
 		LF_WORKER_LOG_DP(DEBUG,
-				"Rate limit filter check failed for " PRIISDAS
-				" and DRKey protocol %u (res = %d).\n",
-				PRIISDAS_VAL(rte_be_to_cpu_64(src_as)),
-				rte_be_to_cpu_16(drkey_protocol), res);
+				"Failed to get packet rate limit contexts (res = %d).\n", res);
+		return 1;
+	}
 
-		if (res & (LF_RATELIMITER_RES_BYTES | LF_RATELIMITER_RES_PKTS)) {
-			lf_statistics_worker_counter_inc(worker_context->statistics,
-					ratelimit_as);
-		}
-		if (res & (LF_RATELIMITER_RES_BYTES | LF_RATELIMITER_RES_PKTS)) {
-			lf_statistics_worker_counter_inc(worker_context->statistics,
-					ratelimit_system);
-		}
+	for (i = 0; i < nb_pkts; i++) {
+		rte_prefetch0(rl_pkt_ctx[i].peer_ratelimit);
+	}
+	return 0;
+}
+
+/**
+ * Update the statistics for a packet exceeding the rate limit.
+ */
+static inline void
+count_ratelimit_res(struct lf_worker_context *worker_context, int res)
+{
+	LF_WORKER_LOG_DP(DEBUG, "Rate limit filter check failed (res = %d).\n",
+			res);
+
+	if (res & (LF_RATELIMITER_RES_BYTES | LF_RATELIMITER_RES_PKTS |
+					  LF_RATELIMITER_RES_HOST_BYTES |
+					  LF_RATELIMITER_RES_HOST_PKTS)) {
+		lf_statistics_worker_counter_inc(worker_context->statistics,
+				ratelimit_as);
+	}
+	if (res & (LF_RATELIMITER_RES_BYTES | LF_RATELIMITER_RES_PKTS)) {
+		lf_statistics_worker_counter_inc(worker_context->statistics,
+				ratelimit_system);
+	}
+}
+
+/**
+ * Check if the packet is within the rate limit of the provided rate limiter
+ * context (without consuming tokens).
+ * If this check is disable, the check is not performed and the function just
+ * returns 0.
+ *
+ * @param rl_pkt_ctx The rate limiter context for this specific packet.
+ * @return Returns 0 if withing the rate limit. Otherwise, returns > 0 if AS
+ * rate limiter, or < 0 if overall rate limited.
+ */
+static inline int
+check_ratelimit_ctx(struct lf_worker_context *worker_context, uint32_t pkt_len,
+		uint64_t ns_now, struct lf_ratelimiter_pkt_ctx *rl_pkt_ctx)
+{
+#if LF_WORKER_OMIT_RATELIMIT_CHECK
+	return 0;
+#endif
+	int res;
+
+	res = lf_ratelimiter_worker_check(rl_pkt_ctx, pkt_len, ns_now);
+	if (likely(res != 0)) {
+		count_ratelimit_res(worker_context, res);
 	} else {
 		LF_WORKER_LOG_DP(DEBUG, "Rate limit check pass (res=%d).\n", res);
 	}
@@ -95,6 +168,77 @@ check_ratelimit(struct lf_worker_context *worker_context, uint64_t src_as,
 	return res;
 }
 
+/**
+ * Check if the packet is within the rate limit (without consuming tokens).
+ * If this check is disable, the check is not performed and the function just
+ * returns 0.
+ *
+ * @param rl_pkt_ctx Returns the rate limiter context for this specific packet.
+ * @return Returns 0 if withing the rate limit. Otherwise, returns > 0 if AS
+ * rate limiter, or < 0 if overall rate limited.
+ */
+static inline int
+check_ratelimit(struct lf_worker_context *worker_context, uint64_t src_as,
+		uint16_t drkey_protocol, const struct lf_host_addr *src_addr,
+		uint32_t pkt_len, uint64_t ns_now,
+		struct lf_ratelimiter_pkt_ctx *rl_pkt_ctx)
+{
+	int res;
+
+	res = get_ratelimit_ctx(worker_context, src_as, drkey_protocol, src_addr,
+			rl_pkt_ctx);
+	if (res != 0) {
+		return res;
+	}
+
+	return check_ratelimit_ctx(worker_context, pkt_len, ns_now, rl_pkt_ctx);
+}
+
+/**
+ * Check the rate limits of the valid packets of a burst (without consuming
+ * tokens). The packets are grouped by their rate limit, such that the tokens
+ * are checked once per group. Packets exceeding the rate limit are marked as
+ * AS or system rate limited, like lf_worker_check_pkt() does.
+ * If this check is disable, the check is not performed.
+ *
+ * @param rl_burst_ctx Returns the grouping of the packets for
+ * consume_ratelimit_burst().
+ */
+static inline void
+check_ratelimit_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts, uint64_t ns_now,
+		struct lf_ratelimiter_pkt_ctx rl_pkt_ctx[],
+		struct lf_ratelimiter_burst_ctx *rl_burst_ctx,
+		enum lf_check_state check_state[])
+{
+#if LF_WORKER_OMIT_RATELIMIT_CHECK
+	return;
+#endif
+	uint16_t i;
+	uint32_t pkt_len[LF_MAX_PKT_BURST];
+	int res[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts; i++) {
+		pkt_len[i] = pkt_data[i].pkt_len;
+		res[i] = check_state[i] == LF_CHECK_VALID ? 0 : 1;
+	}
+
+	lf_ratelimiter_worker_check_burst(rl_burst_ctx, rl_pkt_ctx, pkt_len,
+			nb_pkts, ns_now, res);
+
+	for (i = 0; i < nb_pkts; i++) {
+		if (check_state[i] != LF_CHECK_VALID || likely(res[i] == 0)) {
+			continue;
+		}
+		count_ratelimit_res(worker_context, res[i]);
+		if (res[i] > 0) {
+			check_state[i] = LF_CHECK_AS_RATELIMITED;
+		} else {
+			check_state[i] = LF_CHECK_SYSTEM_RATELIMITED;
+		}
+	}
+}
+
 /**
  * Add the packet to the rate and update the rate limiter state (consume
  * tokens). If the rate limiter check is disable, this function does not do
@@ -111,6 +255,63 @@ consume_ratelimit(uint32_t pkt_len, struct lf_ratelimiter_pkt_ctx *rl_pkt_ctx)
 	lf_ratelimiter_worker_consume(rl_pkt_ctx, pkt_len);
 }
 
+/**
+ * Consume the tokens of the valid packets of a burst, which have been checked
+ * with check_ratelimit_burst(). If the rate limiter check is disable, this
+ * function does not do anything.
+ */
+static inline void
+consume_ratelimit_burst(const struct lf_pkt_data pkt_data[], uint16_t nb_pkts,
+		const struct lf_ratelimiter_burst_ctx *rl_burst_ctx,
+		const enum lf_check_state check_state[])
+{
+#if LF_WORKER_OMIT_RATELIMIT_CHECK
+	return;
+#endif
+	uint16_t i;
+	uint32_t pkt_len[LF_MAX_PKT_BURST];
+	bool consume[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts; i++) {
+		pkt_len[i] = pkt_data[i].pkt_len;
+		consume[i] = check_state[i] == LF_CHECK_VALID;
+	}
+
+	lf_ratelimiter_worker_consume_burst(rl_burst_ctx, pkt_len, consume,
+			nb_pkts);
+}
+
+/**
+ * Log the result of a DRKey lookup and update the statistics accordingly.
+ */
+static inline void
+report_drkey_res(struct lf_worker_context *worker_context, uint64_t src_as,
+		const struct lf_host_addr *src_addr,
+		const struct lf_host_addr *dst_addr, uint16_t drkey_protocol,
+		uint64_t ns_now, uint64_t ns_rel_time,
+		const struct lf_crypto_drkey *drkey, int res)
+{
+	if (unlikely(res < 0)) {
+		LF_WORKER_LOG_DP(INFO,
+				"Inbound DRKey not found for AS " PRIISDAS
+				" and drkey_protocol %d (timestamp = %" PRIu64
+				", offset = %" PRIu64 ", res = %d)\n",
+				PRIISDAS_VAL(rte_be_to_cpu_64(src_as)),
+				rte_be_to_cpu_16(drkey_protocol), ns_now, ns_rel_time, res);
+		lf_statistics_worker_counter_inc(worker_context->statistics, no_key);
+	} else {
+		LF_WORKER_LOG_DP(DEBUG,
+				"DRKey [XX]: " PRIIP ",[" PRIISDAS "]:" PRIIP
+				" and drkey_protocol %d (timestamp = %" PRIu64
+				", offset = %" PRIu64 ") is %x\n",
+				PRIIP_VAL(*(uint32_t *)dst_addr->addr),
+				PRIISDAS_VAL(rte_be_to_cpu_64(src_as)),
+				PRIIP_VAL(*(uint32_t *)src_addr->addr),
+				rte_be_to_cpu_16(drkey_protocol), ns_now, ns_rel_time,
+				drkey->key[0]);
+	}
+}
+
 /**
  * Check if a valid DRKey is available and get it.
  * If this check is disable, the check is not performed and the function just
@@ -136,9 +337,10 @@ get_drkey(struct lf_worker_context *worker_context, uint64_t src_as,
 		struct lf_crypto_drkey *drkey)
 {
 #if LF_WORKER_OMIT_KEY_GET
-	for (int i = 0; i < LF_CRYPTO_DRKEY_SIZE; i++) {
-		drkey->key[i] = 0;
-	}
+	/* the MAC computation also uses the expanded round keys */
+	static const uint8_t zero_key[LF_CRYPTO_DRKEY_SIZE] = { 0 };
+	lf_crypto_drkey_from_buf(&worker_context->crypto_drkey_ctx, zero_key,
+			drkey);
 	return 0;
 #endif
 
@@ -146,26 +348,97 @@ get_drkey(struct lf_worker_context *worker_context, uint64_t src_as,
 	res = lf_keymanager_worker_inbound_get_drkey(worker_context->key_manager,
 			src_as, src_addr, dst_addr, drkey_protocol, ns_now, ns_rel_time,
 			ns_drkey_epoch_start, drkey);
-	if (unlikely(res < 0)) {
-		LF_WORKER_LOG_DP(INFO,
-				"Inbound DRKey not found for AS " PRIISDAS
-				" and drkey_protocol %d (timestamp = %" PRIu64
-				", offset = %" PRIu64 ", res = %d)\n",
-				PRIISDAS_VAL(rte_be_to_cpu_64(src_as)),
-				rte_be_to_cpu_16(drkey_protocol), ns_now, ns_rel_time, res);
-		lf_statistics_worker_counter_inc(worker_context->statistics, no_key);
+	report_drkey_res(worker_context, src_as, src_addr, dst_addr,
+			drkey_protocol, ns_now, ns_rel_time, drkey, res);
+
+	return res;
+}
+
+/**
+ * Get the DRKeys for all packets of the burst that are still in the pipeline,
+ * i.e., that are marked with LF_CHECK_VALID. The DRKeys that are not cached
+ * are derived in parallel.
+ * Packets for which no valid DRKey is available are marked with
+ * LF_CHECK_NO_KEY.
+ */
+static inline void
+get_drkey_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts, uint64_t ns_now,
+		uint64_t ns_drkey_epoch_start[], struct lf_crypto_drkey drkey[],
+		enum lf_check_state check_state[])
+{
+	uint16_t i, j, nb_keys = 0;
+	uint16_t pkt_index[LF_MAX_PKT_BURST];
+	uint64_t src_as[LF_MAX_PKT_BURST];
+	const struct lf_host_addr *src_addr[LF_MAX_PKT_BURST];
+	const struct lf_host_addr *dst_addr[LF_MAX_PKT_BURST];
+	uint16_t drkey_protocol[LF_MAX_PKT_BURST];
+	uint64_t ns_rel_time[LF_MAX_PKT_BURST];
+	uint64_t epoch_start[LF_MAX_PKT_BURST];
+	struct lf_crypto_drkey *drkey_ptr[LF_MAX_PKT_BURST];
+	int res[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts; i++) {
+		if (check_state[i] != LF_CHECK_VALID) {
+			continue;
+		}
+#if LF_WORKER_OMIT_KEY_GET
+		(void)get_drkey(worker_context, pkt_data[i].src_as,
+				&pkt_data[i].src_addr, &pkt_data[i].dst_addr,
+				pkt_data[i].drkey_protocol, ns_now, pkt_data[i].timestamp,
+				&ns_drkey_epoch_start[i], &drkey[i]);
+		continue;
+#endif
+		pkt_index[nb_keys] = i;
+		src_as[nb_keys] = pkt_data[i].src_as;
+		src_addr[nb_keys] = &pkt_data[i].src_addr;
+		dst_addr[nb_keys] = &pkt_data[i].dst_addr;
+		drkey_protocol[nb_keys] = pkt_data[i].drkey_protocol;
+		ns_rel_time[nb_keys] = pkt_data[i].timestamp;
+		drkey_ptr[nb_keys] = &drkey[i];
+		nb_keys++;
+	}
+
+	if (nb_keys == 0) {
+		return;
+	}
+
+	lf_keymanager_worker_inbound_get_drkey_burst(worker_context->key_manager,
+			src_as, src_addr, dst_addr, drkey_protocol, ns_now, ns_rel_time,
+			epoch_start, drkey_ptr, res, nb_keys);
+
+	for (j = 0; j < nb_keys; j++) {
+		i = pkt_index[j];
+		report_drkey_res(worker_context, src_as[j], src_addr[j], dst_addr[j],
+				drkey_protocol[j], ns_now, ns_rel_time[j], &drkey[i], res[j]);
+		if (unlikely(res[j] != 0)) {
+			check_state[i] = LF_CHECK_NO_KEY;
+			continue;
+		}
+		ns_drkey_epoch_start[i] = epoch_start[j];
+	}
+}
+
+/**
+ * Log the result of a MAC check and update the statistics accordingly.
+ *
+ * @return Returns the result of the MAC check, or 0 if the check is ignored.
+ */
+static inline int
+report_mac_res(struct lf_worker_context *worker_context, int res)
+{
+	if (likely(res != 0)) {
+		LF_WORKER_LOG_DP(DEBUG, "MAC check failed.\n");
+		lf_statistics_worker_counter_inc(worker_context->statistics,
+				invalid_mac);
 	} else {
-		LF_WORKER_LOG_DP(DEBUG,
-				"DRKey [XX]: " PRIIP ",[" PRIISDAS "]:" PRIIP
-				" and drkey_protocol %d (timestamp = %" PRIu64
-				", offset = %" PRIu64 ") is %x\n",
-				PRIIP_VAL(*(uint32_t *)dst_addr->addr),
-				PRIISDAS_VAL(rte_be_to_cpu_64(src_as)),
-				PRIIP_VAL(*(uint32_t *)src_addr->addr),
-				rte_be_to_cpu_16(drkey_protocol), ns_now, ns_rel_time,
-				drkey->key[0]);
+		LF_WORKER_LOG_DP(DEBUG, "MAC check passed.\n");
 	}
 
+#if LF_WORKER_IGNORE_MAC_CHECK
+	res = 0;
+#endif
+
 	return res;
 }
 
@@ -194,19 +467,53 @@ check_mac(struct lf_worker_context *worker_context,
 
 	res = lf_crypto_drkey_check_mac(&worker_context->crypto_drkey_ctx, drkey,
 			auth_data, mac);
-	if (likely(res != 0)) {
-		LF_WORKER_LOG_DP(DEBUG, "MAC check failed.\n");
-		lf_statistics_worker_counter_inc(worker_context->statistics,
-				invalid_mac);
-	} else {
-		LF_WORKER_LOG_DP(DEBUG, "MAC check passed.\n");
-	}
+	return report_mac_res(worker_context, res);
+}
 
-#if LF_WORKER_IGNORE_MAC_CHECK
-	res = 0;
+/**
+ * Perform the MAC check for all packets of the burst that are still in the
+ * pipeline, i.e., that are marked with LF_CHECK_VALID. The MACs are computed
+ * in parallel.
+ * Packets with an invalid MAC are marked with LF_CHECK_INVALID_MAC.
+ */
+static inline void
+check_mac_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts,
+		const struct lf_crypto_drkey drkey[], enum lf_check_state check_state[])
+{
+#if LF_WORKER_OMIT_MAC_CHECK
+	return;
 #endif
 
-	return res;
+	uint16_t i, j, nb_macs = 0;
+	uint16_t pkt_index[LF_MAX_PKT_BURST];
+	const struct lf_crypto_drkey *drkey_ptr[LF_MAX_PKT_BURST];
+	const uint8_t *auth_data[LF_MAX_PKT_BURST];
+	const uint8_t *mac[LF_MAX_PKT_BURST];
+	int res[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts; i++) {
+		if (i + LF_WORKER_PREFETCH_OFFSET < nb_pkts) {
+			rte_prefetch0(pkt_data[i + LF_WORKER_PREFETCH_OFFSET].auth_data);
+		}
+		if (check_state[i] != LF_CHECK_VALID) {
+			continue;
+		}
+		pkt_index[nb_macs] = i;
+		drkey_ptr[nb_macs] = &drkey[i];
+		auth_data[nb_macs] = pkt_data[i].auth_data;
+		mac[nb_macs] = pkt_data[i].mac;
+		nb_macs++;
+	}
+
+	lf_crypto_drkey_check_mac_burst(&worker_context->crypto_drkey_ctx,
+			drkey_ptr, auth_data, mac, nb_macs, res);
+
+	for (j = 0; j < nb_macs; j++) {
+		if (unlikely(report_mac_res(worker_context, res[j]) != 0)) {
+			check_state[pkt_index[j]] = LF_CHECK_INVALID_MAC;
+		}
+	}
 }
 
 /**
@@ -255,13 +562,13 @@ check_timestamp(struct lf_worker_context *worker_context, uint64_t timestamp,
  * If this check is ignored, the check is performed but the function
  * always return 0.
  *
- * @param mac Packet MAC used to identify packet.
+ * @param hash Hash of the packet MAC, which identifies the packet.
  * @param ns_now Current timestamp.
  * @return Returns 0 if the packet is not a duplicate.
  */
 static inline int
-check_duplicate(struct lf_worker_context *worker_context, const uint8_t *mac,
-		uint64_t ns_now)
+check_duplicate_hash(struct lf_worker_context *worker_context,
+		const struct lf_duplicate_filter_hash *hash, uint64_t ns_now)
 {
 #if LF_WORKER_OMIT_DUPLICATE_CHECK
 	return 0;
@@ -269,7 +576,7 @@ check_duplicate(struct lf_worker_context *worker_context, const uint8_t *mac,
 
 	int res;
 
-	res = lf_duplicate_filter_apply(worker_context->duplicate_filter, mac,
+	res = lf_duplicate_filter_apply_hash(worker_context->duplicate_filter, hash,
 			ns_now);
 	if (likely(res != 0)) {
 		LF_WORKER_LOG_DP(DEBUG, "Duplicate check failed.\n");
@@ -285,8 +592,85 @@ check_duplicate(struct lf_worker_context *worker_context, const uint8_t *mac,
 	return res;
 }
 
-enum lf_check_state
-lf_worker_check_pkt(struct lf_worker_context *worker_context,
+/**
+ * Perform duplicate check (see check_duplicate_hash()).
+ *
+ * @param mac Packet MAC used to identify packet.
+ * @param ns_now Current timestamp.
+ * @return Returns 0 if the packet is not a duplicate.
+ */
+static inline int
+check_duplicate(struct lf_worker_context *worker_context, const uint8_t *mac,
+		uint64_t ns_now)
+{
+#if LF_WORKER_OMIT_DUPLICATE_CHECK
+	return 0;
+#endif
+
+	struct lf_duplicate_filter_hash hash;
+
+	lf_duplicate_filter_hash(worker_context->duplicate_filter, mac, &hash);
+	return check_duplicate_hash(worker_context, &hash, ns_now);
+}
+
+/**
+ * Hash the MACs of the packets that are still valid for the duplicate check,
+ * and prefetch the parts of the duplicate filter that are accessed by the
+ * check. The hash of the i-th packet is stored in hashes[i].
+ */
+static inline void
+hash_duplicate_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts,
+		const enum lf_check_state check_state[],
+		struct lf_duplicate_filter_hash hashes[])
+{
+#if LF_WORKER_OMIT_DUPLICATE_CHECK
+	return;
+#endif
+
+	uint16_t i, nb_keys;
+	const uint8_t *keys[LF_MAX_PKT_BURST];
+	struct lf_duplicate_filter_hash key_hashes[LF_MAX_PKT_BURST];
+
+	nb_keys = 0;
+	for (i = 0; i < nb_pkts; i++) {
+		if (check_state[i] == LF_CHECK_VALID) {
+			keys[nb_keys++] = pkt_data[i].mac;
+		}
+	}
+
+	lf_duplicate_filter_hash_burst(worker_context->duplicate_filter, keys,
+			nb_keys, key_hashes);
+
+	nb_keys = 0;
+	for (i = 0; i < nb_pkts; i++) {
+		if (check_state[i] == LF_CHECK_VALID) {
+			hashes[i] = key_hashes[nb_keys++];
+		}
+	}
+}
+
+/**
+ * Account the packet to its source AS in the worker's heavy hitter sketch.
+ *
+ * @param check_state Result of the packet checks. Packets that are not valid
+ * are counted as dropped.
+ */
+static inline void
+add_heavy_hitter(struct lf_worker_context *worker_context, uint64_t src_as,
+		uint32_t pkt_len, enum lf_check_state check_state)
+{
+#if LF_WORKER_OMIT_HEAVY_HITTER
+	return;
+#endif /* LF_WORKER_OMIT_HEAVY_HITTER */
+
+	lf_statistics_worker_add_heavy_hitter(worker_context->statistics, src_as,
+			pkt_len,
+			check_state != LF_CHECK_VALID && check_state != LF_CHECK_BE);
+}
+
+static inline enum lf_check_state
+check_pkt(struct lf_worker_context *worker_context,
 		const struct lf_pkt_data *pkt_data)
 {
 	int res = 0;
@@ -311,7 +695,8 @@ lf_worker_check_pkt(struct lf_worker_context *worker_context,
 	 * unecessary MAC and duplicate checks can be avoided.
 	 */
 	res = check_ratelimit(worker_context, pkt_data->src_as,
-			pkt_data->drkey_protocol, pkt_data->pkt_len, ns_now, &rl_pkt_ctx);
+			pkt_data->drkey_protocol, &pkt_data->src_addr, pkt_data->pkt_len,
+			ns_now, &rl_pkt_ctx);
 	if (unlikely(res > 0)) {
 		return LF_CHECK_AS_RATELIMITED;
 	} else if (unlikely(res < 0)) {
@@ -366,7 +751,138 @@ lf_worker_check_pkt(struct lf_worker_context *worker_context,
 }
 
 enum lf_check_state
-lf_worker_check_best_effort_pkt(struct lf_worker_context *worker_context,
+lf_worker_check_pkt(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data *pkt_data)
+{
+	enum lf_check_state check_state;
+
+	check_state = check_pkt(worker_context, pkt_data);
+	add_heavy_hitter(worker_context, pkt_data->src_as, pkt_data->pkt_len,
+			check_state);
+
+	return check_state;
+}
+
+void
+lf_worker_check_pkt_burst(struct lf_worker_context *worker_context,
+		const struct lf_pkt_data pkt_data[], uint16_t nb_pkts,
+		enum lf_check_state check_state[])
+{
+	int res;
+	uint16_t i;
+	uint64_t ns_now;
+	struct lf_ratelimiter_pkt_ctx rl_pkt_ctx[LF_MAX_PKT_BURST];
+	struct lf_ratelimiter_burst_ctx rl_burst_ctx;
+	struct lf_crypto_drkey drkey[LF_MAX_PKT_BURST];
+	uint64_t ns_drkey_epoch_start[LF_MAX_PKT_BURST];
+	struct lf_duplicate_filter_hash duplicate_hash[LF_MAX_PKT_BURST];
+
+	/*
+	 * Obtain current time once for the whole burst.
+	 */
+	res = lf_time_worker_get(&worker_context->time, &ns_now);
+	if (unlikely(res != 0)) {
+		for (i = 0; i < nb_pkts; i++) {
+			lf_statistics_worker_counter_inc(worker_context->statistics, error);
+			check_state[i] = LF_CHECK_ERROR;
+		}
+		return;
+	}
+
+	/*
+	 * Rate Limit Context
+	 * Look up the rate limiter buckets of all packets with a bulk lookup and
+	 * prefetch them for the following check.
+	 * Packets that are still processed by the pipeline are marked as valid.
+	 */
+	res = get_ratelimit_ctx_burst(worker_context, pkt_data, nb_pkts,
+			rl_pkt_ctx);
+	for (i = 0; i < nb_pkts; i++) {
+		if (unlikely(res != 0)) {
+			lf_statistics_worker_counter_inc(worker_context->statistics, error);
+			check_state[i] = LF_CHECK_ERROR;
+			continue;
+		}
+		check_state[i] = LF_CHECK_VALID;
+	}
+
+	/*
+	 * Rate Limit Check
+	 * Check if the rate limit would allow the packets such that unnecessary
+	 * MAC and duplicate checks can be avoided. The packets are checked per
+	 * rate limit group, and the tokens are only consumed at the last stage.
+	 */
+	check_ratelimit_burst(worker_context, pkt_data, nb_pkts, ns_now, rl_pkt_ctx,
+			&rl_burst_ctx, check_state);
+
+	/*
+	 * DRKey Get
+	 */
+	get_drkey_burst(worker_context, pkt_data, nb_pkts, ns_now,
+			ns_drkey_epoch_start, drkey, check_state);
+
+	/*
+	 * MAC Check
+	 */
+	check_mac_burst(worker_context, pkt_data, nb_pkts, drkey, check_state);
+
+	/*
+	 * Timestamp Check
+	 */
+	for (i = 0; i < nb_pkts; i++) {
+		if (check_state[i] != LF_CHECK_VALID) {
+			continue;
+		}
+		res = check_timestamp(worker_context,
+				ns_drkey_epoch_start[i] + pkt_data[i].timestamp, ns_now);
+		if (likely(res != 0)) {
+			check_state[i] = LF_CHECK_OUTDATED_TIMESTAMP;
+		}
+	}
+
+	/*
+	 * Duplicate Hash
+	 * Hash the MACs of the whole burst at once and prefetch the duplicate
+	 * filter for the following stage.
+	 */
+	hash_duplicate_burst(worker_context, pkt_data, nb_pkts, check_state,
+			duplicate_hash);
+
+	/*
+	 * Duplicate Check
+	 * The duplicate filter is shared by the packets of the burst. Therefore,
+	 * the check is performed for one packet after the other. The rate limit
+	 * has been checked for all packets of a group together. Hence, the tokens
+	 * of the remaining packets are available without checking again.
+	 */
+	for (i = 0; i < nb_pkts; i++) {
+		if (check_state[i] != LF_CHECK_VALID) {
+			continue;
+		}
+
+		res = check_duplicate_hash(worker_context, &duplicate_hash[i], ns_now);
+		if (likely(res != 0)) {
+			check_state[i] = LF_CHECK_DUPLICATE;
+			continue;
+		}
+
+		lf_statistics_worker_counter_inc(worker_context->statistics, valid);
+	}
+
+	/*
+	 * Rate Limit Update
+	 * Consume the tokens of the valid packets once per rate limit group.
+	 */
+	consume_ratelimit_burst(pkt_data, nb_pkts, &rl_burst_ctx, check_state);
+
+	for (i = 0; i < nb_pkts; i++) {
+		add_heavy_hitter(worker_context, pkt_data[i].src_as,
+				pkt_data[i].pkt_len, check_state[i]);
+	}
+}
+
+static inline enum lf_check_state
+check_best_effort_pkt(struct lf_worker_context *worker_context,
 		const uint32_t pkt_len)
 {
 	int res;
@@ -383,6 +899,11 @@ lf_worker_check_best_effort_pkt(struct lf_worker_context *worker_context,
 	return LF_CHECK_BE;
 #endif /* !LF_WORKER_OMIT_RATELIMIT_CHECK */
 
+	/* the egress scheduler applies the rate limit when dequeuing the packet */
+	if (worker_context->egress != NULL) {
+		return LF_CHECK_BE;
+	}
+
 	res = lf_ratelimiter_worker_apply_best_effort(&worker_context->ratelimiter,
 			pkt_len, ns_now);
 	if (likely(res > 0)) {
@@ -400,3 +921,15 @@ lf_worker_check_best_effort_pkt(struct lf_worker_context *worker_context,
 	}
 	return LF_CHECK_BE;
 }
+
+enum lf_check_state
+lf_worker_check_best_effort_pkt(struct lf_worker_context *worker_context,
+		uint64_t src_as, const uint32_t pkt_len)
+{
+	enum lf_check_state check_state;
+
+	check_state = check_best_effort_pkt(worker_context, pkt_len);
+	add_heavy_hitter(worker_context, src_as, pkt_len, check_state);
+
+	return check_state;
+}
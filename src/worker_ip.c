@@ -11,6 +11,7 @@
 #include <rte_ip.h>
 #include <rte_mbuf.h>
 #include <rte_mbuf_core.h>
+#include <rte_prefetch.h>
 #include <rte_tcp.h>
 #include <rte_udp.h>
 
@@ -38,95 +39,167 @@
 #endif
 
 /**
+ * Headers and data of an inbound packet, which are required for the packet
+ * checks and the subsequent decapsulation.
+ */
+struct parsed_inbound_pkt {
+	/* Offset to memory after the LF header. */
+	unsigned int offset;
+	struct rte_ether_hdr *ether_hdr;
+	struct rte_ipv4_hdr *ipv4_hdr;
+	struct rte_udp_hdr *udp_hdr;
+	struct lf_ip_hdr *lf_hdr;
+
+	/* Destination address used for the DRKey derivation. */
+	uint32_t dst_ip;
+	struct lf_pkt_data pkt_data;
+};
+
+/**
+ * Parse the LF header of an inbound packet and prepare the packet data for
+ * the packet checks.
+ *
  * @param offset Offset to memory after ethernet, IP header, and UDP header.
+ * @param parsed Returns the parsed packet. The ether_hdr, ipv4_hdr and
+ * udp_hdr fields must already be set.
+ * @return Returns 0 on success.
  */
-static enum lf_pkt_action
-handle_inbound_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m,
-		unsigned int offset, struct rte_ether_hdr *ether_hdr,
-		struct rte_ipv4_hdr *ipv4_hdr, __rte_unused struct rte_udp_hdr *udp_hdr)
+static int
+prepare_inbound_pkt(struct lf_worker_context *worker_context,
+		struct rte_mbuf *m, unsigned int offset,
+		struct parsed_inbound_pkt *parsed)
 {
 	int res;
-	struct lf_pkt_data pkt_data;
-
-	uint32_t dst_ip;
-	struct lf_ip_hdr *lf_hdr;
-	enum lf_check_state check_state;
-	uint8_t exp_hash[20]; /* expected hash */
 	uint16_t payload_len; /* payload (upper layer) length */
+	struct lf_ip_hdr *lf_hdr;
+	struct lf_pkt_data *pkt_data = &parsed->pkt_data;
 
 	offset = get_lf_hdr(m, offset, &lf_hdr);
 	if (unlikely(offset == 0)) {
-		return LF_PKT_INBOUND_DROP;
+		return -1;
 	}
 
 	if (lf_hdr->rsv != 0) {
 		LF_WORKER_LOG_DP(NOTICE, "Unexpected reserved values.\n");
-		return LF_PKT_INBOUND_DROP;
+		return -1;
 	}
 
+	parsed->offset = offset;
+	parsed->lf_hdr = lf_hdr;
+
 	/*
 	 * Set host address structs.
 	 * Additionally, check if the destination is using a different public
 	 * address
 	 */
 	res = lf_configmanager_worker_get_ip_public(worker_context->config,
-			&dst_ip);
+			&parsed->dst_ip);
 	if (res != 0) {
 		/* No public IP is provided: use the packets address. */
-		dst_ip = ipv4_hdr->dst_addr;
+		parsed->dst_ip = parsed->ipv4_hdr->dst_addr;
 	}
 
 	/* Initialize packet data structure */
-	pkt_data.src_as = lf_hdr->src_as;
-	pkt_data.dst_as = 0; /* not used for inbound packets */
+	pkt_data->src_as = lf_hdr->src_as;
+	pkt_data->dst_as = 0; /* not used for inbound packets */
 
-	pkt_data.dst_addr.addr = &dst_ip;
-	pkt_data.dst_addr.type_length = LF_HOST_ADDR_TL_IPV4;
-	pkt_data.src_addr.addr = &ipv4_hdr->src_addr;
-	pkt_data.src_addr.type_length = LF_HOST_ADDR_TL_IPV4;
+	pkt_data->dst_addr.addr = &parsed->dst_ip;
+	pkt_data->dst_addr.type_length = LF_HOST_ADDR_TL_IPV4;
+	pkt_data->src_addr.addr = &parsed->ipv4_hdr->src_addr;
+	pkt_data->src_addr.type_length = LF_HOST_ADDR_TL_IPV4;
 
-	pkt_data.timestamp = rte_be_to_cpu_64(lf_hdr->timestamp);
-	pkt_data.drkey_protocol = lf_hdr->drkey_protocol;
-	pkt_data.mac = lf_hdr->mac;
-	pkt_data.auth_data = (uint8_t *)lf_hdr + 4;
-	pkt_data.pkt_len = m->pkt_len - offset;
+	pkt_data->timestamp = rte_be_to_cpu_64(lf_hdr->timestamp);
+	pkt_data->drkey_protocol = lf_hdr->drkey_protocol;
+	pkt_data->mac = lf_hdr->mac;
+	pkt_data->auth_data = (uint8_t *)lf_hdr + 4;
+	pkt_data->pkt_len = m->pkt_len - offset;
 
 	/* Apply authenticated data struct and add payload length to it. */
 	/* TODO: (fstreun) check that payload length fits into a uint16_t */
 	payload_len = m->pkt_len - offset;
 	lf_hdr->drkey_protocol = rte_cpu_to_be_16(payload_len);
 
-	check_state = lf_worker_check_pkt(worker_context, &pkt_data);
+	return 0;
+}
 
-	if (unlikely(check_state != LF_CHECK_VALID)) {
-		/* TODO: (fstreun) for testing, all packets are checked as valid.
-		 * However, under attack it is more likely that packets are declared
-		 * invalid. */
-		return LF_PKT_INBOUND_DROP;
-	}
+/**
+ * Compare the computed packet hash with the one in the LF header, log the
+ * result and update the statistics accordingly.
+ *
+ * @return Returns 0 if the packet hash is valid or the check is ignored.
+ */
+static inline int
+cmp_pkt_hash(struct lf_worker_context *worker_context,
+		const uint8_t hash[LF_CRYPTO_HASH_LENGTH],
+		const struct parsed_inbound_pkt *parsed)
+{
+	int res;
 
-	/* check packet hash */
-#if !(LF_WORKER_OMIT_HASH_CHECK)
-	LF_WORKER_LOG_DP(DEBUG, "Check packet hash.\n");
-	(void)lf_crypto_hash_update(&worker_context->crypto_hash_ctx,
-			(uint8_t *)(lf_hdr + 1), payload_len);
-	(void)lf_crypto_hash_final(&worker_context->crypto_hash_ctx, exp_hash);
-	res = lf_crypto_hash_cmp(exp_hash, lf_hdr->hash);
+	res = lf_crypto_hash_cmp(hash, parsed->lf_hdr->hash);
 	if (likely(res != 0)) {
 		LF_WORKER_LOG_DP(DEBUG, "Packet hash check failed.\n");
 		lf_statistics_worker_counter_inc(worker_context->statistics,
 				invalid_hash);
-#if !(LF_WORKER_IGNORE_HASH_CHECK)
-		// LF_CHECK_VALID_MAC_BUT_INVALID_HASH;
-		return LF_PKT_INBOUND_DROP;
-#else
-		res = 0;
-#endif /* !(LF_WORKER_IGNORE_HASH_CHECK) */
 	}
+
+#if (LF_WORKER_IGNORE_HASH_CHECK)
+	res = 0;
+#endif /* !(LF_WORKER_IGNORE_HASH_CHECK) */
+
+	return res;
+}
+
+/**
+ * Perform the packet hash check for a packet that passed all other checks.
+ * The hash covers the payload following the LF header.
+ *
+ * @return Returns 0 if the packet hash is valid or the check is omitted or
+ * ignored.
+ */
+static int
+check_pkt_hash(struct lf_worker_context *worker_context, struct rte_mbuf *m,
+		struct parsed_inbound_pkt *parsed)
+{
+#if LF_WORKER_OMIT_HASH_CHECK
+	(void)worker_context;
+	(void)m;
+	(void)parsed;
+	return 0;
 #else
-	(void)exp_hash;
-	(void)payload_len;
-#endif /* !(LF_WORKER_OMIT_HASH_CHECK) */
+	uint8_t exp_hash[LF_CRYPTO_HASH_LENGTH]; /* expected hash */
+
+	LF_WORKER_LOG_DP(DEBUG, "Check packet hash.\n");
+	(void)lf_crypto_hash_update(&worker_context->crypto_hash_ctx,
+			(uint8_t *)(parsed->lf_hdr + 1), m->pkt_len - parsed->offset);
+	(void)lf_crypto_hash_final(&worker_context->crypto_hash_ctx, exp_hash);
+
+	return cmp_pkt_hash(worker_context, exp_hash, parsed);
+#endif /* LF_WORKER_OMIT_HASH_CHECK */
+}
+
+/**
+ * Decapsulate a packet that passed all packet checks (including the packet
+ * hash check) and apply the inbound packet modifications.
+ *
+ * @param check_state Result of the packet checks.
+ */
+static enum lf_pkt_action
+finalize_inbound_pkt(struct lf_worker_context *worker_context,
+		struct rte_mbuf *m, struct parsed_inbound_pkt *parsed,
+		enum lf_check_state check_state)
+{
+	unsigned int offset = parsed->offset;
+	struct rte_ether_hdr *ether_hdr = parsed->ether_hdr;
+	struct rte_ipv4_hdr *ipv4_hdr = parsed->ipv4_hdr;
+	struct rte_udp_hdr *udp_hdr = parsed->udp_hdr;
+	struct lf_ip_hdr *lf_hdr = parsed->lf_hdr;
+
+	if (unlikely(check_state != LF_CHECK_VALID)) {
+		/* TODO: (fstreun) for testing, all packets are checked as valid.
+		 * However, under attack it is more likely that packets are declared
+		 * invalid. */
+		return LF_PKT_INBOUND_DROP;
+	}
 
 #if !LF_WORKER_OMIT_DECAPSULATION
 	/**
@@ -149,6 +222,10 @@ handle_inbound_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m,
 	(void)udp_hdr;
 	(void)lf_hdr;
 	(void)offset;
+#else
+	(void)udp_hdr;
+	(void)lf_hdr;
+	(void)offset;
 #endif /* !LF_WORKER_OMIT_DECAPSULATION */
 
 	/*
@@ -162,6 +239,40 @@ handle_inbound_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m,
 	return LF_PKT_INBOUND_FORWARD;
 }
 
+/**
+ * @param offset Offset to memory after ethernet, IP header, and UDP header.
+ */
+static enum lf_pkt_action
+handle_inbound_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m,
+		unsigned int offset, struct rte_ether_hdr *ether_hdr,
+		struct rte_ipv4_hdr *ipv4_hdr, struct rte_udp_hdr *udp_hdr)
+{
+	int res;
+	enum lf_check_state check_state;
+	struct parsed_inbound_pkt parsed;
+
+	parsed.ether_hdr = ether_hdr;
+	parsed.ipv4_hdr = ipv4_hdr;
+	parsed.udp_hdr = udp_hdr;
+
+	res = prepare_inbound_pkt(worker_context, m, offset, &parsed);
+	if (unlikely(res != 0)) {
+		return LF_PKT_INBOUND_DROP;
+	}
+
+	check_state = lf_worker_check_pkt(worker_context, &parsed.pkt_data);
+
+	/* Only if all checks are passed, the packet hash is checked. */
+	if (likely(check_state == LF_CHECK_VALID)) {
+		res = check_pkt_hash(worker_context, m, &parsed);
+		if (res != 0) {
+			check_state = LF_CHECK_VALID_MAC_BUT_INVALID_HASH;
+		}
+	}
+
+	return finalize_inbound_pkt(worker_context, m, &parsed, check_state);
+}
+
 /**
  * @param offset Offset to memory after the ethernet and IP header.
  * @return Size of the upd/lf header construct, which has been added.
@@ -324,13 +435,26 @@ handle_outbound_pkt(struct lf_worker_context *worker_context,
 	return LF_PKT_OUTBOUND_FORWARD;
 }
 
-static enum lf_pkt_action
-handle_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m)
+enum preprocess_pkt_res {
+	PKT_ERROR,
+	PKT_OUTBOUND,
+	PKT_INBOUND,
+};
+
+/**
+ * Parse the ethernet, IP, and (if available) UDP header and determine the
+ * direction of the packet.
+ *
+ * @param offset Returns the offset to the memory after the IP header for
+ * outbound packets and after the UDP header for inbound packets.
+ * @return enum preprocess_pkt_res
+ */
+static enum preprocess_pkt_res
+preprocess_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m,
+		unsigned int *offset, struct rte_ether_hdr **ether_hdr,
+		struct rte_ipv4_hdr **ipv4_hdr, struct rte_udp_hdr **udp_hdr)
 {
-	unsigned int offset, offset_tmp;
-	struct rte_ether_hdr *ether_hdr;
-	struct rte_ipv4_hdr *ipv4_hdr;
-	struct rte_udp_hdr *udp_hdr;
+	unsigned int offset_tmp;
 
 	uint16_t lf_port = lf_configmanager_worker_get_port(worker_context->config);
 
@@ -338,52 +462,227 @@ handle_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m)
 		LF_WORKER_LOG_DP(NOTICE,
 				"Not yet implemented: buffer with multiple segments "
 				"received.\n");
-		return LF_PKT_UNKNOWN_DROP;
+		return PKT_ERROR;
 	}
 
-	offset = 0;
-	offset = lf_get_eth_hdr(m, offset, &ether_hdr);
-	if (unlikely(offset == 0)) {
-		return LF_PKT_UNKNOWN_DROP;
+	*offset = 0;
+	*offset = lf_get_eth_hdr(m, *offset, ether_hdr);
+	if (unlikely(*offset == 0)) {
+		return PKT_ERROR;
 	}
 
-	if (unlikely(ether_hdr->ether_type !=
+	if (unlikely((*ether_hdr)->ether_type !=
 				 rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4))) {
 		LF_WORKER_LOG_DP(NOTICE,
 				"Unsupported packet type %#X: must be IPv4 (%#X).\n",
-				rte_be_to_cpu_16(ether_hdr->ether_type), RTE_ETHER_TYPE_IPV4);
-		return LF_PKT_UNKNOWN_DROP;
+				rte_be_to_cpu_16((*ether_hdr)->ether_type),
+				RTE_ETHER_TYPE_IPV4);
+		return PKT_ERROR;
 	}
 
-	offset = lf_get_ip_hdr(m, offset, &ipv4_hdr);
-	if (unlikely(offset == 0)) {
-		return LF_PKT_UNKNOWN_DROP;
+	*offset = lf_get_ip_hdr(m, *offset, ipv4_hdr);
+	if (unlikely(*offset == 0)) {
+		return PKT_ERROR;
 	}
 
 	/*
 	 * With the destination UDP port number, it is determined
 	 * if the packet is a inbound or outbound packet.
 	 */
-	if (ipv4_hdr->next_proto_id == IP_PROTO_ID_UDP) {
-		offset_tmp = lf_get_udp_hdr(m, offset, &udp_hdr);
+	if ((*ipv4_hdr)->next_proto_id == IP_PROTO_ID_UDP) {
+		offset_tmp = lf_get_udp_hdr(m, *offset, udp_hdr);
 		if (unlikely(offset_tmp == 0)) {
-			return LF_PKT_UNKNOWN_DROP;
+			return PKT_ERROR;
 		}
-		if (udp_hdr->dst_port == lf_port) {
+		if ((*udp_hdr)->dst_port == lf_port) {
 			LF_WORKER_LOG_DP(DEBUG, "Inbound packet\n");
-			return handle_inbound_pkt(worker_context, m, offset_tmp, ether_hdr,
-					ipv4_hdr, udp_hdr);
+			*offset = offset_tmp;
+			return PKT_INBOUND;
 		}
 	}
 	LF_WORKER_LOG_DP(DEBUG, "Outbound packet\n");
-	return handle_outbound_pkt(worker_context, m, offset, ether_hdr, ipv4_hdr);
+	return PKT_OUTBOUND;
 }
 
+static enum lf_pkt_action
+handle_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m)
+{
+	unsigned int offset;
+	struct rte_ether_hdr *ether_hdr;
+	struct rte_ipv4_hdr *ipv4_hdr;
+	struct rte_udp_hdr *udp_hdr = NULL;
+
+	switch (preprocess_pkt(worker_context, m, &offset, &ether_hdr, &ipv4_hdr,
+			&udp_hdr)) {
+	case PKT_INBOUND:
+		return handle_inbound_pkt(worker_context, m, offset, ether_hdr,
+				ipv4_hdr, udp_hdr);
+	case PKT_OUTBOUND:
+		return handle_outbound_pkt(worker_context, m, offset, ether_hdr,
+				ipv4_hdr);
+	case PKT_ERROR:
+	default:
+		return LF_PKT_UNKNOWN_DROP;
+	}
+}
+
+#if LF_WORKER_BURST_PIPELINE
+/**
+ * Perform the packet hash check for all inbound packets of the burst that have
+ * passed all other checks, i.e., that are marked with LF_CHECK_VALID. The
+ * payloads are hashed together (see lf_crypto_hash_final_burst()).
+ * Packets with an invalid packet hash are marked with
+ * LF_CHECK_VALID_MAC_BUT_INVALID_HASH.
+ */
+static void
+check_pkt_hash_burst(struct lf_worker_context *worker_context,
+		struct rte_mbuf **pkt_burst, const uint16_t lf_pkt_index[],
+		struct parsed_inbound_pkt parsed_pkt[], uint16_t nb_lf_pkts,
+		enum lf_check_state check_states[])
+{
+#if LF_WORKER_OMIT_HASH_CHECK
+	(void)worker_context;
+	(void)pkt_burst;
+	(void)lf_pkt_index;
+	(void)parsed_pkt;
+	(void)nb_lf_pkts;
+	(void)check_states;
+#else
+	uint16_t j, k, nb_hashes = 0;
+	uint16_t hash_index[LF_MAX_PKT_BURST];
+	struct lf_crypto_hash_ctx *ctx[LF_MAX_PKT_BURST];
+	const uint8_t *payload[LF_MAX_PKT_BURST];
+	size_t payload_len[LF_MAX_PKT_BURST];
+	uint8_t hash[LF_MAX_PKT_BURST][LF_CRYPTO_HASH_LENGTH];
+	uint8_t *hash_ptr[LF_MAX_PKT_BURST];
+
+	for (j = 0; j < nb_lf_pkts; j++) {
+		if (unlikely(check_states[j] != LF_CHECK_VALID)) {
+			continue;
+		}
+
+		ctx[nb_hashes] = &worker_context->crypto_hash_burst_ctx[nb_hashes];
+		payload[nb_hashes] = (const uint8_t *)(parsed_pkt[j].lf_hdr + 1);
+		payload_len[nb_hashes] =
+				pkt_burst[lf_pkt_index[j]]->pkt_len - parsed_pkt[j].offset;
+		hash_ptr[nb_hashes] = hash[nb_hashes];
+		hash_index[nb_hashes] = j;
+		nb_hashes++;
+	}
+
+	LF_WORKER_LOG_DP(DEBUG, "Check %u packet hashes.\n", nb_hashes);
+	lf_crypto_hash_final_burst(ctx, payload, payload_len, hash_ptr,
+			nb_hashes);
+
+	for (k = 0; k < nb_hashes; k++) {
+		j = hash_index[k];
+		if (cmp_pkt_hash(worker_context, hash[k], &parsed_pkt[j]) != 0) {
+			check_states[j] = LF_CHECK_VALID_MAC_BUT_INVALID_HASH;
+		}
+	}
+#endif /* LF_WORKER_OMIT_HASH_CHECK */
+}
+
+/**
+ * Handle a burst of packets stage-wise.
+ * First, all packets of the burst are parsed and classified. Outbound packets
+ * are handled right away. Then, the checks are performed for all inbound
+ * packets at once (see lf_worker_check_pkt_burst()), followed by the packet
+ * hash check of all valid packets. Finally, the valid inbound packets are
+ * decapsulated.
+ */
+static void
+handle_pkt_burst(struct lf_worker_context *worker_context,
+		struct rte_mbuf **pkt_burst, uint16_t nb_pkts,
+		enum lf_pkt_action *pkt_res)
+{
+	int res;
+	uint16_t i, j, nb_lf_pkts = 0;
+	unsigned int offset;
+	struct rte_mbuf *m;
+	struct parsed_inbound_pkt *parsed;
+
+	/* State of the inbound packets. */
+	uint16_t lf_pkt_index[LF_MAX_PKT_BURST];
+	struct parsed_inbound_pkt parsed_pkt[LF_MAX_PKT_BURST];
+	struct lf_pkt_data pkt_data[LF_MAX_PKT_BURST];
+	enum lf_check_state check_states[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts && i < LF_WORKER_PREFETCH_OFFSET; i++) {
+		rte_prefetch0(rte_pktmbuf_mtod(pkt_burst[i], void *));
+	}
+
+	/*
+	 * Parse and classify all packets.
+	 */
+	for (i = 0; i < nb_pkts; i++) {
+		if (i + LF_WORKER_PREFETCH_OFFSET < nb_pkts) {
+			rte_prefetch0(rte_pktmbuf_mtod(
+					pkt_burst[i + LF_WORKER_PREFETCH_OFFSET], void *));
+		}
+
+		if (pkt_res[i] != LF_PKT_UNKNOWN) {
+			/* If packet action is already determined, do not process it */
+			continue;
+		}
+
+		m = pkt_burst[i];
+		parsed = &parsed_pkt[nb_lf_pkts];
+
+		switch (preprocess_pkt(worker_context, m, &offset, &parsed->ether_hdr,
+				&parsed->ipv4_hdr, &parsed->udp_hdr)) {
+		case PKT_INBOUND:
+			break;
+		case PKT_OUTBOUND:
+			pkt_res[i] = handle_outbound_pkt(worker_context, m, offset,
+					parsed->ether_hdr, parsed->ipv4_hdr);
+			continue;
+		case PKT_ERROR:
+		default:
+			pkt_res[i] = LF_PKT_UNKNOWN_DROP;
+			continue;
+		}
+
+		res = prepare_inbound_pkt(worker_context, m, offset, parsed);
+		if (unlikely(res != 0)) {
+			pkt_res[i] = LF_PKT_INBOUND_DROP;
+			continue;
+		}
+
+		/* The destination address refers to the parsed packet struct. */
+		pkt_data[nb_lf_pkts] = parsed->pkt_data;
+		lf_pkt_index[nb_lf_pkts] = i;
+		nb_lf_pkts++;
+	}
+
+	/*
+	 * Check all inbound packets.
+	 */
+	lf_worker_check_pkt_burst(worker_context, pkt_data, nb_lf_pkts,
+			check_states);
+
+	/* Only if all checks are passed, the packet hash is checked. */
+	check_pkt_hash_burst(worker_context, pkt_burst, lf_pkt_index, parsed_pkt,
+			nb_lf_pkts, check_states);
+
+	for (j = 0; j < nb_lf_pkts; j++) {
+		i = lf_pkt_index[j];
+		pkt_res[i] = finalize_inbound_pkt(worker_context, pkt_burst[i],
+				&parsed_pkt[j], check_states[j]);
+	}
+}
+#endif /* LF_WORKER_BURST_PIPELINE */
+
 void
 lf_worker_handle_pkt(struct lf_worker_context *worker_context,
 		struct rte_mbuf **pkt_burst, uint16_t nb_pkts,
 		enum lf_pkt_action *pkt_res)
 {
+#if LF_WORKER_BURST_PIPELINE
+	handle_pkt_burst(worker_context, pkt_burst, nb_pkts, pkt_res);
+	return;
+#endif /* LF_WORKER_BURST_PIPELINE */
+
 	int i;
 
 	for (i = 0; i < nb_pkts; i++) {
@@ -12,11 +12,13 @@
 #include <rte_ip.h>
 #include <rte_mbuf.h>
 #include <rte_mbuf_core.h>
+#include <rte_prefetch.h>
 #include <rte_tcp.h>
 #include <rte_udp.h>
 
 #include "config.h"
 #include "configmanager.h"
+#include "egress.h"
 #include "lf.h"
 #include "lib/crypto/crypto.h"
 #include "lib/scion/scion.h"
@@ -261,7 +263,7 @@ hash_cmn_hdr(struct lf_crypto_hash_ctx *ctx,
 }
 
 static inline int
-hash_path_hdr(struct lf_worker_context *worker_context, void *path_hdr,
+hash_path_hdr(struct lf_crypto_hash_ctx *ctx, void *path_hdr,
 		uint8_t path_type, uint32_t path_header_len)
 {
 	switch (path_type) {
@@ -336,7 +338,7 @@ hash_path_hdr(struct lf_worker_context *worker_context, void *path_hdr,
 			hop_field += 1;
 		}
 
-		lf_crypto_hash_update(&worker_context->crypto_hash_ctx,
+		lf_crypto_hash_update(ctx,
 				(uint8_t *)path_hdr, path_header_len);
 
 		/* PathMeta Header reset */
@@ -375,14 +377,14 @@ hash_path_hdr(struct lf_worker_context *worker_context, void *path_hdr,
 				(struct scion_path_hop_hdr *)(scion_path_info_hdr + 1);
 		uint8_t router_alerts_old = hop_field_1->rie;
 		hop_field_1->rie &= 0xFC; // 0b11111100;
-		lf_crypto_hash_update(&worker_context->crypto_hash_ctx,
+		lf_crypto_hash_update(ctx,
 				(uint8_t *)path_hdr,
 				SCION_PATH_INFOFIELD_SIZE + SCION_PATH_HOPFIELD_SIZE);
 		hop_field_1->rie = router_alerts_old;
 
 		/* add second hop field (with everything zeroed) */
 		uint8_t hop_field_zeroed[SCION_PATH_HOPFIELD_SIZE] = { 0 };
-		lf_crypto_hash_update(&worker_context->crypto_hash_ctx,
+		lf_crypto_hash_update(ctx,
 				hop_field_zeroed, SCION_PATH_HOPFIELD_SIZE);
 		break;
 	}
@@ -396,34 +398,35 @@ hash_path_hdr(struct lf_worker_context *worker_context, void *path_hdr,
 }
 
 /**
+ * Hash the SCION common and path header of the packet into the hash context
+ * and determine the payload, which is hashed last.
  * Assume that the complete SCION header (limited through its size defined
  * in the cmn header) can be accessed in the same mbuf.
+ * @param payload Returns the pointer to the payload.
  * @return 0 if succeeds.
  */
 static inline int
-compute_pkt_hash(struct lf_worker_context *worker_context, struct rte_mbuf *m,
+hash_pkt_hdr(struct lf_crypto_hash_ctx *ctx, struct rte_mbuf *m,
 		struct parsed_pkt *parsed_pkt, struct parsed_spao *parsed_spao,
-		uint8_t hash[LF_CRYPTO_HASH_LENGTH])
+		uint8_t **payload)
 {
 	int res;
-	uint8_t *payload;
 
 	/* hash common header */
-	res = hash_cmn_hdr(&worker_context->crypto_hash_ctx,
-			parsed_pkt->scion_cmn_hdr);
+	res = hash_cmn_hdr(ctx, parsed_pkt->scion_cmn_hdr);
 	if (unlikely(res != 0)) {
 		return res;
 	}
 
 	/* hash path header */
-	res = hash_path_hdr(worker_context, parsed_pkt->scion_path_hdr,
+	res = hash_path_hdr(ctx, parsed_pkt->scion_path_hdr,
 			parsed_pkt->scion_cmn_hdr->path_type,
 			parsed_pkt->scion_path_hdr_len);
 	if (unlikely(res != 0)) {
 		return res;
 	}
 
-	/* hash payload */
+	/* payload */
 	if (unlikely(parsed_spao->payload_offset + parsed_spao->payload_length >
 				 m->data_len)) {
 		LF_WORKER_LOG_DP(NOTICE,
@@ -434,8 +437,34 @@ compute_pkt_hash(struct lf_worker_context *worker_context, struct rte_mbuf *m,
 				m->data_len);
 		return -1;
 	}
-	payload =
+	*payload =
 			rte_pktmbuf_mtod_offset(m, uint8_t *, parsed_spao->payload_offset);
+
+	return 0;
+}
+
+/**
+ * Assume that the complete SCION header (limited through its size defined
+ * in the cmn header) can be accessed in the same mbuf.
+ * @return 0 if succeeds.
+ */
+static inline int
+compute_pkt_hash(struct lf_worker_context *worker_context, struct rte_mbuf *m,
+		struct parsed_pkt *parsed_pkt, struct parsed_spao *parsed_spao,
+		uint8_t hash[LF_CRYPTO_HASH_LENGTH])
+{
+	int res;
+	uint8_t *payload;
+
+	res = hash_pkt_hdr(&worker_context->crypto_hash_ctx, m, parsed_pkt,
+			parsed_spao, &payload);
+	if (unlikely(res != 0)) {
+		/* reset hash context */
+		lf_crypto_hash_final(&worker_context->crypto_hash_ctx, hash);
+		return res;
+	}
+
+	/* hash payload */
 	(void)lf_crypto_hash_update(&worker_context->crypto_hash_ctx, payload,
 			parsed_spao->payload_length);
 
@@ -445,6 +474,35 @@ compute_pkt_hash(struct lf_worker_context *worker_context, struct rte_mbuf *m,
 	return 0;
 }
 
+/**
+ * Compare the computed packet hash with the one in the SPAO header, log the
+ * result and update the statistics accordingly.
+ *
+ * @return Returns 0 if the packet hash is valid or the check is ignored.
+ */
+static inline int
+cmp_pkt_hash(struct lf_worker_context *worker_context,
+		const uint8_t hash[LF_CRYPTO_HASH_LENGTH],
+		const struct parsed_spao *parsed_spao)
+{
+	int res;
+
+	res = lf_crypto_hash_cmp(hash, parsed_spao->spao_hdr->hash);
+	if (likely(res != 0)) {
+		LF_WORKER_LOG_DP(DEBUG, "Packet hash check failed.\n");
+		lf_statistics_worker_counter_inc(worker_context->statistics,
+				invalid_hash);
+	} else {
+		LF_WORKER_LOG_DP(DEBUG, "Packet hash check passed.\n");
+	}
+
+#if (LF_WORKER_IGNORE_HASH_CHECK)
+	res = 0;
+#endif /* !(LF_WORKER_IGNORE_HASH_CHECK) */
+
+	return res;
+}
+
 /**
  * Perform packet hash check.
  * If this check is disable, the check is not performed and the function just
@@ -472,20 +530,7 @@ check_pkt_hash(struct lf_worker_context *worker_context, struct rte_mbuf *m,
 		return 1;
 	}
 
-	res = lf_crypto_hash_cmp(hash, parsed_spao->spao_hdr->hash);
-	if (likely(res != 0)) {
-		LF_WORKER_LOG_DP(DEBUG, "Packet hash check failed.\n");
-		lf_statistics_worker_counter_inc(worker_context->statistics,
-				invalid_hash);
-	} else {
-		LF_WORKER_LOG_DP(DEBUG, "Packet hash check passed.\n");
-	}
-
-#if (LF_WORKER_IGNORE_HASH_CHECK)
-	res = 0;
-#endif /* !(LF_WORKER_IGNORE_HASH_CHECK) */
-
-	return res;
+	return cmp_pkt_hash(worker_context, hash, parsed_spao);
 }
 
 static void
@@ -615,8 +660,8 @@ static enum lf_check_state
 handle_inbound_pkt_without_lf_hdr(struct lf_worker_context *worker_context,
 		struct rte_mbuf *m, struct parsed_pkt *parsed_pkt)
 {
-	(void)parsed_pkt;
-	return lf_worker_check_best_effort_pkt(worker_context, m->pkt_len);
+	return lf_worker_check_best_effort_pkt(worker_context,
+			parsed_pkt->scion_addr_ia_hdr->src_ia, m->pkt_len);
 }
 
 static enum lf_check_state
@@ -648,6 +693,34 @@ handle_inbound_pkt_with_lf_hdr(struct lf_worker_context *worker_context,
 	}
 }
 
+/**
+ * Apply the inbound packet modifications and determine the packet action
+ * according to the result of the packet checks.
+ *
+ * @param check_state Result of the inbound packet checks.
+ * @return enum lf_pkt_action
+ */
+static enum lf_pkt_action
+finalize_inbound_pkt(struct lf_worker_context *worker_context,
+		struct rte_mbuf *m, struct parsed_pkt *parsed_pkt,
+		enum lf_check_state check_state)
+{
+	lf_worker_pkt_mod(m, parsed_pkt->ether_hdr, parsed_pkt->l3_hdr,
+			lf_configmanager_worker_get_inbound_pkt_mod(
+					worker_context->config));
+
+	if (check_state == LF_CHECK_BE && worker_context->egress != NULL) {
+		/* scheduled by the source AS in the egress stage */
+		lf_egress_mark(m, parsed_pkt->scion_addr_ia_hdr->src_ia);
+	}
+
+	if (check_state == LF_CHECK_VALID || check_state == LF_CHECK_BE) {
+		return LF_PKT_INBOUND_FORWARD;
+	} else {
+		return LF_PKT_INBOUND_DROP;
+	}
+}
+
 /**
  * Handle inbound packets.
  *
@@ -676,15 +749,7 @@ handle_inbound_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m,
 		check_state = LF_CHECK_ERROR;
 	}
 
-	lf_worker_pkt_mod(m, parsed_pkt->ether_hdr, parsed_pkt->l3_hdr,
-			lf_configmanager_worker_get_inbound_pkt_mod(
-					worker_context->config));
-
-	if (check_state == LF_CHECK_VALID || check_state == LF_CHECK_BE) {
-		return LF_PKT_INBOUND_FORWARD;
-	} else {
-		return LF_PKT_INBOUND_DROP;
-	}
+	return finalize_inbound_pkt(worker_context, m, parsed_pkt, check_state);
 }
 
 /**
@@ -1110,11 +1175,184 @@ handle_pkt(struct lf_worker_context *worker_context, struct rte_mbuf *m)
 	}
 }
 
+#if LF_WORKER_BURST_PIPELINE
+/**
+ * Perform the packet hash check for all packets of the burst that have passed
+ * all other checks, i.e., that are marked with LF_CHECK_VALID. The headers are
+ * hashed for each packet individually, while the payloads of all packets are
+ * hashed together (see lf_crypto_hash_final_burst()).
+ * Packets with an invalid packet hash are marked with
+ * LF_CHECK_VALID_MAC_BUT_INVALID_HASH.
+ */
+static void
+check_pkt_hash_burst(struct lf_worker_context *worker_context,
+		struct rte_mbuf **pkt_burst, const uint16_t lf_pkt_index[],
+		struct parsed_pkt parsed_pkt[], struct parsed_spao parsed_spao[],
+		uint16_t nb_lf_pkts, enum lf_check_state check_states[])
+{
+#if (LF_WORKER_OMIT_HASH_CHECK)
+	return;
+#endif /* !(LF_WORKER_OMIT_HASH_CHECK) */
+
+	int res;
+	uint16_t j, k, nb_hashes = 0;
+	uint16_t hash_index[LF_MAX_PKT_BURST];
+	struct lf_crypto_hash_ctx *ctx[LF_MAX_PKT_BURST];
+	uint8_t *payload[LF_MAX_PKT_BURST];
+	size_t payload_len[LF_MAX_PKT_BURST];
+	uint8_t hash[LF_MAX_PKT_BURST][LF_CRYPTO_HASH_LENGTH];
+	uint8_t *hash_ptr[LF_MAX_PKT_BURST];
+
+	for (j = 0; j < nb_lf_pkts; j++) {
+		if (likely(check_states[j] != LF_CHECK_VALID)) {
+			continue;
+		}
+
+		ctx[nb_hashes] = &worker_context->crypto_hash_burst_ctx[nb_hashes];
+		res = hash_pkt_hdr(ctx[nb_hashes], pkt_burst[lf_pkt_index[j]],
+				&parsed_pkt[j], &parsed_spao[j], &payload[nb_hashes]);
+		if (unlikely(res != 0)) {
+			/* reset hash context */
+			lf_crypto_hash_final(ctx[nb_hashes], hash[nb_hashes]);
+			LF_WORKER_LOG_DP(ERR, "Failed to compute hash. res = %d\n", res);
+			lf_statistics_worker_counter_inc(worker_context->statistics,
+					error);
+			check_states[j] = LF_CHECK_VALID_MAC_BUT_INVALID_HASH;
+			continue;
+		}
+
+		payload_len[nb_hashes] = parsed_spao[j].payload_length;
+		hash_ptr[nb_hashes] = hash[nb_hashes];
+		hash_index[nb_hashes] = j;
+		nb_hashes++;
+	}
+
+	LF_WORKER_LOG_DP(DEBUG, "Finalize %u hashes\n", nb_hashes);
+	lf_crypto_hash_final_burst(ctx, (const uint8_t *const *)payload,
+			payload_len, hash_ptr, nb_hashes);
+
+	for (k = 0; k < nb_hashes; k++) {
+		j = hash_index[k];
+		res = cmp_pkt_hash(worker_context, hash[k], &parsed_spao[j]);
+		if (res != 0) {
+			check_states[j] = LF_CHECK_VALID_MAC_BUT_INVALID_HASH;
+		}
+	}
+}
+
+/**
+ * Handle a burst of packets stage-wise.
+ * First, all packets of the burst are parsed and classified. Packets that do
+ * not require the LightningFilter checks (outbound, intra-AS, best-effort) are
+ * handled right away. Then, the checks are performed for all inbound LF
+ * packets at once (see lf_worker_check_pkt_burst()). Finally, the packet
+ * hashes of the valid packets are checked together and the inbound packet
+ * modifications are applied.
+ */
+static void
+handle_pkt_burst(struct lf_worker_context *worker_context,
+		struct rte_mbuf **pkt_burst, uint16_t nb_pkts,
+		enum lf_pkt_action *pkt_res)
+{
+	int res;
+	uint16_t i, j, nb_lf_pkts = 0;
+	struct rte_mbuf *m;
+	enum lf_check_state check_state;
+
+	/* State of the inbound packets that carry a LF SPAO header. */
+	uint16_t lf_pkt_index[LF_MAX_PKT_BURST];
+	struct parsed_pkt parsed_pkt[LF_MAX_PKT_BURST];
+	struct parsed_spao parsed_spao[LF_MAX_PKT_BURST];
+	struct lf_pkt_data pkt_data[LF_MAX_PKT_BURST];
+	enum lf_check_state check_states[LF_MAX_PKT_BURST];
+
+	for (i = 0; i < nb_pkts && i < LF_WORKER_PREFETCH_OFFSET; i++) {
+		rte_prefetch0(rte_pktmbuf_mtod(pkt_burst[i], void *));
+	}
+
+	/*
+	 * Parse and classify all packets.
+	 */
+	for (i = 0; i < nb_pkts; i++) {
+		if (i + LF_WORKER_PREFETCH_OFFSET < nb_pkts) {
+			rte_prefetch0(rte_pktmbuf_mtod(
+					pkt_burst[i + LF_WORKER_PREFETCH_OFFSET], void *));
+		}
+
+		if (pkt_res[i] != LF_PKT_UNKNOWN) {
+			/* If packet action is already determined, do not process it */
+			continue;
+		}
+
+		m = pkt_burst[i];
+		j = nb_lf_pkts;
+
+		switch (preprocess_pkt(worker_context, m, &parsed_pkt[j])) {
+		case PKT_INBOUND:
+			break;
+		case PKT_OUTBOUND:
+			pkt_res[i] = handle_outbound_pkt(worker_context, m, &parsed_pkt[j]);
+			continue;
+		case PKT_INTRA_AS:
+			pkt_res[i] = LF_PKT_UNKNOWN_FORWARD;
+			continue;
+		case PKT_ERROR:
+		case PKT_UNEXPECTED:
+		default:
+			pkt_res[i] = LF_PKT_UNKNOWN_DROP;
+			continue;
+		}
+
+		res = get_lf_spao_hdr(m, &parsed_pkt[j], &parsed_spao[j],
+				&pkt_data[j]);
+		if (likely(res == 0)) {
+			/* Checks are performed for all LF packets together. */
+			preprocess_mac_input(&parsed_pkt[j], &parsed_spao[j]);
+			lf_pkt_index[j] = i;
+			nb_lf_pkts++;
+			continue;
+		} else if (res > 0) {
+			check_state = handle_inbound_pkt_without_lf_hdr(worker_context, m,
+					&parsed_pkt[j]);
+		} else {
+			check_state = LF_CHECK_ERROR;
+		}
+		pkt_res[i] = finalize_inbound_pkt(worker_context, m, &parsed_pkt[j],
+				check_state);
+	}
+
+	/*
+	 * Check all inbound LF packets.
+	 */
+	lf_worker_check_pkt_burst(worker_context, pkt_data, nb_lf_pkts,
+			check_states);
+
+	for (j = 0; j < nb_lf_pkts; j++) {
+		postprocess_mac_input(&parsed_spao[j]);
+	}
+
+	/* Only if all checks are passed, the packet hash is checked. */
+	check_pkt_hash_burst(worker_context, pkt_burst, lf_pkt_index, parsed_pkt,
+			parsed_spao, nb_lf_pkts, check_states);
+
+	for (j = 0; j < nb_lf_pkts; j++) {
+		i = lf_pkt_index[j];
+		pkt_res[i] = finalize_inbound_pkt(worker_context, pkt_burst[i],
+				&parsed_pkt[j], check_states[j]);
+	}
+}
+#endif /* LF_WORKER_BURST_PIPELINE */
+
 void
 lf_worker_handle_pkt(struct lf_worker_context *worker_context,
 		struct rte_mbuf **pkt_burst, uint16_t nb_pkts,
 		enum lf_pkt_action *pkt_res)
 {
+#if LF_WORKER_BURST_PIPELINE
+	handle_pkt_burst(worker_context, pkt_burst, nb_pkts, pkt_res);
+	return;
+#endif /* LF_WORKER_BURST_PIPELINE */
+
 	int i;
 
 	for (i = 0; i < nb_pkts; i++) {
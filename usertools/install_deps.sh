@@ -30,8 +30,6 @@ echo "# The following lines were created by install_deps.sh" >> $ENV_VARS_FILE
 sudo apt -y install build-essential gcc make cmake pkg-config
 # OpenSSL
 sudo apt -y install libssl-dev
-# AESNI
-sudo apt -y install yasm
 # Testing Dependencies
 sudo apt -y install bsdmainutils tmux
 